@@ -0,0 +1,176 @@
+// bench/bench_checksum.c
+// Mede o custo dos checksums CRC32C: primeiro a vazão das implementações
+// (SSE4.2, slicing-by-8 e memcpy como referência) e depois a de import/cat
+// no simulador com e sem a verificação ligada, para cada tamanho de bloco.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "crc32c.h"
+#include "fs_core.h"
+
+#define BENCH_DISK "bench_checksum.disk"
+#define BENCH_HOST_FILE "bench_checksum.src"
+#define BENCH_DISK_KB (64 * 1024)
+#define BENCH_DATA_MB 24        // Volume importado por execução, igual para todo tamanho de bloco
+#define BENCH_DIRS 8
+#define BENCH_READ_ROUNDS 20
+#define BENCH_REPEAT 7          // Melhor de N execuções alternadas, para reduzir o ruído
+
+static int files_per_dir;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile uint32_t sink;
+
+static void bench_crc(const char* label, uint32_t (*fn)(uint32_t, const void*, size_t), const char* buf, size_t block, size_t total) {
+    double start = now_sec();
+    uint32_t crc = 0;
+    for (size_t done = 0; done < total; done += block) crc ^= fn(0, buf + done % (1 << 20), block);
+    double elapsed = now_sec() - start;
+    sink = crc;
+    printf("  %-14s %8.0f MB/s\n", label, total / elapsed / (1 << 20));
+}
+
+static char copy_dst[1 << 16];
+static uint32_t memcpy_as_crc(uint32_t crc, const void* data, size_t len) {
+    memcpy(copy_dst, data, len);
+    return crc ^ (uint8_t) copy_dst[len - 1];
+}
+
+static int count_chunk(const char* data, size_t len, void* ctx) {
+    *(size_t*) ctx += len;
+    (void) data;
+    return 0;
+}
+
+// Importa e lê os mesmos arquivos com a verificação ligada ou desligada.
+static int bench_fs(int no_checksum, uint32_t block_kb, double* write_s, double* read_s) {
+    if (fs_format(BENCH_DISK, BENCH_DISK_KB, block_kb) != 0) return -1;
+    MountOptions options = {0};
+    options.no_checksum = no_checksum;
+    if (fs_mount_with_options(BENCH_DISK, &options) != 0) return -1;
+    char name[32];
+    double start = now_sec();
+    for (int d = 0; d < BENCH_DIRS; ++d) {
+        snprintf(name, sizeof(name), "d%d", d);
+        if (fs_create_directory(name) != 0 || fs_change_directory(name) != 0) return -1;
+        for (int f = 0; f < files_per_dir; ++f) {
+            snprintf(name, sizeof(name), "f%d", f);
+            if (fs_import_file(BENCH_HOST_FILE, name) != 0) return -1;
+        }
+        fs_change_directory("..");
+    }
+    fs_sync();
+    *write_s = now_sec() - start;
+
+    size_t bytes = 0;
+    start = now_sec();
+    for (int r = 0; r < BENCH_READ_ROUNDS; ++r) {
+        for (int d = 0; d < BENCH_DIRS; ++d) {
+            snprintf(name, sizeof(name), "d%d", d);
+            fs_change_directory(name);
+            for (int f = 0; f < files_per_dir; ++f) {
+                snprintf(name, sizeof(name), "f%d", f);
+                if (fs_stream_file(name, count_chunk, &bytes) != 0) return -1;
+            }
+            fs_change_directory("..");
+        }
+    }
+    *read_s = now_sec() - start;
+    fs_unmount();
+    return 0;
+}
+
+typedef struct {
+    uint32_t block_kb;
+    double import_off, import_on;  // MB/s sem e com CRC
+    double cat_off, cat_on;
+} BenchResult;
+
+static int bench_block_size(uint32_t block_kb, BenchResult* result) {
+    size_t block = block_kb * 1024;
+    // Arquivos com todos os blocos diretos; a quantidade fecha BENCH_DATA_MB,
+    // limitada ao que cabe nos 12 blocos de cada diretório
+    files_per_dir = (int) (((size_t) BENCH_DATA_MB << 20) / (12 * block) / BENCH_DIRS);
+    int dir_capacity = (int) (12 * block / sizeof(DirectoryEntry)) - 2;
+    if (files_per_dir > dir_capacity) files_per_dir = dir_capacity;
+    if (files_per_dir < 1) files_per_dir = 1;
+
+    char* buf = malloc(1 << 20);
+    if (!buf) return -1;
+    for (int i = 0; i < (1 << 20); ++i) buf[i] = (char) rand();
+    printf("CRC32C em blocos de %zu bytes (implementação ativa: %s)\n", block, crc32c_impl());
+    size_t total = (size_t) 512 << 20;
+    bench_crc("memcpy", memcpy_as_crc, buf, block, total);
+    bench_crc("slicing-by-8", crc32c_sw, buf, block, total);
+    bench_crc(crc32c_impl(), crc32c, buf, block, total);
+
+    FILE* src = fopen(BENCH_HOST_FILE, "wb");
+    if (!src) {
+        free(buf);
+        return -1;
+    }
+    for (size_t done = 0; done < 12 * block; done += 1 << 20) {
+        size_t n = 12 * block - done < (1 << 20) ? 12 * block - done : (1 << 20);
+        fwrite(buf, 1, n, src);
+    }
+    fclose(src);
+    free(buf);
+
+    double w_off = 1e9, r_off = 1e9, w_on = 1e9, r_on = 1e9;
+    for (int rep = 0; rep < BENCH_REPEAT; ++rep) {
+        for (int no_checksum = 1; no_checksum >= 0; --no_checksum) {
+            double w, r;
+            if (bench_fs(no_checksum, block_kb, &w, &r) != 0) return -1;
+            double* best_w = no_checksum ? &w_off : &w_on;
+            double* best_r = no_checksum ? &r_off : &r_on;
+            if (w < *best_w) *best_w = w;
+            if (r < *best_r) *best_r = r;
+        }
+    }
+    double mb_written = BENCH_DIRS * files_per_dir * 12.0 * block / (1 << 20);
+    double mb_read = mb_written * BENCH_READ_ROUNDS;
+    result->block_kb = block_kb;
+    result->import_off = mb_written / w_off;
+    result->import_on = mb_written / w_on;
+    result->cat_off = mb_read / r_off;
+    result->cat_on = mb_read / r_on;
+    printf("  %d arquivos de %zu KB, %d leituras de cada\n\n", BENCH_DIRS * files_per_dir, 12 * block / 1024, BENCH_READ_ROUNDS);
+    return 0;
+}
+
+// Sem argumento mede 1, 4, 16 e 64 KB; com um argumento, só aquele tamanho.
+int main(int argc, char* argv[]) {
+    uint32_t sizes[] = { 1, 4, 16, 64 };
+    int count = 4;
+    if (argc > 1) {
+        sizes[0] = (uint32_t) atoi(argv[1]);
+        count = 1;
+    }
+    BenchResult results[4];
+    for (int i = 0; i < count; ++i) {
+        if (bench_block_size(sizes[i], &results[i]) != 0) {
+            fprintf(stderr, "Erro: Benchmark do sistema de arquivos falhou.\n");
+            remove(BENCH_DISK);
+            remove(BENCH_HOST_FILE);
+            return 1;
+        }
+    }
+    remove(BENCH_DISK);
+    remove(BENCH_HOST_FILE);
+
+    printf("Simulador (até %d MB importados por execução, melhor de %d)\n", BENCH_DATA_MB, BENCH_REPEAT);
+    printf("  %-7s %11s %11s %7s   %11s %11s %7s\n", "bloco", "import", "com CRC", "custo", "cat", "com CRC", "custo");
+    for (int i = 0; i < count; ++i) {
+        const BenchResult* r = &results[i];
+        printf("  %4u KB %6.0f MB/s %6.0f MB/s %6.1f%%   %6.0f MB/s %6.0f MB/s %6.1f%%\n", r->block_kb,
+               r->import_off, r->import_on, (r->import_off / r->import_on - 1) * 100,
+               r->cat_off, r->cat_on, (r->cat_off / r->cat_on - 1) * 100);
+    }
+    return 0;
+}
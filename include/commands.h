@@ -1,20 +1,47 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 
+#include <stdint.h>
+#include "fs_types.h"
+#include "profile.h"
+
 
 // Declaração de todas as funções de comando que o shell pode chamar.
 void cmd_mkdir(const char* nome_dir);
-void cmd_ls();
+void cmd_ls(const char* caminho);
 void cmd_cd(const char* nome_dir);
 void cmd_import(const char* caminho_real, const char* nome_dest);
+void cmd_import_tree(const char* dir_real, const char* nome_dest);
 void cmd_cat(const char* nome_arq);
+void cmd_compress(const char* nome_arq);
+void cmd_cp(const char* origem, const char* destino, int reflink);
+void cmd_truncate(const char* nome_arq, const char* tamanho);
+void cmd_write(const char* nome_arq, const char* deslocamento, const char* texto);
+void cmd_punch(const char* nome_arq, const char* deslocamento, const char* tamanho);
 void cmd_rename(const char* nome_orig, const char* nome_novo);
 void cmd_mv(const char* nome_orig, const char* nome_dest);
 void cmd_rm(const char* nome_arq);
 void cmd_rmdir(const char* nome_dir);
 void cmd_stat(const char* name);
 void cmd_df(void);
+void cmd_du(const char* caminho);
+void cmd_find(const char* caminho, const char* padrao, int varrer);
+void cmd_sync(void);
 void cmd_echo(const char* text, const char* op, const char* filename);
 void cmd_set(const char* param, const char* value);
+int cmd_fsck(int repair);
+void cmd_defrag(const char* name, int compact, uint32_t budget_ms);
+int cmd_profile(const char* amostra, uint32_t tamanho_bloco_kb, WorkloadProfile* perfil);
+
+// Saída de ls, stat, df e du, compartilhada com o shell cliente (run --connect)
+void show_file_list(const FileList* files);
+void show_stat(const char* name, const Inode* inode);
+void show_disk_usage(const DiskUsageInfo* disk_data);
+// Uma linha do du; com 'name' NULL imprime o cabeçalho da tabela
+void show_dir_usage(const char* name, int type, const DirUsage* usage);
+void show_dir_usage_total(const DirUsage* total);
+
+// Converte um tamanho em bytes com sufixo opcional K, M ou G. Retorna 0 ou -1.
+int parse_bytes(const char* texto, uint64_t* out);
 
 #endif // COMMANDS_H
\ No newline at end of file
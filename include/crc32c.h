@@ -0,0 +1,21 @@
+// include/crc32c.h
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (polinômio de Castagnoli, o mesmo do ext4 e do iSCSI). Usa a instrução
+// crc32 do SSE4.2 quando o processador tem suporte e, caso contrário, uma
+// implementação em software com tabelas "slicing-by-8".
+
+// Continua o cálculo a partir de 'crc' (use 0 para começar).
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+// Sempre a versão em software (para comparação e testes).
+uint32_t crc32c_sw(uint32_t crc, const void* data, size_t len);
+
+// Nome da implementação escolhida: "sse4.2" ou "slicing-by-8".
+const char* crc32c_impl(void);
+
+#endif // CRC32C_H
@@ -0,0 +1,41 @@
+// include/extent.h
+#ifndef EXTENT_H
+#define EXTENT_H
+
+#include <stdint.h>
+
+// Índice em memória das sequências (extents) de blocos livres. Cada extent
+// fica em duas árvores AVL: uma ordenada pelo início, com o maior
+// comprimento de cada subárvore, e outra pelo comprimento. Assim as buscas
+// por melhor encaixe, perto de um bloco e pela maior sequência são O(log n).
+
+typedef struct ExtentNode ExtentNode;
+
+typedef struct {
+    ExtentNode* by_start;
+    ExtentNode* by_length;
+    uint32_t count;         // Número de extents
+    uint64_t free_blocks;   // Soma dos comprimentos
+} ExtentTree;
+
+void extent_tree_init(ExtentTree* tree);
+void extent_tree_clear(ExtentTree* tree);
+
+// Marca [start, start + length) como livre, unindo com os vizinhos. Retorna 0 ou -1 (memória).
+int extent_tree_add(ExtentTree* tree, uint32_t start, uint32_t length);
+
+// Marca [start, start + length) como usado. O intervalo precisa estar dentro de
+// um único extent; retorna -1 se não estiver (ou sem memória para dividi-lo).
+int extent_tree_remove(ExtentTree* tree, uint32_t start, uint32_t length);
+
+// Início de 'length' blocos livres a partir de 'goal' (no próprio 'goal', se
+// couber, ou no primeiro extent depois dele) antes de 'limit'. Retorna 0 ou -1.
+int extent_tree_find_near(const ExtentTree* tree, uint32_t goal, uint32_t length, uint32_t limit, uint32_t* start);
+
+// Menor extent com pelo menos 'length' blocos (o de menor início no empate). Retorna 0 ou -1.
+int extent_tree_find_best(const ExtentTree* tree, uint32_t length, uint32_t* start);
+
+// Maior extent. Retorna 0 ou -1 se não houver blocos livres.
+int extent_tree_longest(const ExtentTree* tree, uint32_t* start, uint32_t* length);
+
+#endif // EXTENT_H
@@ -6,23 +6,55 @@
 #include "fs_types.h"
 
 // Formata um novo disco com o tamanho total e de bloco especificados (em KB)
-int fs_format(const char* path, uint32_t total_size_kb, uint32_t block_size_kb);
+int fs_format(const char* path, uint64_t total_size_kb, uint32_t block_size_kb);
+// Igual a fs_format, ligando recursos opcionais do disco (ex.: FEATURE_COMPRESSION)
+int fs_format_with_options(const char* path, uint64_t total_size_kb, uint32_t block_size_kb, const FormatOptions* options);
 
 // Monta (abre) um disco existente
 int fs_mount(const char* path);
+// Igual a fs_mount, com opções (ex.: desligar a verificação de checksums)
+int fs_mount_with_options(const char* path, const MountOptions* options);
 
 // Desmonta (fecha) o disco
 void fs_unmount();
+// Geometria do disco montado, como opções que recriam um disco igual (vazio)
+// com fs_format_with_options. Retorna 0 ou -1 se não houver disco montado.
+int fs_geometry(uint64_t* total_size_kb, uint32_t* block_size_kb, FormatOptions* options);
+// Converte o disco em 'path' para o formato atual (FS_VERSION). Com 'dest_path',
+// o original fica intacto e a conversão é feita numa cópia. Retorna 0 se
+// converteu, 1 se o disco já estava no formato atual e -1 em erro.
+int fs_upgrade(const char* path, const char* dest_path);
 
 
+// Os nomes recebidos abaixo são caminhos: absolutos ("/a/b") ou relativos ao
+// diretório atual, com '.' e '..' ("../b/arquivo.txt").
 FileList fs_list_directory();
+FileList fs_list_path(const char* path);
 Inode fs_list_inode();
 int fs_create_directory(const char* name);
 int fs_change_directory(const char* name);
 void fs_get_current_path(char* path_buffer, size_t buffer_size);
 int fs_remove_directory(const char* name);
 int fs_import_file(const char* source_path, const char* dest_name);
+// Importa recursivamente um diretório do host para um novo diretório
+int fs_import_tree(const char* host_dir, const char* dest_name);
 char* fs_read_file(const char* filename);
+// Recebe o conteúdo de um arquivo em pedaços; retornar != 0 interrompe a leitura
+typedef int (*FsReadCallback)(const char* data, size_t len, void* ctx);
+int fs_stream_file(const char* filename, FsReadCallback cb, void* ctx);
+// Só o trecho [offset, offset + len); os blocos antes do deslocamento não são lidos
+int fs_stream_range(const char* filename, uint64_t offset, uint64_t len, FsReadCallback cb, void* ctx);
+// Converte um arquivo existente para o modo comprimido
+int fs_compress_file(const char* filename);
+// Copia um arquivo; com 'reflink' o novo arquivo compartilha os blocos da
+// origem e cada bloco só é copiado na primeira escrita (cópia na escrita)
+int fs_copy_file(const char* source_name, const char* dest_name, int reflink);
+// Arquivos esparsos: trechos nunca escritos (buracos) não ocupam blocos e são
+// lidos como zeros. truncate e a escrita com deslocamento criam o arquivo se
+// ele não existir; punch transforma um intervalo em buraco.
+int fs_truncate_file(const char* filename, uint64_t size);
+int fs_write_at(const char* filename, uint64_t offset, const char* data, size_t len);
+int fs_punch_file(const char* filename, uint64_t offset, uint64_t len);
 int fs_remove_file(const char* filename);
 int fs_rename(const char* old_name, const char* new_name);
 int fs_move_item(const char* source_name, const char* dest_dir_name);
@@ -31,7 +63,24 @@ void fs_set_verbose(int mode);
 //Extras
 Inode fs_stat_item(const char* name);
 DiskUsageInfo fs_disk_free();
+// Uso da subárvore de 'path' (du). Lido direto da tabela de uso quando o
+// disco tem FEATURE_DIR_USAGE; sem ela, a subárvore é percorrida.
+int fs_dir_usage(const char* path, DirUsage* usage);
+// Procura abaixo de 'path' os itens cujo nome casa com o glob 'pattern' e
+// entrega os caminhos a 'cb' em ordem alfabética. Usa o índice de nomes quando
+// o disco tem FEATURE_NAME_INDEX, a menos que 'walk' peça a varredura da
+// árvore (feita em paralelo). Retorna quantos itens casaram ou -1.
+typedef int (*FsFindCallback)(const char* path, void* ctx);
+int fs_find(const char* path, const char* pattern, int walk, FsFindCallback cb, void* ctx);
 int fs_write_file(const char* filename, const char* text, const char* op);
+// Grava no disco os dados adiados pelo 'echo' (alocação atrasada)
+int fs_sync();
 extern uint32_t current_inode_num;
 int fs_check_item_type(const char* name);
+// Verifica (e opcionalmente repara) bitmaps, contagens de links, '..' e tamanhos.
+// Retorna o número de problemas encontrados ou -1 em caso de erro de leitura.
+int fs_check(int repair, FsckReport* report);
+// Reloca blocos para sequências contíguas. Sem 'name', percorre o disco de forma
+// incremental, parando após 'budget_ms' (0 = sem limite) e continuando na próxima chamada.
+int fs_defrag(const char* name, int compact, uint32_t budget_ms, DefragReport* report);
 #endif // FS_CORE_H
\ No newline at end of file
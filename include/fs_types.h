@@ -6,8 +6,33 @@
 #include <stdint.h> // Essencial para tipos de tamanho fixo como uint32_t
 
 #define MAGIC_NUMBER 0xDA7AF17E // "DATA FILE" em Leetspeak, para identificar nosso FS
+#define FS_VERSION 3 // Formato gravado por fs_format (Superblock.version); discos antigos têm 0 (v1)
 #define MAX_FILENAME_LEN 60
 #define INODE_DIRECT_BLOCKS 12 // 12 ponteiros diretos para blocos de dados
+#define INODE_INLINE_SIZE (INODE_DIRECT_BLOCKS * sizeof(uint32_t)) // Arquivos até este tamanho ficam dentro do i-node
+
+// Recursos opcionais do disco (Superblock.features). Discos antigos têm 0 aqui.
+#define FEATURE_INLINE_DATA 0x1 // I-nodes têm o campo 'flags' válido e podem guardar dados inline
+#define FEATURE_COMPRESSION 0x2 // Arquivos novos são criados comprimidos
+#define FEATURE_CHECKSUMS 0x4   // CRC32C de cada bloco na área que começa em checksum_start
+#define FEATURE_REFCOUNT 0x8    // Blocos podem ser compartilhados (tabela em refcount_start)
+#define FEATURE_DEDUP 0x10      // Blocos cheios idênticos são compartilhados na escrita (índice em dedup_start)
+#define FEATURE_DIR_USAGE 0x20  // Totais de uso por subárvore mantidos na tabela em usage_start
+#define FEATURE_NAME_INDEX 0x40 // Nome e diretório de cada i-node na tabela em name_index_start (find)
+#define FEATURE_LARGE_FILES 0x80 // I-nodes (v2 em diante) guardam os 16 bits altos do tamanho (arquivos acima de 4 GB)
+#define FEATURE_BLOCK_GROUPS 0x100 // Cada grupo de blocos começa com os próprios bitmaps e a sua fatia da tabela de i-nodes
+
+// Estado do disco (Superblock.state)
+#define SB_STATE_CHECKSUMS_STALE 0x1 // Montado sem checksums: a tabela precisa ser recalculada
+
+// Flags do i-node (Inode.flags)
+#define INODE_FLAG_INLINE 0x1   // Conteúdo guardado no espaço de direct_blocks
+#define INODE_FLAG_COMPRESSED 0x2 // Dados comprimidos em clusters de COMPRESS_CLUSTER_BLOCKS blocos
+
+// Um arquivo comprimido é dividido em clusters de 4 blocos lógicos. Cada cluster
+// ocupa as posições [4k, 4k+4) de direct_blocks; se ocupar menos blocos físicos
+// do que lógicos, está comprimido e começa com o tamanho comprimido (uint32_t).
+#define COMPRESS_CLUSTER_BLOCKS 4
 
 // Cores (opcional, mas mantido)
 #define COLOR_RESET   "\033[0m"
@@ -20,12 +45,38 @@ typedef struct {
     uint32_t total_inodes;        // Número total de i-nodes
     uint32_t block_size;          // Tamanho de cada bloco em bytes
 
-    uint32_t inode_bitmap_start;  // Bloco onde começa o bitmap de i-nodes
-    uint32_t block_bitmap_start;  // Bloco onde começa o bitmap de blocos
-    uint32_t inode_table_start;   // Bloco onde começa a tabela de i-nodes
+    uint32_t inode_bitmap_start;  // Bloco onde começa o bitmap de i-nodes (com FEATURE_BLOCK_GROUPS, o do grupo 0)
+    uint32_t block_bitmap_start;  // Bloco onde começa o bitmap de blocos (idem)
+    uint32_t inode_table_start;   // Bloco onde começa a tabela de i-nodes (idem)
     uint32_t data_blocks_start;   // Bloco onde começam os blocos de dados
+    uint32_t features;            // Recursos opcionais (FEATURE_*)
+    uint32_t checksum_start;      // Bloco onde começa a tabela de CRC32C (FEATURE_CHECKSUMS)
+    uint32_t state;               // SB_STATE_*
+    uint32_t refcount_start;      // Tabela de referências extras por bloco (FEATURE_REFCOUNT)
+    uint32_t dedup_start;         // Índice de deduplicação (FEATURE_DEDUP)
+    uint32_t dedup_slots;         // Posições do índice (potência de 2)
+    uint32_t usage_start;         // Tabela de uso por subárvore (FEATURE_DIR_USAGE)
+    uint32_t name_index_start;    // Índice de nomes (FEATURE_NAME_INDEX)
+    uint32_t version;             // Versão do formato em disco (FS_VERSION)
+    uint32_t reserved_start;      // Área reservada no create (ex.: um futuro journal), antes dos dados
+    uint32_t reserved_blocks;
 } Superblock;
 
+// Opções de formatação
+typedef struct {
+    uint32_t features;            // FEATURE_* a habilitar além dos padrões
+    uint32_t disabled_features;   // FEATURE_* padrões a desligar (ex.: FEATURE_CHECKSUMS)
+    uint32_t bytes_per_inode;     // Um i-node a cada tantos bytes do disco (0 = um a cada 4 blocos)
+    uint32_t reserved_kb;         // Área reservada depois dos metadados
+} FormatOptions;
+
+// Opções de montagem
+typedef struct {
+    int no_checksum;              // Não verifica nem atualiza os checksums dos blocos
+    int direct;                   // Abre a imagem com O_DIRECT, sem passar pelo cache de páginas do host
+    const char* trace_path;       // Grava as chamadas à API neste arquivo até desmontar (trace.h)
+} MountOptions;
+
 // Tipo do I-node: Arquivo ou Diretório
 typedef enum {
     TYPE_FILE,
@@ -33,11 +84,20 @@ typedef enum {
 } InodeType;
 
 // I-node: Estrutura que representa um arquivo ou diretório no disco.
-// Ela não contém ponteiros de memória!
+// Ela não contém ponteiros de memória! No formato v1 era gravada byte a byte
+// como está aqui; do v2 em diante cada i-node ocupa INODE_DISK_SIZE bytes
+// little-endian:
+//   0 tipo (u8) | 1 flags (u8) | 2 size, bits 32-47 (u16, FEATURE_LARGE_FILES) |
+//   4 size, bits 0-31 | 8 link_count |
+//   12 created | 16 modified | 20 accessed (u32, segundos) | 24 direct_blocks
+// As datas são segundos desde 1970 sem sinal: valem até 2106, e o que não
+// couber em 32 bits é truncado na gravação.
+#define INODE_DISK_SIZE 72
 typedef struct {
     InodeType type;               // Tipo: arquivo ou diretório
-    uint32_t size;                // Tamanho do arquivo em bytes
+    uint64_t size;                // Tamanho do arquivo em bytes (na prática até 12 blocos diretos)
     uint32_t link_count;          // Quantidade de links para este i-node
+    uint32_t flags;               // INODE_FLAG_*; ocupa o espaço de alinhamento antes dos time_t
     time_t created;
     time_t modified;
     time_t accessed;
@@ -55,7 +115,13 @@ typedef struct {
     size_t count;       // Número de entradas atualmente
 } FileList;
 
-// Representa uma única entrada dentro de um diretório.
+// Representa uma única entrada dentro de um diretório. Nos formatos v1 e v2
+// é gravada como está (64 bytes, inode_num na ordem de bytes do host); no v3
+// cada entrada é um registro compacto de DIRENT_HEADER_SIZE bytes mais o nome:
+//   0 inode_num (u32 LE) | 4 tamanho do nome (u8) | 5 nome, sem o NUL
+// completado com zeros até múltiplo de 4. Os registros ficam em sequência no
+// bloco, e um tamanho de nome 0 marca o fim.
+#define DIRENT_HEADER_SIZE 5
 typedef struct {
     char name[MAX_FILENAME_LEN]; // Nome do arquivo/subdiretório
     uint32_t inode_num;          // Número do i-node correspondente
@@ -66,11 +132,54 @@ typedef struct {
     uint32_t free_blocks;
     uint32_t total_inodes;
     uint32_t total_blocks;
-    uint32_t used_kb;
-    uint32_t total_kb;
-    uint32_t free_kb;
+    uint64_t used_kb;
+    uint64_t total_kb;
+    uint64_t free_kb;
     uint32_t used_blocks;
     uint32_t used_inodes;
+    uint32_t logical_blocks;  // Blocos em uso contando cada referência compartilhada
+    uint64_t logical_kb;
 } DiskUsageInfo;
 
+// Uso de uma subárvore (du). Para um arquivo, só ele mesmo.
+typedef struct {
+    uint64_t bytes;    // Soma dos tamanhos dos arquivos
+    uint32_t blocks;   // Blocos de dados, incluindo os dos diretórios; cada referência compartilhada conta
+    uint64_t kb;
+    uint32_t entries;  // Arquivos e diretórios abaixo (sem contar o próprio item)
+} DirUsage;
+
+// Resultado da verificação de consistência (fsck)
+typedef struct {
+    uint32_t inodes_checked;
+    uint32_t dirs_checked;
+    uint32_t bad_inodes;          // Tipo inválido ou ponteiros fora da área de dados
+    uint32_t orphan_inodes;       // Alocados no bitmap mas sem nenhuma entrada apontando
+    uint32_t dangling_entries;    // Entradas que apontam para i-nodes livres ou inválidos
+    uint32_t link_count_errors;
+    uint32_t dotdot_errors;
+    uint32_t size_errors;
+    uint32_t leaked_blocks;       // Marcados no bitmap mas sem dono
+    uint32_t unmarked_blocks;     // Em uso por algum i-node mas livres no bitmap
+    uint32_t duplicate_blocks;    // Referenciados por mais de um ponteiro
+    uint32_t inode_bitmap_errors; // Referenciados mas livres no bitmap
+    uint32_t checksum_errors;     // Blocos cujo conteúdo não bate com o CRC32C gravado
+    uint32_t refcount_errors;     // Contagem de referências diferente dos ponteiros encontrados
+    uint32_t usage_errors;        // Totais de uso por subárvore diferentes dos recalculados
+    uint32_t name_index_errors;   // Nome ou diretório no índice diferente da árvore
+    uint32_t repaired;
+} FsckReport;
+
+// Resultado de uma fatia de desfragmentação
+typedef struct {
+    uint32_t files_scanned;
+    uint32_t fragmented;      // Itens com mais de uma sequência de blocos
+    uint32_t relocated;
+    uint32_t blocks_moved;
+    uint32_t extents_before;
+    uint32_t extents_after;
+    uint32_t dirs_compacted;  // Diretórios reempacotados (entradas removidas)
+    int finished;             // 1 se a passada pelo disco terminou nesta fatia
+} DefragReport;
+
 #endif // FS_TYPES_H
\ No newline at end of file
@@ -0,0 +1,19 @@
+// include/lz.h
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compressor LZ77 simples no estilo do LZ4 (sequências de literais + cópias
+// com deslocamento de 16 bits), sem dependências externas.
+
+// Comprime 'src' em 'dst'. Retorna o tamanho comprimido ou -1 se o resultado
+// não couber em 'dst_capacity' bytes.
+int lz_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_capacity);
+
+// Descomprime 'src' em 'dst'. Retorna o número de bytes gerados ou -1 se os
+// dados estiverem corrompidos ou não couberem em 'dst_capacity'.
+int lz_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_capacity);
+
+#endif // LZ_H
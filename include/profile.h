@@ -0,0 +1,41 @@
+// include/profile.h
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Análise de uma carga de exemplo para o 'create --profile': um script de
+// comandos do shell (como os de inputs/) ou um diretório do host que seria
+// importado. Não depende de nenhum disco montado.
+
+#define PROFILE_CANDIDATES 7 // Blocos de 1, 2, 4, ..., 64 KB
+
+typedef struct {
+    uint32_t block_size_kb;
+    int viable;               // Todo arquivo cabe nos blocos diretos e todo diretório nas suas entradas
+    uint64_t used_bytes;      // Espaço ocupado pela amostra com esse bloco
+    uint64_t wasted_bytes;    // Sobra no último bloco de cada arquivo e diretório
+} ProfileCandidate;
+
+typedef struct {
+    uint32_t files;
+    uint32_t dirs;
+    uint64_t total_bytes;     // Soma dos tamanhos dos arquivos
+    uint64_t max_file;
+    uint32_t max_fanout;      // Maior número de entradas num diretório
+    uint32_t inline_files;    // Arquivos que ficam dentro do i-node
+    ProfileCandidate candidates[PROFILE_CANDIDATES];
+    // Escolha
+    uint32_t block_size_kb;
+    uint32_t bytes_per_inode;
+} WorkloadProfile;
+
+// Lê a amostra em 'path' e preenche as estatísticas. Retorna 0 ou -1 em erro.
+int profile_workload(const char* path, WorkloadProfile* profile);
+
+// Escolhe o bloco com menos desperdício entre os viáveis (ou usa
+// 'block_size_kb' se não for 0) e a razão bytes por i-node.
+void profile_choose_geometry(WorkloadProfile* profile, uint32_t block_size_kb);
+
+#endif // PROFILE_H
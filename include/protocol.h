@@ -0,0 +1,103 @@
+// include/protocol.h
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs_types.h"
+
+// Protocolo binário entre 'simulador serve' e os clientes locais. Cada
+// mensagem é um cabeçalho de PROTO_HEADER_SIZE bytes seguido de 'length'
+// bytes de argumentos, na ordem de bytes do host (o socket é local):
+//   pedido:   length (u32) | op (u16) | 0 (u16)      | id (u32)
+//   resposta: length (u32) | op (u16) | status (i16) | id (u32)
+// Os argumentos são inteiros de tamanho fixo e textos (u16 com o tamanho e
+// os bytes, sem '\0'); os dados de READ/WRITE/APPEND ocupam o resto da
+// mensagem. O cliente pode enviar vários pedidos sem esperar as respostas,
+// que voltam na ordem dos pedidos.
+
+#define PROTO_HEADER_SIZE 12
+#define PROTO_MAX_PATH 1024
+#define PROTO_MAX_DATA (1024 * 1024)                // Maior trecho de um READ ou WRITE
+#define PROTO_MAX_PAYLOAD (PROTO_MAX_DATA + 4096)   // Maior mensagem aceita
+
+// Status da resposta
+#define PROTO_OK 0
+#define PROTO_FAILED -1        // A operação falhou no servidor (o motivo fica no log dele)
+#define PROTO_BAD_REQUEST -2   // Operação desconhecida ou argumentos inválidos
+
+typedef enum {
+    OP_LOOKUP = 1, // caminho -> i-node (proto_put_inode)
+    OP_READDIR,    // caminho -> u32 n, n x (u8 tipo, texto nome)
+    OP_READ,       // caminho, u64 deslocamento, u32 tamanho -> dados
+    OP_WRITE,      // caminho, u64 deslocamento, dados
+    OP_APPEND,     // caminho, u8 sobrescrever (1 = '>', 0 = '>>'), dados
+    OP_MKDIR,      // caminho
+    OP_RMDIR,      // caminho
+    OP_UNLINK,     // caminho
+    OP_RENAME,     // caminho, novo nome
+    OP_MOVE,       // caminho, diretório de destino
+    OP_COPY,       // origem, destino, u8 reflink
+    OP_TRUNCATE,   // caminho, u64 tamanho
+    OP_PUNCH,      // caminho, u64 deslocamento, u64 tamanho
+    OP_COMPRESS,   // caminho
+    OP_STATFS,     // -> uso do disco (proto_put_usage)
+    OP_SYNC,
+    OP_DU,         // caminho -> uso da subárvore (proto_put_dir_usage)
+    OP_FIND        // caminho, texto padrão, u8 varrer -> u32 encontrados, u32 n, n x texto caminho
+} ProtoOp;
+
+typedef struct {
+    uint32_t length;
+    uint16_t op;
+    int16_t status;
+    uint32_t id;
+} ProtoHeader;
+
+// Buffer que cresce conforme a necessidade
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} ProtoBuf;
+
+// Leitura sequencial dos argumentos; 'bad' fica 1 se faltarem bytes
+typedef struct {
+    const uint8_t* p;
+    size_t left;
+    int bad;
+} ProtoReader;
+
+int proto_reserve(ProtoBuf* buf, size_t extra);
+int proto_put(ProtoBuf* buf, const void* data, size_t len);
+int proto_put_u8(ProtoBuf* buf, uint8_t value);
+int proto_put_u32(ProtoBuf* buf, uint32_t value);
+int proto_put_u64(ProtoBuf* buf, uint64_t value);
+int proto_put_str(ProtoBuf* buf, const char* text);
+int proto_put_inode(ProtoBuf* buf, const Inode* inode);
+int proto_put_usage(ProtoBuf* buf, const DiskUsageInfo* usage);
+int proto_put_dir_usage(ProtoBuf* buf, const DirUsage* usage);
+// Remove os 'n' primeiros bytes
+void proto_consume(ProtoBuf* buf, size_t n);
+void proto_free(ProtoBuf* buf);
+
+// Começa uma mensagem e devolve a posição do cabeçalho; proto_end preenche o 'length'
+size_t proto_begin(ProtoBuf* buf, uint16_t op, int16_t status, uint32_t id);
+void proto_end(ProtoBuf* buf, size_t start);
+void proto_set_status(ProtoBuf* buf, size_t start, int16_t status);
+// Lê o cabeçalho em 'data' (PROTO_HEADER_SIZE bytes)
+void proto_header(const uint8_t* data, ProtoHeader* header);
+
+void proto_reader_init(ProtoReader* r, const uint8_t* data, size_t len);
+uint8_t proto_get_u8(ProtoReader* r);
+uint32_t proto_get_u32(ProtoReader* r);
+uint64_t proto_get_u64(ProtoReader* r);
+// Copia um texto para 'out' com '\0'. Retorna 0 ou -1 (faltam bytes ou não cabe).
+int proto_get_str(ProtoReader* r, char* out, size_t out_size);
+// O resto da mensagem (dados de READ/WRITE)
+const uint8_t* proto_get_rest(ProtoReader* r, size_t* len);
+void proto_get_inode(ProtoReader* r, Inode* inode);
+void proto_get_usage(ProtoReader* r, DiskUsageInfo* usage);
+void proto_get_dir_usage(ProtoReader* r, DirUsage* usage);
+
+#endif // PROTOCOL_H
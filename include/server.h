@@ -0,0 +1,20 @@
+// include/server.h
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "fs_types.h"
+
+// Modo servidor: um processo monta o disco e atende vários clientes locais
+// por um socket Unix (protocolo em protocol.h), num laço epoll de uma só
+// thread. Os pedidos que chegam juntos são processados em lote e as
+// respostas saem numa única escrita.
+
+// Monta o disco em 'disk_path' e atende em 'socket_path' até receber
+// SIGINT/SIGTERM; desmonta ao sair. Retorna 0 ou -1 em erro.
+int server_run(const char* disk_path, const char* socket_path, const MountOptions* options);
+
+// Shell cliente: os comandos viram pedidos ao servidor em 'socket_path'.
+// Retorna 0 ou -1 se não conseguir conectar.
+int client_shell(const char* socket_path);
+
+#endif // SERVER_H
@@ -0,0 +1,19 @@
+// include/simfs.h
+#ifndef SIMFS_H
+#define SIMFS_H
+
+// Interface pública da libsimfs: o núcleo do sistema de arquivos, os comandos
+// do shell, a análise de cargas do 'create --profile', o modo servidor com o
+// seu protocolo e a gravação e reprodução de traces. Não depende do GTK;
+// ferramentas e benchmarks incluem só este cabeçalho e ligam com -lsimfs
+// (libsimfs.a ou libsimfs.so).
+
+#include "fs_types.h"
+#include "fs_core.h"
+#include "commands.h"
+#include "profile.h"
+#include "protocol.h"
+#include "server.h"
+#include "trace.h"
+
+#endif // SIMFS_H
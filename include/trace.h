@@ -0,0 +1,63 @@
+// include/trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Gravação das chamadas à API do fs_core (run/serve --record) e reprodução
+// num disco novo (replay). O arquivo começa com TRACE_MAGIC e a geometria do
+// disco gravado; cada chamada vira um registro com a operação, se falhou, o
+// início (relativo ao registro anterior), a duração, dois números e até dois
+// caminhos. Os inteiros são varints (7 bits por byte), então o arquivo é
+// compacto e não depende da ordem de bytes do host. O conteúdo dos dados
+// escritos não é gravado, só o tamanho; a reprodução escreve um padrão fixo.
+
+#define TRACE_MAGIC "SIMTRACE"
+#define TRACE_VERSION 1
+
+typedef enum {
+    TRACE_LIST = 1,   // caminho
+    TRACE_MKDIR,      // caminho
+    TRACE_CHDIR,      // caminho
+    TRACE_RMDIR,      // caminho
+    TRACE_IMPORT,     // caminho no host, destino; a = tamanho do arquivo no host
+    TRACE_IMPORT_TREE,// diretório no host, destino
+    TRACE_UNLINK,     // caminho
+    TRACE_DELETE,     // caminho
+    TRACE_RENAME,     // caminho, novo nome
+    TRACE_STAT,       // caminho
+    TRACE_DF,
+    TRACE_DU,         // caminho
+    TRACE_ECHO,       // caminho; a = 1 para '>' e 0 para '>>', b = tamanho do texto
+    TRACE_SYNC,
+    TRACE_MOVE,       // caminho, diretório de destino
+    TRACE_READ,       // caminho; a = deslocamento, b = tamanho (0 = arquivo todo)
+    TRACE_COMPRESS,   // caminho
+    TRACE_COPY,       // origem, destino; a = reflink
+    TRACE_TRUNCATE,   // caminho; a = tamanho
+    TRACE_WRITE,      // caminho; a = deslocamento, b = tamanho
+    TRACE_PUNCH,      // caminho; a = deslocamento, b = tamanho
+    TRACE_FIND,       // caminho, padrão; a = varredura
+    TRACE_DEFRAG,     // nome (vazio = disco todo); a = compactar, b = limite em ms
+    TRACE_OP_COUNT
+} TraceOp;
+
+// Começa a gravar em 'path' as chamadas feitas ao disco montado. Retorna 0 ou -1.
+int trace_record_start(const char* path);
+// Termina a gravação e fecha o arquivo
+void trace_record_stop(void);
+
+// Usados pelo fs_core em volta de cada chamada pública. Só a chamada mais
+// externa é gravada (fs_delete chamando fs_remove_file conta uma vez);
+// trace_enter devolve 0 quando a chamada não deve ser gravada.
+uint64_t trace_enter(void);
+void trace_leave(uint64_t start, TraceOp op, int rc, const char* path, const char* path2, uint64_t a, uint64_t b);
+
+// Formata 'disk_path' com a geometria do trace e reexecuta as chamadas com
+// 'threads' threads, cada uma com uma cópia do trace no seu próprio diretório
+// (/replayN) quando há mais de uma. Com 'speed' > 0 respeita os intervalos
+// gravados divididos por 'speed'; com 0 vai o mais rápido possível. Imprime
+// vazão e latências por operação. Retorna 0 ou -1 em erro.
+int trace_replay(const char* trace_path, const char* disk_path, int threads, double speed);
+
+#endif // TRACE_H
@@ -0,0 +1,606 @@
+// src/client.c
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "commands.h"
+#include "protocol.h"
+#include "server.h"
+
+#define CLIENT_WINDOW 8              // Pedidos de leitura/escrita em voo no cat e no import
+#define CLIENT_CHUNK (256 * 1024)    // Trecho de cada um desses pedidos
+#define CLIENT_DISCONNECTED -100     // A conexão caiu (não é um status do protocolo)
+
+typedef struct {
+    int fd;
+    uint32_t next_id;
+    ProtoBuf in;                     // Bytes recebidos ainda não consumidos
+    char cwd[PROTO_MAX_PATH];        // O diretório atual fica no cliente; os pedidos levam caminhos absolutos
+} Connection;
+
+// --- Transporte ---
+
+static int send_request(Connection* c, uint16_t op, const ProtoBuf* args) {
+    ProtoBuf header = {0};
+    size_t start = proto_begin(&header, op, PROTO_OK, c->next_id++);
+    if (header.len != PROTO_HEADER_SIZE) return -1;
+    uint32_t length = (uint32_t) args->len;
+    memcpy(header.data + start, &length, 4);
+
+    struct iovec iov[2] = { { header.data, PROTO_HEADER_SIZE }, { args->data, args->len } };
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+    size_t left = PROTO_HEADER_SIZE + args->len;
+    int rc = 0;
+    while (left > 0) {
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            rc = -1;
+            break;
+        }
+        left -= n;
+        // Avança os vetores pelo que já foi enviado
+        while (msg.msg_iovlen > 0 && (size_t) n >= msg.msg_iov[0].iov_len) {
+            n -= msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (uint8_t*) msg.msg_iov[0].iov_base + n;
+            msg.msg_iov[0].iov_len -= n;
+        }
+    }
+    proto_free(&header);
+    return rc;
+}
+
+// Espera a próxima resposta e copia os dados dela para 'payload'. Retorna o
+// status ou CLIENT_DISCONNECTED.
+static int recv_reply(Connection* c, ProtoBuf* payload) {
+    ProtoHeader header;
+    while (1) {
+        if (c->in.len >= PROTO_HEADER_SIZE) {
+            proto_header(c->in.data, &header);
+            if (header.length > PROTO_MAX_PAYLOAD) return CLIENT_DISCONNECTED;
+            if (c->in.len >= PROTO_HEADER_SIZE + header.length) break;
+        }
+        if (proto_reserve(&c->in, 65536) != 0) return CLIENT_DISCONNECTED;
+        ssize_t n = recv(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return CLIENT_DISCONNECTED;
+        c->in.len += n;
+    }
+    payload->len = 0;
+    if (proto_put(payload, c->in.data + PROTO_HEADER_SIZE, header.length) != 0) return CLIENT_DISCONNECTED;
+    proto_consume(&c->in, PROTO_HEADER_SIZE + header.length);
+    return header.status;
+}
+
+static int call(Connection* c, uint16_t op, const ProtoBuf* args, ProtoBuf* reply) {
+    if (send_request(c, op, args) != 0) return CLIENT_DISCONNECTED;
+    return recv_reply(c, reply);
+}
+
+// --- Caminhos ---
+
+// Junta 'name' ao diretório atual e resolve '.', '..' e barras repetidas.
+static int resolve(const Connection* c, const char* name, char* out) {
+    char joined[2 * PROTO_MAX_PATH];
+    snprintf(joined, sizeof(joined), "%s/%s", name[0] == '/' ? "" : c->cwd, name);
+    size_t len = 0;
+    char* save;
+    for (char* part = strtok_r(joined, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+        if (strcmp(part, ".") == 0) continue;
+        if (strcmp(part, "..") == 0) {
+            while (len > 0 && out[len - 1] != '/') len--;
+            if (len > 0) len--;
+            continue;
+        }
+        size_t part_len = strlen(part);
+        if (len + 1 + part_len >= PROTO_MAX_PATH) {
+            fprintf(stderr, "Erro: Caminho '%s' longo demais.\n", name);
+            return -1;
+        }
+        out[len++] = '/';
+        memcpy(out + len, part, part_len);
+        len += part_len;
+    }
+    if (len == 0) out[len++] = '/';
+    out[len] = '\0';
+    return 0;
+}
+
+// --- Comandos ---
+
+static void report(int status, const char* cmd, const char* name) {
+    if (status == CLIENT_DISCONNECTED) fprintf(stderr, "Erro: A conexão com o servidor caiu.\n");
+    else if (status == PROTO_BAD_REQUEST) fprintf(stderr, "Erro: O servidor não entendeu o pedido '%s'.\n", cmd);
+    else fprintf(stderr, "Erro: '%s %s' falhou no servidor.\n", cmd, name);
+}
+
+// Pedido com um ou dois caminhos (mais 'extra', se houver) e sem dados na resposta
+static int path_call(Connection* c, uint16_t op, const char* cmd, const char* name, const char* name2, const ProtoBuf* extra) {
+    char path[PROTO_MAX_PATH], path2[PROTO_MAX_PATH];
+    if (resolve(c, name, path) != 0 || (name2 && resolve(c, name2, path2) != 0)) return PROTO_BAD_REQUEST;
+    ProtoBuf args = {0}, reply = {0};
+    proto_put_str(&args, path);
+    // O novo nome do rename é só um nome, não um caminho
+    if (name2) proto_put_str(&args, op == OP_RENAME ? name2 : path2);
+    if (extra) proto_put(&args, extra->data, extra->len);
+    int status = call(c, op, &args, &reply);
+    if (status != PROTO_OK) report(status, cmd, name);
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+static int lookup(Connection* c, const char* path, Inode* inode) {
+    ProtoBuf args = {0}, reply = {0};
+    proto_put_str(&args, path);
+    int status = call(c, OP_LOOKUP, &args, &reply);
+    if (status == PROTO_OK) {
+        ProtoReader r;
+        proto_reader_init(&r, reply.data, reply.len);
+        proto_get_inode(&r, inode);
+        if (r.bad) status = PROTO_BAD_REQUEST;
+    }
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+static int remote_cd(Connection* c, const char* name) {
+    char path[PROTO_MAX_PATH];
+    Inode inode;
+    if (resolve(c, name, path) != 0) return -1;
+    int status = lookup(c, path, &inode);
+    if (status == CLIENT_DISCONNECTED) return status;
+    if (status != PROTO_OK) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", name);
+        return status;
+    }
+    if (inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: '%s' não é um diretório.\n", name);
+        return PROTO_FAILED;
+    }
+    strcpy(c->cwd, path);
+    return PROTO_OK;
+}
+
+static int remote_du(Connection* c, const char* name) {
+    char path[PROTO_MAX_PATH], child[PROTO_MAX_PATH + MAX_FILENAME_LEN + 2];
+    if (resolve(c, name ? name : ".", path) != 0) return -1;
+    ProtoBuf args = {0}, reply = {0};
+    proto_put_str(&args, path);
+    DirUsage total;
+    int status = call(c, OP_DU, &args, &reply);
+    if (status == PROTO_OK) {
+        ProtoReader r;
+        proto_reader_init(&r, reply.data, reply.len);
+        proto_get_dir_usage(&r, &total);
+        if (r.bad) status = PROTO_BAD_REQUEST;
+    }
+    if (status == PROTO_OK) status = call(c, OP_READDIR, &args, &reply);
+    if (status != PROTO_OK) {
+        report(status, "du", name ? name : ".");
+        proto_free(&args);
+        proto_free(&reply);
+        return status;
+    }
+
+    // Como no du local: uma linha por filho e o total da subárvore no fim
+    FileList files = {0};
+    ProtoReader r;
+    proto_reader_init(&r, reply.data, reply.len);
+    uint32_t count = proto_get_u32(&r);
+    files.entries = calloc(count ? count : 1, sizeof(FileEntry));
+    for (uint32_t i = 0; files.entries && i < count && !r.bad; i++) {
+        files.entries[i].type = proto_get_u8(&r) == TYPE_DIR ? TYPE_DIR : TYPE_FILE;
+        if (proto_get_str(&r, files.entries[i].name, MAX_FILENAME_LEN) == 0) files.count++;
+    }
+    show_dir_usage(NULL, 0, NULL);
+    for (size_t i = 0; i < files.count && status != CLIENT_DISCONNECTED; i++) {
+        const char* nome = files.entries[i].name;
+        if (strcmp(nome, ".") == 0 || strcmp(nome, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s/%s", strcmp(path, "/") == 0 ? "" : path, nome);
+        if (strlen(child) >= PROTO_MAX_PATH) continue;
+        args.len = 0;
+        proto_put_str(&args, child);
+        if (call(c, OP_DU, &args, &reply) != PROTO_OK) continue;
+        DirUsage usage;
+        proto_reader_init(&r, reply.data, reply.len);
+        proto_get_dir_usage(&r, &usage);
+        if (!r.bad) show_dir_usage(nome, files.entries[i].type, &usage);
+    }
+    show_dir_usage_total(&total);
+    free(files.entries);
+    proto_free(&args);
+    proto_free(&reply);
+    return PROTO_OK;
+}
+
+static int remote_find(Connection* c, const char* name, const char* pattern, int walk) {
+    char path[PROTO_MAX_PATH], found[PROTO_MAX_PATH];
+    if (resolve(c, name, path) != 0) return -1;
+    ProtoBuf args = {0}, reply = {0};
+    proto_put_str(&args, path);
+    proto_put_str(&args, pattern);
+    proto_put_u8(&args, (uint8_t) walk);
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int status = call(c, OP_FIND, &args, &reply);
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    if (status == PROTO_OK) {
+        ProtoReader r;
+        proto_reader_init(&r, reply.data, reply.len);
+        uint32_t total = proto_get_u32(&r);
+        uint32_t sent = proto_get_u32(&r);
+        for (uint32_t i = 0; i < sent && proto_get_str(&r, found, sizeof(found)) == 0; i++) printf("%s\n", found);
+        // O servidor corta a lista quando ela não cabe numa resposta
+        if (sent < total) printf("(%u caminho(s) não couberam na resposta)\n", total - sent);
+        double ms = (fim.tv_sec - inicio.tv_sec) * 1e3 + (fim.tv_nsec - inicio.tv_nsec) / 1e6;
+        printf("%u item(ns) encontrado(s) em %.2f ms.\n", total, ms);
+    } else {
+        report(status, "find", name);
+    }
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+static int remote_ls(Connection* c, const char* name) {
+    char path[PROTO_MAX_PATH];
+    if (resolve(c, name ? name : ".", path) != 0) return -1;
+    ProtoBuf args = {0}, reply = {0};
+    proto_put_str(&args, path);
+    int status = call(c, OP_READDIR, &args, &reply);
+    FileList files = {0};
+    if (status == PROTO_OK) {
+        ProtoReader r;
+        proto_reader_init(&r, reply.data, reply.len);
+        uint32_t count = proto_get_u32(&r);
+        files.entries = calloc(count ? count : 1, sizeof(FileEntry));
+        for (uint32_t i = 0; files.entries && i < count && !r.bad; i++) {
+            files.entries[i].type = proto_get_u8(&r) == TYPE_DIR ? TYPE_DIR : TYPE_FILE;
+            if (proto_get_str(&r, files.entries[i].name, MAX_FILENAME_LEN) == 0) files.count++;
+        }
+    } else if (status == PROTO_FAILED) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", name ? name : ".");
+    } else {
+        report(status, "ls", name ? name : ".");
+    }
+    // Como no ls local, a tabela aparece mesmo se o diretório não existir
+    if (status != CLIENT_DISCONNECTED) show_file_list(&files);
+    free(files.entries);
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+static int remote_stat(Connection* c, const char* name) {
+    char path[PROTO_MAX_PATH];
+    Inode inode;
+    if (resolve(c, name, path) != 0) return -1;
+    int status = lookup(c, path, &inode);
+    // Como o stat local, não imprime nada para um item inexistente
+    if (status == PROTO_OK) show_stat(name, &inode);
+    else if (status != PROTO_FAILED) report(status, "stat", name);
+    return status;
+}
+
+static int remote_df(Connection* c) {
+    ProtoBuf args = {0}, reply = {0};
+    int status = call(c, OP_STATFS, &args, &reply);
+    if (status == PROTO_OK) {
+        DiskUsageInfo usage;
+        ProtoReader r;
+        proto_reader_init(&r, reply.data, reply.len);
+        proto_get_usage(&r, &usage);
+        show_disk_usage(&usage);
+    } else {
+        report(status, "df", "");
+    }
+    proto_free(&reply);
+    return status;
+}
+
+// Lê o arquivo em trechos de CLIENT_CHUNK com até CLIENT_WINDOW pedidos em voo
+static int remote_cat(Connection* c, const char* name) {
+    char path[PROTO_MAX_PATH];
+    Inode inode;
+    if (resolve(c, name, path) != 0) return -1;
+    int status = lookup(c, path, &inode);
+    if (status != PROTO_OK || inode.type != TYPE_FILE) {
+        if (status == PROTO_OK) fprintf(stderr, "Erro: '%s' não é um arquivo.\n", name);
+        else if (status == PROTO_FAILED) fprintf(stderr, "Erro: Arquivo '%s' não encontrado.\n", name);
+        else report(status, "cat", name);
+        return status == PROTO_OK ? PROTO_FAILED : status;
+    }
+
+    ProtoBuf args = {0}, reply = {0};
+    uint64_t next = 0;
+    int in_flight = 0;
+    status = PROTO_OK;
+    do {
+        while (status == PROTO_OK && in_flight < CLIENT_WINDOW && next < inode.size) {
+            uint32_t len = inode.size - next < CLIENT_CHUNK ? (uint32_t) (inode.size - next) : CLIENT_CHUNK;
+            args.len = 0;
+            proto_put_str(&args, path);
+            proto_put_u64(&args, next);
+            proto_put_u32(&args, len);
+            if (send_request(c, OP_READ, &args) != 0) {
+                status = CLIENT_DISCONNECTED;
+                break;
+            }
+            next += len;
+            in_flight++;
+        }
+        if (in_flight == 0) break;
+        int rc = recv_reply(c, &reply);
+        in_flight--;
+        if (rc == CLIENT_DISCONNECTED) {
+            status = rc;
+            break;
+        }
+        // Depois de uma falha, só recolhe as respostas que faltam
+        if (status == PROTO_OK && rc != PROTO_OK) status = rc;
+        if (status == PROTO_OK) fwrite(reply.data, 1, reply.len, stdout);
+    } while (in_flight > 0 || (status == PROTO_OK && next < inode.size));
+    if (status == PROTO_OK) printf("\n");
+    else report(status, "cat", name);
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+// Envia um arquivo do host em pedidos WRITE com até CLIENT_WINDOW em voo
+static int remote_import(Connection* c, const char* host_path, const char* name) {
+    char path[PROTO_MAX_PATH];
+    Inode inode;
+    if (resolve(c, name, path) != 0) return -1;
+    FILE* source = fopen(host_path, "rb");
+    if (!source) {
+        fprintf(stderr, "Erro: Não foi possível abrir o arquivo '%s' no sistema real.\n", host_path);
+        return -1;
+    }
+    int status = lookup(c, path, &inode);
+    if (status != PROTO_FAILED) {
+        if (status == PROTO_OK) fprintf(stderr, "Erro: '%s' já existe.\n", name);
+        else report(status, "import", name);
+        fclose(source);
+        return status == PROTO_OK ? PROTO_FAILED : status;
+    }
+
+    ProtoBuf args = {0}, reply = {0};
+    char* chunk = malloc(CLIENT_CHUNK);
+    uint64_t offset = 0;
+    int in_flight = 0, at_end = 0;
+    status = chunk ? PROTO_OK : PROTO_FAILED;
+    while (status == PROTO_OK && !at_end) {
+        size_t n = fread(chunk, 1, CLIENT_CHUNK, source);
+        at_end = n < CLIENT_CHUNK;
+        if (n == 0 && offset > 0) break;
+        args.len = 0;
+        proto_put_str(&args, path);
+        // Um arquivo vazio é criado com truncate
+        if (n == 0) {
+            proto_put_u64(&args, 0);
+            if (send_request(c, OP_TRUNCATE, &args) != 0) status = CLIENT_DISCONNECTED;
+        } else {
+            proto_put_u64(&args, offset);
+            proto_put(&args, chunk, n);
+            if (send_request(c, OP_WRITE, &args) != 0) status = CLIENT_DISCONNECTED;
+        }
+        offset += n;
+        if (status == PROTO_OK && ++in_flight == CLIENT_WINDOW) {
+            status = recv_reply(c, &reply);
+            in_flight--;
+        }
+    }
+    while (in_flight > 0 && status != CLIENT_DISCONNECTED) {
+        int rc = recv_reply(c, &reply);
+        in_flight--;
+        if (status == PROTO_OK || rc == CLIENT_DISCONNECTED) status = rc;
+    }
+    if (status == PROTO_OK) printf("Arquivo '%s' importado com sucesso para '%s'.\n", host_path, name);
+    else report(status, "import", name);
+    free(chunk);
+    fclose(source);
+    proto_free(&args);
+    proto_free(&reply);
+    return status;
+}
+
+// --- Shell ---
+
+static int connect_server(const char* socket_path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Erro: Caminho do socket '%s' longo demais.\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Erro: Não foi possível conectar ao servidor em '%s': %s\n", socket_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int client_shell(const char* socket_path) {
+    Connection c = { .fd = connect_server(socket_path), .next_id = 1, .cwd = "/" };
+    if (c.fd < 0) return -1;
+    char linha[1024];
+    printf("Conectado ao servidor em '%s'. Digite 'exit' para sair.\n", socket_path);
+
+    int status = PROTO_OK;
+    while (status != CLIENT_DISCONNECTED) {
+        printf("fs:%s$ ", c.cwd);
+        if (fgets(linha, sizeof(linha), stdin) == NULL) {
+            printf("exit\n");
+            break;
+        }
+        linha[strcspn(linha, "\n")] = 0;
+
+        char *cmd = strtok(linha, " \t");
+        if (!cmd) continue;
+        status = PROTO_OK;
+
+        if (strcmp(cmd, "exit") == 0) {
+            break;
+        } else if (strcmp(cmd, "ls") == 0) {
+            status = remote_ls(&c, strtok(NULL, " \t"));
+        } else if (strcmp(cmd, "df") == 0) {
+            status = remote_df(&c);
+        } else if (strcmp(cmd, "sync") == 0) {
+            ProtoBuf args = {0}, reply = {0};
+            status = call(&c, OP_SYNC, &args, &reply);
+            if (status == PROTO_OK) printf("Dados pendentes gravados no disco.\n");
+            else report(status, "sync", "");
+            proto_free(&reply);
+        } else if (strcmp(cmd, "mkdir") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (!arg1) printf("Uso: mkdir <nome_dir>\n");
+            else if ((status = path_call(&c, OP_MKDIR, cmd, arg1, NULL, NULL)) == PROTO_OK) printf("Diretório '%s' criado com sucesso.\n", arg1);
+        } else if (strcmp(cmd, "cd") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (arg1) status = remote_cd(&c, arg1); else printf("Uso: cd <nome_dir>\n");
+        } else if (strcmp(cmd, "rmdir") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (!arg1) printf("Uso: rmdir <nome_dir>\n");
+            else if ((status = path_call(&c, OP_RMDIR, cmd, arg1, NULL, NULL)) == PROTO_OK) printf("Diretório '%s' removido com sucesso.\n", arg1);
+        } else if (strcmp(cmd, "rm") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (!arg1) printf("Uso: rm <nome_arq>\n");
+            else if ((status = path_call(&c, OP_UNLINK, cmd, arg1, NULL, NULL)) == PROTO_OK) printf("Arquivo '%s' removido com sucesso.\n", arg1);
+        } else if (strcmp(cmd, "stat") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (arg1) status = remote_stat(&c, arg1); else printf("Uso: stat <nome_item>\n");
+        } else if (strcmp(cmd, "cat") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (arg1) status = remote_cat(&c, arg1); else printf("Uso: cat <nome_arq>\n");
+        } else if (strcmp(cmd, "compress") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (!arg1) printf("Uso: compress <nome_arq>\n");
+            else if ((status = path_call(&c, OP_COMPRESS, cmd, arg1, NULL, NULL)) == PROTO_OK) printf("Arquivo '%s' comprimido com sucesso.\n", arg1);
+        } else if (strcmp(cmd, "import") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            if (arg1 && arg2 && strcmp(arg1, "-r") != 0) status = remote_import(&c, arg1, arg2);
+            else printf("Uso: import <caminho_real> <nome_dest>\n");
+        } else if (strcmp(cmd, "rename") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            if (!arg1 || !arg2) printf("Uso: rename <antigo> <novo>\n");
+            else if ((status = path_call(&c, OP_RENAME, cmd, arg1, arg2, NULL)) == PROTO_OK) printf("Item '%s' renomeado para '%s' com sucesso.\n", arg1, arg2);
+        } else if (strcmp(cmd, "mv") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            if (!arg1 || !arg2) printf("Uso: mv <origem> <dir_destino>\n");
+            else if ((status = path_call(&c, OP_MOVE, cmd, arg1, arg2, NULL)) == PROTO_OK) printf("'%s' movido para '%s' com sucesso.\n", arg1, arg2);
+        } else if (strcmp(cmd, "cp") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            int reflink = arg1 && strcmp(arg1, "--reflink") == 0;
+            if (reflink) arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            ProtoBuf extra = {0};
+            proto_put_u8(&extra, (uint8_t) reflink);
+            if (!arg1 || !arg2) printf("Uso: cp [--reflink] <origem> <destino>\n");
+            else if ((status = path_call(&c, OP_COPY, cmd, arg1, arg2, &extra)) == PROTO_OK)
+                printf("Arquivo '%s' copiado para '%s'%s.\n", arg1, arg2, reflink ? " (blocos compartilhados)" : "");
+            proto_free(&extra);
+        } else if (strcmp(cmd, "truncate") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            uint64_t size;
+            ProtoBuf extra = {0};
+            if (!arg1 || !arg2) printf("Uso: truncate <arquivo> <tamanho>\n");
+            else if (parse_bytes(arg2, &size) != 0) printf("Tamanho inválido: %s\n", arg2);
+            else if (proto_put_u64(&extra, size) == 0 && (status = path_call(&c, OP_TRUNCATE, cmd, arg1, NULL, &extra)) == PROTO_OK)
+                printf("Arquivo '%s' agora tem %llu bytes.\n", arg1, (unsigned long long) size);
+            proto_free(&extra);
+        } else if (strcmp(cmd, "write") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            char *text = strtok(NULL, "\"");
+            uint64_t offset;
+            ProtoBuf extra = {0};
+            if (!arg1 || !arg2 || !text) printf("Uso: write <arquivo> <deslocamento> \"texto\"\n");
+            else if (parse_bytes(arg2, &offset) != 0) printf("Deslocamento inválido: %s\n", arg2);
+            else if (proto_put_u64(&extra, offset) == 0 && proto_put(&extra, text, strlen(text)) == 0 &&
+                     (status = path_call(&c, OP_WRITE, cmd, arg1, NULL, &extra)) == PROTO_OK)
+                printf("%zu bytes escritos em '%s' a partir do byte %llu.\n", strlen(text), arg1, (unsigned long long) offset);
+            proto_free(&extra);
+        } else if (strcmp(cmd, "punch") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            char *arg3 = strtok(NULL, " \t");
+            uint64_t offset, len;
+            ProtoBuf extra = {0};
+            if (!arg1 || !arg2 || !arg3 || parse_bytes(arg2, &offset) != 0 || parse_bytes(arg3, &len) != 0) {
+                printf("Uso: punch <arquivo> <deslocamento> <tamanho>\n");
+            } else if (proto_put_u64(&extra, offset) == 0 && proto_put_u64(&extra, len) == 0 &&
+                       (status = path_call(&c, OP_PUNCH, cmd, arg1, NULL, &extra)) == PROTO_OK) {
+                printf("Intervalo liberado em '%s'.\n", arg1);
+            }
+            proto_free(&extra);
+        } else if (strcmp(cmd, "echo") == 0) {
+            char *text_start = strtok(NULL, "\"");
+            char *op = text_start ? strtok(NULL, " \t") : NULL;
+            char *filename = op ? strtok(NULL, " \t") : NULL;
+            if (!text_start) {
+                printf("Uso: echo \"texto\" >/>> <arquivo>\n");
+            } else if (!op) {
+                printf("%s\n", text_start);
+            } else if (!filename) {
+                printf("Uso: echo \"texto\" >/>> <arquivo>\n");
+            } else if (strcmp(op, ">") != 0 && strcmp(op, ">>") != 0) {
+                printf("Operador de redirecionamento inválido: %s\n", op);
+            } else {
+                ProtoBuf extra = {0};
+                proto_put_u8(&extra, strcmp(op, ">") == 0);
+                proto_put(&extra, text_start, strlen(text_start));
+                if ((status = path_call(&c, OP_APPEND, cmd, filename, NULL, &extra)) == PROTO_OK)
+                    printf("Texto escrito em '%s' com sucesso.\n", filename);
+                proto_free(&extra);
+            }
+        } else if (strcmp(cmd, "du") == 0) {
+            status = remote_du(&c, strtok(NULL, " \t"));
+        } else if (strcmp(cmd, "find") == 0) {
+            int walk = 0;
+            char *path = NULL, *pattern = NULL, *arg;
+            while ((arg = strtok(NULL, " \t")) != NULL) {
+                if (strcmp(arg, "--walk") == 0) walk = 1;
+                else if (strcmp(arg, "-name") == 0) pattern = strtok(NULL, " \t");
+                else path = arg;
+            }
+            if (pattern) {
+                // Aspas em volta do padrão são opcionais
+                size_t len = strlen(pattern);
+                if (len >= 2 && (pattern[0] == '"' || pattern[0] == '\'') && pattern[len - 1] == pattern[0]) {
+                    pattern[len - 1] = '\0';
+                    pattern++;
+                }
+                status = remote_find(&c, path ? path : ".", pattern, walk);
+            } else {
+                printf("Uso: find [--walk] [caminho] -name <padrão>\n");
+            }
+        } else if (strcmp(cmd, "defrag") == 0 || strcmp(cmd, "set") == 0) {
+            printf("Comando não disponível no modo cliente: %s\n", cmd);
+        } else {
+            printf("Comando desconhecido: %s\n", cmd);
+        }
+        fflush(stdout);
+    }
+
+    close(c.fd);
+    proto_free(&c.in);
+    return 0;
+}
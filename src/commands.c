@@ -6,6 +6,7 @@
 #include "fs_core.h"
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 /*
  * =================================================================
@@ -30,13 +31,17 @@
     }
 }
 
-void cmd_ls() {
-    FileList files = fs_list_directory();
+void show_file_list(const FileList* files) {
     printf("Tipo\t\tNome\n");
     printf("----\t\t----\n");
-    for (size_t i = 0; i < files.count; i++) {
-        printf("<%s>\t\t%s\n", files.entries[i].type == TYPE_DIR ? "DIR" : "FILE", files.entries[i].name);
+    for (size_t i = 0; i < files->count; i++) {
+        printf("<%s>\t\t%s\n", files->entries[i].type == TYPE_DIR ? "DIR" : "FILE", files->entries[i].name);
     }
+}
+
+void cmd_ls(const char* caminho) {
+    FileList files = caminho ? fs_list_path(caminho) : fs_list_directory();
+    show_file_list(&files);
     free(files.entries);
 }
 
@@ -53,16 +58,88 @@ void cmd_import(const char* caminho_real, const char* nome_dest) {
     // A função do core já imprime a mensagem de erro específica
 }
 
+void cmd_import_tree(const char* dir_real, const char* nome_dest) {
+    if (fs_import_tree(dir_real, nome_dest) == 0) {
+        printf("Diretório '%s' importado com sucesso para '%s'.\n", dir_real, nome_dest);
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
+static int cat_chunk(const char* data, size_t len, void* ctx) {
+    (void) ctx;
+    return fwrite(data, 1, len, stdout) == len ? 0 : -1;
+}
+
 void cmd_cat(const char* nome_arq) {
-    char* file_content = fs_read_file(nome_arq);
-    if (file_content) {
-        printf("%s\n",file_content);
-        free(file_content); // Libera a memória alocada pela função fs_read_file
-    } else {
-        // A função do core já imprime a mensagem de erro específica
+    // Lê em fluxo: arquivos comprimidos são descomprimidos cluster a cluster
+    if (fs_stream_file(nome_arq, cat_chunk, NULL) == 0) {
+        printf("\n");
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
+void cmd_compress(const char* nome_arq) {
+    if (fs_compress_file(nome_arq) == 0) {
+        printf("Arquivo '%s' comprimido com sucesso.\n", nome_arq);
     }
 }
 
+void cmd_cp(const char* origem, const char* destino, int reflink) {
+    if (fs_copy_file(origem, destino, reflink) == 0) {
+        printf("Arquivo '%s' copiado para '%s'%s.\n", origem, destino, reflink ? " (blocos compartilhados)" : "");
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
+// Converte um tamanho/deslocamento em bytes; aceita os sufixos K, M e G.
+int parse_bytes(const char* texto, uint64_t* out) {
+    char* fim;
+    unsigned long long valor = strtoull(texto, &fim, 10);
+    if (fim == texto) return -1;
+    if (*fim == 'K' || *fim == 'k') { valor *= 1024; fim++; }
+    else if (*fim == 'M' || *fim == 'm') { valor *= 1024 * 1024; fim++; }
+    else if (*fim == 'G' || *fim == 'g') { valor *= 1024ULL * 1024 * 1024; fim++; }
+    if (*fim != '\0') return -1;
+    *out = valor;
+    return 0;
+}
+
+void cmd_truncate(const char* nome_arq, const char* tamanho) {
+    uint64_t bytes;
+    if (parse_bytes(tamanho, &bytes) != 0) {
+        printf("Tamanho inválido: %s\n", tamanho);
+        return;
+    }
+    if (fs_truncate_file(nome_arq, bytes) == 0) {
+        printf("Arquivo '%s' agora tem %llu bytes.\n", nome_arq, (unsigned long long) bytes);
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
+void cmd_write(const char* nome_arq, const char* deslocamento, const char* texto) {
+    uint64_t offset;
+    if (parse_bytes(deslocamento, &offset) != 0) {
+        printf("Deslocamento inválido: %s\n", deslocamento);
+        return;
+    }
+    if (fs_write_at(nome_arq, offset, texto, strlen(texto)) == 0) {
+        printf("%zu bytes escritos em '%s' a partir do byte %llu.\n", strlen(texto), nome_arq, (unsigned long long) offset);
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
+void cmd_punch(const char* nome_arq, const char* deslocamento, const char* tamanho) {
+    uint64_t offset, len;
+    if (parse_bytes(deslocamento, &offset) != 0 || parse_bytes(tamanho, &len) != 0) {
+        printf("Uso: punch <arquivo> <deslocamento> <tamanho>\n");
+        return;
+    }
+    if (fs_punch_file(nome_arq, offset, len) == 0) {
+        printf("Intervalo liberado em '%s'.\n", nome_arq);
+    }
+    // A função do core já imprime a mensagem de erro específica
+}
+
 void cmd_rename(const char* nome_antigo, const char* nome_novo) {
     if (fs_rename(nome_antigo, nome_novo) == 0) {
         printf("Item '%s' renomeado para '%s' com sucesso.\n", nome_antigo, nome_novo);
@@ -91,45 +168,122 @@ void cmd_rmdir(const char* nome_dir) {
     // A função do core já imprime a mensagem de erro específica
 }
 
-void cmd_stat(const char* name) {
-    Inode inode = fs_stat_item(name);
-
-    if (inode.link_count != 0) {  // Supondo que inode válido sempre tem link_count > 0
-        printf("Estatísticas para: '%s'\n", name);
-        printf("----------------------------------\n");
-        printf("  Tipo..........: %s\n", (inode.type == TYPE_DIR) ? "Diretório" : "Arquivo");
-        printf("  Links.........: %u\n", inode.link_count);
-        printf("  Tamanho.......: %u bytes\n", inode.size);
-        char time_buffer[26];
-        ctime_r(&inode.created, time_buffer);
-        time_buffer[strlen(time_buffer) - 1] = '\0';
-        printf("  Criado em.....: %s\n", time_buffer);
-        ctime_r(&inode.accessed, time_buffer);
-        time_buffer[strlen(time_buffer) - 1] = '\0';
-        printf("  Acessado em...: %s\n", time_buffer);
-        ctime_r(&inode.modified, time_buffer);
-        time_buffer[strlen(time_buffer) - 1] = '\0';
-        printf("  Modificado em.: %s\n", time_buffer);
+void show_stat(const char* name, const Inode* inode) {
+    printf("Estatísticas para: '%s'\n", name);
+    printf("----------------------------------\n");
+    printf("  Tipo..........: %s\n", (inode->type == TYPE_DIR) ? "Diretório" : "Arquivo");
+    printf("  Links.........: %u\n", inode->link_count);
+    printf("  Tamanho.......: %llu bytes\n", (unsigned long long) inode->size);
+    char time_buffer[26];
+    ctime_r(&inode->created, time_buffer);
+    time_buffer[strlen(time_buffer) - 1] = '\0';
+    printf("  Criado em.....: %s\n", time_buffer);
+    ctime_r(&inode->accessed, time_buffer);
+    time_buffer[strlen(time_buffer) - 1] = '\0';
+    printf("  Acessado em...: %s\n", time_buffer);
+    ctime_r(&inode->modified, time_buffer);
+    time_buffer[strlen(time_buffer) - 1] = '\0';
+    printf("  Modificado em.: %s\n", time_buffer);
+    if (inode->flags & INODE_FLAG_COMPRESSED) {
+        printf("  Compressão....: ligada (clusters de %d blocos)\n", COMPRESS_CLUSTER_BLOCKS);
+    }
+    if (inode->flags & INODE_FLAG_INLINE) {
+        printf("  Blocos de Dados: nenhum (dados inline no i-node)\n");
+    } else {
         printf("  Blocos de Dados: [ ");
         for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-            if (inode.direct_blocks[i] != 0) {
-                printf("%u ", inode.direct_blocks[i]);
+            if (inode->direct_blocks[i] != 0) {
+                printf("%u ", inode->direct_blocks[i]);
             }
         }
         printf("]\n");
     }
 }
 
-void cmd_df() {
-    DiskUsageInfo disk_data = fs_disk_free();
+void cmd_stat(const char* name) {
+    Inode inode = fs_stat_item(name);
+    if (inode.link_count != 0) {  // Supondo que inode válido sempre tem link_count > 0
+        show_stat(name, &inode);
+    }
+}
+
+void show_disk_usage(const DiskUsageInfo* disk_data) {
     printf("Visão Geral do Sistema de Arquivos\n");
     printf("----------------------------------------------------------\n");
     printf("Recurso      |         Total |          Usado |          Livre\n");
     printf("----------------------------------------------------------\n");
-    printf("I-nodes      | %13u | %12u | %12u\n", disk_data.total_inodes, disk_data.used_inodes, disk_data.free_inodes);
-    printf("Blocos       | %13u | %12u | %12u\n", disk_data.total_blocks, disk_data.used_blocks, disk_data.free_blocks);
-    printf("Espaço (KB)  | %13u | %12u | %12u\n", disk_data.total_kb, disk_data.used_kb, disk_data.free_kb);
+    printf("I-nodes      | %13u | %12u | %12u\n", disk_data->total_inodes, disk_data->used_inodes, disk_data->free_inodes);
+    printf("Blocos       | %13u | %12u | %12u\n", disk_data->total_blocks, disk_data->used_blocks, disk_data->free_blocks);
+    printf("Espaço (KB)  | %13llu | %12llu | %12llu\n", (unsigned long long) disk_data->total_kb,
+           (unsigned long long) disk_data->used_kb, (unsigned long long) disk_data->free_kb);
     printf("----------------------------------------------------------\n");
+    if (disk_data->logical_blocks > disk_data->used_blocks) {
+        printf("Uso lógico: %llu KB em %llu KB físicos (%llu KB economizados com blocos compartilhados)\n",
+               (unsigned long long) disk_data->logical_kb, (unsigned long long) disk_data->used_kb,
+               (unsigned long long) (disk_data->logical_kb - disk_data->used_kb));
+    }
+}
+
+void cmd_df() {
+    DiskUsageInfo disk_data = fs_disk_free();
+    show_disk_usage(&disk_data);
+}
+
+void show_dir_usage(const char* name, int type, const DirUsage* usage) {
+    if (!name) {
+        printf("%12s %10s %8s  Nome\n", "Bytes", "KB", "Itens");
+        return;
+    }
+    printf("%12llu %10llu %8u  %s%s\n", (unsigned long long) usage->bytes, (unsigned long long) usage->kb,
+           usage->entries, name, type == TYPE_DIR ? "/" : "");
+}
+
+void show_dir_usage_total(const DirUsage* total) {
+    printf("%12llu %10llu %8u  total (%u blocos)\n", (unsigned long long) total->bytes, (unsigned long long) total->kb,
+           total->entries, total->blocks);
+}
+
+void cmd_du(const char* caminho) {
+    const char* raiz = caminho ? caminho : ".";
+    DirUsage total;
+    if (fs_dir_usage(raiz, &total) != 0) return;
+    show_dir_usage(NULL, 0, NULL);
+    FileList files = fs_list_path(raiz);
+    size_t len = strlen(raiz) + MAX_FILENAME_LEN + 2;
+    char* filho = malloc(len);
+    for (size_t i = 0; i < files.count && filho; i++) {
+        const char* nome = files.entries[i].name;
+        if (strcmp(nome, ".") == 0 || strcmp(nome, "..") == 0) continue;
+        snprintf(filho, len, "%s/%s", raiz, nome);
+        DirUsage uso;
+        if (fs_dir_usage(filho, &uso) != 0) continue;
+        show_dir_usage(nome, files.entries[i].type, &uso);
+    }
+    free(filho);
+    free(files.entries);
+    show_dir_usage_total(&total);
+}
+
+static int print_path(const char* path, void* ctx) {
+    printf("%s\n", path);
+    (void) ctx;
+    return 0;
+}
+
+void cmd_find(const char* caminho, const char* padrao, int varrer) {
+    struct timespec inicio, fim;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int encontrados = fs_find(caminho, padrao, varrer, print_path, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &fim);
+    if (encontrados < 0) return;
+    double ms = (fim.tv_sec - inicio.tv_sec) * 1e3 + (fim.tv_nsec - inicio.tv_nsec) / 1e6;
+    printf("%d item(ns) encontrado(s) em %.2f ms.\n", encontrados, ms);
+}
+
+void cmd_sync() {
+    if (fs_sync() == 0) {
+        printf("Dados pendentes gravados no disco.\n");
+    }
 }
 
 void cmd_echo(const char* text, const char* op, const char* filename) {
@@ -152,4 +306,74 @@ void cmd_set(const char* param, const char* value) {
     } else {
         printf("Parâmetro desconhecido: %s\n", param);
     }
-}
\ No newline at end of file
+}
+
+int cmd_fsck(int repair) {
+    FsckReport report;
+    int problems = fs_check(repair, &report);
+    if (problems < 0) {
+        fprintf(stderr, "Erro: A verificação não pôde ser concluída.\n");
+        return -1;
+    }
+    printf("Verificação do Sistema de Arquivos\n");
+    printf("----------------------------------------------------------\n");
+    printf("I-nodes verificados.........: %u (%u diretórios)\n", report.inodes_checked, report.dirs_checked);
+    printf("I-nodes inválidos...........: %u\n", report.bad_inodes);
+    printf("I-nodes órfãos..............: %u\n", report.orphan_inodes);
+    printf("Entradas pendentes..........: %u\n", report.dangling_entries);
+    printf("Erros de link_count.........: %u\n", report.link_count_errors);
+    printf("Erros de '..'...............: %u\n", report.dotdot_errors);
+    printf("Erros de tamanho............: %u\n", report.size_errors);
+    printf("Blocos vazados..............: %u\n", report.leaked_blocks);
+    printf("Blocos em uso não marcados..: %u\n", report.unmarked_blocks);
+    printf("Blocos duplicados...........: %u\n", report.duplicate_blocks);
+    printf("Erros no bitmap de i-nodes..: %u\n", report.inode_bitmap_errors);
+    printf("Checksums inválidos.........: %u\n", report.checksum_errors);
+    printf("Contagens de referência.....: %u\n", report.refcount_errors);
+    printf("Totais de uso...............: %u\n", report.usage_errors);
+    printf("Índice de nomes.............: %u\n", report.name_index_errors);
+    printf("----------------------------------------------------------\n");
+    if (problems == 0) {
+        printf("Nenhum problema encontrado.\n");
+    } else if (repair) {
+        printf("%d problema(s) encontrado(s), %u correção(ões) aplicada(s).\n", problems, report.repaired);
+    } else {
+        printf("%d problema(s) encontrado(s). Execute com -y para reparar.\n", problems);
+    }
+    return problems;
+}
+
+void cmd_defrag(const char* name, int compact, uint32_t budget_ms) {
+    DefragReport report;
+    if (fs_defrag(name, compact, budget_ms, &report) != 0) {
+        // A função do core já imprime a mensagem de erro específica
+        return;
+    }
+    printf("Itens examinados: %u | fragmentados: %u | realocados: %u (%u blocos)\n",
+           report.files_scanned, report.fragmented, report.relocated, report.blocks_moved);
+    printf("Sequências de blocos: %u -> %u\n", report.extents_before, report.extents_after);
+    if (report.dirs_compacted > 0) printf("Diretórios compactados: %u\n", report.dirs_compacted);
+    if (!report.finished) {
+        printf("Fatia de tempo esgotada. Execute 'defrag' novamente para continuar.\n");
+    }
+}
+int cmd_profile(const char* amostra, uint32_t tamanho_bloco_kb, WorkloadProfile* perfil) {
+    if (profile_workload(amostra, perfil) != 0) return -1;
+    profile_choose_geometry(perfil, tamanho_bloco_kb);
+    printf("Amostra '%s': %u arquivos (%u inline), %u diretórios, %llu bytes.\n", amostra, perfil->files,
+           perfil->inline_files, perfil->dirs, (unsigned long long) perfil->total_bytes);
+    printf("Maior arquivo: %llu bytes; maior diretório: %u entradas.\n",
+           (unsigned long long) perfil->max_file, perfil->max_fanout);
+    printf("%-8s %14s %14s  %s\n", "Bloco", "Ocupado", "Desperdício", "Cabe");
+    for (int i = 0; i < PROFILE_CANDIDATES; ++i) {
+        const ProfileCandidate* c = &perfil->candidates[i];
+        printf("%5u KB %14llu %14llu  %s%s\n", c->block_size_kb, (unsigned long long) c->used_bytes,
+               (unsigned long long) c->wasted_bytes, c->viable ? "sim" : "não",
+               c->block_size_kb == perfil->block_size_kb ? "  <-" : "");
+    }
+    if (!tamanho_bloco_kb && !perfil->candidates[PROFILE_CANDIDATES - 1].viable) {
+        printf("Aviso: a amostra não cabe nos blocos diretos com nenhum tamanho; usando o maior.\n");
+    }
+    printf("Escolhido: blocos de %u KB, um i-node a cada %u bytes.\n", perfil->block_size_kb, perfil->bytes_per_inode);
+    return 0;
+}
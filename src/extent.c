@@ -0,0 +1,276 @@
+// src/extent.c
+#include <stdlib.h>
+#include "extent.h"
+
+#define BY_START 0
+#define BY_LENGTH 1
+
+typedef struct {
+    ExtentNode* left;
+    ExtentNode* right;
+    int height;
+    uint32_t max_length; // Maior comprimento na subárvore (usado na árvore por início)
+} ExtentLink;
+
+struct ExtentNode {
+    uint32_t start;
+    uint32_t length;
+    ExtentLink link[2];
+};
+
+// --- Árvore AVL (uma por ordem, nos mesmos nós) ---
+
+static int compare(const ExtentNode* a, const ExtentNode* b, int order) {
+    if (order == BY_LENGTH && a->length != b->length) return a->length < b->length ? -1 : 1;
+    if (a->start != b->start) return a->start < b->start ? -1 : 1;
+    return 0;
+}
+
+static int height(const ExtentNode* node, int order) {
+    return node ? node->link[order].height : 0;
+}
+
+static uint32_t max_length(const ExtentNode* node, int order) {
+    return node ? node->link[order].max_length : 0;
+}
+
+static void update(ExtentNode* node, int order) {
+    ExtentLink* l = &node->link[order];
+    int hl = height(l->left, order), hr = height(l->right, order);
+    l->height = 1 + (hl > hr ? hl : hr);
+    l->max_length = node->length;
+    if (max_length(l->left, order) > l->max_length) l->max_length = max_length(l->left, order);
+    if (max_length(l->right, order) > l->max_length) l->max_length = max_length(l->right, order);
+}
+
+static ExtentNode* rotate_right(ExtentNode* node, int order) {
+    ExtentNode* pivot = node->link[order].left;
+    node->link[order].left = pivot->link[order].right;
+    pivot->link[order].right = node;
+    update(node, order);
+    update(pivot, order);
+    return pivot;
+}
+
+static ExtentNode* rotate_left(ExtentNode* node, int order) {
+    ExtentNode* pivot = node->link[order].right;
+    node->link[order].right = pivot->link[order].left;
+    pivot->link[order].left = node;
+    update(node, order);
+    update(pivot, order);
+    return pivot;
+}
+
+static ExtentNode* rebalance(ExtentNode* node, int order) {
+    update(node, order);
+    ExtentLink* l = &node->link[order];
+    int balance = height(l->left, order) - height(l->right, order);
+    if (balance > 1) {
+        if (height(l->left->link[order].left, order) < height(l->left->link[order].right, order)) {
+            l->left = rotate_left(l->left, order);
+        }
+        return rotate_right(node, order);
+    }
+    if (balance < -1) {
+        if (height(l->right->link[order].right, order) < height(l->right->link[order].left, order)) {
+            l->right = rotate_right(l->right, order);
+        }
+        return rotate_left(node, order);
+    }
+    return node;
+}
+
+static ExtentNode* avl_insert(ExtentNode* root, ExtentNode* node, int order) {
+    if (!root) {
+        node->link[order].left = node->link[order].right = NULL;
+        update(node, order);
+        return node;
+    }
+    if (compare(node, root, order) < 0) root->link[order].left = avl_insert(root->link[order].left, node, order);
+    else root->link[order].right = avl_insert(root->link[order].right, node, order);
+    return rebalance(root, order);
+}
+
+// Tira o menor nó da subárvore; ele volta em '*min'.
+static ExtentNode* avl_remove_min(ExtentNode* root, ExtentNode** min, int order) {
+    if (!root->link[order].left) {
+        *min = root;
+        return root->link[order].right;
+    }
+    root->link[order].left = avl_remove_min(root->link[order].left, min, order);
+    return rebalance(root, order);
+}
+
+static ExtentNode* avl_remove(ExtentNode* root, const ExtentNode* node, int order) {
+    if (!root) return NULL;
+    int cmp = compare(node, root, order);
+    if (cmp < 0) {
+        root->link[order].left = avl_remove(root->link[order].left, node, order);
+    } else if (cmp > 0) {
+        root->link[order].right = avl_remove(root->link[order].right, node, order);
+    } else {
+        ExtentNode* left = root->link[order].left;
+        ExtentNode* right = root->link[order].right;
+        if (!right) return left;
+        ExtentNode* successor;
+        right = avl_remove_min(right, &successor, order);
+        successor->link[order].left = left;
+        successor->link[order].right = right;
+        return rebalance(successor, order);
+    }
+    return rebalance(root, order);
+}
+
+static void link_node(ExtentTree* tree, ExtentNode* node) {
+    tree->by_start = avl_insert(tree->by_start, node, BY_START);
+    tree->by_length = avl_insert(tree->by_length, node, BY_LENGTH);
+    tree->count++;
+    tree->free_blocks += node->length;
+}
+
+static void unlink_node(ExtentTree* tree, ExtentNode* node) {
+    tree->by_start = avl_remove(tree->by_start, node, BY_START);
+    tree->by_length = avl_remove(tree->by_length, node, BY_LENGTH);
+    tree->count--;
+    tree->free_blocks -= node->length;
+}
+
+// Último extent com início <= 'block', ou NULL.
+static ExtentNode* floor_extent(const ExtentTree* tree, uint32_t block) {
+    ExtentNode* node = tree->by_start;
+    ExtentNode* found = NULL;
+    while (node) {
+        if (node->start <= block) {
+            found = node;
+            node = node->link[BY_START].right;
+        } else {
+            node = node->link[BY_START].left;
+        }
+    }
+    return found;
+}
+
+// Primeiro extent (por início) com início >= 'from' e pelo menos 'length' blocos.
+static ExtentNode* first_fit_from(ExtentNode* node, uint32_t from, uint32_t length) {
+    if (!node || node->link[BY_START].max_length < length) return NULL;
+    if (node->start < from) return first_fit_from(node->link[BY_START].right, from, length);
+    ExtentNode* left = first_fit_from(node->link[BY_START].left, from, length);
+    if (left) return left;
+    if (node->length >= length) return node;
+    return first_fit_from(node->link[BY_START].right, from, length);
+}
+
+static void free_subtree(ExtentNode* node) {
+    if (!node) return;
+    free_subtree(node->link[BY_START].left);
+    free_subtree(node->link[BY_START].right);
+    free(node);
+}
+
+// --- Interface ---
+
+void extent_tree_init(ExtentTree* tree) {
+    tree->by_start = tree->by_length = NULL;
+    tree->count = 0;
+    tree->free_blocks = 0;
+}
+
+void extent_tree_clear(ExtentTree* tree) {
+    free_subtree(tree->by_start);
+    extent_tree_init(tree);
+}
+
+int extent_tree_add(ExtentTree* tree, uint32_t start, uint32_t length) {
+    if (length == 0) return 0;
+    ExtentNode* before = floor_extent(tree, start);
+    ExtentNode* after = floor_extent(tree, start + length);
+    if (after && after->start != start + length) after = NULL;
+    if (before && (uint64_t) before->start + before->length != start) before = NULL;
+    ExtentNode* node = before ? before : after;
+    if (node) {
+        unlink_node(tree, node);
+        if (before && after) {
+            unlink_node(tree, after);
+            before->length += length + after->length;
+            free(after);
+        } else if (before) {
+            before->length += length;
+        } else {
+            after->start = start;
+            after->length += length;
+        }
+    } else {
+        node = malloc(sizeof(ExtentNode));
+        if (!node) return -1;
+        node->start = start;
+        node->length = length;
+    }
+    link_node(tree, node);
+    return 0;
+}
+
+int extent_tree_remove(ExtentTree* tree, uint32_t start, uint32_t length) {
+    if (length == 0) return 0;
+    ExtentNode* node = floor_extent(tree, start);
+    if (!node || (uint64_t) start + length > (uint64_t) node->start + node->length) return -1;
+    uint32_t tail_start = start + length;
+    uint32_t tail_length = node->start + node->length - tail_start;
+    ExtentNode* tail = NULL;
+    if (tail_length > 0 && start > node->start) {
+        // Sobra dos dois lados: o extent se divide em dois
+        tail = malloc(sizeof(ExtentNode));
+        if (!tail) return -1;
+        tail->start = tail_start;
+        tail->length = tail_length;
+    }
+    unlink_node(tree, node);
+    if (start > node->start) {
+        node->length = start - node->start;
+        link_node(tree, node);
+        if (tail) link_node(tree, tail);
+    } else if (tail_length > 0) {
+        node->start = tail_start;
+        node->length = tail_length;
+        link_node(tree, node);
+    } else {
+        free(node);
+    }
+    return 0;
+}
+
+int extent_tree_find_near(const ExtentTree* tree, uint32_t goal, uint32_t length, uint32_t limit, uint32_t* start) {
+    ExtentNode* node = floor_extent(tree, goal);
+    if (node && (uint64_t) node->start + node->length >= (uint64_t) goal + length && (uint64_t) goal + length <= limit) {
+        *start = goal;
+        return 0;
+    }
+    node = first_fit_from(tree->by_start, goal, length);
+    if (!node || (uint64_t) node->start + length > limit) return -1;
+    *start = node->start;
+    return 0;
+}
+
+int extent_tree_find_best(const ExtentTree* tree, uint32_t length, uint32_t* start) {
+    ExtentNode* node = tree->by_length;
+    ExtentNode* found = NULL;
+    while (node) {
+        if (node->length >= length) {
+            found = node;
+            node = node->link[BY_LENGTH].left;
+        } else {
+            node = node->link[BY_LENGTH].right;
+        }
+    }
+    if (!found) return -1;
+    *start = found->start;
+    return 0;
+}
+
+int extent_tree_longest(const ExtentTree* tree, uint32_t* start, uint32_t* length) {
+    ExtentNode* node = tree->by_length;
+    if (!node) return -1;
+    while (node->link[BY_LENGTH].right) node = node->link[BY_LENGTH].right;
+    *start = node->start;
+    *length = node->length;
+    return 0;
+}
@@ -1,17 +1,36 @@
+#define _GNU_SOURCE // O_DIRECT
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include "fs_core.h"
 #include "fs_types.h"
+#include "lz.h"
+#include "crc32c.h"
+#include "extent.h"
+#include "trace.h"
 #include <time.h>
 #include <stdarg.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <fnmatch.h>
+#include <sched.h>
 
 // --- Variáveis Globais ---
 static FILE* disk_file = NULL;
 static Superblock sb;
 uint32_t current_inode_num = 0;
 static int verbose_mode = 0;
+static uint32_t* block_checksums = NULL;     // CRC32C de cada bloco (NULL = verificação desligada)
+static unsigned char* checksum_dirty = NULL; // Blocos da tabela alterados desde a última gravação
+static unsigned char* checksum_state = NULL; // CHECKSUM_* de cada bloco nesta montagem
+
+#define CHECKSUM_UNVERIFIED 0 // Ainda não lido nesta montagem
+#define CHECKSUM_TRUSTED 1    // Já verificado ou escrito por este processo
+#define CHECKSUM_PENDING 2    // Metadado reescrito; CRC calculado só no próximo sync
 
 // --- Funções Auxiliares de Impressão ---
 static void verbose_printf(const char* format, ...) {
@@ -24,848 +43,4778 @@ static void verbose_printf(const char* format, ...) {
     }
 }
 
-// --- Funções Auxiliares de Bloco ---
-static int block_write(uint32_t block_num, const void* data) {
-    verbose_printf("Escrevendo no disco: Bloco %u\n", block_num);
-    if (!disk_file) return -1;
-    if (fseek(disk_file, block_num * sb.block_size, SEEK_SET) != 0) return -1;
-    if (fwrite(data, sb.block_size, 1, disk_file) != 1) return -1;
-    return 0;
+// --- Codificação em Disco ---
+// A partir do formato v2, superbloco e i-nodes são gravados campo a campo em
+// little-endian, sem depender do alinhamento ou do tamanho de time_t e enum.
+// No v3 o resto também: entradas de diretório (registros compactos, veja
+// DirectoryEntry), as tabelas de checksums, referências, deduplicação, uso e
+// nomes e o cabeçalho dos clusters comprimidos. Nos discos v1 e v2 esses
+// ficam na ordem de bytes do host; o 'upgrade' os converte.
+static uint32_t get_le32(const unsigned char* p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
 }
 
-static int block_read(uint32_t block_num, void* data) {
-    verbose_printf("Lendo do disco: Bloco %u\n", block_num);
-    if (!disk_file) return -1;
-    if (fseek(disk_file, block_num * sb.block_size, SEEK_SET) != 0) return -1;
-    if (fread(data, sb.block_size, 1, disk_file) != 1) return -1;
-    return 0;
+static void put_le32(unsigned char* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
 }
 
-// --- Funções Auxiliares de I-node e Bitmap ---
-static int inode_write(uint32_t inode_num, const Inode* inode_data) {
-    uint32_t inodes_per_block = sb.block_size / sizeof(Inode);
-    uint32_t block_num = sb.inode_table_start + (inode_num / inodes_per_block);
-    uint32_t offset_in_block = (inode_num % inodes_per_block) * sizeof(Inode);
-    verbose_printf("Escrevendo i-node %u (Bloco: %u, Offset: %u)\n", inode_num, block_num, offset_in_block);
-    char block_buffer[sb.block_size];
-    if (block_read(block_num, block_buffer) != 0) return -1;
-    memcpy(block_buffer + offset_in_block, inode_data, sizeof(Inode));
-    return block_write(block_num, block_buffer);
+static int host_is_little_endian() {
+    const uint16_t one = 1;
+    return *(const unsigned char*) &one == 1;
 }
 
-static int inode_read(uint32_t inode_num, Inode* inode_data) {
-    uint32_t inodes_per_block = sb.block_size / sizeof(Inode);
-    uint32_t block_num = sb.inode_table_start + (inode_num / inodes_per_block);
-    uint32_t offset_in_block = (inode_num % inodes_per_block) * sizeof(Inode);
-    verbose_printf("Lendo i-node %u (Bloco: %u, Offset: %u)\n", inode_num, block_num, offset_in_block);
-    char block_buffer[sb.block_size];
-    if (block_read(block_num, block_buffer) != 0) return -1;
-    memcpy(inode_data, block_buffer + offset_in_block, sizeof(Inode));
-    return 0;
+// As tabelas ficam em memória na ordem do host. Num disco v3 em host
+// big-endian elas são convertidas ao ler e ao gravar; nos demais casos o
+// conteúdo em disco já é o da memória.
+static int tables_need_swap() {
+    return sb.version >= 3 && !host_is_little_endian();
 }
 
-static int find_free_bit_from(uint32_t bitmap_start_block, uint32_t total_bits, uint32_t start_bit) {
-    if (start_bit >= total_bits) return -1;
-    char block_buffer[sb.block_size];
-    uint32_t start_block_idx = start_bit / (sb.block_size * 8);
-    uint32_t blocks_in_bitmap = (total_bits + 8 * sb.block_size - 1) / (8 * sb.block_size);
-    for (uint32_t i = start_block_idx; i < blocks_in_bitmap; ++i) {
-        if (block_read(bitmap_start_block + i, block_buffer) != 0) return -1;
-        uint32_t start_byte = (i == start_block_idx) ? (start_bit % (sb.block_size * 8)) / 8 : 0;
-        for (uint32_t byte = start_byte; byte < sb.block_size; ++byte) {
-            if ((unsigned char)block_buffer[byte] != 0xFF) {
-                uint32_t start_bit_in_byte = (i == start_block_idx && byte == start_byte) ? (start_bit % 8) : 0;
-                for (int bit = start_bit_in_byte; bit < 8; ++bit) {
-                    if (!((block_buffer[byte] >> bit) & 1)) {
-                        uint32_t bit_num = i * sb.block_size * 8 + byte * 8 + bit;
-                        if (bit_num < total_bits) return bit_num;
-                    }
-                }
-            }
-        }
-    }
-    return -1;
+// Trocam no lugar um inteiro entre a ordem do host e little-endian. A troca é
+// a própria inversa, então serve nos dois sentidos.
+static void le32_swap(unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    put_le32(p, value);
 }
 
-static uint32_t count_set_bits(uint32_t bitmap_start_block, uint32_t total_bits) {
-    verbose_printf("Contando bits usados no bitmap (início: bloco %u, total: %u bits)\n", bitmap_start_block, total_bits);
-    uint32_t count = 0;
-    char block_buffer[sb.block_size];
-    uint32_t blocks_in_bitmap = (total_bits + 8 * sb.block_size - 1) / (8 * sb.block_size);
-    for (uint32_t i = 0; i < blocks_in_bitmap; ++i) {
-        if (block_read(bitmap_start_block + i, block_buffer) != 0) return -1;
-        for (uint32_t byte = 0; byte < sb.block_size; ++byte) {
-            for (int bit = 0; bit < 8; ++bit) {
-                if ((block_buffer[byte] >> bit) & 1) {
-                    if ((i * sb.block_size * 8 + byte * 8 + bit) < total_bits) count++;
-                }
-            }
-        }
+static void le64_swap(unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    put_le32(p, (uint32_t) value);
+    put_le32(p + 4, (uint32_t) (value >> 32));
+}
+
+// Tabelas formadas só por inteiros de 32 bits (checksums, referências e deduplicação).
+static void u32_table_swap(char* data, size_t bytes) {
+    for (size_t off = 0; off + sizeof(uint32_t) <= bytes; off += sizeof(uint32_t)) le32_swap((unsigned char*) data + off);
+}
+
+// O superbloco só tem campos uint32_t: todas as versões têm a mesma codificação em hosts little-endian.
+static void superblock_encode(const Superblock* from, unsigned char* raw) {
+    const uint32_t* field = (const uint32_t*) from;
+    for (size_t i = 0; i < sizeof(Superblock) / sizeof(uint32_t); ++i) put_le32(raw + i * sizeof(uint32_t), field[i]);
+}
+
+static void superblock_decode(const unsigned char* raw, Superblock* to) {
+    uint32_t* field = (uint32_t*) to;
+    for (size_t i = 0; i < sizeof(Superblock) / sizeof(uint32_t); ++i) field[i] = get_le32(raw + i * sizeof(uint32_t));
+}
+
+// --- Disposição do Disco ---
+// O disco começa com o superbloco e as tabelas globais (checksums,
+// referências, deduplicação, uso, nomes e a área reservada), e é dividido em
+// grupos de blocos. Com FEATURE_BLOCK_GROUPS, como no ext2, cada grupo começa
+// com os próprios metadados: um bloco do bitmap de blocos, um do bitmap de
+// i-nodes e a sua fatia da tabela de i-nodes, perto dos dados do grupo. Sem o
+// recurso (discos anteriores a ele), os bitmaps e a tabela são áreas
+// contíguas logo depois do superbloco. O resto do código endereça bitmaps e
+// tabela por índice lógico (bitmap_block, inode_table_block); só a posição
+// no disco muda.
+
+// I-node do formato v1: a estrutura em memória de então, gravada como estava.
+typedef struct {
+    InodeType type;
+    uint32_t size;
+    uint32_t link_count;
+    uint32_t flags;
+    time_t created;
+    time_t modified;
+    time_t accessed;
+    uint32_t direct_blocks[INODE_DIRECT_BLOCKS];
+} InodeV1;
+
+static uint32_t inode_disk_size() {
+    return sb.version >= 2 ? INODE_DISK_SIZE : sizeof(InodeV1);
+}
+
+// Um i-node nunca atravessa blocos: a sobra no fim de cada bloco fica vazia.
+static uint32_t inodes_per_block() {
+    return sb.block_size / inode_disk_size();
+}
+
+static uint32_t inode_table_blocks(uint32_t total_inodes) {
+    return (total_inodes + inodes_per_block() - 1) / inodes_per_block();
+}
+
+// Primeiro bloco depois da tabela de i-nodes: a próxima área que existe no
+// disco. Em discos anteriores aos checksums, checksum_start e as outras
+// tabelas são 0 e a tabela vai até o início dos dados.
+static uint32_t inode_table_end() {
+    uint32_t starts[] = { sb.checksum_start, sb.refcount_start, sb.dedup_start, sb.usage_start,
+                          sb.name_index_start, sb.reserved_start };
+    uint32_t end = sb.data_blocks_start;
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); ++i) {
+        if (starts[i] > sb.inode_table_start && starts[i] < end) end = starts[i];
     }
-    verbose_printf("Total de bits usados: %u\n", count);
-    return count;
+    return end;
 }
 
-static int set_bit(uint32_t bitmap_start_block, uint32_t bit_num, int value) {
-    uint32_t block_idx = bit_num / (sb.block_size * 8);
-    uint32_t byte_in_block = (bit_num % (sb.block_size * 8)) / 8;
-    uint32_t bit_in_byte = bit_num % 8;
-    verbose_printf("Definindo bit #%u para %d (Bloco do bitmap: %u)\n", bit_num, value, bitmap_start_block + block_idx);
-    char block_buffer[sb.block_size];
-    if (block_read(bitmap_start_block + block_idx, block_buffer) != 0) return -1;
-    if (value) block_buffer[byte_in_block] |= (1 << bit_in_byte);
-    else block_buffer[byte_in_block] &= ~(1 << bit_in_byte);
-    return block_write(bitmap_start_block + block_idx, block_buffer);
+// Grupos de blocos: 8 * block_size blocos, um bloco do bitmap de blocos cada.
+static uint32_t blocks_per_group() {
+    return sb.block_size * 8;
 }
 
-static int alloc_inode() {
-    verbose_printf("Procurando i-node livre a partir do #1...\n");
-    int inode_num = find_free_bit_from(sb.inode_bitmap_start, sb.total_inodes, 1);
-    if (inode_num != -1) {
-        verbose_printf("I-node livre encontrado: #%d. Marcando como usado.\n", inode_num);
-        if (set_bit(sb.inode_bitmap_start, inode_num, 1) != 0) return -1;
+static uint32_t group_count() {
+    return (sb.total_blocks + blocks_per_group() - 1) / blocks_per_group();
+}
+
+// Múltiplo dos i-nodes por bloco: a fatia de cada grupo ocupa blocos inteiros da tabela
+static uint32_t inodes_per_group() {
+    uint32_t per_group = (sb.total_inodes + group_count() - 1) / group_count();
+    return (per_group + inodes_per_block() - 1) / inodes_per_block() * inodes_per_block();
+}
+
+static uint32_t inode_group(uint32_t inode_num) {
+    return inode_num / inodes_per_group();
+}
+
+static int grouped_layout() {
+    return (sb.features & FEATURE_BLOCK_GROUPS) != 0;
+}
+
+// Metadados de cada grupo com FEATURE_BLOCK_GROUPS: o bloco do bitmap de
+// blocos, o do bitmap de i-nodes e a fatia da tabela de i-nodes.
+static uint32_t group_meta_blocks() {
+    return 2 + inodes_per_group() / inodes_per_block();
+}
+
+// Grupos que começam antes do fim do cabeçalho: os metadados deles ficam
+// empilhados logo depois do cabeçalho, que termina no bitmap do grupo 0. O
+// primeiro grupo com metadados próprios começa depois da pilha.
+static uint32_t stacked_groups() {
+    uint32_t span = blocks_per_group() - group_meta_blocks();
+    uint32_t stacked = sb.block_bitmap_start / span + 1;
+    return stacked < group_count() ? stacked : group_count();
+}
+
+static uint32_t group_meta_start(uint32_t group) {
+    if (group < stacked_groups()) return sb.block_bitmap_start + group * group_meta_blocks();
+    return group * blocks_per_group();
+}
+
+// Metadados de um grupo no início do próprio grupo, no meio da área de dados
+// (ficam marcados como usados no bitmap de blocos).
+static int is_group_meta_block(uint32_t block_num) {
+    if (!grouped_layout() || block_num < sb.data_blocks_start) return 0;
+    return block_num / blocks_per_group() >= stacked_groups() && block_num % blocks_per_group() < group_meta_blocks();
+}
+
+// Bloco que pode pertencer a um arquivo.
+static int is_data_block(uint32_t block_num) {
+    return block_num >= sb.data_blocks_start && block_num < sb.total_blocks && !is_group_meta_block(block_num);
+}
+
+// Bits úteis em cada bloco de um bitmap (identificado pelo início gravado no
+// superbloco). O bitmap de i-nodes agrupado tem um bloco por grupo, só com os
+// i-nodes do grupo.
+static uint32_t bitmap_bits_per_block(uint32_t bitmap_start) {
+    if (grouped_layout() && bitmap_start == sb.inode_bitmap_start) return inodes_per_group();
+    return sb.block_size * 8;
+}
+
+// Posição no disco do bloco 'index' de um bitmap
+static uint32_t bitmap_block(uint32_t bitmap_start, uint32_t index) {
+    if (!grouped_layout()) return bitmap_start + index;
+    return group_meta_start(index) + (bitmap_start == sb.inode_bitmap_start ? 1 : 0);
+}
+
+// Posição no disco do bloco 'index' da tabela de i-nodes
+static uint32_t inode_table_block(uint32_t index) {
+    if (!grouped_layout()) return sb.inode_table_start + index;
+    uint32_t per_group = inodes_per_group() / inodes_per_block();
+    return group_meta_start(index / per_group) + 2 + index % per_group;
+}
+
+// Quantos blocos da tabela seguem contíguos no disco a partir de 'index'
+static uint32_t inode_table_run(uint32_t index) {
+    if (!grouped_layout()) return inode_table_blocks(sb.total_inodes) - index;
+    uint32_t per_group = inodes_per_group() / inodes_per_block();
+    return per_group - index % per_group;
+}
+
+// --- E/S Direta ---
+// Com 'run --direct', os blocos são lidos e gravados por um descritor aberto
+// com O_DIRECT, sem uma segunda cópia no cache de páginas do host. O O_DIRECT
+// exige endereço, deslocamento e tamanho alinhados; os buffers de quem chama
+// (em geral VLAs na pilha) não são, então cada requisição passa por um buffer
+// alinhado de um pool, com até DIRECT_CHUNK_BLOCKS blocos por vez.
+
+#define DIRECT_ALIGN 4096
+#define DIRECT_POOL_SIZE 4
+#define DIRECT_CHUNK_BLOCKS 16
+
+static int direct_fd = -1;
+static void* direct_pool[DIRECT_POOL_SIZE];
+static int direct_pool_free = 0; // Buffers disponíveis no topo de direct_pool
+static pthread_mutex_t direct_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t direct_chunk_bytes() {
+    return (size_t) DIRECT_CHUNK_BLOCKS * sb.block_size;
+}
+
+static void* direct_buffer_get() {
+    void* buffer = NULL;
+    pthread_mutex_lock(&direct_pool_lock);
+    if (direct_pool_free > 0) buffer = direct_pool[--direct_pool_free];
+    pthread_mutex_unlock(&direct_pool_lock);
+    if (!buffer && posix_memalign(&buffer, DIRECT_ALIGN, direct_chunk_bytes()) != 0) return NULL;
+    return buffer;
+}
+
+static void direct_buffer_put(void* buffer) {
+    pthread_mutex_lock(&direct_pool_lock);
+    if (direct_pool_free < DIRECT_POOL_SIZE) {
+        direct_pool[direct_pool_free++] = buffer;
+        buffer = NULL;
     }
-    return inode_num;
+    pthread_mutex_unlock(&direct_pool_lock);
+    free(buffer);
 }
 
-static int alloc_block() {
-    verbose_printf("Procurando bloco de dados livre a partir do bloco #%u...\n", sb.data_blocks_start);
-    int block_num = find_free_bit_from(sb.block_bitmap_start, sb.total_blocks, sb.data_blocks_start);
-    if (block_num != -1) {
-        verbose_printf("Bloco livre encontrado: #%d. Marcando como usado.\n", block_num);
-        if (set_bit(sb.block_bitmap_start, block_num, 1) != 0) return -1;
+static void direct_close() {
+    if (direct_fd >= 0) close(direct_fd);
+    direct_fd = -1;
+    while (direct_pool_free > 0) free(direct_pool[--direct_pool_free]);
+}
+
+// Abre 'path' com O_DIRECT e confere com uma leitura do bloco 0 que o sistema
+// de arquivos do host aceita o tamanho de bloco. Retorna 0 ou -1.
+static int direct_open(const char* path) {
+    if (sb.block_size % 512 != 0) return -1;
+    direct_fd = open(path, O_RDWR | O_DIRECT);
+    if (direct_fd < 0) return -1;
+    void* probe = direct_buffer_get();
+    int ok = probe && pread(direct_fd, probe, sb.block_size, 0) == (ssize_t) sb.block_size;
+    if (probe) direct_buffer_put(probe);
+    if (!ok) {
+        direct_close();
+        return -1;
     }
-    return block_num;
+    return 0;
 }
 
-static int find_in_directory(const Inode* dir_inode, const char* name) {
-    verbose_printf("Procurando por '%s' nas entradas do i-node.\n", name);
-    if (dir_inode->type != TYPE_DIR) return -1;
-    char block_buffer[sb.block_size];
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = dir_inode->direct_blocks[i];
-        if (block_num == 0) continue;
-        if (block_read(block_num, block_buffer) != 0) return -1;
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries = sb.block_size / sizeof(DirectoryEntry);
-        for (int j = 0; j < num_entries; ++j) {
-            if (strlen(entry[j].name) > 0 && strcmp(entry[j].name, name) == 0) {
-                verbose_printf("Entrada '%s' encontrada, aponta para o i-node %u.\n", name, entry[j].inode_num);
-                return entry[j].inode_num;
-            }
+static int direct_transfer(uint32_t first_block, uint32_t count, void* data, int write) {
+    void* buffer = direct_buffer_get();
+    if (!buffer) return -1;
+    int rc = 0;
+    for (uint32_t done = 0; done < count && rc == 0; done += DIRECT_CHUNK_BLOCKS) {
+        uint32_t n = count - done < DIRECT_CHUNK_BLOCKS ? count - done : DIRECT_CHUNK_BLOCKS;
+        size_t len = (size_t) n * sb.block_size;
+        off_t offset = (off_t) (first_block + done) * sb.block_size;
+        char* chunk = (char*) data + (size_t) done * sb.block_size;
+        if (write) {
+            memcpy(buffer, chunk, len);
+            if (pwrite(direct_fd, buffer, len, offset) != (ssize_t) len) rc = -1;
+        } else {
+            if (pread(direct_fd, buffer, len, offset) != (ssize_t) len) rc = -1;
+            else memcpy(chunk, buffer, len);
         }
     }
-    verbose_printf("Entrada '%s' não encontrada.\n", name);
-    return -1;
+    direct_buffer_put(buffer);
+    return rc;
 }
 
-static int add_entry_to_directory(Inode* dir_inode, uint32_t dir_inode_num, const char* new_name, uint32_t new_inode_num) {
-    verbose_printf("Adicionando entrada '%s' (i-node %u) ao diretório (i-node %u).\n", new_name, new_inode_num, dir_inode_num);
-    char block_buffer[sb.block_size];
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = dir_inode->direct_blocks[i];
-        if (block_num == 0) {
-            // Futuramente: alocar novo bloco se diretório estiver cheio
-            continue;
-        }
-        if (block_read(block_num, block_buffer) != 0) return -1;
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries = sb.block_size / sizeof(DirectoryEntry);
-        for (int j = 0; j < num_entries; ++j) {
-            if (strlen(entry[j].name) == 0) {
-                verbose_printf(" -> Slot livre encontrado no bloco de dados %u, posição %d.\n", block_num, j);
-                strncpy(entry[j].name, new_name, MAX_FILENAME_LEN);
-                entry[j].name[MAX_FILENAME_LEN-1] = '\0';
-                entry[j].inode_num = new_inode_num;
-                dir_inode->size += sizeof(DirectoryEntry);
-                verbose_printf(" -> Atualizando tamanho do i-node pai %u para %u bytes.\n", dir_inode_num, dir_inode->size);
-                inode_write(dir_inode_num, dir_inode);
-                return block_write(block_num, block_buffer);
-            }
-        }
-    }
-    fprintf(stderr, "Erro: Diretório está cheio.\n");
-    return -1;
+// --- Funções Auxiliares de Bloco ---
+// Lê ou grava 'count' blocos consecutivos numa única requisição.
+static int raw_blocks_write(uint32_t first_block, uint32_t count, const void* data) {
+    if (!disk_file) return -1;
+    if (direct_fd >= 0) return direct_transfer(first_block, count, (void*) data, 1);
+    if (fseeko(disk_file, (off_t) first_block * sb.block_size, SEEK_SET) != 0) return -1;
+    if (fwrite(data, sb.block_size, count, disk_file) != count) return -1;
+    return 0;
 }
 
-static int free_block(uint32_t block_num) {
-    verbose_printf("Liberando bloco de dados #%u.\n", block_num);
-    return set_bit(sb.block_bitmap_start, block_num, 0);
+static int raw_blocks_read(uint32_t first_block, uint32_t count, void* data) {
+    if (!disk_file) return -1;
+    if (direct_fd >= 0) return direct_transfer(first_block, count, data, 0);
+    if (fseeko(disk_file, (off_t) first_block * sb.block_size, SEEK_SET) != 0) return -1;
+    if (fread(data, sb.block_size, count, disk_file) != count) return -1;
+    return 0;
 }
 
-static int free_inode(uint32_t inode_num) {
-    verbose_printf("Liberando i-node #%u.\n", inode_num);
-    return set_bit(sb.inode_bitmap_start, inode_num, 0);
+static int raw_block_read(uint32_t block_num, void* data) {
+    return raw_blocks_read(block_num, 1, data);
 }
 
-static int remove_entry_from_directory(Inode* parent_inode, uint32_t parent_inode_num, const char* name_to_remove) {
-    verbose_printf("Removendo entrada '%s' do diretório (i-node %u).\n", name_to_remove, parent_inode_num);
-    char block_buffer[sb.block_size];
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = parent_inode->direct_blocks[i];
-        if (block_num == 0) continue;
-        if (block_read(block_num, block_buffer) != 0) return -1;
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries = sb.block_size / sizeof(DirectoryEntry);
-        for (int j = 0; j < num_entries; ++j) {
-            if (strlen(entry[j].name) > 0 && strcmp(entry[j].name, name_to_remove) == 0) {
-                verbose_printf(" -> Entrada encontrada no bloco %u. Zerando entrada.\n", block_num);
-                memset(&entry[j], 0, sizeof(DirectoryEntry));
-                parent_inode->size -= sizeof(DirectoryEntry);
-                verbose_printf(" -> Atualizando tamanho do i-node pai %u para %u bytes.\n", parent_inode_num, parent_inode->size);
-                inode_write(parent_inode_num, parent_inode);
-                return block_write(block_num, block_buffer);
-            }
+static uint32_t checksums_per_block() {
+    return sb.block_size / sizeof(uint32_t);
+}
+
+// Grava 'count' blocos consecutivos numa única requisição.
+static int blocks_write(uint32_t first_block, uint32_t count, const void* data) {
+    if (count == 1) verbose_printf("Escrevendo no disco: Bloco %u\n", first_block);
+    else verbose_printf("Escrevendo no disco: Blocos %u a %u\n", first_block, first_block + count - 1);
+    if (raw_blocks_write(first_block, count, data) != 0) return -1;
+    for (uint32_t i = 0; block_checksums && i < count; ++i) {
+        uint32_t block_num = first_block + i;
+        // Bitmaps e tabela de i-nodes são reescritos várias vezes por operação;
+        // o CRC deles é calculado uma vez só, quando a tabela vai para o disco
+        if (block_num < sb.data_blocks_start || is_group_meta_block(block_num)) {
+            checksum_state[block_num] = CHECKSUM_PENDING;
+            continue;
         }
+        block_checksums[block_num] = crc32c(0, (const char*) data + (size_t) i * sb.block_size, sb.block_size);
+        checksum_dirty[block_num / checksums_per_block()] = 1;
+        checksum_state[block_num] = CHECKSUM_TRUSTED;
     }
-    return -1;
+    return 0;
 }
 
-// --- Funções Principais ---
-
-Inode fs_list_inode() {
-    verbose_printf("Iniciando 'ls' no i-node nº %u\n", current_inode_num);
-    Inode current_inode;
-    if (inode_read(current_inode_num, &current_inode) != 0 || current_inode.type != TYPE_DIR) {
-        Inode empty = {0};
-        return empty;
-    }
-    return current_inode;
+static int block_write(uint32_t block_num, const void* data) {
+    return blocks_write(block_num, 1, data);
 }
 
-FileList fs_list_directory() {
-    verbose_printf("Iniciando 'ls' no i-node nº %u\n", current_inode_num);
-    Inode current_inode = fs_list_inode();
-    char block_buffer[sb.block_size];
-    FileList file_list = {0};
-    int num_blocks = (current_inode.size + sb.block_size - 1) / sb.block_size;
-    for (int i = 0; i < num_blocks; ++i) {
-        uint32_t block_num = current_inode.direct_blocks[i];
-        if (block_num == 0) continue;
-        if (block_read(block_num, block_buffer) != 0) {
-            fprintf(stderr, "Erro ao ler o bloco de dados do diretório.\n");
-            free(file_list.entries);
-            file_list.entries = NULL;
-            file_list.count = 0;
-            return file_list;
-        }
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries_per_block = sb.block_size / sizeof(DirectoryEntry);
-
-        for (int j = 0; j < num_entries_per_block; ++j) {
-            if (strlen(entry[j].name) > 0) {
-                Inode entry_inode;
-                if(inode_read(entry[j].inode_num, &entry_inode) == 0) {
-                    FileEntry *tmp = realloc(file_list.entries, (file_list.count + 1) * sizeof(FileEntry));
-                    if (!tmp) {
-                        fprintf(stderr, "Erro de alocação de memória\n");
-                        free(file_list.entries);
-                        file_list.entries = NULL;
-                        file_list.count = 0;
-                        return file_list;
-                    }
-                    file_list.entries = tmp;
-                    strncpy(file_list.entries[file_list.count].name, entry[j].name, MAX_FILENAME_LEN);
-                    file_list.entries[file_list.count].name[MAX_FILENAME_LEN-1] = '\0';
-                    file_list.entries[file_list.count].type = entry_inode.type;
-                    file_list.count++;
-                }
-            }
+// Lê 'count' blocos consecutivos numa única requisição.
+static int blocks_read(uint32_t first_block, uint32_t count, void* data) {
+    if (count == 1) verbose_printf("Lendo do disco: Bloco %u\n", first_block);
+    else verbose_printf("Lendo do disco: Blocos %u a %u\n", first_block, first_block + count - 1);
+    if (raw_blocks_read(first_block, count, data) != 0) return -1;
+    // Cada bloco é verificado na primeira leitura da montagem; depois disso o
+    // conteúdo é o que já foi conferido ou o que este processo escreveu.
+    for (uint32_t i = 0; block_checksums && i < count; ++i) {
+        uint32_t block_num = first_block + i;
+        if (checksum_state[block_num] != CHECKSUM_UNVERIFIED) continue;
+        uint32_t crc = crc32c(0, (const char*) data + (size_t) i * sb.block_size, sb.block_size);
+        if (crc != block_checksums[block_num]) {
+            fprintf(stderr, "Erro: Checksum inválido no bloco %u (esperado 0x%08X, calculado 0x%08X). Execute 'fsck'.\n",
+                    block_num, block_checksums[block_num], crc);
+            return -1;
         }
+        checksum_state[block_num] = CHECKSUM_TRUSTED;
     }
-    return file_list;
+    return 0;
 }
 
-int fs_create_directory(const char* name) {
-    verbose_printf("Iniciando 'mkdir %s'\n", name);
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) {
-        fprintf(stderr, "Erro ao ler o i-node do diretório atual.\n");
+static int block_read(uint32_t block_num, void* data) {
+    return blocks_read(block_num, 1, data);
+}
+
+// --- Checksums dos Blocos ---
+// A tabela fica inteira em memória enquanto o disco está montado; block_write
+// atualiza a entrada do bloco e só os pedaços alterados voltam ao disco no
+// 'sync' e na desmontagem. Os blocos da própria tabela não têm checksum.
+
+static uint32_t checksum_table_blocks(uint32_t total_blocks, uint32_t block_size) {
+    return ((uint64_t) total_blocks * sizeof(uint32_t) + block_size - 1) / block_size;
+}
+
+static int is_checksum_block(uint32_t block_num) {
+    return (sb.features & FEATURE_CHECKSUMS) && block_num >= sb.checksum_start &&
+           block_num < sb.checksum_start + checksum_table_blocks(sb.total_blocks, sb.block_size);
+}
+
+static void checksum_release() {
+    free(block_checksums);
+    free(checksum_dirty);
+    free(checksum_state);
+    block_checksums = NULL;
+    checksum_dirty = NULL;
+    checksum_state = NULL;
+}
+
+static int checksum_alloc() {
+    uint32_t table_blocks = checksum_table_blocks(sb.total_blocks, sb.block_size);
+    block_checksums = calloc((size_t) table_blocks * checksums_per_block(), sizeof(uint32_t));
+    checksum_dirty = calloc(table_blocks, 1);
+    checksum_state = calloc(sb.total_blocks, 1);
+    if (!block_checksums || !checksum_dirty || !checksum_state) {
+        checksum_release();
         return -1;
     }
-    verbose_printf("Lido i-node pai nº %u\n", current_inode_num);
-    if (find_in_directory(&parent_inode, name) != -1) {
-        fprintf(stderr, "Erro: Um item com o nome '%s' já existe.\n", name);
+    return 0;
+}
+
+static int checksum_load() {
+    if (checksum_alloc() != 0) return -1;
+    uint32_t table_blocks = checksum_table_blocks(sb.total_blocks, sb.block_size);
+    if (raw_blocks_read(sb.checksum_start, table_blocks, block_checksums) != 0) {
+        checksum_release();
         return -1;
     }
-    int new_inode_num = alloc_inode();
-    if (new_inode_num == -1) {
-        fprintf(stderr, "Erro: Não há i-nodes livres.\n");
-        return -1;
+    if (tables_need_swap()) u32_table_swap((char*) block_checksums, (size_t) table_blocks * sb.block_size);
+    return 0;
+}
+
+static int checksum_settle(uint32_t block_num) {
+    char block_buffer[sb.block_size];
+    if (checksum_state[block_num] != CHECKSUM_PENDING) return 0;
+    if (raw_block_read(block_num, block_buffer) != 0) return -1;
+    block_checksums[block_num] = crc32c(0, block_buffer, sb.block_size);
+    checksum_dirty[block_num / checksums_per_block()] = 1;
+    checksum_state[block_num] = CHECKSUM_TRUSTED;
+    return 0;
+}
+
+static int checksum_store() {
+    if (!block_checksums) return 0;
+    for (uint32_t b = 0; b < sb.data_blocks_start; ++b) {
+        if (checksum_settle(b) != 0) return -1;
     }
-    int new_block_num = alloc_block();
-    if (new_block_num == -1) {
-        fprintf(stderr, "Erro: Não há blocos de dados livres.\n");
-        free_inode(new_inode_num);
-        return -1;
+    // Metadados dos grupos que ficam no meio da área de dados
+    for (uint32_t g = grouped_layout() ? stacked_groups() : group_count(); g < group_count(); ++g) {
+        for (uint32_t k = 0; k < group_meta_blocks(); ++k) {
+            if (checksum_settle(group_meta_start(g) + k) != 0) return -1;
+        }
     }
-    if (add_entry_to_directory(&parent_inode, current_inode_num, name, new_inode_num) != 0) {
-        fprintf(stderr, "Erro ao adicionar entrada no diretório pai.\n");
-        free_inode(new_inode_num);
-        free_block(new_block_num);
-        return -1;
+    uint32_t table_blocks = checksum_table_blocks(sb.total_blocks, sb.block_size);
+    for (uint32_t i = 0; i < table_blocks; ++i) {
+        if (!checksum_dirty[i]) continue;
+        uint32_t run = 1;
+        while (i + run < table_blocks && checksum_dirty[i + run]) run++;
+        char* data = (char*) block_checksums + (size_t) i * sb.block_size;
+        if (tables_need_swap()) u32_table_swap(data, (size_t) run * sb.block_size);
+        int rc = raw_blocks_write(sb.checksum_start + i, run, data);
+        if (tables_need_swap()) u32_table_swap(data, (size_t) run * sb.block_size);
+        if (rc != 0) return -1;
+        memset(checksum_dirty + i, 0, run);
+        i += run - 1;
     }
-    verbose_printf("Inicializando i-node %d para o novo diretório.\n", new_inode_num);
-    Inode new_inode;
-    new_inode.type = TYPE_DIR;
-    new_inode.size = sizeof(DirectoryEntry) * 2;
-    new_inode.link_count = 2;
-    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
-    for(int i=0; i<INODE_DIRECT_BLOCKS; ++i) new_inode.direct_blocks[i] = 0;
-    new_inode.direct_blocks[0] = new_block_num;
-    if (inode_write(new_inode_num, &new_inode) != 0) { return -1; }
+    verbose_printf("Tabela de checksums gravada.\n");
+    return 0;
+}
 
-    verbose_printf("Escrevendo '.' e '..' no bloco de dados %d.\n", new_block_num);
-    DirectoryEntry dot_entry, dotdot_entry;
-    strncpy(dot_entry.name, ".", MAX_FILENAME_LEN);
-    dot_entry.inode_num = new_inode_num;
-    strncpy(dotdot_entry.name, "..", MAX_FILENAME_LEN);
-    dotdot_entry.inode_num = current_inode_num;
+// Recalcula a tabela a partir do conteúdo atual (após uma montagem sem checksums).
+static int checksum_rebuild() {
+    char block_buffer[sb.block_size];
+    for (uint32_t b = 0; b < sb.total_blocks; ++b) {
+        if (is_checksum_block(b)) continue;
+        if (raw_block_read(b, block_buffer) != 0) return -1;
+        block_checksums[b] = crc32c(0, block_buffer, sb.block_size);
+        checksum_state[b] = CHECKSUM_TRUSTED;
+    }
+    memset(checksum_dirty, 1, checksum_table_blocks(sb.total_blocks, sb.block_size));
+    return 0;
+}
+
+static int superblock_write() {
     char block_buffer[sb.block_size];
     memset(block_buffer, 0, sb.block_size);
-    memcpy(block_buffer, &dot_entry, sizeof(DirectoryEntry));
-    memcpy(block_buffer + sizeof(DirectoryEntry), &dotdot_entry, sizeof(DirectoryEntry));
-    if (block_write(new_block_num, block_buffer) != 0) { return -1; }
-    
-    verbose_printf("Atualizando contagem de links do i-node pai %u.\n", current_inode_num);
-    parent_inode.link_count++;
-    inode_write(current_inode_num, &parent_inode);
+    superblock_encode(&sb, (unsigned char*) block_buffer);
+    return block_write(0, block_buffer);
+}
+
+// --- Tabelas de Metadados ---
+// Tabela mantida em memória enquanto o disco está montado e gravada no sync.
+typedef struct {
+    char* data;
+    uint32_t start;
+    uint32_t blocks;
+    unsigned char* dirty;
+    void (*swap)(char* data, size_t bytes); // Converte entre a ordem do host e a do disco
+} MetaTable;
+
+static int meta_table_load(MetaTable* table, uint32_t start, uint32_t blocks, void (*swap)(char*, size_t)) {
+    table->data = malloc((size_t) blocks * sb.block_size);
+    table->dirty = calloc(blocks, 1);
+    table->start = start;
+    table->blocks = blocks;
+    table->swap = swap;
+    if (!table->data || !table->dirty) return -1;
+    if (blocks > 0 && blocks_read(start, blocks, table->data) != 0) return -1;
+    if (tables_need_swap()) swap(table->data, (size_t) blocks * sb.block_size);
     return 0;
 }
 
-int fs_change_directory(const char* name) {
-    verbose_printf("Iniciando 'cd %s'.\n", name);
-    Inode current_dir_inode;
-    if (inode_read(current_inode_num, &current_dir_inode) != 0) return -1;
-    verbose_printf("Procurando por '%s' no diretório atual (i-node %u).\n", name, current_inode_num);
-    int target_inode_num = find_in_directory(&current_dir_inode, name);
-    if (target_inode_num == -1) {
-        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", name);
-        return -1;
-    }
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
-    if (target_inode.type != TYPE_DIR) {
-        fprintf(stderr, "Erro: '%s' não é um diretório.\n", name);
-        return -1;
+// Grava os blocos alterados, juntando os consecutivos numa só requisição.
+static int meta_table_store(MetaTable* table) {
+    for (uint32_t i = 0; table->data && i < table->blocks; ++i) {
+        if (!table->dirty[i]) continue;
+        uint32_t run = 1;
+        while (i + run < table->blocks && table->dirty[i + run]) run++;
+        char* data = table->data + (size_t) i * sb.block_size;
+        // Convertido só durante a gravação: em memória a tabela fica na ordem do host
+        if (tables_need_swap()) table->swap(data, (size_t) run * sb.block_size);
+        int rc = blocks_write(table->start + i, run, data);
+        if (tables_need_swap()) table->swap(data, (size_t) run * sb.block_size);
+        if (rc != 0) return -1;
+        memset(table->dirty + i, 0, run);
+        i += run - 1;
     }
-    verbose_printf("Mudando o diretório atual para o i-node %d.\n", target_inode_num);
-    current_inode_num = target_inode_num;
     return 0;
 }
 
-void fs_get_current_path(char* path_buffer, size_t buffer_size) {
-    if (current_inode_num == 0) {
-        snprintf(path_buffer, buffer_size, "/");
+static void meta_table_release(MetaTable* table) {
+    free(table->data);
+    free(table->dirty);
+    memset(table, 0, sizeof(MetaTable));
+}
+
+static void meta_table_touch(MetaTable* table, size_t offset) {
+    table->dirty[offset / sb.block_size] = 1;
+}
+
+// Uso por subárvore (FEATURE_DIR_USAGE): cada i-node tem uma entrada com os
+// totais dele e de tudo abaixo dele, e o diretório que o contém. Gravar um
+// i-node soma a variação da parte própria ao longo da cadeia de pais; ligar
+// ou desligar um item de um diretório soma ou subtrai a entrada inteira.
+// Assim 'du' só lê uma entrada.
+
+#define USAGE_UNLINKED UINT32_MAX
+
+typedef struct {
+    uint64_t bytes;       // Tamanho dos arquivos da subárvore
+    uint32_t blocks;      // Blocos de dados da subárvore, incluindo os do próprio i-node
+    uint32_t entries;     // Itens da subárvore, incluindo o próprio i-node
+    uint32_t own_blocks;  // Parte de 'blocks' que é do próprio i-node
+    uint32_t parent;      // Diretório que contém o i-node (a raiz aponta para si mesma)
+    uint64_t own_bytes;   // Parte de 'bytes' que é do próprio i-node
+} UsageEntry;
+
+static MetaTable usage_table = {0};
+
+static void usage_table_swap(char* data, size_t bytes) {
+    for (size_t off = 0; off + sizeof(UsageEntry) <= bytes; off += sizeof(UsageEntry)) {
+        unsigned char* entry = (unsigned char*) data + off;
+        le64_swap(entry + offsetof(UsageEntry, bytes));
+        le32_swap(entry + offsetof(UsageEntry, blocks));
+        le32_swap(entry + offsetof(UsageEntry, entries));
+        le32_swap(entry + offsetof(UsageEntry, own_blocks));
+        le32_swap(entry + offsetof(UsageEntry, parent));
+        le64_swap(entry + offsetof(UsageEntry, own_bytes));
+    }
+}
+
+static uint32_t usage_table_blocks(uint32_t total_inodes, uint32_t block_size) {
+    return ((uint64_t) total_inodes * sizeof(UsageEntry) + block_size - 1) / block_size;
+}
+
+static UsageEntry* usage_entry(uint32_t inode_num) {
+    return usage_table.data ? (UsageEntry*) usage_table.data + inode_num : NULL;
+}
+
+static void usage_touch(uint32_t inode_num) {
+    meta_table_touch(&usage_table, (size_t) inode_num * sizeof(UsageEntry));
+}
+
+// Soma a variação à entrada do i-node e às de todos os seus ancestrais.
+static void usage_apply(uint32_t inode_num, int64_t bytes, int64_t blocks, int64_t entries) {
+    for (uint32_t hops = 0; hops <= sb.total_inodes; ++hops) {
+        UsageEntry* entry = usage_entry(inode_num);
+        entry->bytes += bytes;
+        entry->blocks += blocks;
+        entry->entries += entries;
+        usage_touch(inode_num);
+        if (entry->parent == USAGE_UNLINKED || entry->parent == inode_num) return;
+        inode_num = entry->parent;
+    }
+}
+
+// I-node recém-alocado: só ele mesmo, ainda fora de qualquer diretório.
+static void usage_reset(uint32_t inode_num) {
+    UsageEntry* entry = usage_entry(inode_num);
+    if (!entry) return;
+    memset(entry, 0, sizeof(UsageEntry));
+    entry->entries = 1;
+    entry->parent = USAGE_UNLINKED;
+    usage_touch(inode_num);
+}
+
+static void usage_set_own(uint32_t inode_num, uint64_t bytes, uint32_t blocks) {
+    UsageEntry* entry = usage_entry(inode_num);
+    if (!entry || (entry->own_bytes == bytes && entry->own_blocks == blocks)) return;
+    int64_t delta_bytes = (int64_t) bytes - (int64_t) entry->own_bytes;
+    int64_t delta_blocks = (int64_t) blocks - (int64_t) entry->own_blocks;
+    entry->own_bytes = bytes;
+    entry->own_blocks = blocks;
+    usage_apply(inode_num, delta_bytes, delta_blocks, 0);
+}
+
+// Tira a subárvore do i-node dos totais de 'parent' (se ainda estiver nele).
+static void usage_unlink(uint32_t inode_num, uint32_t parent) {
+    UsageEntry* entry = usage_entry(inode_num);
+    if (!entry || entry->parent != parent || parent == inode_num) return;
+    entry->parent = USAGE_UNLINKED;
+    usage_touch(inode_num);
+    usage_apply(parent, -(int64_t) entry->bytes, -(int64_t) entry->blocks, -(int64_t) entry->entries);
+}
+
+// Põe a subárvore do i-node nos totais de 'parent', saindo do pai anterior (mv).
+static void usage_link(uint32_t inode_num, uint32_t parent) {
+    UsageEntry* entry = usage_entry(inode_num);
+    if (!entry) return;
+    if (entry->parent != USAGE_UNLINKED) usage_unlink(inode_num, entry->parent);
+    entry->parent = parent;
+    usage_touch(inode_num);
+    usage_apply(parent, entry->bytes, entry->blocks, entry->entries);
+}
+
+// I-node liberado: sai do diretório, se ainda estiver em algum.
+static void usage_release(uint32_t inode_num) {
+    UsageEntry* entry = usage_entry(inode_num);
+    if (!entry) return;
+    if (entry->parent != USAGE_UNLINKED) usage_unlink(inode_num, entry->parent);
+    memset(entry, 0, sizeof(UsageEntry));
+    entry->parent = USAGE_UNLINKED;
+    usage_touch(inode_num);
+}
+
+// Índice de nomes (FEATURE_NAME_INDEX): o nome de cada i-node e o diretório
+// que o contém, na posição do i-node. O 'find' varre a tabela em memória em
+// vez de ler diretórios, e o caminho sai subindo pelos pais.
+
+typedef struct {
+    char name[MAX_FILENAME_LEN];  // Vazio se o i-node não está em nenhum diretório
+    uint32_t parent;
+} NameEntry;
+
+static MetaTable name_table = {0};
+
+// O nome são bytes: só 'parent' muda de ordem.
+static void name_table_swap(char* data, size_t bytes) {
+    for (size_t off = 0; off + sizeof(NameEntry) <= bytes; off += sizeof(NameEntry)) {
+        le32_swap((unsigned char*) data + off + offsetof(NameEntry, parent));
+    }
+}
+
+static uint32_t name_index_blocks(uint32_t total_inodes, uint32_t block_size) {
+    return ((uint64_t) total_inodes * sizeof(NameEntry) + block_size - 1) / block_size;
+}
+
+static NameEntry* name_entry(uint32_t inode_num) {
+    return name_table.data ? (NameEntry*) name_table.data + inode_num : NULL;
+}
+
+static void name_index_set(uint32_t inode_num, uint32_t parent, const char* name) {
+    NameEntry* entry = name_entry(inode_num);
+    if (!entry) return;
+    strncpy(entry->name, name, MAX_FILENAME_LEN);
+    entry->name[MAX_FILENAME_LEN - 1] = '\0';
+    entry->parent = parent;
+    meta_table_touch(&name_table, (size_t) inode_num * sizeof(NameEntry));
+}
+
+// Só apaga se o i-node ainda estiver em 'parent' (no mv a entrada nova vem antes).
+static void name_index_clear(uint32_t inode_num, uint32_t parent) {
+    NameEntry* entry = name_entry(inode_num);
+    if (!entry || entry->parent != parent) return;
+    memset(entry, 0, sizeof(NameEntry));
+    meta_table_touch(&name_table, (size_t) inode_num * sizeof(NameEntry));
+}
+
+// --- Funções Auxiliares de I-node e Bitmap ---
+static void inode_decode(const unsigned char* raw, Inode* inode) {
+    memset(inode, 0, sizeof(Inode));
+    if (sb.version < 2) {
+        InodeV1 old;
+        memcpy(&old, raw, sizeof(InodeV1));
+        inode->type = old.type;
+        inode->size = old.size;
+        inode->link_count = old.link_count;
+        // Em discos sem o recurso, o campo 'flags' é apenas alinhamento e pode ter lixo
+        inode->flags = (sb.features & FEATURE_INLINE_DATA) ? old.flags : 0;
+        inode->created = old.created;
+        inode->modified = old.modified;
+        inode->accessed = old.accessed;
+        memcpy(inode->direct_blocks, old.direct_blocks, sizeof(old.direct_blocks));
+        return;
+    }
+    inode->type = (InodeType) raw[0];
+    inode->flags = raw[1];
+    inode->size = get_le32(raw + 4);
+    if (sb.features & FEATURE_LARGE_FILES) inode->size |= (uint64_t) (raw[2] | raw[3] << 8) << 32;
+    inode->link_count = get_le32(raw + 8);
+    inode->created = get_le32(raw + 12);
+    inode->modified = get_le32(raw + 16);
+    inode->accessed = get_le32(raw + 20);
+    // Dados inline são bytes, não ponteiros: vão sem conversão
+    if (inode->flags & INODE_FLAG_INLINE) memcpy(inode->direct_blocks, raw + 24, INODE_INLINE_SIZE);
+    else for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) inode->direct_blocks[i] = get_le32(raw + 24 + 4 * i);
+}
+
+static void inode_encode(const Inode* inode, unsigned char* raw) {
+    if (sb.version < 2) {
+        InodeV1 old;
+        memset(&old, 0, sizeof(InodeV1));
+        old.type = inode->type;
+        old.size = (uint32_t) inode->size;
+        old.link_count = inode->link_count;
+        old.flags = inode->flags;
+        old.created = inode->created;
+        old.modified = inode->modified;
+        old.accessed = inode->accessed;
+        memcpy(old.direct_blocks, inode->direct_blocks, sizeof(old.direct_blocks));
+        memcpy(raw, &old, sizeof(InodeV1));
+        return;
+    }
+    raw[0] = (unsigned char) inode->type;
+    raw[1] = (unsigned char) inode->flags;
+    raw[2] = (sb.features & FEATURE_LARGE_FILES) ? (inode->size >> 32) & 0xFF : 0;
+    raw[3] = (sb.features & FEATURE_LARGE_FILES) ? (inode->size >> 40) & 0xFF : 0;
+    put_le32(raw + 4, (uint32_t) inode->size);
+    put_le32(raw + 8, inode->link_count);
+    put_le32(raw + 12, (uint32_t) inode->created);
+    put_le32(raw + 16, (uint32_t) inode->modified);
+    put_le32(raw + 20, (uint32_t) inode->accessed);
+    if (inode->flags & INODE_FLAG_INLINE) memcpy(raw + 24, inode->direct_blocks, INODE_INLINE_SIZE);
+    else for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) put_le32(raw + 24 + 4 * i, inode->direct_blocks[i]);
+}
+
+static int inode_read(uint32_t inode_num, Inode* inode_data) {
+    uint32_t block_num = inode_table_block(inode_num / inodes_per_block());
+    uint32_t offset_in_block = (inode_num % inodes_per_block()) * inode_disk_size();
+    verbose_printf("Lendo i-node %u (Bloco: %u, Offset: %u)\n", inode_num, block_num, offset_in_block);
+    char block_buffer[sb.block_size];
+    if (block_read(block_num, block_buffer) != 0) return -1;
+    inode_decode((unsigned char*) block_buffer + offset_in_block, inode_data);
+    return 0;
+}
+
+static int inode_is_inline(const Inode* inode) {
+    return (inode->flags & INODE_FLAG_INLINE) != 0;
+}
+
+static int fits_inline(uint64_t size) {
+    return (sb.features & FEATURE_INLINE_DATA) && size <= INODE_INLINE_SIZE;
+}
+
+static uint32_t count_data_blocks(const Inode* inode) {
+    uint32_t count = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(inode); ++i) if (inode->direct_blocks[i] != 0) count++;
+    return count;
+}
+
+static int inode_write(uint32_t inode_num, const Inode* inode_data) {
+    uint32_t block_num = inode_table_block(inode_num / inodes_per_block());
+    uint32_t offset_in_block = (inode_num % inodes_per_block()) * inode_disk_size();
+    verbose_printf("Escrevendo i-node %u (Bloco: %u, Offset: %u)\n", inode_num, block_num, offset_in_block);
+    char block_buffer[sb.block_size];
+    if (block_read(block_num, block_buffer) != 0) return -1;
+    inode_encode(inode_data, (unsigned char*) block_buffer + offset_in_block);
+    if (block_write(block_num, block_buffer) != 0) return -1;
+    usage_set_own(inode_num, inode_data->type == TYPE_FILE ? inode_data->size : 0, count_data_blocks(inode_data));
+    return 0;
+}
+
+// --- Grupos de Blocos ---
+// Cada grupo (ver Disposição do Disco) tem uma fatia do bitmap e da tabela de
+// i-nodes. O i-node, os blocos de diretório e os dados de um arquivo novo vão
+// para o grupo do diretório pai; com FEATURE_BLOCK_GROUPS, a fatia da tabela
+// fica no início do próprio grupo, então 'ls' seguido de 'cat' num diretório
+// lê blocos próximos. Diretórios novos são espalhados pelos grupos. Os
+// contadores de cada grupo ficam em memória e são recalculados a partir dos
+// bitmaps na montagem.
+
+typedef struct {
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+} BlockGroup;
+
+static BlockGroup* groups = NULL;
+static uint32_t num_groups = 0;
+static uint32_t last_dir_group = 0; // Onde o último diretório foi criado
+
+// Primeiro bloco de dados do grupo, depois dos metadados do disco ou do próprio grupo
+static uint32_t group_first_block(uint32_t group) {
+    uint64_t first = (uint64_t) group * blocks_per_group();
+    if (grouped_layout() && group >= stacked_groups()) first += group_meta_blocks();
+    return first < sb.data_blocks_start ? sb.data_blocks_start : (uint32_t) first;
+}
+
+// Onde procurar blocos para os dados de um i-node que ainda não tem nenhum
+static uint32_t group_goal_block(uint32_t inode_num) {
+    uint32_t group = inode_group(inode_num);
+    return group < num_groups ? group_first_block(group) : sb.data_blocks_start;
+}
+
+static void groups_release() {
+    free(groups);
+    groups = NULL;
+    num_groups = 0;
+    last_dir_group = 0;
+}
+
+static int groups_load() {
+    groups_release();
+    num_groups = group_count();
+    groups = calloc(num_groups, sizeof(BlockGroup));
+    if (!groups) return -1;
+    unsigned char block_buffer[sb.block_size];
+    uint32_t bits_per_block = sb.block_size * 8;
+    for (uint32_t g = 0; g < num_groups; ++g) {
+        // Um bloco do bitmap de blocos por grupo
+        if (block_read(bitmap_block(sb.block_bitmap_start, g), block_buffer) != 0) return -1;
+        for (uint32_t b = 0; b < bits_per_block && g * bits_per_block + b < sb.total_blocks; ++b) {
+            if (!((block_buffer[b / 8] >> (b % 8)) & 1)) groups[g].free_blocks++;
+        }
+    }
+    bits_per_block = bitmap_bits_per_block(sb.inode_bitmap_start);
+    uint32_t inode_bitmap_blocks = (sb.total_inodes + bits_per_block - 1) / bits_per_block;
+    for (uint32_t i = 0; i < inode_bitmap_blocks; ++i) {
+        if (block_read(bitmap_block(sb.inode_bitmap_start, i), block_buffer) != 0) return -1;
+        for (uint32_t b = 0; b < bits_per_block && i * bits_per_block + b < sb.total_inodes; ++b) {
+            uint32_t group = inode_group(i * bits_per_block + b);
+            if (group < num_groups && !((block_buffer[b / 8] >> (b % 8)) & 1)) groups[group].free_inodes++;
+        }
+    }
+    verbose_printf("%u grupos de %u blocos e %u i-nodes.\n", num_groups, blocks_per_group(), inodes_per_group());
+    return 0;
+}
+
+// Um bit dos bitmaps mudou de 'was' para 'now': atualiza o contador do grupo.
+static void group_note(uint32_t bitmap_start_block, uint32_t bit_num, int was, int now) {
+    if (!groups || was == now) return;
+    int delta = now ? -1 : 1;
+    if (bitmap_start_block == sb.block_bitmap_start) {
+        groups[bit_num / blocks_per_group()].free_blocks += delta;
+    } else if (bitmap_start_block == sb.inode_bitmap_start && inode_group(bit_num) < num_groups) {
+        groups[inode_group(bit_num)].free_inodes += delta;
+    }
+}
+
+// Grupo para um diretório novo: a partir do grupo seguinte ao do último
+// diretório criado, o primeiro com i-nodes e blocos livres acima da média.
+// Sem nenhum assim, o grupo com mais i-nodes livres.
+static uint32_t group_for_directory(uint32_t parent_num) {
+    if (!groups || num_groups == 1) return inode_group(parent_num);
+    uint64_t free_inodes = 0, free_blocks = 0;
+    for (uint32_t g = 0; g < num_groups; ++g) {
+        free_inodes += groups[g].free_inodes;
+        free_blocks += groups[g].free_blocks;
+    }
+    uint32_t chosen = inode_group(parent_num), best_free = 0;
+    int found = 0;
+    for (uint32_t k = 1; k <= num_groups && !found; ++k) {
+        uint32_t g = (last_dir_group + k) % num_groups;
+        if (groups[g].free_inodes > 0 && (uint64_t) groups[g].free_inodes * num_groups >= free_inodes &&
+            (uint64_t) groups[g].free_blocks * num_groups >= free_blocks) {
+            chosen = g;
+            found = 1;
+        }
+    }
+    for (uint32_t g = 0; g < num_groups && !found; ++g) {
+        if (groups[g].free_inodes > best_free) {
+            best_free = groups[g].free_inodes;
+            chosen = g;
+        }
+    }
+    last_dir_group = chosen;
+    return chosen;
+}
+
+// --- Índice de Extents Livres ---
+// As sequências de blocos livres da área de dados ficam num ExtentTree,
+// montado a partir do bitmap na montagem e atualizado a cada bit alterado.
+// Com ele, achar 'n' blocos contíguos perto de um bloco, no melhor encaixe ou
+// na maior sequência do disco não exige varrer o bitmap.
+
+static ExtentTree free_extents;
+static int extents_loaded = 0;
+
+// Blocos prometidos aos buffers da alocação atrasada (ver delalloc_append).
+// Nenhum alocador pode usá-los, exceto a descarga do próprio buffer, que
+// recebe a sua parte em 'delalloc_flush_grant' enquanto roda.
+static uint32_t delalloc_reserved_blocks = 0;
+static uint32_t delalloc_flush_grant = 0;
+
+// Blocos livres que ainda não foram prometidos (com o índice carregado)
+static uint64_t blocks_available() {
+    uint32_t held = delalloc_reserved_blocks > delalloc_flush_grant ? delalloc_reserved_blocks - delalloc_flush_grant : 0;
+    return free_extents.free_blocks > held ? free_extents.free_blocks - held : 0;
+}
+
+static void extents_release() {
+    if (extents_loaded) extent_tree_clear(&free_extents);
+    extents_loaded = 0;
+}
+
+static int extents_load() {
+    extents_release();
+    extent_tree_init(&free_extents);
+    extents_loaded = 1;
+    unsigned char block_buffer[sb.block_size];
+    uint32_t bits_per_block = sb.block_size * 8;
+    uint32_t run_start = 0, run_len = 0;
+    for (uint32_t i = sb.data_blocks_start / bits_per_block; i * (uint64_t) bits_per_block < sb.total_blocks; ++i) {
+        if (block_read(bitmap_block(sb.block_bitmap_start, i), block_buffer) != 0) {
+            extents_release();
+            return -1;
+        }
+        for (uint32_t b = 0; b < bits_per_block; ++b) {
+            uint32_t block_num = i * bits_per_block + b;
+            if (block_num < sb.data_blocks_start) continue;
+            if (block_num >= sb.total_blocks) break;
+            if (!((block_buffer[b / 8] >> (b % 8)) & 1)) {
+                if (run_len++ == 0) run_start = block_num;
+                continue;
+            }
+            if (run_len > 0 && extent_tree_add(&free_extents, run_start, run_len) != 0) {
+                extents_release();
+                return -1;
+            }
+            run_len = 0;
+        }
+    }
+    if (run_len > 0 && extent_tree_add(&free_extents, run_start, run_len) != 0) {
+        extents_release();
+        return -1;
+    }
+    verbose_printf("%u sequências livres, %llu blocos.\n", free_extents.count, (unsigned long long) free_extents.free_blocks);
+    return 0;
+}
+
+// Um bit dos bitmaps mudou de 'was' para 'now': atualiza os grupos e, no
+// bitmap de blocos, o índice de extents (que é refeito na próxima alocação
+// se faltar memória para dividir um extent).
+static void bitmap_note(uint32_t bitmap_start_block, uint32_t bit_num, int was, int now) {
+    group_note(bitmap_start_block, bit_num, was, now);
+    if (!extents_loaded || was == now || bitmap_start_block != sb.block_bitmap_start || bit_num < sb.data_blocks_start) return;
+    int rc = now ? extent_tree_remove(&free_extents, bit_num, 1) : extent_tree_add(&free_extents, bit_num, 1);
+    if (rc != 0) extents_release();
+}
+
+// Onde alocar 'count' blocos contíguos: em 'goal' ou logo depois dele, dentro
+// do mesmo grupo; senão, o extent de melhor encaixe do disco. Retorna 0 ou -1.
+static int pick_run(uint32_t count, uint32_t goal, uint32_t* start) {
+    if (goal >= sb.data_blocks_start && goal < sb.total_blocks) {
+        uint64_t group_end = ((uint64_t) goal / blocks_per_group() + 1) * blocks_per_group();
+        uint32_t limit = group_end < sb.total_blocks ? (uint32_t) group_end : sb.total_blocks;
+        if (extent_tree_find_near(&free_extents, goal, count, limit, start) == 0) return 0;
+    }
+    return extent_tree_find_best(&free_extents, count, start);
+}
+
+static int find_free_bit_from(uint32_t bitmap_start_block, uint32_t total_bits, uint32_t start_bit) {
+    if (start_bit >= total_bits) return -1;
+    char block_buffer[sb.block_size];
+    uint32_t bits_per_block = bitmap_bits_per_block(bitmap_start_block);
+    uint32_t start_block_idx = start_bit / bits_per_block;
+    uint32_t blocks_in_bitmap = (total_bits + bits_per_block - 1) / bits_per_block;
+    for (uint32_t i = start_block_idx; i < blocks_in_bitmap; ++i) {
+        if (block_read(bitmap_block(bitmap_start_block, i), block_buffer) != 0) return -1;
+        uint32_t start_byte = (i == start_block_idx) ? (start_bit % bits_per_block) / 8 : 0;
+        for (uint32_t byte = start_byte; byte * 8 < bits_per_block; ++byte) {
+            if ((unsigned char)block_buffer[byte] != 0xFF) {
+                uint32_t start_bit_in_byte = (i == start_block_idx && byte == start_byte) ? (start_bit % bits_per_block) % 8 : 0;
+                for (uint32_t bit = start_bit_in_byte; bit < 8 && byte * 8 + bit < bits_per_block; ++bit) {
+                    if (!((block_buffer[byte] >> bit) & 1)) {
+                        uint32_t bit_num = i * bits_per_block + byte * 8 + bit;
+                        if (bit_num < total_bits) return bit_num;
+                    }
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+static uint32_t count_set_bits(uint32_t bitmap_start_block, uint32_t total_bits) {
+    verbose_printf("Contando bits usados no bitmap (início: bloco %u, total: %u bits)\n", bitmap_start_block, total_bits);
+    uint32_t count = 0;
+    char block_buffer[sb.block_size];
+    uint32_t bits_per_block = bitmap_bits_per_block(bitmap_start_block);
+    uint32_t blocks_in_bitmap = (total_bits + bits_per_block - 1) / bits_per_block;
+    for (uint32_t i = 0; i < blocks_in_bitmap; ++i) {
+        if (block_read(bitmap_block(bitmap_start_block, i), block_buffer) != 0) return -1;
+        for (uint32_t b = 0; b < bits_per_block && i * bits_per_block + b < total_bits; ++b) {
+            if ((block_buffer[b / 8] >> (b % 8)) & 1) count++;
+        }
+    }
+    verbose_printf("Total de bits usados: %u\n", count);
+    return count;
+}
+
+static int set_bit(uint32_t bitmap_start_block, uint32_t bit_num, int value) {
+    uint32_t bits_per_block = bitmap_bits_per_block(bitmap_start_block);
+    uint32_t block_num = bitmap_block(bitmap_start_block, bit_num / bits_per_block);
+    uint32_t byte_in_block = (bit_num % bits_per_block) / 8;
+    uint32_t bit_in_byte = (bit_num % bits_per_block) % 8;
+    verbose_printf("Definindo bit #%u para %d (Bloco do bitmap: %u)\n", bit_num, value, block_num);
+    char block_buffer[sb.block_size];
+    if (block_read(block_num, block_buffer) != 0) return -1;
+    int was = (block_buffer[byte_in_block] >> bit_in_byte) & 1;
+    if (value) block_buffer[byte_in_block] |= (1 << bit_in_byte);
+    else block_buffer[byte_in_block] &= ~(1 << bit_in_byte);
+    if (block_write(block_num, block_buffer) != 0) return -1;
+    bitmap_note(bitmap_start_block, bit_num, was, value != 0);
+    return 0;
+}
+
+// Aloca um i-node no grupo do diretório pai (ou, para diretórios, no grupo
+// escolhido por group_for_directory), passando aos grupos seguintes se cheio.
+static int alloc_inode(uint32_t parent_num, int is_dir) {
+    uint32_t group = is_dir ? group_for_directory(parent_num) : inode_group(parent_num);
+    uint32_t start = group * inodes_per_group();
+    if (start == 0 || start >= sb.total_inodes) start = 1;
+    verbose_printf("Procurando i-node livre a partir do #%u (grupo %u)...\n", start, group);
+    int inode_num = find_free_bit_from(sb.inode_bitmap_start, sb.total_inodes, start);
+    if (inode_num == -1 && start > 1) inode_num = find_free_bit_from(sb.inode_bitmap_start, start, 1);
+    if (inode_num != -1) {
+        verbose_printf("I-node livre encontrado: #%d. Marcando como usado.\n", inode_num);
+        if (set_bit(sb.inode_bitmap_start, inode_num, 1) != 0) return -1;
+        usage_reset(inode_num);
+    }
+    return inode_num;
+}
+
+// Aloca um bloco a partir de 'goal' (volta ao início da área de dados se preciso).
+static int alloc_block(uint32_t goal) {
+    if (goal < sb.data_blocks_start || goal >= sb.total_blocks) goal = sb.data_blocks_start;
+    verbose_printf("Procurando bloco de dados livre a partir do bloco #%u...\n", goal);
+    if (!extents_loaded && extents_load() != 0) return -1;
+    if (blocks_available() == 0) return -1;
+    uint32_t found;
+    int block_num = -1;
+    if (extent_tree_find_near(&free_extents, goal, 1, sb.total_blocks, &found) == 0 ||
+        extent_tree_find_near(&free_extents, sb.data_blocks_start, 1, sb.total_blocks, &found) == 0) block_num = found;
+    if (block_num != -1) {
+        verbose_printf("Bloco livre encontrado: #%d. Marcando como usado.\n", block_num);
+        if (set_bit(sb.block_bitmap_start, block_num, 1) != 0) return -1;
+    }
+    return block_num;
+}
+
+// Aloca até 'count' bits livres de uma só vez, lendo e escrevendo cada bloco
+// do bitmap no máximo uma vez. Retorna quantos bits foram alocados.
+static int alloc_bits_batch(uint32_t bitmap_start_block, uint32_t total_bits, uint32_t start_bit, uint32_t count, uint32_t* out) {
+    verbose_printf("Alocando em lote %u bits a partir do #%u (bitmap no bloco %u).\n", count, start_bit, bitmap_start_block);
+    if (count == 0) return 0;
+    char block_buffer[sb.block_size];
+    uint32_t bits_per_block = bitmap_bits_per_block(bitmap_start_block);
+    uint32_t blocks_in_bitmap = (total_bits + bits_per_block - 1) / bits_per_block;
+    uint32_t found = 0;
+    for (uint32_t i = start_bit / bits_per_block; i < blocks_in_bitmap && found < count; ++i) {
+        if (block_read(bitmap_block(bitmap_start_block, i), block_buffer) != 0) return -1;
+        int dirty = 0;
+        uint32_t first = (i == start_bit / bits_per_block) ? start_bit % bits_per_block : 0;
+        for (uint32_t b = first; b < bits_per_block && found < count; ++b) {
+            uint32_t bit_num = i * bits_per_block + b;
+            if (bit_num >= total_bits) break;
+            if (!((block_buffer[b / 8] >> (b % 8)) & 1)) {
+                block_buffer[b / 8] |= (1 << (b % 8));
+                out[found++] = bit_num;
+                bitmap_note(bitmap_start_block, bit_num, 0, 1);
+                dirty = 1;
+            }
+        }
+        if (dirty && block_write(bitmap_block(bitmap_start_block, i), block_buffer) != 0) return -1;
+    }
+    return found;
+}
+
+// Aloca 'count' i-nodes para arquivos do diretório 'parent_num', a partir do grupo dele.
+static int alloc_inodes_batch(uint32_t count, uint32_t parent_num, uint32_t* out) {
+    uint32_t start = inode_group(parent_num) * inodes_per_group();
+    if (start == 0 || start >= sb.total_inodes) start = 1;
+    int n = alloc_bits_batch(sb.inode_bitmap_start, sb.total_inodes, start, count, out);
+    if (n >= 0 && (uint32_t) n < count && start > 1) {
+        int more = alloc_bits_batch(sb.inode_bitmap_start, start, 1, count - n, out + n);
+        n = more < 0 ? -1 : n + more;
+    }
+    for (int i = 0; i < n; ++i) usage_reset(out[i]);
+    verbose_printf("%d de %u i-nodes alocados em lote.\n", n, count);
+    return n;
+}
+
+static int bitmap_test(const unsigned char* bitmap, uint32_t bit) {
+    return (bitmap[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void bitmap_assign(unsigned char* bitmap, uint32_t bit, int value) {
+    if (value) bitmap[bit / 8] |= (1 << (bit % 8));
+    else bitmap[bit / 8] &= ~(1 << (bit % 8));
+}
+
+// Carrega um bitmap inteiro em memória, com os bits em sequência (sem os
+// bits que sobram no fim de cada bloco do bitmap de i-nodes agrupado).
+static int load_bitmap(uint32_t start_block, uint32_t total_bits, unsigned char** out) {
+    uint32_t bits_per_block = bitmap_bits_per_block(start_block);
+    uint32_t nblocks = (total_bits + bits_per_block - 1) / bits_per_block;
+    *out = calloc(nblocks, sb.block_size);
+    if (!*out) return -1;
+    unsigned char block_buffer[sb.block_size];
+    for (uint32_t i = 0; i < nblocks; ++i) {
+        if (bits_per_block == sb.block_size * 8) {
+            if (block_read(bitmap_block(start_block, i), *out + (size_t) i * sb.block_size) != 0) return -1;
+            continue;
+        }
+        if (block_read(bitmap_block(start_block, i), block_buffer) != 0) return -1;
+        for (uint32_t b = 0; b < bits_per_block; ++b) {
+            bitmap_assign(*out, i * bits_per_block + b, bitmap_test(block_buffer, b));
+        }
+    }
+    return 0;
+}
+
+static int store_bitmap(uint32_t start_block, uint32_t total_bits, const unsigned char* bitmap) {
+    uint32_t bits_per_block = bitmap_bits_per_block(start_block);
+    uint32_t nblocks = (total_bits + bits_per_block - 1) / bits_per_block;
+    unsigned char block_buffer[sb.block_size];
+    for (uint32_t i = 0; i < nblocks; ++i) {
+        const unsigned char* data = bitmap + (size_t) i * sb.block_size;
+        if (bits_per_block != sb.block_size * 8) {
+            memset(block_buffer, 0, sb.block_size);
+            for (uint32_t b = 0; b < bits_per_block; ++b) {
+                bitmap_assign(block_buffer, b, bitmap_test(bitmap, i * bits_per_block + b));
+            }
+            data = block_buffer;
+        }
+        if (block_write(bitmap_block(start_block, i), data) != 0) return -1;
+    }
+    return 0;
+}
+
+static int set_bit_range(uint32_t bitmap_start_block, uint32_t first_bit, uint32_t count, int value) {
+    verbose_printf("Definindo bits #%u a #%u para %d.\n", first_bit, first_bit + count - 1, value);
+    char block_buffer[sb.block_size];
+    uint32_t bits_per_block = bitmap_bits_per_block(bitmap_start_block);
+    uint32_t bit = first_bit;
+    while (bit < first_bit + count) {
+        uint32_t block_idx = bit / bits_per_block;
+        if (block_read(bitmap_block(bitmap_start_block, block_idx), block_buffer) != 0) return -1;
+        for (; bit < first_bit + count && bit / bits_per_block == block_idx; ++bit) {
+            uint32_t b = bit % bits_per_block;
+            bitmap_note(bitmap_start_block, bit, (block_buffer[b / 8] >> (b % 8)) & 1, value != 0);
+            if (value) block_buffer[b / 8] |= (1 << (b % 8));
+            else block_buffer[b / 8] &= ~(1 << (b % 8));
+        }
+        if (block_write(bitmap_block(bitmap_start_block, block_idx), block_buffer) != 0) return -1;
+    }
+    return 0;
+}
+
+// Primeira sequência de 'count' blocos livres contíguos em [from, limit); 0 se não houver.
+static uint32_t find_free_run(const unsigned char* bitmap, uint32_t from, uint32_t count, uint32_t limit) {
+    uint32_t run_start = 0, run_len = 0;
+    for (uint32_t b = from; b < limit; ++b) {
+        if (bitmap_test(bitmap, b)) { run_len = 0; continue; }
+        if (run_len == 0) run_start = b;
+        if (++run_len == count) return run_start;
+    }
+    return 0;
+}
+
+// Aloca 'count' blocos, preferindo uma sequência contígua em 'goal' ou logo
+// depois dele (normalmente após o último bloco do arquivo, ou o início do grupo
+// do i-node) e, senão, o extent de melhor encaixe. Se nenhum extent comporta
+// o que falta, usa a maior sequência livre e continua com o resto.
+static int alloc_block_run(uint32_t count, uint32_t goal, uint32_t* out) {
+    if (count == 0) return 0;
+    if (!extents_loaded && extents_load() != 0) return -1;
+    if (blocks_available() < count) {
+        verbose_printf("Só %llu bloco(s) livres fora das reservas; %u pedidos.\n", (unsigned long long) blocks_available(), count);
+        return 0;
+    }
+    uint32_t found = 0;
+    while (found < count) {
+        uint32_t start, length = count - found;
+        if (pick_run(length, goal, &start) != 0) {
+            if (extent_tree_longest(&free_extents, &start, &length) != 0) break;
+            verbose_printf("Nenhuma sequência contígua de %u blocos; usando a maior (%u).\n", count - found, length);
+        }
+        verbose_printf("Sequência contígua alocada: blocos %u..%u.\n", start, start + length - 1);
+        if (set_bit_range(sb.block_bitmap_start, start, length, 1) != 0) return -1;
+        for (uint32_t i = 0; i < length; ++i) out[found++] = start + i;
+        goal = start + length;
+    }
+    return found;
+}
+
+// --- Entradas de Diretório ---
+// Até o v2 um bloco de diretório é um vetor de DirectoryEntry de 64 bytes,
+// com posições vazias (nome vazio) no meio. No v3 os registros são compactos
+// e contíguos: remover um desloca os seguintes, e o espaço livre fica todo no
+// fim do bloco. O tamanho de um diretório é a soma dos registros vivos.
+// As funções abaixo escondem a diferença: quem percorre um bloco usa um
+// DirCursor e recebe cópias das entradas.
+
+#define DIRENT_ALIGN 4
+
+typedef struct {
+    uint32_t pos;   // Início da última entrada devolvida por dirent_next
+    uint32_t next;  // Onde a próxima busca começa
+} DirCursor;
+
+static int dirents_packed() {
+    return sb.version >= 3;
+}
+
+static uint32_t dirent_record_size(size_t name_len) {
+    if (!dirents_packed()) return sizeof(DirectoryEntry);
+    return (DIRENT_HEADER_SIZE + name_len + DIRENT_ALIGN - 1) & ~(uint32_t) (DIRENT_ALIGN - 1);
+}
+
+static uint32_t dirent_size(const char* name) {
+    return dirent_record_size(strnlen(name, MAX_FILENAME_LEN - 1));
+}
+
+// Tamanho de um diretório só com '.' e '..'.
+static uint32_t empty_directory_size() {
+    return dirent_size(".") + dirent_size("..");
+}
+
+// Copia para 'out' a próxima entrada viva do bloco a partir do cursor.
+// Retorna 0 no fim do bloco (ou num registro v3 corrompido).
+static int dirent_next(const char* block, DirCursor* cur, DirectoryEntry* out) {
+    if (!dirents_packed()) {
+        for (; cur->next + sizeof(DirectoryEntry) <= sb.block_size; cur->next += sizeof(DirectoryEntry)) {
+            if (block[cur->next] == '\0') continue;
+            memcpy(out, block + cur->next, sizeof(DirectoryEntry));
+            out->name[MAX_FILENAME_LEN - 1] = '\0';
+            cur->pos = cur->next;
+            cur->next += sizeof(DirectoryEntry);
+            return 1;
+        }
+        return 0;
+    }
+    if (cur->next + DIRENT_HEADER_SIZE > sb.block_size) return 0;
+    const unsigned char* raw = (const unsigned char*) block + cur->next;
+    uint32_t len = raw[4];
+    if (len == 0 || len >= MAX_FILENAME_LEN || cur->next + dirent_record_size(len) > sb.block_size) return 0;
+    memset(out, 0, sizeof(DirectoryEntry));
+    out->inode_num = get_le32(raw);
+    memcpy(out->name, raw + DIRENT_HEADER_SIZE, len);
+    cur->pos = cur->next;
+    cur->next += dirent_record_size(len);
+    return 1;
+}
+
+// Bytes ocupados pelos registros v3 do bloco (o resto está livre).
+static uint32_t dirent_block_used(const char* block) {
+    DirCursor cur = {0};
+    DirectoryEntry entry;
+    while (dirent_next(block, &cur, &entry));
+    return cur.next;
+}
+
+// Acrescenta uma entrada ao bloco. Retorna -1 se não houver espaço.
+static int dirent_add(char* block, const char* name, uint32_t inode_num) {
+    size_t len = strnlen(name, MAX_FILENAME_LEN - 1);
+    if (!dirents_packed()) {
+        for (uint32_t off = 0; off + sizeof(DirectoryEntry) <= sb.block_size; off += sizeof(DirectoryEntry)) {
+            if (block[off] != '\0') continue;
+            DirectoryEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            memcpy(entry.name, name, len);
+            entry.inode_num = inode_num;
+            memcpy(block + off, &entry, sizeof(entry));
+            return 0;
+        }
+        return -1;
+    }
+    uint32_t used = dirent_block_used(block);
+    if (used + dirent_record_size(len) > sb.block_size) return -1;
+    unsigned char* raw = (unsigned char*) block + used;
+    memset(raw, 0, dirent_record_size(len));
+    put_le32(raw, inode_num);
+    raw[4] = (unsigned char) len;
+    memcpy(raw + DIRENT_HEADER_SIZE, name, len);
+    return 0;
+}
+
+// Remove a entrada em que o cursor parou. O cursor continua válido para
+// seguir a varredura.
+static void dirent_remove(char* block, DirCursor* cur) {
+    uint32_t size = cur->next - cur->pos;
+    if (!dirents_packed()) {
+        memset(block + cur->pos, 0, size);
+        return;
+    }
+    uint32_t used = dirent_block_used(block);
+    memmove(block + cur->pos, block + cur->next, used - cur->next);
+    memset(block + used - size, 0, size);
+    cur->next = cur->pos;
+}
+
+static void dirent_set_inode(char* block, const DirCursor* cur, uint32_t inode_num) {
+    if (dirents_packed()) put_le32((unsigned char*) block + cur->pos, inode_num);
+    else memcpy(block + cur->pos + offsetof(DirectoryEntry, inode_num), &inode_num, sizeof(inode_num));
+}
+
+// Primeiro bloco de um diretório novo: só '.' e '..'.
+static void dirent_block_init(char* block, uint32_t self, uint32_t parent) {
+    memset(block, 0, sb.block_size);
+    dirent_add(block, ".", self);
+    dirent_add(block, "..", parent);
+}
+
+// Bytes de registros que cabem num bloco com certeza: no v3 a sobra no fim
+// de um bloco cheio é menor que o maior registro.
+static uint32_t dirent_block_capacity() {
+    if (!dirents_packed()) return sb.block_size / sizeof(DirectoryEntry) * sizeof(DirectoryEntry);
+    return sb.block_size - (dirent_record_size(MAX_FILENAME_LEN - 1) - DIRENT_ALIGN);
+}
+
+static int find_in_directory(const Inode* dir_inode, const char* name) {
+    verbose_printf("Procurando por '%s' nas entradas do i-node.\n", name);
+    if (dir_inode->type != TYPE_DIR) return -1;
+    char block_buffer[sb.block_size];
+    // O tamanho conta só as entradas vivas: depois da última, não há o que ler
+    uint64_t live_left = dir_inode->size;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && live_left > 0; ++i) {
+        uint32_t block_num = dir_inode->direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) return -1;
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (live_left > 0 && dirent_next(block_buffer, &cur, &entry)) {
+            if (strcmp(entry.name, name) == 0) {
+                verbose_printf("Entrada '%s' encontrada, aponta para o i-node %u.\n", name, entry.inode_num);
+                return entry.inode_num;
+            }
+            uint32_t record = cur.next - cur.pos;
+            live_left = live_left > record ? live_left - record : 0;
+        }
+    }
+    verbose_printf("Entrada '%s' não encontrada.\n", name);
+    return -1;
+}
+
+// Diretório sem posição livre: aloca mais um bloco (perto do último) e
+// devolve o índice em direct_blocks, com 'block_buffer' zerado, ou -1.
+// O bloco só é gravado por quem chamou, depois de preencher as entradas.
+static int grow_directory(Inode* dir_inode, uint32_t dir_inode_num, char* block_buffer) {
+    uint32_t goal = 0;
+    int slot = -1;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        if (dir_inode->direct_blocks[i] != 0) goal = dir_inode->direct_blocks[i] + 1;
+        else if (slot == -1) slot = i;
+    }
+    if (slot == -1) {
+        fprintf(stderr, "Erro: Diretório está cheio.\n");
+        return -1;
+    }
+    uint32_t block_num;
+    if (alloc_block_run(1, goal, &block_num) != 1) {
+        fprintf(stderr, "Erro: Sem blocos livres para expandir o diretório.\n");
+        return -1;
+    }
+    verbose_printf("Diretório (i-node %u) cresce: bloco %u na posição %d.\n", dir_inode_num, block_num, slot);
+    dir_inode->direct_blocks[slot] = block_num;
+    memset(block_buffer, 0, sb.block_size);
+    return slot;
+}
+
+static int add_entry_to_directory(Inode* dir_inode, uint32_t dir_inode_num, const char* new_name, uint32_t new_inode_num) {
+    verbose_printf("Adicionando entrada '%s' (i-node %u) ao diretório (i-node %u).\n", new_name, new_inode_num, dir_inode_num);
+    char block_buffer[sb.block_size];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t block_num = dir_inode->direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) return -1;
+        if (dirent_add(block_buffer, new_name, new_inode_num) == 0) {
+            verbose_printf(" -> Espaço livre encontrado no bloco de dados %u.\n", block_num);
+            dir_inode->size += dirent_size(new_name);
+            verbose_printf(" -> Atualizando tamanho do i-node pai %u para %llu bytes.\n", dir_inode_num, (unsigned long long) dir_inode->size);
+            inode_write(dir_inode_num, dir_inode);
+            usage_link(new_inode_num, dir_inode_num);
+            name_index_set(new_inode_num, dir_inode_num, new_name);
+            return block_write(block_num, block_buffer);
+        }
+    }
+    int slot = grow_directory(dir_inode, dir_inode_num, block_buffer);
+    if (slot == -1) return -1;
+    dirent_add(block_buffer, new_name, new_inode_num);
+    if (block_write(dir_inode->direct_blocks[slot], block_buffer) != 0) return -1;
+    dir_inode->size += dirent_size(new_name);
+    usage_link(new_inode_num, dir_inode_num);
+    name_index_set(new_inode_num, dir_inode_num, new_name);
+    return inode_write(dir_inode_num, dir_inode);
+}
+
+// Insere várias entradas no diretório gravando cada bloco uma única vez e o
+// i-node pai apenas no final. Retorna quantas entradas couberam (na ordem dada).
+static int add_entries_to_directory(Inode* dir_inode, uint32_t dir_inode_num, char names[][MAX_FILENAME_LEN], const uint32_t* inode_nums, uint32_t count) {
+    verbose_printf("Adicionando %u entradas em lote ao diretório (i-node %u).\n", count, dir_inode_num);
+    char block_buffer[sb.block_size];
+    uint32_t added = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && added < count; ++i) {
+        uint32_t block_num = dir_inode->direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) return -1;
+        int dirty = 0;
+        while (added < count && dirent_add(block_buffer, names[added], inode_nums[added]) == 0) {
+            dir_inode->size += dirent_size(names[added]);
+            added++;
+            dirty = 1;
+        }
+        if (dirty && block_write(block_num, block_buffer) != 0) return -1;
+    }
+    while (added < count) {
+        int slot = grow_directory(dir_inode, dir_inode_num, block_buffer);
+        if (slot == -1) break;
+        while (added < count && dirent_add(block_buffer, names[added], inode_nums[added]) == 0) {
+            dir_inode->size += dirent_size(names[added]);
+            added++;
+        }
+        if (block_write(dir_inode->direct_blocks[slot], block_buffer) != 0) return -1;
+    }
+    if (added > 0) {
+        dir_inode->modified = time(NULL);
+        inode_write(dir_inode_num, dir_inode);
+    }
+    for (uint32_t i = 0; i < added; ++i) {
+        usage_link(inode_nums[i], dir_inode_num);
+        name_index_set(inode_nums[i], dir_inode_num, names[i]);
+    }
+    return added;
+}
+
+// --- Resolução de Caminhos ---
+// namei percorre um caminho absoluto ou relativo ao diretório atual, com
+// '.' e '..', numa única passada. Cada passo (diretório, nome) -> i-node passa
+// pelo cache de entradas (dcache), que evita reler o diretório em caminhos
+// repetidos. Só acertos são guardados; remoções e renomeações invalidam.
+
+#define DCACHE_SIZE 512
+
+typedef struct {
+    uint32_t parent;
+    uint32_t inode_num;
+    char name[MAX_FILENAME_LEN];
+    int valid;
+} DcacheEntry;
+
+static DcacheEntry dcache[DCACHE_SIZE];
+
+static uint32_t dcache_slot(uint32_t parent, const char* name) {
+    uint32_t h = 2166136261u ^ parent;
+    for (const unsigned char* c = (const unsigned char*) name; *c; ++c) h = (h ^ *c) * 16777619u;
+    return h % DCACHE_SIZE;
+}
+
+static void dcache_insert(uint32_t parent, const char* name, uint32_t inode_num) {
+    DcacheEntry* e = &dcache[dcache_slot(parent, name)];
+    e->parent = parent;
+    e->inode_num = inode_num;
+    strncpy(e->name, name, MAX_FILENAME_LEN);
+    e->name[MAX_FILENAME_LEN - 1] = '\0';
+    e->valid = 1;
+}
+
+static void dcache_forget(uint32_t parent, const char* name) {
+    DcacheEntry* e = &dcache[dcache_slot(parent, name)];
+    if (e->valid && e->parent == parent && strcmp(e->name, name) == 0) e->valid = 0;
+}
+
+// Esquece todas as entradas de um diretório (removido, ou '..' alterado).
+static void dcache_forget_dir(uint32_t dir) {
+    for (int i = 0; i < DCACHE_SIZE; ++i) if (dcache[i].parent == dir) dcache[i].valid = 0;
+}
+
+static void dcache_clear() {
+    memset(dcache, 0, sizeof(dcache));
+}
+
+// Procura 'name' no diretório 'dir_num', consultando o dcache primeiro.
+static int dir_lookup(uint32_t dir_num, const char* name) {
+    DcacheEntry* e = &dcache[dcache_slot(dir_num, name)];
+    if (e->valid && e->parent == dir_num && strcmp(e->name, name) == 0) {
+        verbose_printf("Entrada '%s' do i-node %u encontrada no dcache (i-node %u).\n", name, dir_num, e->inode_num);
+        return e->inode_num;
+    }
+    Inode dir_inode;
+    if (inode_read(dir_num, &dir_inode) != 0) return -1;
+    int found = find_in_directory(&dir_inode, name);
+    if (found != -1) dcache_insert(dir_num, name, found);
+    return found;
+}
+
+// Percorre 'path' a partir da raiz ou do diretório atual. Com 'last' != NULL,
+// o último componente não é resolvido: ele é copiado para 'last' e o retorno
+// é o diretório que o contém. Retorna o número do i-node ou -1.
+static int path_walk(const char* path, char* last) {
+    if (!path || !*path) return -1;
+    uint32_t dir = path[0] == '/' ? 0 : current_inode_num;
+    const char* p = path;
+    char component[MAX_FILENAME_LEN];
+    if (last) last[0] = '\0';
+    while (*p) {
+        while (*p == '/') p++;
+        if (!*p) break;
+        size_t len = strcspn(p, "/");
+        if (len >= MAX_FILENAME_LEN) {
+            fprintf(stderr, "Erro: Nome muito longo no caminho '%s'.\n", path);
+            return -1;
+        }
+        memcpy(component, p, len);
+        component[len] = '\0';
+        p += len;
+        while (*p == '/') p++;
+        if (last && !*p) {
+            memcpy(last, component, len + 1);
+            break;
+        }
+        if (strcmp(component, ".") == 0) continue;
+        int next = dir_lookup(dir, component);
+        if (next == -1) return -1;
+        dir = next;
+    }
+    if (last && !last[0]) return -1; // "/" ou vazio: não há último componente
+    return dir;
+}
+
+// Indica se 'ancestor' está no caminho de 'dir' até a raiz (incluindo 'dir').
+static int dir_is_within(uint32_t dir, uint32_t ancestor) {
+    for (uint32_t depth = 0; depth < sb.total_inodes; ++depth) {
+        if (dir == ancestor) return 1;
+        if (dir == 0) return 0;
+        int parent = dir_lookup(dir, "..");
+        if (parent == -1) return 0;
+        dir = parent;
+    }
+    return 0;
+}
+
+static int namei(const char* path) {
+    return path_walk(path, NULL);
+}
+
+// Resolve o diretório pai de 'path' e copia o último componente para 'name'
+// (MAX_FILENAME_LEN bytes). Retorna o i-node do pai ou -1.
+static int namei_parent(const char* path, char* name) {
+    int parent = path_walk(path, name);
+    if (parent == -1) return -1;
+    Inode parent_inode;
+    if (inode_read(parent, &parent_inode) != 0 || parent_inode.type != TYPE_DIR) return -1;
+    return parent;
+}
+
+// --- Contagem de Referências e Deduplicação ---
+// Um bloco pode ser apontado por mais de um arquivo. A tabela de referências
+// guarda, para cada bloco, quantos donos ele tem além do primeiro: 0 é o caso
+// comum e mantém o formato compatível com discos sem o recurso. Com
+// FEATURE_DEDUP, um índice (CRC32C do conteúdo -> bloco) permite reaproveitar
+// um bloco cheio idêntico em vez de alocar outro. O índice funciona como cache:
+// entradas velhas são toleradas porque todo candidato é conferido byte a byte.
+
+#define DEDUP_PROBE 8 // Posições examinadas por busca/inserção no índice
+
+typedef struct {
+    uint32_t hash;
+    uint32_t block;  // 0 = posição vazia
+} DedupSlot;
+
+static MetaTable refcount_table = {0};
+static MetaTable dedup_table = {0};
+
+static uint32_t refcount_table_blocks(uint32_t total_blocks, uint32_t block_size) {
+    return ((uint64_t) total_blocks * sizeof(uint32_t) + block_size - 1) / block_size;
+}
+
+static uint32_t dedup_table_blocks(uint32_t slots, uint32_t block_size) {
+    return ((uint64_t) slots * sizeof(DedupSlot) + block_size - 1) / block_size;
+}
+
+static uint32_t* block_refcounts() {
+    return (uint32_t*) refcount_table.data;
+}
+
+static uint32_t block_extra_refs(uint32_t block_num) {
+    return refcount_table.data ? block_refcounts()[block_num] : 0;
+}
+
+static int refcount_inc(uint32_t block_num) {
+    if (!refcount_table.data || block_refcounts()[block_num] == UINT32_MAX) return -1;
+    block_refcounts()[block_num]++;
+    meta_table_touch(&refcount_table, (size_t) block_num * sizeof(uint32_t));
+    return 0;
+}
+
+static int block_is_allocated(uint32_t block_num) {
+    char block_buffer[sb.block_size];
+    uint32_t bits_per_block = sb.block_size * 8;
+    if (block_read(bitmap_block(sb.block_bitmap_start, block_num / bits_per_block), block_buffer) != 0) return 0;
+    uint32_t bit = block_num % bits_per_block;
+    return (block_buffer[bit / 8] >> (bit % 8)) & 1;
+}
+
+// Procura um bloco em uso com exatamente o mesmo conteúdo. Retorna 0 se não houver.
+static uint32_t dedup_find(const char* data, uint32_t hash) {
+    DedupSlot* slots = (DedupSlot*) dedup_table.data;
+    char block_buffer[sb.block_size];
+    for (uint32_t p = 0; p < DEDUP_PROBE; ++p) {
+        DedupSlot* slot = &slots[(hash + p) & (sb.dedup_slots - 1)];
+        if (slot->block == 0) break;
+        if (slot->hash != hash || !block_is_allocated(slot->block)) continue;
+        if (block_read(slot->block, block_buffer) == 0 && memcmp(block_buffer, data, sb.block_size) == 0) {
+            return slot->block;
+        }
+    }
+    return 0;
+}
+
+static void dedup_insert(uint32_t hash, uint32_t block_num) {
+    DedupSlot* slots = (DedupSlot*) dedup_table.data;
+    uint32_t victim = hash & (sb.dedup_slots - 1);
+    for (uint32_t p = 0; p < DEDUP_PROBE; ++p) {
+        uint32_t pos = (hash + p) & (sb.dedup_slots - 1);
+        if (slots[pos].block == 0 || slots[pos].block == block_num) { victim = pos; break; }
+    }
+    // Sem posição livre na vizinhança: substitui a primeira (o índice é só um cache)
+    slots[victim].hash = hash;
+    slots[victim].block = block_num;
+    meta_table_touch(&dedup_table, (size_t) victim * sizeof(DedupSlot));
+}
+
+// Grava um bloco de dados de arquivo recém-alocado em '*block_num'. Com
+// deduplicação, um bloco cheio idêntico a outro já existente é compartilhado:
+// o bloco novo é devolvido e '*block_num' passa a apontar para o existente.
+static int store_data_block(uint32_t* block_num, const char* data, int full) {
+    if (!dedup_table.data || !full) return block_write(*block_num, data);
+    uint32_t hash = crc32c(0, data, sb.block_size);
+    uint32_t existing = dedup_find(data, hash);
+    if (existing != 0 && refcount_inc(existing) == 0) {
+        verbose_printf("Bloco idêntico ao #%u: compartilhando (referências extras: %u).\n", existing, block_extra_refs(existing));
+        set_bit(sb.block_bitmap_start, *block_num, 0);
+        *block_num = existing;
+        return 0;
+    }
+    if (block_write(*block_num, data) != 0) return -1;
+    dedup_insert(hash, *block_num);
+    return 0;
+}
+
+static int meta_tables_load() {
+    if ((sb.features & FEATURE_REFCOUNT) &&
+        meta_table_load(&refcount_table, sb.refcount_start, refcount_table_blocks(sb.total_blocks, sb.block_size), u32_table_swap) != 0) return -1;
+    if ((sb.features & FEATURE_DEDUP) &&
+        meta_table_load(&dedup_table, sb.dedup_start, dedup_table_blocks(sb.dedup_slots, sb.block_size), u32_table_swap) != 0) return -1;
+    if ((sb.features & FEATURE_DIR_USAGE) &&
+        meta_table_load(&usage_table, sb.usage_start, usage_table_blocks(sb.total_inodes, sb.block_size), usage_table_swap) != 0) return -1;
+    if ((sb.features & FEATURE_NAME_INDEX) &&
+        meta_table_load(&name_table, sb.name_index_start, name_index_blocks(sb.total_inodes, sb.block_size), name_table_swap) != 0) return -1;
+    return 0;
+}
+
+static int meta_tables_store() {
+    if (meta_table_store(&refcount_table) != 0 || meta_table_store(&dedup_table) != 0 ||
+        meta_table_store(&usage_table) != 0 || meta_table_store(&name_table) != 0) return -1;
+    return 0;
+}
+
+static void meta_tables_release() {
+    meta_table_release(&refcount_table);
+    meta_table_release(&dedup_table);
+    meta_table_release(&usage_table);
+    meta_table_release(&name_table);
+}
+
+static int free_block(uint32_t block_num) {
+    if (block_extra_refs(block_num) > 0) {
+        // Bloco compartilhado: só perde uma referência
+        block_refcounts()[block_num]--;
+        meta_table_touch(&refcount_table, (size_t) block_num * sizeof(uint32_t));
+        verbose_printf("Bloco #%u ainda compartilhado (referências extras: %u).\n", block_num, block_refcounts()[block_num]);
+        return 0;
+    }
+    verbose_printf("Liberando bloco de dados #%u.\n", block_num);
+    return set_bit(sb.block_bitmap_start, block_num, 0);
+}
+
+static int free_inode(uint32_t inode_num) {
+    verbose_printf("Liberando i-node #%u.\n", inode_num);
+    usage_release(inode_num);
+    NameEntry* entry = name_entry(inode_num);
+    if (entry) name_index_clear(inode_num, entry->parent);
+    return set_bit(sb.inode_bitmap_start, inode_num, 0);
+}
+
+static uint32_t directory_blocks(const Inode* dir_inode) {
+    uint32_t count = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) if (dir_inode->direct_blocks[i] != 0) count++;
+    return count;
+}
+
+// Reempacota as entradas vivas, na ordem, nos primeiros blocos do diretório
+// e libera os que sobram. '.' e '..' continuam no início do bloco 0.
+static int compact_directory(Inode* dir_inode, uint32_t dir_inode_num) {
+    uint32_t blocks = directory_blocks(dir_inode);
+    size_t max_entries = (size_t) blocks * (sb.block_size / dirent_record_size(1));
+    DirectoryEntry* live = calloc(max_entries ? max_entries : 1, sizeof(DirectoryEntry));
+    // Reempacotar na mesma ordem nunca precisa de mais blocos que os atuais
+    char* packed = calloc(blocks ? blocks : 1, sb.block_size);
+    if (!live || !packed) {
+        free(live);
+        free(packed);
+        return -1;
+    }
+    uint32_t count = 0;
+    uint32_t kept[INODE_DIRECT_BLOCKS];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t block_num = dir_inode->direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, packed) != 0) {
+            free(live);
+            free(packed);
+            return -1;
+        }
+        DirCursor cur = {0};
+        while (count < max_entries && dirent_next(packed, &cur, &live[count])) count++;
+    }
+    memset(packed, 0, (size_t) (blocks ? blocks : 1) * sb.block_size);
+    uint32_t needed = 1;
+    uint64_t size = 0;
+    for (uint32_t k = 0; k < count; ++k) {
+        if (dirent_add(packed + (size_t) (needed - 1) * sb.block_size, live[k].name, live[k].inode_num) != 0) {
+            needed++;
+            dirent_add(packed + (size_t) (needed - 1) * sb.block_size, live[k].name, live[k].inode_num);
+        }
+        size += dirent_size(live[k].name);
+    }
+    uint32_t n = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) if (dir_inode->direct_blocks[i] != 0) kept[n++] = dir_inode->direct_blocks[i];
+    verbose_printf("Compactando diretório (i-node %u): %u entradas, %u -> %u bloco(s).\n", dir_inode_num, count, blocks, needed);
+    int rc = 0;
+    for (uint32_t b = 0; b < needed && rc == 0; ++b) rc = block_write(kept[b], packed + (size_t) b * sb.block_size);
+    free(live);
+    free(packed);
+    if (rc != 0) return -1;
+    memset(dir_inode->direct_blocks, 0, sizeof(dir_inode->direct_blocks));
+    for (uint32_t b = 0; b < needed; ++b) dir_inode->direct_blocks[b] = kept[b];
+    dir_inode->size = size;
+    if (inode_write(dir_inode_num, dir_inode) != 0) return -1;
+    for (uint32_t b = needed; b < blocks; ++b) free_block(kept[b]);
+    return 0;
+}
+
+// Indica se compactar o diretório libera blocos além de 'slack'. Na remoção
+// a folga é de um bloco, para não reempacotar a cada criação/remoção no
+// limite; o defrag compacta tudo o que for possível. A conta usa a
+// capacidade garantida de um bloco, então só acusa quando a compactação
+// com certeza devolve blocos.
+static int directory_needs_compaction(const Inode* dir_inode, uint32_t slack) {
+    uint32_t capacity = dirent_block_capacity();
+    uint64_t needed = (dir_inode->size + capacity - 1) / capacity;
+    return directory_blocks(dir_inode) > (needed ? needed : 1) + slack;
+}
+
+static int remove_entry_from_directory(Inode* parent_inode, uint32_t parent_inode_num, const char* name_to_remove) {
+    verbose_printf("Removendo entrada '%s' do diretório (i-node %u).\n", name_to_remove, parent_inode_num);
+    char block_buffer[sb.block_size];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t block_num = parent_inode->direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) return -1;
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (dirent_next(block_buffer, &cur, &entry)) {
+            if (strcmp(entry.name, name_to_remove) != 0) continue;
+            verbose_printf(" -> Entrada encontrada no bloco %u. Removendo entrada.\n", block_num);
+            usage_unlink(entry.inode_num, parent_inode_num);
+            name_index_clear(entry.inode_num, parent_inode_num);
+            parent_inode->size -= cur.next - cur.pos;
+            dirent_remove(block_buffer, &cur);
+            dcache_forget(parent_inode_num, name_to_remove);
+            verbose_printf(" -> Atualizando tamanho do i-node pai %u para %llu bytes.\n", parent_inode_num, (unsigned long long) parent_inode->size);
+            DirCursor first = {0};
+            if (i > 0 && !dirent_next(block_buffer, &first, &entry)) {
+                // Bloco extra ficou vazio: é devolvido em vez de gravado
+                verbose_printf(" -> Bloco %u do diretório ficou vazio. Liberando.\n", block_num);
+                parent_inode->direct_blocks[i] = 0;
+                if (inode_write(parent_inode_num, parent_inode) != 0) return -1;
+                free_block(block_num);
+            } else {
+                inode_write(parent_inode_num, parent_inode);
+                if (block_write(block_num, block_buffer) != 0) return -1;
+            }
+            if (directory_needs_compaction(parent_inode, 1)) return compact_directory(parent_inode, parent_inode_num);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// --- Compressão ---
+
+typedef struct {
+    uint32_t count;                      // Blocos físicos gerados
+    uint32_t slot[INODE_DIRECT_BLOCKS];  // Posição em direct_blocks de cada bloco físico
+    char* data;                          // count * block_size bytes
+} PackedData;
+
+static int inode_is_compressed(const Inode* inode) {
+    return (inode->flags & INODE_FLAG_COMPRESSED) != 0;
+}
+
+static uint32_t cluster_bytes() {
+    return COMPRESS_CLUSTER_BLOCKS * sb.block_size;
+}
+
+// Tamanho comprimido no início do primeiro bloco do cluster: little-endian no
+// v3, na ordem do host antes dele.
+static uint32_t cluster_header_get(const char* block) {
+    uint32_t clen;
+    if (sb.version >= 3) return get_le32((const unsigned char*) block);
+    memcpy(&clen, block, sizeof(clen));
+    return clen;
+}
+
+static void cluster_header_put(char* block, uint32_t clen) {
+    if (sb.version >= 3) put_le32((unsigned char*) block, clen);
+    else memcpy(block, &clen, sizeof(clen));
+}
+
+// Divide 'data' (que começa no início do cluster 'first_cluster') em clusters
+// e comprime cada um; clusters que não economizam ao menos um bloco ficam crus.
+// Não toca em estado global mutável, então pode rodar nas threads do import -r.
+static int pack_clusters(const char* data, size_t len, uint32_t first_cluster, PackedData* out) {
+    uint32_t bs = sb.block_size;
+    uint32_t cb = cluster_bytes();
+    uint32_t logical_total = (len + bs - 1) / bs;
+    memset(out, 0, sizeof(PackedData));
+    if (first_cluster * COMPRESS_CLUSTER_BLOCKS + logical_total > INODE_DIRECT_BLOCKS) return -1;
+    out->data = calloc(logical_total ? logical_total : 1, bs);
+    uint8_t* tmp = malloc(cb);
+    if (!out->data || !tmp) {
+        free(out->data);
+        free(tmp);
+        out->data = NULL;
+        return -1;
+    }
+    for (size_t off = 0; off < len; off += cb) {
+        size_t chunk = len - off < cb ? len - off : cb;
+        uint32_t logical = (chunk + bs - 1) / bs;
+        uint32_t base_slot = (first_cluster + off / cb) * COMPRESS_CLUSTER_BLOCKS;
+        char* dst = out->data + (size_t) out->count * bs;
+        int clen = -1;
+        if (logical > 1) {
+            clen = lz_compress((const uint8_t*) data + off, chunk, tmp, (logical - 1) * bs - sizeof(uint32_t));
+        }
+        uint32_t physical = logical;
+        if (clen > 0) {
+            cluster_header_put(dst, clen);
+            memcpy(dst + sizeof(uint32_t), tmp, clen);
+            physical = (sizeof(uint32_t) + clen + bs - 1) / bs;
+        } else {
+            memcpy(dst, data + off, chunk);
+        }
+        for (uint32_t p = 0; p < physical; ++p) out->slot[out->count++] = base_slot + p;
+    }
+    free(tmp);
+    return 0;
+}
+
+// Aloca blocos (em sequência contígua, se possível) e grava os dados empacotados.
+// Os blocos vão logo após os que o i-node já tem ou, se não tiver nenhum, a partir de 'goal'.
+static int write_packed(Inode* inode, const PackedData* packed, uint32_t goal) {
+    uint32_t blocks[INODE_DIRECT_BLOCKS];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) if (inode->direct_blocks[i] != 0) goal = inode->direct_blocks[i] + 1;
+    int got = alloc_block_run(packed->count, goal, blocks);
+    if (got != (int) packed->count) {
+        for (int i = 0; i < got; ++i) free_block(blocks[i]);
+        fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
+        return -1;
+    }
+    for (uint32_t i = 0; i < packed->count; ++i) {
+        // Todo bloco empacotado é cheio (completado com zeros), então também passa pela deduplicação
+        if (store_data_block(&blocks[i], packed->data + (size_t) i * sb.block_size, 1) != 0) {
+            for (uint32_t j = 0; j < packed->count; ++j) free_block(blocks[j]);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < packed->count; ++i) inode->direct_blocks[packed->slot[i]] = blocks[i];
+    return 0;
+}
+
+// Lê o cluster 'k' de um arquivo comprimido de 'size' bytes para 'out'
+// (cluster_bytes() bytes). Retorna quantos bytes lógicos o cluster tem ou -1.
+static int read_cluster(const Inode* inode, uint64_t size, uint32_t k, char* out) {
+    uint32_t bs = sb.block_size;
+    uint32_t cb = cluster_bytes();
+    if ((uint64_t) k * cb >= size) return 0;
+    size_t chunk = size - (uint64_t) k * cb < cb ? size - (uint64_t) k * cb : cb;
+    uint32_t logical = (chunk + bs - 1) / bs;
+    uint32_t base = k * COMPRESS_CLUSTER_BLOCKS;
+    uint32_t physical = 0;
+    while (physical < logical && inode->direct_blocks[base + physical] != 0) physical++;
+    if (physical == 0) {
+        // Cluster inteiro é um buraco (arquivo esparso)
+        memset(out, 0, chunk);
+        return chunk;
+    }
+    if (physical == logical) {
+        for (uint32_t p = 0; p < physical; ++p) {
+            if (block_read(inode->direct_blocks[base + p], out + (size_t) p * bs) != 0) return -1;
+        }
+        return chunk;
+    }
+    char* packed = malloc((size_t) (physical ? physical : 1) * bs);
+    if (!packed) return -1;
+    for (uint32_t p = 0; p < physical; ++p) {
+        if (block_read(inode->direct_blocks[base + p], packed + (size_t) p * bs) != 0) { free(packed); return -1; }
+    }
+    uint32_t clen = 0;
+    if (physical > 0) clen = cluster_header_get(packed);
+    int n = -1;
+    if (physical > 0 && clen <= physical * bs - sizeof(clen)) {
+        n = lz_decompress((const uint8_t*) packed + sizeof(clen), clen, (uint8_t*) out, chunk);
+    }
+    free(packed);
+    if (n != (int) chunk) {
+        fprintf(stderr, "Erro: Cluster %u do arquivo está corrompido.\n", k);
+        return -1;
+    }
+    verbose_printf("Cluster %u descomprimido: %u bloco(s) físicos -> %zu bytes.\n", k, physical, chunk);
+    return chunk;
+}
+
+// Libera os blocos do cluster 'k' e zera suas posições em direct_blocks.
+static void free_cluster(Inode* inode, uint32_t k) {
+    for (uint32_t p = 0; p < COMPRESS_CLUSTER_BLOCKS; ++p) {
+        uint32_t slot = k * COMPRESS_CLUSTER_BLOCKS + p;
+        if (slot >= INODE_DIRECT_BLOCKS) break;
+        if (inode->direct_blocks[slot] != 0) free_block(inode->direct_blocks[slot]);
+        inode->direct_blocks[slot] = 0;
+    }
+}
+
+// --- Alocação Atrasada ---
+// Os dados anexados com 'echo >>' ficam em buffers por i-node e só ganham
+// blocos no disco no 'sync', na desmontagem ou quando os buffers passam do
+// limite de memória. Assim várias escritas pequenas viram poucas escritas de
+// blocos inteiros, alocados em sequência contígua.
+
+#define DELALLOC_MAX_BYTES (1024 * 1024)
+
+typedef struct DirtyBuffer {
+    uint32_t inode_num;
+    char* data;
+    size_t len;
+    size_t capacity;
+    struct DirtyBuffer* next;
+} DirtyBuffer;
+
+static DirtyBuffer* dirty_buffers = NULL;
+static size_t dirty_bytes = 0;
+
+static DirtyBuffer* find_dirty_buffer(uint32_t inode_num) {
+    for (DirtyBuffer* buf = dirty_buffers; buf; buf = buf->next) {
+        if (buf->inode_num == inode_num) return buf;
+    }
+    return NULL;
+}
+
+static uint32_t blocks_for_size(uint64_t size) {
+    if (fits_inline(size)) return 0;
+    uint64_t blocks = size / sb.block_size + (size % sb.block_size != 0);
+    // Satura em vez de truncar: tamanhos absurdos continuam acima do limite
+    return blocks > UINT32_MAX ? UINT32_MAX : (uint32_t) blocks;
+}
+
+// Um arquivo deste tamanho cabe nos blocos diretos (e em 32 bits, sem FEATURE_LARGE_FILES)?
+static int size_fits_inode(uint64_t size) {
+    return blocks_for_size(size) <= INODE_DIRECT_BLOCKS && ((sb.features & FEATURE_LARGE_FILES) || size <= UINT32_MAX);
+}
+
+static void release_dirty_buffer(DirtyBuffer* target, uint64_t on_disk_size) {
+    DirtyBuffer** link = &dirty_buffers;
+    while (*link && *link != target) link = &(*link)->next;
+    if (!*link) return;
+    *link = target->next;
+    delalloc_reserved_blocks -= blocks_for_size(on_disk_size + target->len) - blocks_for_size(on_disk_size);
+    dirty_bytes -= target->len;
+    free(target->data);
+    free(target);
+}
+
+// Arquivo comprimido: o último cluster (parcial) é descomprimido, recebe os
+// dados pendentes e é recomprimido junto com os clusters novos. Os blocos
+// antigos do cluster saem do i-node, mas só são liberados por quem chamou.
+static int flush_compressed(DirtyBuffer* buf, Inode* inode) {
+    uint64_t old_size = inode->size;
+    uint32_t cb = cluster_bytes();
+    int was_inline = inode_is_inline(inode);
+    uint32_t first_cluster = was_inline ? 0 : old_size / cb;
+    size_t tail_len = was_inline ? old_size : old_size - (uint64_t) first_cluster * cb;
+    char* data = malloc(tail_len + buf->len + cb);
+    if (!data) return -1;
+    if (was_inline) {
+        memcpy(data, inode->direct_blocks, old_size);
+        memset(inode->direct_blocks, 0, sizeof(inode->direct_blocks));
+        inode->flags &= ~INODE_FLAG_INLINE;
+    } else if (tail_len > 0 && read_cluster(inode, old_size, first_cluster, data) != (int) tail_len) {
+        free(data);
+        return -1;
+    }
+    memcpy(data + tail_len, buf->data, buf->len);
+    verbose_printf("Recomprimindo a partir do cluster %u (%zu bytes) do i-node %u.\n", first_cluster, tail_len + buf->len, buf->inode_num);
+    PackedData packed;
+    if (pack_clusters(data, tail_len + buf->len, first_cluster, &packed) != 0) {
+        fprintf(stderr, "Erro: Conteúdo excede o tamanho máximo do arquivo.\n");
+        free(data);
+        return -1;
+    }
+    free(data);
+    if (tail_len > 0 && !was_inline) {
+        for (uint32_t slot = first_cluster * COMPRESS_CLUSTER_BLOCKS; slot < INODE_DIRECT_BLOCKS; ++slot) inode->direct_blocks[slot] = 0;
+    }
+    int rc = write_packed(inode, &packed, group_goal_block(buf->inode_num));
+    free(packed.data);
+    if (rc != 0) return -1;
+    inode->size = old_size + buf->len;
+    return 0;
+}
+
+// Coloca os dados pendentes de 'buf' em blocos e atualiza 'inode' em memória.
+// Não grava o i-node nem libera blocos antigos: flush_dirty_buffer cuida disso.
+static int write_dirty_data(DirtyBuffer* buf, Inode* inode) {
+    uint64_t old_size = inode->size;
+    uint64_t new_size = old_size + buf->len;
+
+    if ((old_size == 0 || inode_is_inline(inode)) && fits_inline(new_size)) {
+        verbose_printf("Descarregando %zu bytes pendentes do i-node %u inline (tamanho final %llu).\n", buf->len, buf->inode_num, (unsigned long long) new_size);
+        memcpy((char*) inode->direct_blocks + old_size, buf->data, buf->len);
+        inode->flags |= INODE_FLAG_INLINE;
+        inode->size = new_size;
+        return 0;
+    }
+    if (inode_is_compressed(inode)) return flush_compressed(buf, inode);
+    char* promoted = NULL;
+    const char* src = buf->data;
+    size_t left = buf->len;
+    if (inode_is_inline(inode)) {
+        // Cresceu além do limite: os dados inline vão para blocos junto com os pendentes
+        verbose_printf("I-node %u deixa de ser inline (%llu bytes).\n", buf->inode_num, (unsigned long long) new_size);
+        promoted = malloc(new_size);
+        if (!promoted) return -1;
+        memcpy(promoted, inode->direct_blocks, old_size);
+        memcpy(promoted + old_size, buf->data, buf->len);
+        src = promoted;
+        left = new_size;
+        memset(inode->direct_blocks, 0, sizeof(inode->direct_blocks));
+        inode->flags &= ~INODE_FLAG_INLINE;
+        inode->size = 0;
+    }
+    uint64_t start_size = inode->size;
+    uint32_t old_blocks = (start_size + sb.block_size - 1) / sb.block_size;
+    uint32_t new_blocks = (new_size + sb.block_size - 1) / sb.block_size;
+    verbose_printf("Descarregando %zu bytes pendentes do i-node %u (%u -> %u blocos).\n", buf->len, buf->inode_num, old_blocks, new_blocks);
+
+    uint32_t fresh[INODE_DIRECT_BLOCKS];
+    uint32_t goal = old_blocks > 0 && inode->direct_blocks[old_blocks - 1] != 0 ? inode->direct_blocks[old_blocks - 1] + 1
+                                                                               : group_goal_block(buf->inode_num);
+    if (new_blocks > old_blocks) {
+        int got = alloc_block_run(new_blocks - old_blocks, goal, fresh);
+        if (got != (int)(new_blocks - old_blocks)) {
+            for (int i = 0; i < got; ++i) free_block(fresh[i]);
+            fprintf(stderr, "Erro: Sem blocos livres para gravar os dados pendentes do i-node %u.\n", buf->inode_num);
+            free(promoted);
+            return -1;
+        }
+        for (uint32_t i = old_blocks; i < new_blocks; ++i) inode->direct_blocks[i] = fresh[i - old_blocks];
+    }
+
+    char block_buffer[sb.block_size];
+    uint32_t index = start_size / sb.block_size;
+    uint32_t offset = start_size % sb.block_size;
+    int rc = 0;
+    if (offset > 0 && inode->direct_blocks[index] == 0) {
+        // O último bloco é um buraco (arquivo esparso): ganha um bloco agora
+        int hole_block = alloc_block(goal);
+        if (hole_block == -1) rc = -1;
+        else inode->direct_blocks[index] = hole_block;
+        memset(block_buffer, 0, sb.block_size);
+    } else if (offset > 0 && block_read(inode->direct_blocks[index], block_buffer) != 0) rc = -1;
+    if (rc == 0 && offset > 0 && block_extra_refs(inode->direct_blocks[index]) > 0) {
+        // Cópia na escrita: o último bloco é compartilhado com um clone e ganha uma cópia própria
+        int copy = alloc_block(inode->direct_blocks[index]);
+        if (copy == -1) {
+            fprintf(stderr, "Erro: Sem blocos livres para copiar o bloco compartilhado do i-node %u.\n", buf->inode_num);
+            rc = -1;
+        } else {
+            verbose_printf("Bloco #%u compartilhado: copiando para #%d antes de alterar.\n", inode->direct_blocks[index], copy);
+            inode->direct_blocks[index] = copy;
+        }
+    }
+    while (rc == 0 && left > 0) {
+        if (offset == 0) memset(block_buffer, 0, sb.block_size);
+        size_t chunk = sb.block_size - offset < left ? sb.block_size - offset : left;
+        memcpy(block_buffer + offset, src, chunk);
+        int fresh_full = offset == 0 && chunk == sb.block_size && index >= old_blocks;
+        if (store_data_block(&inode->direct_blocks[index], block_buffer, fresh_full) != 0) rc = -1;
+        src += chunk;
+        left -= chunk;
+        offset = 0;
+        index++;
+    }
+    free(promoted);
+    if (rc != 0) return -1;
+    inode->size = new_size;
+    return 0;
+}
+
+// Grava no disco os dados pendentes de um i-node. A descarga pode usar os
+// blocos reservados para este buffer. Se falhar, os blocos que ela alocou
+// voltam a ficar livres e o buffer continua pendente.
+static int flush_dirty_buffer(DirtyBuffer* buf) {
+    Inode inode;
+    if (inode_read(buf->inode_num, &inode) != 0) return -1;
+    Inode before = inode;
+    delalloc_flush_grant = blocks_for_size(before.size + buf->len) - blocks_for_size(before.size);
+    int rc = write_dirty_data(buf, &inode);
+    delalloc_flush_grant = 0;
+    if (rc == 0 && inode_write(buf->inode_num, &inode) != 0) rc = -1;
+
+    // Compara os ponteiros: os substituídos saem de uso (sucesso) ou os novos
+    // são devolvidos (falha). Inline, direct_blocks guarda dados, não blocos.
+    // Num arquivo comprimido o último cluster é sempre regravado, e a
+    // deduplicação pode devolver o mesmo bloco com uma referência a mais.
+    int had_blocks = !inode_is_inline(&before);
+    int has_blocks = !inode_is_inline(&inode);
+    uint32_t rewritten = inode_is_compressed(&before) && had_blocks ? before.size / cluster_bytes() * COMPRESS_CLUSTER_BLOCKS
+                                                                   : INODE_DIRECT_BLOCKS;
+    for (uint32_t i = 0; i < INODE_DIRECT_BLOCKS && (had_blocks || has_blocks); ++i) {
+        uint32_t old_block = had_blocks ? before.direct_blocks[i] : 0;
+        uint32_t new_block = has_blocks ? inode.direct_blocks[i] : 0;
+        if (old_block == new_block && (i < rewritten || old_block == 0)) continue;
+        if (rc == 0 && old_block != 0) free_block(old_block);
+        if (rc != 0 && new_block != 0) free_block(new_block);
+    }
+    if (rc != 0) return -1;
+    release_dirty_buffer(buf, before.size);
+    return 0;
+}
+
+static int flush_all_dirty_buffers() {
+    int rc = 0;
+    DirtyBuffer* buf = dirty_buffers;
+    while (buf) {
+        DirtyBuffer* next = buf->next;
+        // Um buffer que não pôde ser gravado continua pendente (e reservado) para a próxima tentativa
+        if (flush_dirty_buffer(buf) != 0) rc = -1;
+        buf = next;
+    }
+    return rc;
+}
+
+// Descarta os dados pendentes (arquivo removido ou sobrescrito).
+static void drop_dirty_buffer(uint32_t inode_num, uint64_t on_disk_size) {
+    DirtyBuffer* buf = find_dirty_buffer(inode_num);
+    if (buf) {
+        verbose_printf("Descartando %zu bytes pendentes do i-node %u.\n", buf->len, inode_num);
+        release_dirty_buffer(buf, on_disk_size);
+    }
+}
+
+static int delalloc_append(uint32_t inode_num, const Inode* inode, const char* text, size_t len) {
+    DirtyBuffer* buf = find_dirty_buffer(inode_num);
+    size_t pending = buf ? buf->len : 0;
+    uint32_t before = blocks_for_size((uint64_t) inode->size + pending);
+    uint32_t after = blocks_for_size((uint64_t) inode->size + pending + len);
+    if (after > INODE_DIRECT_BLOCKS) {
+        fprintf(stderr, "Erro: Conteúdo excede o tamanho máximo do arquivo.\n");
+        return -1;
+    }
+    if (after > before) {
+        // Reserva os blocos agora para que a descarga futura não fique sem espaço
+        if (!extents_loaded && extents_load() != 0) return -1;
+        if (blocks_available() < after - before) {
+            fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
+            return -1;
+        }
+    }
+    if (!buf) {
+        buf = calloc(1, sizeof(DirtyBuffer));
+        if (!buf) return -1;
+        buf->inode_num = inode_num;
+        buf->next = dirty_buffers;
+        dirty_buffers = buf;
+    }
+    if (buf->len + len > buf->capacity) {
+        size_t new_cap = buf->capacity ? buf->capacity : sb.block_size;
+        while (new_cap < buf->len + len) new_cap *= 2;
+        char* tmp = realloc(buf->data, new_cap);
+        if (!tmp) return -1;
+        buf->data = tmp;
+        buf->capacity = new_cap;
+    }
+    memcpy(buf->data + buf->len, text, len);
+    buf->len += len;
+    dirty_bytes += len;
+    delalloc_reserved_blocks += after - before;
+    verbose_printf("%zu bytes adiados para o i-node %u (pendentes: %zu, total em memória: %zu).\n", len, inode_num, buf->len, dirty_bytes);
+    if (dirty_bytes > DELALLOC_MAX_BYTES) {
+        verbose_printf("Limite de memória dos buffers atingido. Descarregando tudo.\n");
+        return flush_all_dirty_buffers();
+    }
+    return 0;
+}
+
+// --- Funções Principais ---
+
+Inode fs_list_inode() {
+    verbose_printf("Iniciando 'ls' no i-node nº %u\n", current_inode_num);
+    Inode current_inode;
+    if (inode_read(current_inode_num, &current_inode) != 0 || current_inode.type != TYPE_DIR) {
+        Inode empty = {0};
+        return empty;
+    }
+    return current_inode;
+}
+
+FileList fs_list_directory() {
+    return fs_list_path(".");
+}
+
+static FileList list_path_untraced(const char* path) {
+    FileList file_list = {0};
+    int dir_num = namei(path);
+    Inode current_inode;
+    if (dir_num == -1 || inode_read(dir_num, &current_inode) != 0 || current_inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", path);
+        return file_list;
+    }
+    verbose_printf("Iniciando 'ls' no i-node nº %d\n", dir_num);
+    char block_buffer[sb.block_size];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t block_num = current_inode.direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) {
+            fprintf(stderr, "Erro ao ler o bloco de dados do diretório.\n");
+            free(file_list.entries);
+            file_list.entries = NULL;
+            file_list.count = 0;
+            return file_list;
+        }
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (dirent_next(block_buffer, &cur, &entry)) {
+            Inode entry_inode;
+            if(inode_read(entry.inode_num, &entry_inode) == 0) {
+                FileEntry *tmp = realloc(file_list.entries, (file_list.count + 1) * sizeof(FileEntry));
+                if (!tmp) {
+                    fprintf(stderr, "Erro de alocação de memória\n");
+                    free(file_list.entries);
+                    file_list.entries = NULL;
+                    file_list.count = 0;
+                    return file_list;
+                }
+                file_list.entries = tmp;
+                strncpy(file_list.entries[file_list.count].name, entry.name, MAX_FILENAME_LEN);
+                file_list.entries[file_list.count].name[MAX_FILENAME_LEN-1] = '\0';
+                file_list.entries[file_list.count].type = entry_inode.type;
+                file_list.count++;
+            }
+        }
+    }
+    return file_list;
+}
+
+// Cria o diretório 'name' dentro do diretório de i-node 'parent_num'.
+// Retorna o número do novo i-node ou -1 em caso de erro.
+static int create_directory_in(uint32_t parent_num, const char* name) {
+    Inode parent_inode;
+    if (inode_read(parent_num, &parent_inode) != 0) {
+        fprintf(stderr, "Erro ao ler o i-node do diretório atual.\n");
+        return -1;
+    }
+    verbose_printf("Lido i-node pai nº %u\n", parent_num);
+    if (find_in_directory(&parent_inode, name) != -1) {
+        fprintf(stderr, "Erro: Um item com o nome '%s' já existe.\n", name);
+        return -1;
+    }
+    int new_inode_num = alloc_inode(parent_num, 1);
+    if (new_inode_num == -1) {
+        fprintf(stderr, "Erro: Não há i-nodes livres.\n");
+        return -1;
+    }
+    int new_block_num = alloc_block(group_goal_block(new_inode_num));
+    if (new_block_num == -1) {
+        fprintf(stderr, "Erro: Não há blocos de dados livres.\n");
+        free_inode(new_inode_num);
+        return -1;
+    }
+    if (add_entry_to_directory(&parent_inode, parent_num, name, new_inode_num) != 0) {
+        fprintf(stderr, "Erro ao adicionar entrada no diretório pai.\n");
+        free_inode(new_inode_num);
+        free_block(new_block_num);
+        return -1;
+    }
+    verbose_printf("Inicializando i-node %d para o novo diretório.\n", new_inode_num);
+    Inode new_inode;
+    memset(&new_inode, 0, sizeof(Inode));
+    new_inode.type = TYPE_DIR;
+    new_inode.size = empty_directory_size();
+    new_inode.link_count = 2;
+    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
+    for(int i=0; i<INODE_DIRECT_BLOCKS; ++i) new_inode.direct_blocks[i] = 0;
+    new_inode.direct_blocks[0] = new_block_num;
+    if (inode_write(new_inode_num, &new_inode) != 0) { return -1; }
+
+    verbose_printf("Escrevendo '.' e '..' no bloco de dados %d.\n", new_block_num);
+    char block_buffer[sb.block_size];
+    dirent_block_init(block_buffer, new_inode_num, parent_num);
+    if (block_write(new_block_num, block_buffer) != 0) { return -1; }
+    
+    verbose_printf("Atualizando contagem de links do i-node pai %u.\n", parent_num);
+    parent_inode.link_count++;
+    inode_write(parent_num, &parent_inode);
+    return new_inode_num;
+}
+
+static int create_directory_untraced(const char* path) {
+    verbose_printf("Iniciando 'mkdir %s'\n", path);
+    char name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(path, name);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", path);
+        return -1;
+    }
+    return create_directory_in(parent_num, name) == -1 ? -1 : 0;
+}
+
+static int change_directory_untraced(const char* name) {
+    verbose_printf("Iniciando 'cd %s'.\n", name);
+    int target_inode_num = namei(name);
+    if (target_inode_num == -1) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", name);
+        return -1;
+    }
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+    if (target_inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: '%s' não é um diretório.\n", name);
+        return -1;
+    }
+    verbose_printf("Mudando o diretório atual para o i-node %d.\n", target_inode_num);
+    current_inode_num = target_inode_num;
+    return 0;
+}
+
+void fs_get_current_path(char* path_buffer, size_t buffer_size) {
+    if (current_inode_num == 0) {
+        snprintf(path_buffer, buffer_size, "/");
+        return;
+    }
+    char temp_path[buffer_size];
+    temp_path[0] = '\0';
+    uint32_t temp_inode_num = current_inode_num;
+    while (temp_inode_num != 0) {
+        Inode child_inode;
+        if(inode_read(temp_inode_num, &child_inode) != 0) { snprintf(path_buffer, buffer_size, "/<erro>"); return; }
+        int parent_inode_num = find_in_directory(&child_inode, "..");
+        if (parent_inode_num == -1) { snprintf(path_buffer, buffer_size, "/<erro_pai>"); return; }
+        Inode parent_inode;
+        if (inode_read(parent_inode_num, &parent_inode) != 0) { snprintf(path_buffer, buffer_size, "/<erro>"); return; }
+        char current_name[MAX_FILENAME_LEN] = "?";
+        char block_buffer[sb.block_size];
+        int found = 0;
+        for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+             uint32_t block_num = parent_inode.direct_blocks[i];
+             if (block_num == 0) continue;
+             if (block_read(block_num, block_buffer) != 0) continue;
+             DirCursor cur = {0};
+             DirectoryEntry entry;
+             while (dirent_next(block_buffer, &cur, &entry)) {
+                 if(entry.inode_num == temp_inode_num) {
+                     strncpy(current_name, entry.name, MAX_FILENAME_LEN);
+                     found = 1;
+                     break;
+                 }
+             }
+             if(found) break;
+        }
+        char segment[buffer_size];
+        snprintf(segment, buffer_size, "/%s%s", current_name, temp_path);
+        strcpy(temp_path, segment);
+        temp_inode_num = parent_inode_num;
+    }
+    strncpy(path_buffer, temp_path, buffer_size);
+}
+
+static int remove_directory_untraced(const char* path) {
+    verbose_printf("Iniciando 'rmdir %s'.\n", path);
+    char name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(path, name);
+    if (parent_num != -1 && (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)) {
+        fprintf(stderr, "Erro: Não é permitido remover '.' ou '..'.\n");
+        return -1;
+    }
+    Inode parent_inode;
+    int target_inode_num = parent_num == -1 ? -1 : dir_lookup(parent_num, name);
+    if (target_inode_num == -1) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", path);
+        return -1;
+    }
+    if (inode_read(parent_num, &parent_inode) != 0) return -1;
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+    if (target_inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: '%s' não é um diretório.\n", name);
+        return -1;
+    }
+    verbose_printf("Verificando se o diretório (i-node %d) está vazio.\n", target_inode_num);
+    if (target_inode.size > empty_directory_size()) {
+        fprintf(stderr, "Erro: O diretório '%s' não está vazio.\n", path);
+        return -1;
+    }
+    if ((uint32_t) target_inode_num == current_inode_num) {
+        fprintf(stderr, "Erro: Não é possível remover o diretório atual.\n");
+        return -1;
+    }
+    verbose_printf("Removendo entrada '%s' do diretório pai (i-node %d).\n", name, parent_num);
+    if (remove_entry_from_directory(&parent_inode, parent_num, name) != 0) {
+        fprintf(stderr, "Erro ao remover a entrada do diretório pai.\n");
+        return -1;
+    }
+    verbose_printf("Liberando recursos do i-node %d (%u bloco(s) de dados).\n", target_inode_num, directory_blocks(&target_inode));
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        if (target_inode.direct_blocks[i] != 0 && free_block(target_inode.direct_blocks[i]) != 0) return -1;
+    }
+    if (free_inode(target_inode_num) != 0) { return -1; }
+    dcache_forget_dir(target_inode_num);
+    verbose_printf("Decrementando contagem de links do pai %d.\n", parent_num);
+    parent_inode.link_count--;
+    inode_write(parent_num, &parent_inode);
+    return 0;
+}
+
+// Importação para disco com compressão: lê o arquivo inteiro, comprime por
+// cluster e grava só os blocos físicos necessários.
+static int import_compressed(FILE* source_file, long file_size, int new_inode_num, Inode* parent_inode, uint32_t parent_num, const char* dest_name) {
+    char* data = malloc(file_size);
+    if (!data || fread(data, 1, file_size, source_file) != (size_t) file_size) {
+        free(data);
+        free_inode(new_inode_num);
+        fclose(source_file);
+        return -1;
+    }
+    fclose(source_file);
+    Inode new_inode;
+    memset(&new_inode, 0, sizeof(Inode));
+    new_inode.type = TYPE_FILE;
+    new_inode.size = file_size;
+    new_inode.link_count = 1;
+    new_inode.flags = INODE_FLAG_COMPRESSED;
+    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
+    PackedData packed;
+    int rc = pack_clusters(data, file_size, 0, &packed);
+    free(data);
+    if (rc == 0) {
+        verbose_printf("Arquivo comprimido: %u blocos físicos em vez de %u.\n", packed.count, blocks_for_size(file_size));
+        rc = write_packed(&new_inode, &packed, group_goal_block(new_inode_num));
+        free(packed.data);
+    }
+    if (rc != 0) {
+        free_inode(new_inode_num);
+        return -1;
+    }
+    if (inode_write(new_inode_num, &new_inode) != 0) { return -1; }
+    if (add_entry_to_directory(parent_inode, parent_num, dest_name, new_inode_num) != 0) { return -1; }
+    return 0;
+}
+
+static int import_file_untraced(const char* source_path, const char* dest_path) {
+    verbose_printf("Iniciando 'import %s' para '%s'.\n", source_path, dest_path);
+    char dest_name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(dest_path, dest_name);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", dest_path);
+        return -1;
+    }
+    FILE* source_file = fopen(source_path, "rb");
+    if (!source_file) {
+        fprintf(stderr, "Erro: Não foi possível abrir o arquivo de origem '%s'.\n", source_path);
+        return -1;
+    }
+    fseek(source_file, 0, SEEK_END);
+    long file_size = ftell(source_file);
+    fseek(source_file, 0, SEEK_SET);
+    verbose_printf("Arquivo de origem aberto, tamanho: %ld bytes.\n", file_size);
+    Inode parent_inode;
+    if (inode_read(parent_num, &parent_inode) != 0) { fclose(source_file); return -1; }
+    if (find_in_directory(&parent_inode, dest_name) != -1) {
+        fprintf(stderr, "Erro: Um item com o nome '%s' já existe.\n", dest_name);
+        fclose(source_file);
+        return -1;
+    }
+    int new_inode_num = alloc_inode(parent_num, 0);
+    if (new_inode_num == -1) {
+        fprintf(stderr, "Erro: Sem i-nodes livres.\n");
+        fclose(source_file);
+        return -1;
+    }
+    uint32_t num_blocks_needed = blocks_for_size(file_size);
+    verbose_printf("Arquivo necessita de %u blocos de dados%s.\n", num_blocks_needed, fits_inline(file_size) ? " (dados inline no i-node)" : "");
+    if (num_blocks_needed > INODE_DIRECT_BLOCKS) {
+        fprintf(stderr, "Erro: O arquivo é muito grande para os blocos diretos.\n");
+        free_inode(new_inode_num);
+        fclose(source_file);
+        return -1;
+    }
+    if ((sb.features & FEATURE_COMPRESSION) && num_blocks_needed > 0) {
+        return import_compressed(source_file, file_size, new_inode_num, &parent_inode, parent_num, dest_name);
+    }
+    uint32_t allocated_blocks[INODE_DIRECT_BLOCKS];
+    int got = alloc_block_run(num_blocks_needed, group_goal_block(new_inode_num), allocated_blocks);
+    if (got != (int) num_blocks_needed) {
+        fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
+        for (int j = 0; j < got; ++j) { free_block(allocated_blocks[j]); }
+        free_inode(new_inode_num);
+        fclose(source_file);
+        return -1;
+    }
+    verbose_printf("Copiando dados para os blocos alocados...\n");
+    char block_buffer[sb.block_size];
+    for (uint32_t i = 0; i < num_blocks_needed; ++i) {
+        size_t got = fread(block_buffer, 1, sb.block_size, source_file);
+        if (got < sb.block_size) memset(block_buffer + got, 0, sb.block_size - got);
+        if (store_data_block(&allocated_blocks[i], block_buffer, got == sb.block_size) != 0) {
+            for (uint32_t j = 0; j < num_blocks_needed; ++j) { free_block(allocated_blocks[j]); }
+            free_inode(new_inode_num);
+            fclose(source_file);
+            return -1;
+        }
+    }
+    verbose_printf("Inicializando i-node %d para o novo arquivo.\n", new_inode_num);
+    Inode new_inode;
+    memset(&new_inode, 0, sizeof(Inode));
+    new_inode.type = TYPE_FILE;
+    new_inode.size = file_size;
+    new_inode.link_count = 1;
+    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
+    if (fits_inline(file_size) && file_size > 0) {
+        new_inode.flags |= INODE_FLAG_INLINE;
+        if (fread(new_inode.direct_blocks, 1, file_size, source_file) != (size_t) file_size) {
+            free_inode(new_inode_num);
+            fclose(source_file);
+            return -1;
+        }
+    }
+    fclose(source_file);
+    for (uint32_t i = 0; i < num_blocks_needed; ++i) {
+        new_inode.direct_blocks[i] = allocated_blocks[i];
+    }
+    if (inode_write(new_inode_num, &new_inode) != 0) { return -1; }
+    if (add_entry_to_directory(&parent_inode, parent_num, dest_name, new_inode_num) != 0) { return -1; }
+    return 0;
+}
+
+// --- Importação recursiva (import -r) ---
+
+#define IMPORT_BATCH_FILES 64
+#define IMPORT_MAX_THREADS 8
+
+typedef struct {
+    char* host_path;
+    char name[MAX_FILENAME_LEN];
+    int is_dir;
+    int parent;            // Índice do diretório pai na lista (-1 = diretório de destino)
+    uint32_t inode_num;    // I-node atribuído no disco (0 = ainda não criado)
+    char* data;            // Conteúdo lido pelas threads leitoras
+    long size;
+    int read_ok;
+    int compressed;        // 'packed' preenchido pelas threads leitoras
+    PackedData packed;
+} ImportNode;
+
+typedef struct {
+    ImportNode* nodes;
+    size_t count;
+    size_t capacity;
+} ImportList;
+
+typedef struct {
+    ImportNode* nodes;
+    const uint32_t* batch;
+    uint32_t batch_count;
+    uint32_t next;         // Próximo item do lote (incrementado atomicamente)
+    int compress;          // Disco formatado com FEATURE_COMPRESSION
+} ImportReadJob;
+
+static int import_list_push(ImportList* list, const char* host_path, const char* name, int is_dir, int parent) {
+    if (list->count == list->capacity) {
+        size_t new_cap = list->capacity ? list->capacity * 2 : 64;
+        ImportNode* tmp = realloc(list->nodes, new_cap * sizeof(ImportNode));
+        if (!tmp) return -1;
+        list->nodes = tmp;
+        list->capacity = new_cap;
+    }
+    ImportNode* node = &list->nodes[list->count];
+    memset(node, 0, sizeof(ImportNode));
+    node->host_path = strdup(host_path);
+    if (!node->host_path) return -1;
+    strncpy(node->name, name, MAX_FILENAME_LEN);
+    node->name[MAX_FILENAME_LEN-1] = '\0';
+    node->is_dir = is_dir;
+    node->parent = parent;
+    return list->count++;
+}
+
+// Percorre a árvore do host em pré-ordem: cada diretório aparece antes dos seus filhos.
+static int import_collect(ImportList* list, const char* host_dir, int parent) {
+    DIR* dir = opendir(host_dir);
+    if (!dir) {
+        fprintf(stderr, "Erro: Não foi possível abrir o diretório de origem '%s'.\n", host_dir);
+        return -1;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        if (strlen(ent->d_name) >= MAX_FILENAME_LEN) {
+            fprintf(stderr, "Aviso: Nome '%s' é muito longo, ignorado.\n", ent->d_name);
+            continue;
+        }
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", host_dir, ent->d_name);
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            int idx = import_list_push(list, path, ent->d_name, 1, parent);
+            if (idx < 0 || import_collect(list, path, idx) != 0) { closedir(dir); return -1; }
+        } else if (S_ISREG(st.st_mode)) {
+            int idx = import_list_push(list, path, ent->d_name, 0, parent);
+            if (idx < 0) { closedir(dir); return -1; }
+            // O tamanho do lstat deixa as leitoras pularem o que não caberia no i-node
+            list->nodes[idx].size = st.st_size;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+static void* import_reader_thread(void* arg) {
+    ImportReadJob* job = (ImportReadJob*) arg;
+    uint32_t i;
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->batch_count) {
+        ImportNode* node = &job->nodes[job->batch[i]];
+        // Grande demais: nem abre, para não carregar na memória algo que será recusado
+        if (!size_fits_inode(node->size)) continue;
+        FILE* f = fopen(node->host_path, "rb");
+        if (!f) continue;
+        fseek(f, 0, SEEK_END);
+        node->size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (!size_fits_inode(node->size)) {
+            fclose(f);
+            continue;
+        }
+        node->data = malloc(node->size > 0 ? node->size : 1);
+        if (node->data && (node->size == 0 || fread(node->data, 1, node->size, f) == (size_t) node->size)) {
+            node->read_ok = 1;
+        }
+        fclose(f);
+        // A compressão também roda aqui, em paralelo, fora da seção de escrita
+        uint32_t nblocks = blocks_for_size(node->size);
+        if (node->read_ok && job->compress && nblocks > 0 && nblocks <= INODE_DIRECT_BLOCKS) {
+            node->compressed = pack_clusters(node->data, node->size, 0, &node->packed) == 0;
+        }
+    }
+    return NULL;
+}
+
+static void import_release_batch(ImportList* list, const uint32_t* batch, uint32_t batch_count) {
+    for (uint32_t i = 0; i < batch_count; ++i) {
+        free(list->nodes[batch[i]].data);
+        free(list->nodes[batch[i]].packed.data);
+        list->nodes[batch[i]].data = NULL;
+        list->nodes[batch[i]].packed.data = NULL;
+    }
+}
+
+// Lê os arquivos do lote em paralelo e grava os dados no disco.
+static void import_write_batch(ImportList* list, const uint32_t* batch, uint32_t batch_count, uint32_t dest_inode_num, int* failures) {
+    ImportReadJob job = { list->nodes, batch, batch_count, 0, (sb.features & FEATURE_COMPRESSION) != 0 };
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu > 0 ? (int) ncpu : 1;
+    if (nthreads > IMPORT_MAX_THREADS) nthreads = IMPORT_MAX_THREADS;
+    if ((uint32_t) nthreads > batch_count) nthreads = batch_count;
+    pthread_t threads[IMPORT_MAX_THREADS];
+    int started = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        if (pthread_create(&threads[t], NULL, import_reader_thread, &job) == 0) started++;
+    }
+    if (started == 0) import_reader_thread(&job);
+    for (int t = 0; t < started; ++t) pthread_join(threads[t], NULL);
+
+    // Descarta o que não pôde ser lido ou não cabe nos blocos diretos
+    uint32_t valid[IMPORT_BATCH_FILES];
+    uint32_t valid_count = 0, blocks_needed = 0;
+    for (uint32_t i = 0; i < batch_count; ++i) {
+        ImportNode* node = &list->nodes[batch[i]];
+        uint32_t nblocks = node->compressed ? node->packed.count : blocks_for_size(node->size);
+        if (!size_fits_inode(node->size) || nblocks > INODE_DIRECT_BLOCKS) {
+            fprintf(stderr, "Erro: O arquivo '%s' é muito grande para os blocos diretos.\n", node->host_path);
+            (*failures)++;
+        } else if (!node->read_ok) {
+            fprintf(stderr, "Erro: Não foi possível ler '%s'.\n", node->host_path);
+            (*failures)++;
+        } else {
+            valid[valid_count++] = batch[i];
+            blocks_needed += nblocks;
+        }
+    }
+
+    uint32_t inode_nums[IMPORT_BATCH_FILES];
+    uint32_t* block_nums = malloc((blocks_needed ? blocks_needed : 1) * sizeof(uint32_t));
+    // Os lotes seguem a ordem da árvore: o grupo do pai do primeiro arquivo serve para todos
+    int first_parent = valid_count > 0 ? list->nodes[valid[0]].parent : -1;
+    uint32_t batch_parent = first_parent < 0 ? dest_inode_num : list->nodes[first_parent].inode_num;
+    int got_inodes = block_nums ? alloc_inodes_batch(valid_count, batch_parent, inode_nums) : -1;
+    uint32_t goal = got_inodes > 0 ? group_goal_block(inode_nums[0]) : sb.data_blocks_start;
+    int got_blocks = got_inodes >= 0 ? alloc_block_run(blocks_needed, goal, block_nums) : -1;
+    if (got_inodes != (int) valid_count || got_blocks != (int) blocks_needed) {
+        fprintf(stderr, "Erro: Sem i-nodes ou blocos livres para importar o lote.\n");
+        for (int j = 0; j < got_inodes; ++j) free_inode(inode_nums[j]);
+        for (int j = 0; j < got_blocks; ++j) free_block(block_nums[j]);
+        *failures += valid_count;
+        free(block_nums);
+        import_release_batch(list, batch, batch_count);
         return;
     }
-    char temp_path[buffer_size];
-    temp_path[0] = '\0';
-    uint32_t temp_inode_num = current_inode_num;
-    while (temp_inode_num != 0) {
-        Inode child_inode;
-        if(inode_read(temp_inode_num, &child_inode) != 0) { snprintf(path_buffer, buffer_size, "/<erro>"); return; }
-        int parent_inode_num = find_in_directory(&child_inode, "..");
-        if (parent_inode_num == -1) { snprintf(path_buffer, buffer_size, "/<erro_pai>"); return; }
+
+    char block_buffer[sb.block_size];
+    uint32_t next_block = 0;
+    time_t now = time(NULL);
+    for (uint32_t i = 0; i < valid_count; ++i) {
+        ImportNode* node = &list->nodes[valid[i]];
+        Inode new_inode;
+        memset(&new_inode, 0, sizeof(Inode));
+        new_inode.type = TYPE_FILE;
+        new_inode.size = node->size;
+        new_inode.link_count = 1;
+        new_inode.created = new_inode.modified = new_inode.accessed = now;
+        uint32_t nblocks = node->compressed ? 0 : blocks_for_size(node->size);
+        if (fits_inline(node->size) && node->size > 0) {
+            new_inode.flags |= INODE_FLAG_INLINE;
+            memcpy(new_inode.direct_blocks, node->data, node->size);
+        }
+        if (node->compressed) {
+            new_inode.flags |= INODE_FLAG_COMPRESSED;
+            for (uint32_t p = 0; p < node->packed.count; ++p) {
+                new_inode.direct_blocks[node->packed.slot[p]] = block_nums[next_block];
+                block_write(block_nums[next_block++], node->packed.data + (size_t) p * sb.block_size);
+            }
+        }
+        for (uint32_t b = 0; b < nblocks; ++b) {
+            long offset = (long) b * sb.block_size;
+            long chunk = node->size - offset < (long) sb.block_size ? node->size - offset : (long) sb.block_size;
+            memset(block_buffer, 0, sb.block_size);
+            memcpy(block_buffer, node->data + offset, chunk);
+            new_inode.direct_blocks[b] = block_nums[next_block++];
+            store_data_block(&new_inode.direct_blocks[b], block_buffer, chunk == (long) sb.block_size);
+        }
+        node->inode_num = inode_nums[i];
+        inode_write(node->inode_num, &new_inode);
+    }
+    free(block_nums);
+
+    // Agrupa as entradas por diretório pai e insere cada grupo de uma vez
+    char (*names)[MAX_FILENAME_LEN] = malloc(valid_count * MAX_FILENAME_LEN + 1);
+    uint32_t group_inodes[IMPORT_BATCH_FILES];
+    int done[IMPORT_BATCH_FILES] = {0};
+    for (uint32_t i = 0; names && i < valid_count; ++i) {
+        if (done[i]) continue;
+        int parent = list->nodes[valid[i]].parent;
+        uint32_t group_count = 0;
+        uint32_t members[IMPORT_BATCH_FILES];
+        for (uint32_t k = i; k < valid_count; ++k) {
+            if (!done[k] && list->nodes[valid[k]].parent == parent) {
+                memcpy(names[group_count], list->nodes[valid[k]].name, MAX_FILENAME_LEN);
+                group_inodes[group_count] = list->nodes[valid[k]].inode_num;
+                members[group_count++] = k;
+                done[k] = 1;
+            }
+        }
+        uint32_t dir_num = parent < 0 ? dest_inode_num : list->nodes[parent].inode_num;
+        Inode dir_inode;
+        int added = 0;
+        if (inode_read(dir_num, &dir_inode) == 0) {
+            added = add_entries_to_directory(&dir_inode, dir_num, names, group_inodes, group_count);
+            if (added < 0) added = 0;
+        }
+        // Quem não coube no diretório tem os recursos devolvidos
+        for (uint32_t g = added; g < group_count; ++g) {
+            ImportNode* node = &list->nodes[valid[members[g]]];
+            fprintf(stderr, "Erro: Diretório cheio, '%s' não foi importado.\n", node->host_path);
+            Inode lost;
+            if (inode_read(node->inode_num, &lost) == 0 && !inode_is_inline(&lost)) {
+                for (int b = 0; b < INODE_DIRECT_BLOCKS; ++b) {
+                    if (lost.direct_blocks[b] != 0) free_block(lost.direct_blocks[b]);
+                }
+            }
+            free_inode(node->inode_num);
+            node->inode_num = 0;
+            (*failures)++;
+        }
+    }
+    free(names);
+    import_release_batch(list, batch, batch_count);
+}
+
+static int import_tree_untraced(const char* host_dir, const char* dest_path) {
+    verbose_printf("Iniciando 'import -r %s' para '%s'.\n", host_dir, dest_path);
+    char dest_name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(dest_path, dest_name);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", dest_path);
+        return -1;
+    }
+    struct stat st;
+    if (stat(host_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "Erro: '%s' não é um diretório do host.\n", host_dir);
+        return -1;
+    }
+    ImportList list = {0};
+    if (import_collect(&list, host_dir, -1) != 0) {
+        for (size_t i = 0; i < list.count; ++i) free(list.nodes[i].host_path);
+        free(list.nodes);
+        return -1;
+    }
+    verbose_printf("%zu itens encontrados na árvore de origem.\n", list.count);
+
+    int dest_inode_num = create_directory_in(parent_num, dest_name);
+    if (dest_inode_num == -1) {
+        for (size_t i = 0; i < list.count; ++i) free(list.nodes[i].host_path);
+        free(list.nodes);
+        return -1;
+    }
+
+    // Diretórios primeiro, na ordem da lista (pais antes dos filhos)
+    int failures = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        ImportNode* node = &list.nodes[i];
+        if (!node->is_dir) continue;
+        uint32_t parent_num = node->parent < 0 ? (uint32_t) dest_inode_num : list.nodes[node->parent].inode_num;
+        if (node->parent >= 0 && parent_num == 0) { failures++; continue; }
+        int num = create_directory_in(parent_num, node->name);
+        if (num == -1) failures++;
+        else node->inode_num = num;
+    }
+
+    // Arquivos em lotes: leitura paralela, alocação e inserção em bloco
+    uint32_t batch[IMPORT_BATCH_FILES];
+    uint32_t batch_count = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        ImportNode* node = &list.nodes[i];
+        if (node->is_dir) continue;
+        if (node->parent >= 0 && list.nodes[node->parent].inode_num == 0) { failures++; continue; }
+        batch[batch_count++] = i;
+        if (batch_count == IMPORT_BATCH_FILES) {
+            import_write_batch(&list, batch, batch_count, dest_inode_num, &failures);
+            batch_count = 0;
+        }
+    }
+    if (batch_count > 0) import_write_batch(&list, batch, batch_count, dest_inode_num, &failures);
+
+    for (size_t i = 0; i < list.count; ++i) free(list.nodes[i].host_path);
+    free(list.nodes);
+    if (failures > 0) {
+        fprintf(stderr, "Aviso: %d item(ns) não puderam ser importados.\n", failures);
+        return -1;
+    }
+    return 0;
+}
+
+static int remove_file_untraced(const char* path) {
+    verbose_printf("Iniciando 'rm %s'.\n", path);
+    char filename[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(path, filename);
+    int target_inode_num = parent_num == -1 ? -1 : dir_lookup(parent_num, filename);
+    if (target_inode_num == -1) {
+        fprintf(stderr, "Erro: Arquivo '%s' não encontrado.\n", path);
+        return -1;
+    }
+    Inode parent_inode, target_inode;
+    if (inode_read(parent_num, &parent_inode) != 0) return -1;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+    if (target_inode.type != TYPE_FILE) {
+        fprintf(stderr, "Erro: '%s' não é um arquivo. Use 'rmdir' para diretórios.\n", path);
+        return -1;
+    }
+    drop_dirty_buffer(target_inode_num, target_inode.size);
+    verbose_printf("Liberando blocos de dados do i-node %d...\n", target_inode_num);
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(&target_inode); ++i) {
+        uint32_t block_num = target_inode.direct_blocks[i];
+        if (block_num == 0) continue;
+        if (free_block(block_num) != 0) { fprintf(stderr, "Erro crítico ao liberar o bloco de dados %u.\n", block_num); }
+    }
+    verbose_printf("Liberando i-node %d...\n", target_inode_num);
+    if (free_inode(target_inode_num) != 0) { fprintf(stderr, "Erro crítico ao liberar o i-node %d.\n", target_inode_num); }
+    verbose_printf("Removendo entrada '%s' do diretório pai.\n", filename);
+    if (remove_entry_from_directory(&parent_inode, parent_num, filename) != 0) {
+        fprintf(stderr, "Erro ao remover a entrada '%s' do diretório pai.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+static int delete_untraced(const char* name) {
+    int target_inode_num = namei(name);
+    if (target_inode_num == -1) {
+        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", name);
+        return -1;
+    }
+
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+
+    if (target_inode.type == TYPE_FILE) {
+        return fs_remove_file(name);
+    } else if (target_inode.type == TYPE_DIR) {
+        if (dir_is_within(current_inode_num, target_inode_num)) {
+            fprintf(stderr, "Erro: '%s' contém o diretório atual.\n", name);
+            return -1;
+        }
+        // Remove o conteúdo pelo caminho completo, sem mudar o diretório atual
+        FileList contents = fs_list_path(name);
+        size_t child_len = strlen(name) + MAX_FILENAME_LEN + 2;
+        char* child = malloc(child_len);
+        for (size_t i = 0; i < contents.count && child; ++i) {
+            if (strcmp(contents.entries[i].name, ".") == 0 || strcmp(contents.entries[i].name, "..") == 0)
+                continue;
+
+            snprintf(child, child_len, "%s/%s", name, contents.entries[i].name);
+            fs_delete(child);
+        }
+        free(child);
+        free(contents.entries);
+
+        return fs_remove_directory(name);
+    }
+
+    return -1;
+}
+
+static int rename_untraced(const char* old_path, const char* new_path) {
+    verbose_printf("Iniciando 'rename %s' para '%s'.\n", old_path, new_path);
+    // O novo nome pode vir como caminho, desde que no mesmo diretório
+    char old_name[MAX_FILENAME_LEN], new_name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(old_path, old_name);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", old_path);
+        return -1;
+    }
+    if (strchr(new_path, '/')) {
+        if (namei_parent(new_path, new_name) != parent_num) {
+            fprintf(stderr, "Erro: 'rename' não muda o diretório do item. Use 'mv'.\n");
+            return -1;
+        }
+    } else if (strlen(new_path) >= MAX_FILENAME_LEN) {
+        fprintf(stderr, "Erro: Novo nome é muito longo.\n");
+        return -1;
+    } else {
+        strcpy(new_name, new_path);
+    }
+    if (strcmp(old_name, ".") == 0 || strcmp(old_name, "..") == 0 || strcmp(new_name, ".") == 0 || strcmp(new_name, "..") == 0) {
+        fprintf(stderr, "Erro: Não é permitido renomear '.' ou '..'.\n");
+        return -1;
+    }
+    Inode parent_inode;
+    if (inode_read(parent_num, &parent_inode) != 0) return -1;
+    if (find_in_directory(&parent_inode, old_name) == -1) {
+        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", old_path);
+        return -1;
+    }
+    if (find_in_directory(&parent_inode, new_name) != -1) {
+        fprintf(stderr, "Erro: Já existe um item com o nome '%s'.\n", new_name);
+        return -1;
+    }
+    verbose_printf("Modificando entrada no bloco de dados do diretório pai (i-node %d).\n", parent_num);
+    char block_buffer[sb.block_size];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t block_num = parent_inode.direct_blocks[i];
+        if (block_num == 0) continue;
+        if (block_read(block_num, block_buffer) != 0) return -1;
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (dirent_next(block_buffer, &cur, &entry)) {
+            if (strcmp(entry.name, old_name) != 0) continue;
+            uint32_t old_size = cur.next - cur.pos;
+            dirent_remove(block_buffer, &cur);
+            if (dirent_add(block_buffer, new_name, entry.inode_num) != 0) {
+                // Registros compactos: o nome maior não cabe mais neste bloco e a entrada muda de lugar
+                verbose_printf("Nome novo não cabe no bloco %u: movendo a entrada.\n", block_num);
+                if (remove_entry_from_directory(&parent_inode, parent_num, old_name) != 0) return -1;
+                if (add_entry_to_directory(&parent_inode, parent_num, new_name, entry.inode_num) != 0) {
+                    if (add_entry_to_directory(&parent_inode, parent_num, old_name, entry.inode_num) != 0) {
+                        fprintf(stderr, "Erro crítico: A entrada '%s' foi perdida; execute 'fsck'.\n", old_name);
+                    }
+                    return -1;
+                }
+            } else {
+                if (block_write(block_num, block_buffer) != 0) {
+                    fprintf(stderr, "Erro ao escrever as alterações no disco.\n");
+                    return -1;
+                }
+                parent_inode.size = parent_inode.size - old_size + dirent_size(new_name);
+                name_index_set(entry.inode_num, parent_num, new_name);
+                dcache_forget(parent_num, old_name);
+            }
+            parent_inode.modified = time(NULL);
+            inode_write(parent_num, &parent_inode);
+            return 0;
+        }
+    }
+    fprintf(stderr, "Erro: Inconsistência encontrada ao tentar renomear.\n");
+    return -1;
+}
+
+static Inode stat_item_untraced(const char* name) {
+    verbose_printf("Iniciando 'stat %s'.\n", name);
+    int target_inode_num = namei(name);
+    if (target_inode_num == -1) {
+        return (Inode){0}; // Retorna um i-node vazio se não encontrado
+    }
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return (Inode){0};
+    DirtyBuffer* pending = find_dirty_buffer(target_inode_num);
+    if (pending) target_inode.size += pending->len;
+    return target_inode;
+}
+
+static DiskUsageInfo disk_free_untraced(void) {
+    verbose_printf("Iniciando 'df'.\n");
+    uint32_t used_inodes = count_set_bits(sb.inode_bitmap_start, sb.total_inodes);
+    uint32_t used_blocks = count_set_bits(sb.block_bitmap_start, sb.total_blocks);
+    if (used_inodes == (uint32_t)-1 || used_blocks == (uint32_t)-1) {
+        fprintf(stderr, "Erro ao ler bitmaps do disco.\n");
+        return (DiskUsageInfo){0};
+    }
+    uint32_t free_inodes = sb.total_inodes - used_inodes;
+    uint32_t free_blocks = sb.total_blocks - used_blocks;
+    uint64_t total_kb = ((uint64_t) sb.total_blocks * sb.block_size) / 1024;
+    uint64_t used_kb = ((uint64_t) used_blocks * sb.block_size) / 1024;
+    uint64_t free_kb = ((uint64_t) free_blocks * sb.block_size) / 1024;
+    uint32_t logical_blocks = used_blocks;
+    for (uint32_t b = sb.data_blocks_start; b < sb.total_blocks && refcount_table.data; ++b) logical_blocks += block_refcounts()[b];
+    return (DiskUsageInfo){
+        .total_inodes = sb.total_inodes,
+        .used_inodes = used_inodes,
+        .free_inodes = free_inodes,
+        .total_blocks = sb.total_blocks,
+        .used_blocks = used_blocks,
+        .free_blocks = free_blocks,
+        .total_kb = total_kb,
+        .used_kb = used_kb,
+        .free_kb = free_kb,
+        .logical_blocks = logical_blocks,
+        .logical_kb = ((uint64_t) logical_blocks * sb.block_size) / 1024
+    };
+
+}
+
+// Recalcula a entrada de uso de 'inode_num' e de tudo abaixo dele em 'table'
+// (zerada antes da primeira chamada), lendo a árvore do disco. Com 'names',
+// preenche também o índice de nomes da subárvore.
+static int usage_compute(uint32_t inode_num, uint32_t parent, UsageEntry* table, NameEntry* names) {
+    Inode inode;
+    if (inode_read(inode_num, &inode) != 0) return -1;
+    UsageEntry* entry = &table[inode_num];
+    entry->own_bytes = inode.type == TYPE_FILE ? inode.size : 0;
+    entry->own_blocks = count_data_blocks(&inode);
+    entry->bytes = entry->own_bytes;
+    entry->blocks = entry->own_blocks;
+    entry->entries = 1;
+    entry->parent = parent;
+    if (inode.type != TYPE_DIR) return 0;
+    char block_buffer[sb.block_size];
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        if (inode.direct_blocks[i] == 0) continue;
+        if (block_read(inode.direct_blocks[i], block_buffer) != 0) return -1;
+        DirCursor cur = {0};
+        DirectoryEntry dir_entry;
+        while (dirent_next(block_buffer, &cur, &dir_entry)) {
+            uint32_t child = dir_entry.inode_num;
+            if (strcmp(dir_entry.name, ".") == 0 || strcmp(dir_entry.name, "..") == 0) continue;
+            // Entradas inválidas ou repetidas (ciclos) ficam para o fsck
+            if (child >= sb.total_inodes || table[child].entries != 0) continue;
+            if (names) {
+                strncpy(names[child].name, dir_entry.name, MAX_FILENAME_LEN);
+                names[child].name[MAX_FILENAME_LEN - 1] = '\0';
+                names[child].parent = inode_num;
+            }
+            if (usage_compute(child, inode_num, table, names) != 0) return -1;
+            entry->bytes += table[child].bytes;
+            entry->blocks += table[child].blocks;
+            entry->entries += table[child].entries;
+        }
+    }
+    return 0;
+}
+
+static int dir_usage_untraced(const char* path, DirUsage* usage) {
+    verbose_printf("Iniciando 'du %s'.\n", path);
+    int inode_num = namei(path);
+    if (inode_num == -1) {
+        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", path);
+        return -1;
+    }
+    // Dados adiados ainda não estão no tamanho nem nos blocos dos i-nodes
+    if (flush_all_dirty_buffers() != 0) return -1;
+    UsageEntry entry;
+    if (usage_table.data) {
+        entry = *usage_entry(inode_num);
+    } else {
+        verbose_printf("Disco sem tabela de uso: percorrendo a subárvore.\n");
+        UsageEntry* table = calloc(sb.total_inodes, sizeof(UsageEntry));
+        if (!table) return -1;
+        int rc = usage_compute(inode_num, USAGE_UNLINKED, table, NULL);
+        entry = table[inode_num];
+        free(table);
+        if (rc != 0) return -1;
+    }
+    usage->bytes = entry.bytes;
+    usage->blocks = entry.blocks;
+    usage->kb = (uint64_t) entry.blocks * sb.block_size / 1024;
+    usage->entries = entry.entries - 1;
+    return 0;
+}
+
+int fs_check_item_type(const char* name) {
+    int target_inode_num = namei(name);
+    if (target_inode_num == -1) return -1;
+    
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+    
+    return target_inode.type;
+}
+
+
+// Cria um arquivo vazio no diretório 'parent_num'. Retorna o número do i-node ou -1.
+static int create_empty_file(Inode* parent_inode, uint32_t parent_num, const char* filename) {
+    int new_inode_num = alloc_inode(parent_num, 0);
+    if (new_inode_num == -1) return -1;
+    Inode new_inode;
+    memset(&new_inode, 0, sizeof(Inode));
+    new_inode.type = TYPE_FILE;
+    new_inode.link_count = 1;
+    if (sb.features & FEATURE_COMPRESSION) new_inode.flags |= INODE_FLAG_COMPRESSED;
+    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
+    if (inode_write(new_inode_num, &new_inode) != 0) {
+        free_inode(new_inode_num);
+        return -1;
+    }
+    if (add_entry_to_directory(parent_inode, parent_num, filename, new_inode_num) != 0) {
+        free_inode(new_inode_num);
+        return -1;
+    }
+    return new_inode_num;
+}
+
+static int write_file_untraced(const char* path, const char* text, const char* op) {
+    verbose_printf("Iniciando 'echo' para o arquivo '%s' (operação: %s)\n", path, op);
+    char filename[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(path, filename);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", path);
+        return -1;
+    }
+    int target_inode_num = dir_lookup(parent_num, filename);
+    if (strcmp(op, ">") == 0 && target_inode_num != -1) {
+        verbose_printf("Arquivo '%s' existe. Removendo para sobrescrever.\n", filename);
+        if (fs_remove_file(path) != 0) {
+            fprintf(stderr, "Erro ao tentar sobrescrever o arquivo existente.\n");
+            return -1;
+        }
+        target_inode_num = -1;
+    }
+    if (target_inode_num == -1) {
+        verbose_printf("Arquivo '%s' não existe. Criando novo arquivo.\n", filename);
+        // Lido só agora: a remoção acima altera o tamanho do pai
         Inode parent_inode;
-        if (inode_read(parent_inode_num, &parent_inode) != 0) { snprintf(path_buffer, buffer_size, "/<erro>"); return; }
-        char current_name[MAX_FILENAME_LEN] = "?";
+        if (inode_read(parent_num, &parent_inode) != 0) return -1;
+        target_inode_num = create_empty_file(&parent_inode, parent_num, filename);
+        if (target_inode_num == -1) return -1;
+    }
+    Inode target_inode;
+    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+    if(target_inode.type == TYPE_DIR) {
+        fprintf(stderr, "Erro: Não é possível escrever em um diretório.\n");
+        return -1;
+    }
+    target_inode.modified = target_inode.accessed = time(NULL);
+    inode_write(target_inode_num, &target_inode);
+    return delalloc_append(target_inode_num, &target_inode, text, strlen(text));
+}
+
+static int sync_untraced(void) {
+    verbose_printf("Iniciando 'sync'.\n");
+    int rc = flush_all_dirty_buffers();
+    if (meta_tables_store() != 0 || checksum_store() != 0) rc = -1;
+    if (disk_file) fflush(disk_file);
+    return rc;
+}
+
+static int move_item_untraced(const char* source_path, const char* dest_dir_name) {
+    verbose_printf("Iniciando 'mv %s' para '%s'.\n", source_path, dest_dir_name);
+    char source_name[MAX_FILENAME_LEN];
+    int source_parent_num = namei_parent(source_path, source_name);
+    if (source_parent_num != -1 && (strcmp(source_name, ".") == 0 || strcmp(source_name, "..") == 0)) {
+        fprintf(stderr, "Erro: Não é permitido mover '.' ou '..'.\n");
+        return -1;
+    }
+    Inode current_dir_inode;
+    int source_inode_num = source_parent_num == -1 ? -1 : dir_lookup(source_parent_num, source_name);
+    if (source_inode_num == -1) {
+        fprintf(stderr, "Erro: Item de origem '%s' não encontrado.\n", source_path);
+        return -1;
+    }
+    if (inode_read(source_parent_num, &current_dir_inode) != 0) return -1;
+    int dest_dir_inode_num = namei(dest_dir_name);
+    if (dest_dir_inode_num == -1) {
+        fprintf(stderr, "Erro: Diretório de destino '%s' não encontrado.\n", dest_dir_name);
+        return -1;
+    }
+    Inode source_inode, dest_dir_inode;
+    if (inode_read(source_inode_num, &source_inode) != 0) return -1;
+    if (inode_read(dest_dir_inode_num, &dest_dir_inode) != 0) return -1;
+    if (dest_dir_inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: O destino '%s' não é um diretório.\n", dest_dir_name);
+        return -1;
+    }
+    if (source_inode.type == TYPE_DIR && dir_is_within(dest_dir_inode_num, source_inode_num)) {
+        fprintf(stderr, "Erro: Não é possível mover '%s' para dentro de si mesmo.\n", source_path);
+        return -1;
+    }
+    if (find_in_directory(&dest_dir_inode, source_name) != -1) {
+        fprintf(stderr, "Erro: Já existe um item com o nome '%s' no destino.\n", source_name);
+        return -1;
+    }
+    verbose_printf("Movendo i-node %d para o diretório de destino (i-node %d).\n", source_inode_num, dest_dir_inode_num);
+    if (add_entry_to_directory(&dest_dir_inode, dest_dir_inode_num, source_name, source_inode_num) != 0) { return -1; }
+    if (source_inode.type == TYPE_DIR) {
+        verbose_printf("Item movido é um diretório. Atualizando sua entrada '..'.\n");
         char block_buffer[sb.block_size];
-        int found = 0;
-        for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-             uint32_t block_num = parent_inode.direct_blocks[i];
-             if (block_num == 0) continue;
-             block_read(block_num, block_buffer);
-             DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-             int num_entries = sb.block_size / sizeof(DirectoryEntry);
-             for (int j = 0; j < num_entries; ++j) {
-                 if(entry[j].inode_num == temp_inode_num) {
-                     strncpy(current_name, entry[j].name, MAX_FILENAME_LEN);
-                     found = 1;
-                     break;
-                 }
-             }
-             if(found) break;
+        if(block_read(source_inode.direct_blocks[0], block_buffer) != 0) return -1;
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (dirent_next(block_buffer, &cur, &entry)) {
+            if (strcmp(entry.name, "..") == 0) {
+                dirent_set_inode(block_buffer, &cur, dest_dir_inode_num);
+                break;
+            }
         }
-        char segment[buffer_size];
-        snprintf(segment, buffer_size, "/%s%s", current_name, temp_path);
-        strcpy(temp_path, segment);
-        temp_inode_num = parent_inode_num;
+        if(block_write(source_inode.direct_blocks[0], block_buffer) != 0) return -1;
+        dcache_forget(source_inode_num, "..");
+        verbose_printf("Atualizando contagem de links dos diretórios pai (antigo: %d, novo: %d).\n", source_parent_num, dest_dir_inode_num);
+        current_dir_inode.link_count--;
+        dest_dir_inode.link_count++;
+        inode_write(source_parent_num, &current_dir_inode);
+        inode_write(dest_dir_inode_num, &dest_dir_inode);
     }
-    strncpy(path_buffer, temp_path, buffer_size);
+    if (remove_entry_from_directory(&current_dir_inode, source_parent_num, source_name) != 0) {
+        fprintf(stderr, "Erro crítico: O item foi copiado para o destino, mas falhou ao ser removido da origem.\n");
+        return -1;
+    }
+    return 0;
 }
 
-int fs_remove_directory(const char* name) {
-    verbose_printf("Iniciando 'rmdir %s'.\n", name);
-    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
-        fprintf(stderr, "Erro: Não é permitido remover '.' ou '..'.\n");
-        return -1;
+// Entrega o conteúdo do arquivo em pedaços para 'cb', sem montar tudo em
+// memória: inline de uma vez, clusters comprimidos descomprimidos um a um,
+// blocos crus um a um e, por fim, os dados ainda pendentes em memória.
+// Repassa a 'cb' só a parte de cada trecho que cai em [start, end) do arquivo.
+typedef struct {
+    uint64_t pos;   // Posição no arquivo do próximo trecho
+    uint64_t start;
+    uint64_t end;
+    FsReadCallback cb;
+    void* ctx;
+} StreamRange;
+
+static int stream_range_chunk(StreamRange* r, const char* data, size_t len) {
+    uint64_t from = r->pos, to = r->pos + len;
+    r->pos = to;
+    if (to <= r->start || from >= r->end) return 0;
+    uint64_t skip = r->start > from ? r->start - from : 0;
+    uint64_t stop = r->end < to ? r->end - from : len;
+    return r->cb(data + skip, stop - skip, r->ctx);
+}
+
+// Entrega o trecho [offset, offset + len) do conteúdo lógico do arquivo
+// (dados no disco seguidos do buffer pendente). Blocos e clusters antes do
+// deslocamento não são lidos, e a leitura para no fim do trecho.
+static int stream_inode_range(const Inode* inode, uint32_t inode_num, uint64_t offset, uint64_t len, FsReadCallback cb, void* ctx) {
+    StreamRange r = { 0, offset, len > UINT64_MAX - offset ? UINT64_MAX : offset + len, cb, ctx };
+    if (inode_is_inline(inode)) {
+        if (inode->size > 0 && stream_range_chunk(&r, (const char*) inode->direct_blocks, inode->size) != 0) return -1;
+    } else if (inode_is_compressed(inode)) {
+        char* cluster = malloc(cluster_bytes());
+        if (!cluster) return -1;
+        uint32_t clusters = (inode->size + cluster_bytes() - 1) / cluster_bytes();
+        uint32_t first = offset / cluster_bytes() < clusters ? offset / cluster_bytes() : clusters;
+        r.pos = (uint64_t) first * cluster_bytes();
+        for (uint32_t k = first; k < clusters && r.pos < r.end; ++k) {
+            int n = read_cluster(inode, inode->size, k, cluster);
+            if (n < 0 || stream_range_chunk(&r, cluster, n) != 0) {
+                free(cluster);
+                return -1;
+            }
+        }
+        free(cluster);
+    } else {
+        // Blocos consecutivos no disco são lidos numa só requisição
+        char* run_buffer = malloc((size_t) INODE_DIRECT_BLOCKS * sb.block_size);
+        if (!run_buffer) return -1;
+        uint32_t nblocks = blocks_for_size(inode->size);
+        uint32_t i = offset / sb.block_size < nblocks ? offset / sb.block_size : nblocks;
+        r.pos = (uint64_t) i * sb.block_size;
+        while (i < nblocks && i < INODE_DIRECT_BLOCKS && r.pos < r.end) {
+            uint32_t block_num = inode->direct_blocks[i];
+            uint32_t run = 1;
+            if (block_num == 0) {
+                // Buraco: lido como zeros, sem I/O
+                memset(run_buffer, 0, sb.block_size);
+            } else {
+                while (i + run < nblocks && inode->direct_blocks[i + run] == block_num + run &&
+                       r.pos + (uint64_t) run * sb.block_size < r.end) run++;
+                if (blocks_read(block_num, run, run_buffer) != 0) {
+                    fprintf(stderr, "Erro ao ler bloco de dados do arquivo.\n");
+                    free(run_buffer);
+                    return -1;
+                }
+            }
+            uint64_t run_bytes = (uint64_t) run * sb.block_size;
+            uint64_t bytes_left_to_read = inode->size - r.pos;
+            size_t bytes_to_copy = bytes_left_to_read > run_bytes ? run_bytes : bytes_left_to_read;
+            if (stream_range_chunk(&r, run_buffer, bytes_to_copy) != 0) {
+                free(run_buffer);
+                return -1;
+            }
+            i += run;
+        }
+        free(run_buffer);
     }
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
-    int target_inode_num = find_in_directory(&parent_inode, name);
+    r.pos = inode->size;
+    DirtyBuffer* pending = find_dirty_buffer(inode_num);
+    if (pending && pending->len > 0 && r.pos < r.end && stream_range_chunk(&r, pending->data, pending->len) != 0) return -1;
+    return 0;
+}
+
+static int stream_inode_data(const Inode* inode, uint32_t inode_num, FsReadCallback cb, void* ctx) {
+    return stream_inode_range(inode, inode_num, 0, UINT64_MAX, cb, ctx);
+}
+
+static int open_file_for_read(const char* filename, Inode* target_inode) {
+    int target_inode_num = namei(filename);
     if (target_inode_num == -1) {
-        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", name);
+        fprintf(stderr, "Erro: Arquivo '%s' não encontrado.\n", filename);
+        return -1;
+    }
+    if (inode_read(target_inode_num, target_inode) != 0) return -1;
+    if (target_inode->type != TYPE_FILE) {
+        fprintf(stderr, "Erro: '%s' não é um arquivo.\n", filename);
         return -1;
     }
+    return target_inode_num;
+}
+
+static void touch_accessed(uint32_t inode_num, Inode* inode) {
+    verbose_printf("Atualizando timestamp de acesso do i-node %u.\n", inode_num);
+    inode->accessed = time(NULL);
+    inode_write(inode_num, inode);
+}
+
+static int stream_file_untraced(const char* filename, uint64_t offset, uint64_t len, FsReadCallback cb, void* ctx) {
+    verbose_printf("Iniciando leitura em fluxo de '%s' (a partir do byte %llu).\n", filename, (unsigned long long) offset);
     Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
-    if (target_inode.type != TYPE_DIR) {
-        fprintf(stderr, "Erro: '%s' não é um diretório.\n", name);
+    int target_inode_num = open_file_for_read(filename, &target_inode);
+    if (target_inode_num == -1) return -1;
+    if (stream_inode_range(&target_inode, target_inode_num, offset, len, cb, ctx) != 0) return -1;
+    touch_accessed(target_inode_num, &target_inode);
+    return 0;
+}
+
+typedef struct {
+    char* content;
+    size_t offset;
+} ReadAllContext;
+
+static int read_all_chunk(const char* data, size_t len, void* ctx) {
+    ReadAllContext* rc = ctx;
+    memcpy(rc->content + rc->offset, data, len);
+    rc->offset += len;
+    return 0;
+}
+
+static char* read_file_untraced(const char* filename) {
+    verbose_printf("Iniciando 'cat %s'.\n", filename);
+
+    Inode target_inode;
+    int target_inode_num = open_file_for_read(filename, &target_inode);
+    if (target_inode_num == -1) return NULL;
+
+    DirtyBuffer* pending = find_dirty_buffer(target_inode_num);
+    size_t pending_len = pending ? pending->len : 0;
+    verbose_printf("Lendo %llu bytes do arquivo (i-node %d), mais %zu bytes pendentes em memória.\n", (unsigned long long) target_inode.size, target_inode_num, pending_len);
+
+    char* content = malloc(target_inode.size + pending_len + 1); // +1 para o '\0'
+    if (!content) {
+        fprintf(stderr, "Erro de alocação de memória.\n");
+        return NULL;
+    }
+    ReadAllContext ctx = { content, 0 };
+    if (stream_inode_data(&target_inode, target_inode_num, read_all_chunk, &ctx) != 0) {
+        free(content);
+        return NULL;
+    }
+    content[ctx.offset] = '\0'; // Garantir terminação nula
+
+    touch_accessed(target_inode_num, &target_inode);
+    return content;
+}
+
+static int compress_file_untraced(const char* filename) {
+    verbose_printf("Iniciando 'compress %s'.\n", filename);
+    Inode inode;
+    int inode_num = open_file_for_read(filename, &inode);
+    if (inode_num == -1) return -1;
+    DirtyBuffer* pending = find_dirty_buffer(inode_num);
+    if (pending) {
+        if (flush_dirty_buffer(pending) != 0) return -1;
+        if (inode_read(inode_num, &inode) != 0) return -1;
+    }
+    if (!(sb.features & FEATURE_INLINE_DATA)) {
+        // Discos antigos não têm o campo de flags no i-node
+        fprintf(stderr, "Erro: Este disco não suporta arquivos comprimidos. Formate-o novamente.\n");
         return -1;
     }
-    verbose_printf("Verificando se o diretório (i-node %d) está vazio.\n", target_inode_num);
-    if (target_inode.size > sizeof(DirectoryEntry) * 2) {
-        fprintf(stderr, "Erro: O diretório '%s' não está vazio.\n", name);
+    if (inode_is_compressed(&inode)) {
+        fprintf(stderr, "Erro: '%s' já está comprimido.\n", filename);
         return -1;
     }
-    verbose_printf("Removendo entrada '%s' do diretório pai (i-node %u).\n", name, current_inode_num);
-    if (remove_entry_from_directory(&parent_inode, current_inode_num, name) != 0) {
-        fprintf(stderr, "Erro ao remover a entrada do diretório pai.\n");
+    if (inode_is_inline(&inode) || inode.size == 0) {
+        // Sem blocos de dados; só marca para que as próximas escritas sejam comprimidas
+        inode.flags |= INODE_FLAG_COMPRESSED;
+        return inode_write(inode_num, &inode);
+    }
+    char* content = malloc(inode.size);
+    if (!content) return -1;
+    ReadAllContext ctx = { content, 0 };
+    if (stream_inode_data(&inode, inode_num, read_all_chunk, &ctx) != 0) {
+        free(content);
         return -1;
     }
-    uint32_t target_block_num = target_inode.direct_blocks[0];
-    verbose_printf("Liberando recursos do i-node %d (bloco de dados %u).\n", target_inode_num, target_block_num);
-    if (free_block(target_block_num) != 0) { return -1; }
-    if (free_inode(target_inode_num) != 0) { return -1; }
-    verbose_printf("Decrementando contagem de links do pai %u.\n", current_inode_num);
-    parent_inode.link_count--;
-    inode_write(current_inode_num, &parent_inode);
+    PackedData packed;
+    int rc = pack_clusters(content, inode.size, 0, &packed);
+    free(content);
+    if (rc != 0) return -1;
+    // Os blocos novos são gravados antes de liberar os antigos: uma falha no
+    // meio do caminho deixa o arquivo original intacto.
+    Inode compressed = inode;
+    memset(compressed.direct_blocks, 0, sizeof(compressed.direct_blocks));
+    compressed.flags |= INODE_FLAG_COMPRESSED;
+    rc = write_packed(&compressed, &packed, group_goal_block(inode_num));
+    uint32_t physical = packed.count;
+    free(packed.data);
+    if (rc != 0) return -1;
+    if (inode_write(inode_num, &compressed) != 0) return -1;
+    uint32_t old_blocks = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        if (inode.direct_blocks[i] != 0) {
+            free_block(inode.direct_blocks[i]);
+            old_blocks++;
+        }
+    }
+    verbose_printf("Arquivo '%s' comprimido: %u -> %u blocos.\n", filename, old_blocks, physical);
     return 0;
 }
 
-int fs_import_file(const char* source_path, const char* dest_name) {
-    verbose_printf("Iniciando 'import %s' para '%s'.\n", source_path, dest_name);
-    FILE* source_file = fopen(source_path, "rb");
-    if (!source_file) {
-        fprintf(stderr, "Erro: Não foi possível abrir o arquivo de origem '%s'.\n", source_path);
+static int is_zero(const char* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) if (data[i] != 0) return 0;
+    return 1;
+}
+
+// Grava 'len' bytes como conteúdo de um i-node recém-criado: inline, em
+// clusters comprimidos (se 'new_inode' já tiver a flag) ou em blocos crus,
+// procurando espaço a partir de 'goal'.
+static int write_file_content(Inode* new_inode, const char* data, size_t len, uint32_t goal) {
+    new_inode->size = len;
+    if (len == 0) return 0;
+    if (fits_inline(len)) {
+        new_inode->flags |= INODE_FLAG_INLINE;
+        memcpy(new_inode->direct_blocks, data, len);
+        return 0;
+    }
+    if (inode_is_compressed(new_inode)) {
+        PackedData packed;
+        if (pack_clusters(data, len, 0, &packed) != 0) return -1;
+        int rc = write_packed(new_inode, &packed, goal);
+        free(packed.data);
+        return rc;
+    }
+    uint32_t nblocks = blocks_for_size(len);
+    uint32_t blocks[INODE_DIRECT_BLOCKS];
+    int got = alloc_block_run(nblocks, goal, blocks);
+    if (got != (int) nblocks) {
+        for (int i = 0; i < got; ++i) free_block(blocks[i]);
+        fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
+        return -1;
+    }
+    char block_buffer[sb.block_size];
+    for (uint32_t i = 0; i < nblocks; ++i) {
+        size_t offset = (size_t) i * sb.block_size;
+        size_t chunk = len - offset < sb.block_size ? len - offset : sb.block_size;
+        memset(block_buffer, 0, sb.block_size);
+        memcpy(block_buffer, data + offset, chunk);
+        if (is_zero(block_buffer, chunk)) {
+            // Bloco todo zerado (ex.: buraco da origem): a cópia também fica esparsa
+            free_block(blocks[i]);
+            blocks[i] = 0;
+        } else if (store_data_block(&blocks[i], block_buffer, chunk == sb.block_size) != 0) {
+            for (uint32_t j = 0; j < nblocks; ++j) if (blocks[j] != 0) free_block(blocks[j]);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < nblocks; ++i) new_inode->direct_blocks[i] = blocks[i];
+    return 0;
+}
+
+static int copy_file_untraced(const char* source_name, const char* dest_path, int reflink) {
+    verbose_printf("Iniciando 'cp%s %s %s'.\n", reflink ? " --reflink" : "", source_name, dest_path);
+    Inode source;
+    int source_num = open_file_for_read(source_name, &source);
+    if (source_num == -1) return -1;
+    char dest_name[MAX_FILENAME_LEN];
+    int parent_num = namei_parent(dest_path, dest_name);
+    if (parent_num == -1) {
+        fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", dest_path);
         return -1;
     }
-    fseek(source_file, 0, SEEK_END);
-    long file_size = ftell(source_file);
-    fseek(source_file, 0, SEEK_SET);
-    verbose_printf("Arquivo de origem aberto, tamanho: %ld bytes.\n", file_size);
     Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) { fclose(source_file); return -1; }
+    if (inode_read(parent_num, &parent_inode) != 0) return -1;
     if (find_in_directory(&parent_inode, dest_name) != -1) {
         fprintf(stderr, "Erro: Um item com o nome '%s' já existe.\n", dest_name);
-        fclose(source_file);
         return -1;
     }
-    int new_inode_num = alloc_inode();
+    if (reflink && !refcount_table.data) {
+        fprintf(stderr, "Erro: Este disco não suporta blocos compartilhados (--reflink). Formate-o novamente.\n");
+        return -1;
+    }
+    // Os dados pendentes da origem precisam estar no disco antes de copiar ou compartilhar
+    DirtyBuffer* pending = find_dirty_buffer(source_num);
+    if (pending) {
+        if (flush_dirty_buffer(pending) != 0) return -1;
+        if (inode_read(source_num, &source) != 0) return -1;
+    }
+
+    int new_inode_num = alloc_inode(parent_num, 0);
     if (new_inode_num == -1) {
         fprintf(stderr, "Erro: Sem i-nodes livres.\n");
-        fclose(source_file);
         return -1;
     }
-    uint32_t num_blocks_needed = (file_size + sb.block_size - 1) / sb.block_size;
-    verbose_printf("Arquivo necessita de %u blocos de dados.\n", num_blocks_needed);
-    if (num_blocks_needed > INODE_DIRECT_BLOCKS) {
-        fprintf(stderr, "Erro: O arquivo é muito grande para os blocos diretos.\n");
+    Inode copy;
+    memset(&copy, 0, sizeof(Inode));
+    copy.type = TYPE_FILE;
+    copy.link_count = 1;
+    copy.flags = source.flags & INODE_FLAG_COMPRESSED;
+    copy.created = copy.modified = copy.accessed = time(NULL);
+    if (reflink) {
+        // Só metadados: o clone aponta para os mesmos blocos, que ganham uma referência cada
+        copy.flags = source.flags;
+        copy.size = source.size;
+        memcpy(copy.direct_blocks, source.direct_blocks, sizeof(copy.direct_blocks));
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(&source); ++i) {
+            if (source.direct_blocks[i] == 0) continue;
+            if (refcount_inc(source.direct_blocks[i]) != 0) {
+                for (int j = 0; j < i; ++j) if (source.direct_blocks[j] != 0) free_block(source.direct_blocks[j]);
+                free_inode(new_inode_num);
+                return -1;
+            }
+        }
+        verbose_printf("Clone do i-node %d criado no i-node %d compartilhando os blocos.\n", source_num, new_inode_num);
+    } else {
+        char* content = malloc(source.size ? source.size : 1);
+        ReadAllContext ctx = { content, 0 };
+        int rc = content ? stream_inode_data(&source, source_num, read_all_chunk, &ctx) : -1;
+        if (rc == 0) rc = write_file_content(&copy, content, source.size, group_goal_block(new_inode_num));
+        free(content);
+        if (rc != 0) {
+            free_inode(new_inode_num);
+            return -1;
+        }
+    }
+    if (inode_write(new_inode_num, &copy) != 0) return -1;
+    if (add_entry_to_directory(&parent_inode, parent_num, dest_name, new_inode_num) != 0) {
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(&copy); ++i) {
+            if (copy.direct_blocks[i] != 0) free_block(copy.direct_blocks[i]);
+        }
         free_inode(new_inode_num);
-        fclose(source_file);
         return -1;
     }
-    uint32_t allocated_blocks[INODE_DIRECT_BLOCKS];
-    for (uint32_t i = 0; i < num_blocks_needed; ++i) {
-        int block_num = alloc_block();
-        if (block_num == -1) {
-            fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
-            for (uint32_t j = 0; j < i; ++j) { free_block(allocated_blocks[j]); }
-            free_inode(new_inode_num);
-            fclose(source_file);
-            return -1;
+    return 0;
+}
+
+// --- Arquivos Esparsos ---
+// Posições zeradas em direct_blocks são buracos: lidos como zeros, sem bloco
+// alocado nem I/O. As operações abaixo trabalham por unidade (o bloco, ou o
+// cluster nos arquivos comprimidos) e uma unidade toda zerada vira buraco.
+
+static uint32_t unit_bytes(const Inode* inode) {
+    return inode_is_compressed(inode) ? cluster_bytes() : sb.block_size;
+}
+
+// Bytes lógicos da unidade 'k' com o tamanho atual do i-node.
+static size_t unit_len(const Inode* inode, uint32_t k) {
+    uint64_t start = (uint64_t) k * unit_bytes(inode);
+    if (start >= inode->size) return 0;
+    return inode->size - start < unit_bytes(inode) ? inode->size - start : unit_bytes(inode);
+}
+
+// Lê a unidade 'k' para 'out' (unit_bytes() bytes, completados com zeros).
+static int read_unit(const Inode* inode, uint32_t k, char* out) {
+    memset(out, 0, unit_bytes(inode));
+    if (unit_len(inode, k) == 0) return 0;
+    if (inode_is_compressed(inode)) return read_cluster(inode, inode->size, k, out) < 0 ? -1 : 0;
+    if (inode->direct_blocks[k] == 0) return 0;
+    return block_read(inode->direct_blocks[k], out);
+}
+
+static void free_unit(Inode* inode, uint32_t k) {
+    if (inode_is_compressed(inode)) {
+        free_cluster(inode, k);
+    } else if (k < INODE_DIRECT_BLOCKS && inode->direct_blocks[k] != 0) {
+        free_block(inode->direct_blocks[k]);
+        inode->direct_blocks[k] = 0;
+    }
+}
+
+// Regrava a unidade 'k' com 'data' (unit_bytes() bytes) para o tamanho atual
+// do i-node. Um bloco cru exclusivo é sobrescrito no lugar; nos demais casos
+// os blocos antigos são liberados, o que também desfaz o compartilhamento com
+// clones (cópia na escrita). Blocos novos ficam logo após o bloco anterior do
+// arquivo ou, se for um buraco, a partir de 'goal'.
+static int write_unit(Inode* inode, uint32_t k, const char* data, uint32_t goal) {
+    size_t len = unit_len(inode, k);
+    if (len == 0 || is_zero(data, len)) {
+        free_unit(inode, k);
+        return 0;
+    }
+    if (inode_is_compressed(inode)) {
+        PackedData packed;
+        if (pack_clusters(data, len, k, &packed) != 0) return -1;
+        free_cluster(inode, k);
+        int rc = write_packed(inode, &packed, goal);
+        free(packed.data);
+        return rc;
+    }
+    uint32_t block = inode->direct_blocks[k];
+    if (block != 0 && block_extra_refs(block) == 0) return block_write(block, data);
+    int fresh = alloc_block(k > 0 && inode->direct_blocks[k - 1] != 0 ? inode->direct_blocks[k - 1] + 1 : goal);
+    if (fresh == -1) {
+        fprintf(stderr, "Erro: Sem blocos de dados livres.\n");
+        return -1;
+    }
+    if (block != 0) {
+        verbose_printf("Bloco #%u compartilhado: copiando para #%d antes de alterar.\n", block, fresh);
+        free_block(block);
+    }
+    inode->direct_blocks[k] = fresh;
+    return store_data_block(&inode->direct_blocks[k], data, len == sb.block_size);
+}
+
+// Muda o tamanho de um i-node sem dados pendentes. Crescer não aloca nada:
+// o trecho novo é um buraco. Encolher libera as unidades além do fim e zera
+// o resto da última, para que um crescimento futuro leia zeros ali. 'goal'
+// é repassado a write_unit.
+static int truncate_inode(Inode* inode, uint64_t new_size, uint32_t goal) {
+    uint64_t old_size = inode->size;
+    if (!size_fits_inode(new_size)) {
+        fprintf(stderr, "Erro: Tamanho excede o máximo do arquivo.\n");
+        return -1;
+    }
+    if (new_size == old_size) return 0;
+    uint64_t keep = old_size < new_size ? old_size : new_size;
+
+    if (new_size == 0 || fits_inline(new_size)) {
+        // Cabe no i-node: o que sobra do conteúdo vai inline e os blocos são liberados
+        char head[INODE_INLINE_SIZE];
+        memset(head, 0, sizeof(head));
+        if (inode_is_inline(inode)) {
+            memcpy(head, inode->direct_blocks, keep);
+        } else if (keep > 0) {
+            char* unit = malloc(unit_bytes(inode));
+            if (!unit || read_unit(inode, 0, unit) != 0) {
+                free(unit);
+                return -1;
+            }
+            memcpy(head, unit, keep);
+            free(unit);
+        }
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(inode); ++i) {
+            if (inode->direct_blocks[i] != 0) free_block(inode->direct_blocks[i]);
         }
-        allocated_blocks[i] = block_num;
+        memset(inode->direct_blocks, 0, sizeof(inode->direct_blocks));
+        memcpy(inode->direct_blocks, head, new_size);
+        if (new_size > 0) inode->flags |= INODE_FLAG_INLINE;
+        else inode->flags &= ~INODE_FLAG_INLINE;
+        inode->size = new_size;
+        return 0;
     }
-    verbose_printf("Copiando dados para os blocos alocados...\n");
-    char block_buffer[sb.block_size];
-    for (uint32_t i = 0; i < num_blocks_needed; ++i) {
-        fread(block_buffer, 1, sb.block_size, source_file);
-        if (block_write(allocated_blocks[i], block_buffer) != 0) {
-            for (uint32_t j = 0; j < num_blocks_needed; ++j) { free_block(allocated_blocks[j]); }
-            free_inode(new_inode_num);
-            fclose(source_file);
+
+    char* unit = malloc(unit_bytes(inode));
+    if (!unit) return -1;
+    int rc = 0;
+    if (inode_is_inline(inode)) {
+        // Cresceu além do limite: os dados inline vão para a primeira unidade
+        verbose_printf("Dados inline (%llu bytes) movidos para blocos.\n", (unsigned long long) old_size);
+        memset(unit, 0, unit_bytes(inode));
+        memcpy(unit, inode->direct_blocks, old_size);
+        memset(inode->direct_blocks, 0, sizeof(inode->direct_blocks));
+        inode->flags &= ~INODE_FLAG_INLINE;
+        inode->size = new_size;
+        rc = write_unit(inode, 0, unit, goal);
+    } else {
+        // A unidade que contém o novo fim (ou o antigo, ao crescer um cluster
+        // comprimido, cujo tamanho lógico muda) é regravada
+        uint32_t k = keep / unit_bytes(inode);
+        uint32_t cut = keep % unit_bytes(inode);
+        if (cut != 0 && (new_size < old_size || inode_is_compressed(inode))) {
+            rc = read_unit(inode, k, unit);
+            memset(unit + cut, 0, unit_bytes(inode) - cut);
+            inode->size = new_size;
+            if (rc == 0) rc = write_unit(inode, k, unit, goal);
+        }
+        inode->size = new_size;
+        uint32_t first_unused = (new_size + unit_bytes(inode) - 1) / unit_bytes(inode);
+        for (uint32_t j = first_unused; j < INODE_DIRECT_BLOCKS; ++j) free_unit(inode, j);
+    }
+    free(unit);
+    return rc;
+}
+
+// Abre um arquivo do diretório atual para alteração no meio, com os dados
+// pendentes já descarregados. Com 'create', um arquivo ausente é criado vazio.
+static int open_file_for_update(const char* filename, int create, Inode* inode) {
+    if (create && namei(filename) == -1) {
+        char name[MAX_FILENAME_LEN];
+        int parent_num = namei_parent(filename, name);
+        Inode parent_inode;
+        if (parent_num == -1 || inode_read(parent_num, &parent_inode) != 0) {
+            fprintf(stderr, "Erro: Caminho '%s' não encontrado.\n", filename);
             return -1;
         }
+        verbose_printf("Arquivo '%s' não existe. Criando novo arquivo.\n", filename);
+        if (create_empty_file(&parent_inode, parent_num, name) == -1) return -1;
     }
-    fclose(source_file);
-    verbose_printf("Inicializando i-node %d para o novo arquivo.\n", new_inode_num);
-    Inode new_inode;
-    new_inode.type = TYPE_FILE;
-    new_inode.size = file_size;
-    new_inode.link_count = 1;
-    new_inode.created = new_inode.modified = new_inode.accessed = time(NULL);
-    memset(new_inode.direct_blocks, 0, sizeof(new_inode.direct_blocks));
-    for (uint32_t i = 0; i < num_blocks_needed; ++i) {
-        new_inode.direct_blocks[i] = allocated_blocks[i];
+    int inode_num = open_file_for_read(filename, inode);
+    if (inode_num == -1) return -1;
+    DirtyBuffer* pending = find_dirty_buffer(inode_num);
+    if (pending) {
+        if (flush_dirty_buffer(pending) != 0) return -1;
+        if (inode_read(inode_num, inode) != 0) return -1;
     }
-    if (inode_write(new_inode_num, &new_inode) != 0) { return -1; }
-    if (add_entry_to_directory(&parent_inode, current_inode_num, dest_name, new_inode_num) != 0) { return -1; }
-    return 0;
+    return inode_num;
 }
 
-int fs_remove_file(const char* filename) {
-    verbose_printf("Iniciando 'rm %s'.\n", filename);
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
-    int target_inode_num = find_in_directory(&parent_inode, filename);
-    if (target_inode_num == -1) {
-        fprintf(stderr, "Erro: Arquivo '%s' não encontrado.\n", filename);
+static int truncate_file_untraced(const char* filename, uint64_t size) {
+    verbose_printf("Iniciando 'truncate %s %llu'.\n", filename, (unsigned long long) size);
+    // Antes de criar o arquivo: um truncate recusado não deixa um arquivo vazio para trás
+    if (!size_fits_inode(size)) {
+        fprintf(stderr, "Erro: Tamanho excede o máximo do arquivo.\n");
         return -1;
     }
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
-    if (target_inode.type != TYPE_FILE) {
-        fprintf(stderr, "Erro: '%s' não é um arquivo. Use 'rmdir' para diretórios.\n", filename);
+    Inode inode;
+    int inode_num = open_file_for_update(filename, 1, &inode);
+    if (inode_num == -1) return -1;
+    uint32_t before = count_data_blocks(&inode);
+    uint64_t old_size = inode.size;
+    int rc = truncate_inode(&inode, size, group_goal_block(inode_num));
+    inode.modified = time(NULL);
+    if (inode_write(inode_num, &inode) != 0) rc = -1;
+    if (rc == 0) verbose_printf("Arquivo '%s': %llu -> %llu bytes, %u -> %u bloco(s).\n", filename, (unsigned long long) old_size,
+                                (unsigned long long) size, before, count_data_blocks(&inode));
+    return rc;
+}
+
+static int write_at_untraced(const char* filename, uint64_t offset, const char* data, size_t len) {
+    verbose_printf("Iniciando escrita de %zu bytes em '%s' no deslocamento %llu.\n", len, filename, (unsigned long long) offset);
+    uint64_t end = offset + len;
+    if (!size_fits_inode(end)) {
+        fprintf(stderr, "Erro: Conteúdo excede o tamanho máximo do arquivo.\n");
         return -1;
     }
-    verbose_printf("Liberando blocos de dados do i-node %d...\n", target_inode_num);
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = target_inode.direct_blocks[i];
-        if (block_num == 0) continue;
-        if (free_block(block_num) != 0) { fprintf(stderr, "Erro crítico ao liberar o bloco de dados %u.\n", block_num); }
+    Inode inode;
+    int inode_num = open_file_for_update(filename, 1, &inode);
+    if (inode_num == -1) return -1;
+    int rc = 0;
+    if (end > inode.size) rc = truncate_inode(&inode, end, group_goal_block(inode_num));
+    if (rc == 0 && len > 0 && inode_is_inline(&inode)) {
+        memcpy((char*) inode.direct_blocks + offset, data, len);
+    } else if (rc == 0 && len > 0) {
+        uint32_t ub = unit_bytes(&inode);
+        char* unit = malloc(ub);
+        if (!unit) rc = -1;
+        for (uint32_t k = offset / ub; rc == 0 && (uint64_t) k * ub < end; ++k) {
+            uint64_t start = (uint64_t) k * ub > offset ? (uint64_t) k * ub : offset;
+            uint64_t stop = (uint64_t) (k + 1) * ub < end ? (uint64_t) (k + 1) * ub : end;
+            rc = read_unit(&inode, k, unit);
+            if (rc == 0) {
+                memcpy(unit + (start - (uint64_t) k * ub), data + (start - offset), stop - start);
+                rc = write_unit(&inode, k, unit, group_goal_block(inode_num));
+            }
+        }
+        free(unit);
     }
-    verbose_printf("Liberando i-node %d...\n", target_inode_num);
-    if (free_inode(target_inode_num) != 0) { fprintf(stderr, "Erro crítico ao liberar o i-node %d.\n", target_inode_num); }
-    verbose_printf("Removendo entrada '%s' do diretório pai.\n", filename);
-    if (remove_entry_from_directory(&parent_inode, current_inode_num, filename) != 0) {
-        fprintf(stderr, "Erro ao remover a entrada '%s' do diretório pai.\n", filename);
-        return -1;
+    inode.modified = time(NULL);
+    if (inode_write(inode_num, &inode) != 0) rc = -1;
+    return rc;
+}
+
+static int punch_file_untraced(const char* filename, uint64_t offset, uint64_t len) {
+    verbose_printf("Iniciando 'punch %s %llu %llu'.\n", filename, (unsigned long long) offset, (unsigned long long) len);
+    Inode inode;
+    int inode_num = open_file_for_update(filename, 0, &inode);
+    if (inode_num == -1) return -1;
+    if (offset >= inode.size || len == 0) return 0;
+    uint64_t end = len < inode.size - offset ? offset + len : inode.size;
+    uint32_t before = count_data_blocks(&inode);
+    int rc = 0;
+    if (inode_is_inline(&inode)) {
+        memset((char*) inode.direct_blocks + offset, 0, end - offset);
+    } else {
+        uint32_t ub = unit_bytes(&inode);
+        char* unit = malloc(ub);
+        if (!unit) return -1;
+        for (uint32_t k = offset / ub; rc == 0 && (uint64_t) k * ub < end; ++k) {
+            uint64_t base = (uint64_t) k * ub;
+            uint64_t start = base > offset ? base : offset;
+            uint64_t stop = base + unit_len(&inode, k) < end ? base + unit_len(&inode, k) : end;
+            if (start == base && stop == base + unit_len(&inode, k)) {
+                // Unidade inteira dentro do intervalo: vira buraco sem ler nada
+                free_unit(&inode, k);
+                continue;
+            }
+            rc = read_unit(&inode, k, unit);
+            if (rc == 0) {
+                memset(unit + (start - base), 0, stop - start);
+                rc = write_unit(&inode, k, unit, group_goal_block(inode_num));
+            }
+        }
+        free(unit);
     }
-    return 0;
+    inode.modified = time(NULL);
+    if (inode_write(inode_num, &inode) != 0) rc = -1;
+    if (rc == 0) verbose_printf("Buraco em '%s' [%llu, %llu): %u bloco(s) liberado(s).\n", filename, (unsigned long long) offset,
+                                (unsigned long long) end, before - count_data_blocks(&inode));
+    return rc;
 }
 
-int fs_delete(const char* name) {
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
+// --- Verificação de consistência (fsck) ---
 
-    int target_inode_num = find_in_directory(&parent_inode, name);
-    if (target_inode_num == -1) {
-        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", name);
-        return -1;
-    }
+#define FSCK_MAX_THREADS 16
+#define FSCK_CHUNK_BLOCKS 64
 
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
+// Estado compartilhado entre as threads de verificação. Os contadores
+// são atualizados com operações atômicas; cada diretório é varrido por
+// uma única thread, então os vetores indexados pelo diretório não precisam de trava.
+typedef struct {
+    int fd;
+    unsigned char* inode_bitmap;
+    unsigned char* block_bitmap;
+    Inode* table;           // Cópia da tabela de i-nodes
+    uint8_t* bad;           // I-node com tipo inválido ou ponteiros fora do disco
+    uint32_t* block_refs;   // Quantos ponteiros apontam para cada bloco
+    uint32_t* block_owner;  // Primeiro i-node encontrado como dono do bloco
+    uint32_t* inode_refs;   // Quantas entradas (exceto '.' e '..') apontam para o i-node
+    uint32_t* ref_parent;   // Diretório que contém a entrada do i-node
+    uint32_t* dotdot;       // Valor da entrada '..' de cada diretório
+    uint32_t* subdirs;      // Subdiretórios de cada diretório
+    uint32_t* live_bytes;   // Bytes de entradas ocupadas de cada diretório
+    uint8_t* has_dangling;  // Diretório com entradas para i-nodes livres/inválidos
+    uint8_t* bad_checksum;  // Bloco cujo CRC32C não confere com a tabela
+    uint32_t* dir_list;
+    uint32_t dir_count;
+    uint32_t table_blocks;
+    uint32_t next;          // Próximo trabalho (incrementado atomicamente)
+} FsckContext;
 
-    if (target_inode.type == TYPE_FILE) {
-        return fs_remove_file(name);
-    } else if (target_inode.type == TYPE_DIR) {
-        if (fs_change_directory(name) != 0) return -1;
+// Leitura direta via pread: pode ser usada por várias threads ao mesmo tempo.
+static int pread_blocks(int fd, uint32_t block_num, uint32_t count, void* data) {
+    size_t len = (size_t) count * sb.block_size;
+    off_t offset = (off_t) block_num * sb.block_size;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, (char*) data + done, len - done, offset + done);
+        if (r <= 0) return -1;
+        done += r;
+    }
+    return 0;
+}
 
-        FileList contents = fs_list_directory();
-        for (size_t i = 0; i < contents.count; ++i) {
-            if (strcmp(contents.entries[i].name, ".") == 0 || strcmp(contents.entries[i].name, "..") == 0)
-                continue;
+// Fase 1: lê a tabela de i-nodes em pedaços e conta as referências a blocos.
+static void* fsck_scan_inodes(void* arg) {
+    FsckContext* ctx = (FsckContext*) arg;
+    uint32_t per_block = inodes_per_block();
+    char* buffer = malloc((size_t) FSCK_CHUNK_BLOCKS * sb.block_size);
+    if (!buffer) return NULL;
+    uint32_t chunk;
+    while ((chunk = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED)) * FSCK_CHUNK_BLOCKS < ctx->table_blocks) {
+        uint32_t first = chunk * FSCK_CHUNK_BLOCKS;
+        uint32_t count = ctx->table_blocks - first < FSCK_CHUNK_BLOCKS ? ctx->table_blocks - first : FSCK_CHUNK_BLOCKS;
+        // Com grupos, a tabela fica em fatias: um pread por trecho contíguo
+        int read_ok = 1;
+        for (uint32_t done = 0, run; done < count && read_ok; done += run) {
+            run = inode_table_run(first + done);
+            if (run > count - done) run = count - done;
+            read_ok = pread_blocks(ctx->fd, inode_table_block(first + done), run,
+                                   buffer + (size_t) done * sb.block_size) == 0;
+        }
+        if (!read_ok) continue;
+        for (uint32_t b = 0; b < count; ++b) {
+            for (uint32_t k = 0; k < per_block; ++k) {
+                uint32_t ino = (first + b) * per_block + k;
+                if (ino >= sb.total_inodes) break;
+                Inode* inode = &ctx->table[ino];
+                inode_decode((unsigned char*) buffer + (size_t) b * sb.block_size + k * inode_disk_size(), inode);
+                if (!bitmap_test(ctx->inode_bitmap, ino)) continue;
+                if (inode->type != TYPE_FILE && inode->type != TYPE_DIR) ctx->bad[ino] = 1;
+                if (inode_is_inline(inode)) {
+                    if (inode->type != TYPE_FILE || inode->size > INODE_INLINE_SIZE) ctx->bad[ino] = 1;
+                    continue;
+                }
+                for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+                    uint32_t blk = inode->direct_blocks[i];
+                    if (blk == 0) continue;
+                    if (!is_data_block(blk)) { ctx->bad[ino] = 1; continue; }
+                    if (__atomic_fetch_add(&ctx->block_refs[blk], 1, __ATOMIC_RELAXED) == 0) {
+                        ctx->block_owner[blk] = ino;
+                    }
+                }
+            }
+        }
+    }
+    free(buffer);
+    return NULL;
+}
 
-            fs_delete(contents.entries[i].name);
+// Fase 0: confere o CRC32C de todos os blocos fora da própria tabela de checksums.
+static void* fsck_scan_checksums(void* arg) {
+    FsckContext* ctx = (FsckContext*) arg;
+    char* buffer = malloc((size_t) FSCK_CHUNK_BLOCKS * sb.block_size);
+    if (!buffer) return NULL;
+    uint32_t chunk;
+    while ((chunk = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED)) * FSCK_CHUNK_BLOCKS < sb.total_blocks) {
+        uint32_t first = chunk * FSCK_CHUNK_BLOCKS;
+        uint32_t count = sb.total_blocks - first < FSCK_CHUNK_BLOCKS ? sb.total_blocks - first : FSCK_CHUNK_BLOCKS;
+        if (pread_blocks(ctx->fd, first, count, buffer) != 0) continue;
+        for (uint32_t b = 0; b < count; ++b) {
+            if (is_checksum_block(first + b)) continue;
+            if (crc32c(0, buffer + (size_t) b * sb.block_size, sb.block_size) != block_checksums[first + b]) {
+                ctx->bad_checksum[first + b] = 1;
+            }
         }
-        free(contents.entries);
+    }
+    free(buffer);
+    return NULL;
+}
 
-        // Volta para o diretório original, não só para ".."
-        fs_change_directory("..");
+// Fase 2: varre os blocos de cada diretório e monta o mapa de referências a i-nodes.
+static void* fsck_scan_dirs(void* arg) {
+    FsckContext* ctx = (FsckContext*) arg;
+    char* buffer = malloc(sb.block_size);
+    if (!buffer) return NULL;
+    uint32_t idx;
+    while ((idx = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED)) < ctx->dir_count) {
+        uint32_t dir = ctx->dir_list[idx];
+        const Inode* inode = &ctx->table[dir];
+        for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+            uint32_t blk = inode->direct_blocks[i];
+            if (!is_data_block(blk)) continue;
+            if (pread_blocks(ctx->fd, blk, 1, buffer) != 0) continue;
+            DirCursor cur = {0};
+            DirectoryEntry entry;
+            while (dirent_next(buffer, &cur, &entry)) {
+                ctx->live_bytes[dir] += cur.next - cur.pos;
+                uint32_t target = entry.inode_num;
+                if (target >= sb.total_inodes || !bitmap_test(ctx->inode_bitmap, target)) {
+                    ctx->has_dangling[dir] = 1;
+                    continue;
+                }
+                if (strcmp(entry.name, ".") == 0) continue;
+                if (strcmp(entry.name, "..") == 0) { ctx->dotdot[dir] = target; continue; }
+                __atomic_fetch_add(&ctx->inode_refs[target], 1, __ATOMIC_RELAXED);
+                ctx->ref_parent[target] = dir;
+                if (ctx->table[target].type == TYPE_DIR && !ctx->bad[target]) ctx->subdirs[dir]++;
+            }
+        }
+    }
+    free(buffer);
+    return NULL;
+}
 
-        return fs_remove_directory(name);
+static void fsck_run_threads(FsckContext* ctx, void* (*fn)(void*)) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu > 0 ? (int) ncpu : 1;
+    if (nthreads > FSCK_MAX_THREADS) nthreads = FSCK_MAX_THREADS;
+    pthread_t threads[FSCK_MAX_THREADS];
+    int started = 0;
+    ctx->next = 0;
+    for (int t = 0; t < nthreads; ++t) {
+        if (pthread_create(&threads[t], NULL, fn, ctx) == 0) started++;
     }
+    if (started == 0) fn(ctx);
+    for (int t = 0; t < started; ++t) pthread_join(threads[t], NULL);
+}
 
-    return -1;
+// Remove de um diretório as entradas que apontam para i-nodes livres ou
+// inválidos. Retorna quantos bytes de entradas saíram.
+static uint32_t fsck_drop_dangling(FsckContext* ctx, uint32_t dir) {
+    char block_buffer[sb.block_size];
+    uint32_t removed = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t blk = ctx->table[dir].direct_blocks[i];
+        if (!is_data_block(blk)) continue;
+        if (block_read(blk, block_buffer) != 0) continue;
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        int dirty = 0;
+        while (dirent_next(block_buffer, &cur, &entry)) {
+            uint32_t target = entry.inode_num;
+            if (target >= sb.total_inodes || !bitmap_test(ctx->inode_bitmap, target)) {
+                removed += cur.next - cur.pos;
+                dirent_remove(block_buffer, &cur);
+                dirty = 1;
+            }
+        }
+        if (dirty) block_write(blk, block_buffer);
+    }
+    return removed;
 }
 
-int fs_rename(const char* old_name, const char* new_name) {
-    verbose_printf("Iniciando 'rename %s' para '%s'.\n", old_name, new_name);
-    if (strcmp(old_name, ".") == 0 || strcmp(old_name, "..") == 0 || strcmp(new_name, ".") == 0 || strcmp(new_name, "..") == 0) {
-        fprintf(stderr, "Erro: Não é permitido renomear '.' ou '..'.\n");
-        return -1;
+#define FSCK_PROBLEM(counter, ...) do { (counter)++; printf("  [fsck] " __VA_ARGS__); } while (0)
+
+int fs_check(int repair, FsckReport* report) {
+    verbose_printf("Iniciando 'fsck' (%s).\n", repair ? "com reparo" : "somente leitura");
+    memset(report, 0, sizeof(FsckReport));
+    if (!disk_file) return -1;
+    flush_all_dirty_buffers();
+    fflush(disk_file);
+
+    FsckContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fd = fileno(disk_file);
+    ctx.table_blocks = inode_table_blocks(sb.total_inodes);
+    int rc = -1;
+    if (block_checksums) {
+        // Antes de tudo: as fases seguintes dependem de os blocos lerem sem erro de checksum
+        ctx.bad_checksum = calloc(sb.total_blocks, 1);
+        if (!ctx.bad_checksum || checksum_store() != 0) goto out;
+        fsck_run_threads(&ctx, fsck_scan_checksums);
+        for (uint32_t blk = 0; blk < sb.total_blocks; ++blk) {
+            if (!ctx.bad_checksum[blk]) continue;
+            FSCK_PROBLEM(report->checksum_errors, "Bloco %u com checksum inválido (conteúdo corrompido ou escrita incompleta).\n", blk);
+            if (repair) {
+                // O conteúdo não pode ser recuperado: aceita o que está no disco
+                char block_buffer[sb.block_size];
+                if (raw_block_read(blk, block_buffer) == 0 && block_write(blk, block_buffer) == 0) report->repaired++;
+            }
+        }
+        if (repair && checksum_store() != 0) goto out;
     }
-    if (strlen(new_name) >= MAX_FILENAME_LEN) {
-        fprintf(stderr, "Erro: Novo nome é muito longo.\n");
-        return -1;
+    if (load_bitmap(sb.inode_bitmap_start, sb.total_inodes, &ctx.inode_bitmap) != 0 ||
+        load_bitmap(sb.block_bitmap_start, sb.total_blocks, &ctx.block_bitmap) != 0) {
+        fprintf(stderr, "Erro ao ler bitmaps do disco.\n");
+        goto out;
     }
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
-    if (find_in_directory(&parent_inode, old_name) == -1) {
-        fprintf(stderr, "Erro: Item '%s' não encontrado.\n", old_name);
-        return -1;
+    ctx.table = calloc(sb.total_inodes, sizeof(Inode));
+    ctx.bad = calloc(sb.total_inodes, 1);
+    ctx.has_dangling = calloc(sb.total_inodes, 1);
+    ctx.inode_refs = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.ref_parent = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.dotdot = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.subdirs = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.live_bytes = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.dir_list = calloc(sb.total_inodes, sizeof(uint32_t));
+    ctx.block_refs = calloc(sb.total_blocks, sizeof(uint32_t));
+    ctx.block_owner = calloc(sb.total_blocks, sizeof(uint32_t));
+    if (!ctx.table || !ctx.bad || !ctx.has_dangling || !ctx.inode_refs || !ctx.ref_parent || !ctx.dotdot ||
+        !ctx.subdirs || !ctx.live_bytes || !ctx.dir_list || !ctx.block_refs || !ctx.block_owner) {
+        fprintf(stderr, "Erro de alocação de memória.\n");
+        goto out;
     }
-    if (find_in_directory(&parent_inode, new_name) != -1) {
-        fprintf(stderr, "Erro: Já existe um item com o nome '%s'.\n", new_name);
-        return -1;
+
+    fsck_run_threads(&ctx, fsck_scan_inodes);
+    for (uint32_t ino = 0; ino < sb.total_inodes; ++ino) {
+        if (!bitmap_test(ctx.inode_bitmap, ino)) continue;
+        report->inodes_checked++;
+        if (ctx.bad[ino]) {
+            FSCK_PROBLEM(report->bad_inodes, "I-node %u com tipo inválido (%d) ou ponteiros fora da área de dados.\n", ino, (int) ctx.table[ino].type);
+        } else if (ctx.table[ino].type == TYPE_DIR) {
+            ctx.dir_list[ctx.dir_count++] = ino;
+        }
     }
-    verbose_printf("Modificando entrada no bloco de dados do diretório pai (i-node %u).\n", current_inode_num);
-    char block_buffer[sb.block_size];
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = parent_inode.direct_blocks[i];
-        if (block_num == 0) continue;
-        if (block_read(block_num, block_buffer) != 0) return -1;
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries = sb.block_size / sizeof(DirectoryEntry);
-        for (int j = 0; j < num_entries; ++j) {
-            if (strlen(entry[j].name) > 0 && strcmp(entry[j].name, old_name) == 0) {
-                strncpy(entry[j].name, new_name, MAX_FILENAME_LEN);
-                entry[j].name[MAX_FILENAME_LEN - 1] = '\0';
-                if (block_write(block_num, block_buffer) != 0) {
-                    fprintf(stderr, "Erro ao escrever as alterações no disco.\n");
-                    return -1;
+    report->dirs_checked = ctx.dir_count;
+    fsck_run_threads(&ctx, fsck_scan_dirs);
+
+    uint32_t bs = sb.block_size;
+    for (uint32_t ino = 0; ino < sb.total_inodes; ++ino) {
+        if (!bitmap_test(ctx.inode_bitmap, ino)) {
+            if (ctx.inode_refs[ino] > 0) {
+                FSCK_PROBLEM(report->inode_bitmap_errors, "I-node %u referenciado mas livre no bitmap.\n", ino);
+            }
+            continue;
+        }
+        Inode* inode = &ctx.table[ino];
+        int dirty = 0;
+        if (ctx.has_dangling[ino]) {
+            uint32_t dropped = repair ? fsck_drop_dangling(&ctx, ino) : 1;
+            FSCK_PROBLEM(report->dangling_entries, "Diretório %u tem entradas para i-nodes livres ou inválidos.\n", ino);
+            if (repair) {
+                ctx.live_bytes[ino] -= dropped;
+                report->repaired++;
+            }
+        }
+        if (ino != 0 && ctx.inode_refs[ino] == 0) {
+            FSCK_PROBLEM(report->orphan_inodes, "I-node %u alocado mas órfão (nenhuma entrada aponta para ele).\n", ino);
+            if (repair) {
+                // Devolve os blocos que pertencem só a ele e libera o i-node
+                for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(inode); ++i) {
+                    uint32_t blk = inode->direct_blocks[i];
+                    if (!is_data_block(blk) || ctx.block_refs[blk] == 0) continue;
+                    if (--ctx.block_refs[blk] == 0) bitmap_assign(ctx.block_bitmap, blk, 0);
+                }
+                bitmap_assign(ctx.inode_bitmap, ino, 0);
+                report->repaired++;
+            }
+            continue;
+        }
+        if (ctx.bad[ino]) {
+            if (!repair) continue;
+            // Referenciado mas sem tipo válido: trata como arquivo e descarta ponteiros inválidos
+            if (inode->type != TYPE_FILE && inode->type != TYPE_DIR) inode->type = TYPE_FILE;
+            if (inode_is_inline(inode)) {
+                // Dados inline inconsistentes não podem ser recuperados
+                inode->flags &= ~INODE_FLAG_INLINE;
+                memset(inode->direct_blocks, 0, sizeof(inode->direct_blocks));
+                inode->size = 0;
+            }
+            for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+                uint32_t blk = inode->direct_blocks[i];
+                if (blk != 0 && !is_data_block(blk)) inode->direct_blocks[i] = 0;
+            }
+            report->repaired++;
+            dirty = 1;
+        }
+        if (inode->type == TYPE_DIR && !ctx.bad[ino]) {
+            uint32_t expected_links = 2 + ctx.subdirs[ino];
+            if (inode->link_count != expected_links) {
+                FSCK_PROBLEM(report->link_count_errors, "Diretório %u: link_count %u, esperado %u.\n", ino, inode->link_count, expected_links);
+                if (repair) { inode->link_count = expected_links; dirty = 1; report->repaired++; }
+            }
+            if (ino != 0 && ctx.inode_refs[ino] > 1) {
+                FSCK_PROBLEM(report->link_count_errors, "Diretório %u aparece em %u diretórios.\n", ino, ctx.inode_refs[ino]);
+            }
+            uint32_t expected_parent = ino == 0 ? 0 : ctx.ref_parent[ino];
+            if (ctx.dotdot[ino] != expected_parent) {
+                FSCK_PROBLEM(report->dotdot_errors, "Diretório %u: '..' aponta para %u, esperado %u.\n", ino, ctx.dotdot[ino], expected_parent);
+                if (repair && inode->direct_blocks[0] != 0) {
+                    char block_buffer[bs];
+                    if (block_read(inode->direct_blocks[0], block_buffer) == 0) {
+                        DirCursor cur = {0};
+                        DirectoryEntry entry;
+                        while (dirent_next(block_buffer, &cur, &entry)) {
+                            if (strcmp(entry.name, "..") == 0) { dirent_set_inode(block_buffer, &cur, expected_parent); break; }
+                        }
+                        block_write(inode->direct_blocks[0], block_buffer);
+                        report->repaired++;
+                    }
+                }
+            }
+            uint32_t expected_size = ctx.live_bytes[ino];
+            if (inode->size != expected_size) {
+                FSCK_PROBLEM(report->size_errors, "Diretório %u: tamanho %llu, esperado %u.\n", ino, (unsigned long long) inode->size, expected_size);
+                if (repair) { inode->size = expected_size; dirty = 1; report->repaired++; }
+            }
+        } else if (inode->type == TYPE_FILE) {
+            if (inode->link_count != ctx.inode_refs[ino]) {
+                FSCK_PROBLEM(report->link_count_errors, "Arquivo %u: link_count %u, esperado %u.\n", ino, inode->link_count, ctx.inode_refs[ino]);
+                if (repair) { inode->link_count = ctx.inode_refs[ino]; dirty = 1; report->repaired++; }
+            }
+            uint32_t used = 0;
+            for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) if (inode->direct_blocks[i] != 0) used = i + 1;
+            uint64_t logical = (inode->size + bs - 1) / bs;
+            if (!inode_is_inline(inode) && inode_is_compressed(inode)) {
+                // Clusters comprimidos (e buracos) usam menos posições que o tamanho lógico
+                if (used > logical) {
+                    FSCK_PROBLEM(report->size_errors, "Arquivo comprimido %u: tamanho %llu incompatível com %u bloco(s).\n", ino, (unsigned long long) inode->size, used);
+                    if (repair) {
+                        // Sem o mapa de clusters íntegro, o conteúdo passa a ser lido cru
+                        inode->flags &= ~INODE_FLAG_COMPRESSED;
+                        inode->size = (uint64_t) used * bs;
+                        dirty = 1;
+                        report->repaired++;
+                    }
                 }
-                parent_inode.modified = time(NULL);
-                inode_write(current_inode_num, &parent_inode);
-                return 0;
+            } else if (!inode_is_inline(inode) && used > logical) {
+                // Posições zeradas antes do fim são buracos de um arquivo esparso
+                FSCK_PROBLEM(report->size_errors, "Arquivo %u: tamanho %llu incompatível com %u bloco(s).\n", ino, (unsigned long long) inode->size, used);
+                if (repair) { inode->size = (uint64_t) used * bs; dirty = 1; report->repaired++; }
             }
         }
+        if (dirty) inode_write(ino, inode);
     }
-    fprintf(stderr, "Erro: Inconsistência encontrada ao tentar renomear.\n");
-    return -1;
-}
 
-Inode fs_stat_item(const char* name) {
-    verbose_printf("Iniciando 'stat %s'.\n", name);
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return (Inode){0};
-    int target_inode_num = find_in_directory(&parent_inode, name);
-    if (target_inode_num == -1) {
-        return (Inode){0}; // Retorna um i-node vazio se não encontrado
+    // Blocos compartilhados: no reparo, cada dono extra recebe uma cópia própria.
+    // Com FEATURE_REFCOUNT o compartilhamento é legítimo e só a contagem é conferida.
+    for (uint32_t ino = 0; ino < sb.total_inodes && !refcount_table.data; ++ino) {
+        if (!bitmap_test(ctx.inode_bitmap, ino)) continue;
+        Inode* inode = &ctx.table[ino];
+        int dirty = 0;
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && !inode_is_inline(inode); ++i) {
+            uint32_t blk = inode->direct_blocks[i];
+            if (!is_data_block(blk) || ctx.block_refs[blk] <= 1) continue;
+            if (ctx.block_owner[blk] == ino) continue;
+            FSCK_PROBLEM(report->duplicate_blocks, "Bloco %u compartilhado pelos i-nodes %u e %u.\n", blk, ctx.block_owner[blk], ino);
+            if (!repair) continue;
+            uint32_t copy = 0;
+            for (uint32_t b = sb.data_blocks_start; b < sb.total_blocks; ++b) {
+                if (is_data_block(b) && ctx.block_refs[b] == 0 && !bitmap_test(ctx.block_bitmap, b)) { copy = b; break; }
+            }
+            char block_buffer[bs];
+            if (copy == 0 || block_read(blk, block_buffer) != 0 || block_write(copy, block_buffer) != 0) {
+                fprintf(stderr, "Erro: Sem espaço para duplicar o bloco %u.\n", blk);
+                continue;
+            }
+            ctx.block_refs[blk]--;
+            ctx.block_refs[copy] = 1;
+            bitmap_assign(ctx.block_bitmap, copy, 1);
+            inode->direct_blocks[i] = copy;
+            dirty = 1;
+            report->repaired++;
+        }
+        if (dirty) inode_write(ino, inode);
     }
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return (Inode){0};
-    return target_inode;
-}
 
-DiskUsageInfo fs_disk_free() {
-    verbose_printf("Iniciando 'df'.\n");
-    uint32_t used_inodes = count_set_bits(sb.inode_bitmap_start, sb.total_inodes);
-    uint32_t used_blocks = count_set_bits(sb.block_bitmap_start, sb.total_blocks);
-    if (used_inodes == (uint32_t)-1 || used_blocks == (uint32_t)-1) {
-        fprintf(stderr, "Erro ao ler bitmaps do disco.\n");
-        return (DiskUsageInfo){0};
+    for (uint32_t blk = sb.data_blocks_start; blk < sb.total_blocks && refcount_table.data; ++blk) {
+        uint32_t expected = ctx.block_refs[blk] > 1 ? ctx.block_refs[blk] - 1 : 0;
+        if (block_refcounts()[blk] == expected) continue;
+        FSCK_PROBLEM(report->refcount_errors, "Bloco %u: %u referência(s) extra(s) registrada(s), %u encontrada(s).\n", blk, block_refcounts()[blk], expected);
+        if (repair) {
+            block_refcounts()[blk] = expected;
+            meta_table_touch(&refcount_table, (size_t) blk * sizeof(uint32_t));
+            report->repaired++;
+        }
     }
-    uint32_t free_inodes = sb.total_inodes - used_inodes;
-    uint32_t free_blocks = sb.total_blocks - used_blocks;
-    uint32_t total_kb = (sb.total_blocks * sb.block_size) / 1024;
-    uint32_t used_kb = (used_blocks * sb.block_size) / 1024;
-    uint32_t free_kb = (free_blocks * sb.block_size) / 1024;
-    return (DiskUsageInfo){
-        .total_inodes = sb.total_inodes,
-        .used_inodes = used_inodes,
-        .free_inodes = free_inodes,
-        .total_blocks = sb.total_blocks,
-        .used_blocks = used_blocks,
-        .free_blocks = free_blocks,
-        .total_kb = total_kb,
-        .used_kb = used_kb,
-        .free_kb = free_kb
-    };
 
+    for (uint32_t blk = sb.data_blocks_start; blk < sb.total_blocks; ++blk) {
+        int marked = bitmap_test(ctx.block_bitmap, blk);
+        if (is_group_meta_block(blk)) {
+            if (marked) continue;
+            FSCK_PROBLEM(report->unmarked_blocks, "Bloco %u de metadados do grupo %u livre no bitmap.\n", blk, blk / blocks_per_group());
+            if (repair) { bitmap_assign(ctx.block_bitmap, blk, 1); report->repaired++; }
+            continue;
+        }
+        if (ctx.block_refs[blk] > 0 && !marked) {
+            FSCK_PROBLEM(report->unmarked_blocks, "Bloco %u em uso pelo i-node %u mas livre no bitmap.\n", blk, ctx.block_owner[blk]);
+        } else if (ctx.block_refs[blk] == 0 && marked) {
+            FSCK_PROBLEM(report->leaked_blocks, "Bloco %u marcado como usado mas sem dono (vazamento).\n", blk);
+        } else {
+            continue;
+        }
+        if (repair) { bitmap_assign(ctx.block_bitmap, blk, ctx.block_refs[blk] > 0); report->repaired++; }
+    }
+    if (usage_table.data || name_table.data) {
+        UsageEntry* expected = calloc(sb.total_inodes, sizeof(UsageEntry));
+        NameEntry* names = calloc(sb.total_inodes, sizeof(NameEntry));
+        if (!expected || !names || usage_compute(0, 0, expected, names) != 0) {
+            fprintf(stderr, "Erro ao recalcular as tabelas de uso e de nomes.\n");
+            free(expected);
+            free(names);
+            goto out;
+        }
+        for (uint32_t ino = 0; ino < sb.total_inodes && name_table.data; ++ino) {
+            const NameEntry* found = name_entry(ino);
+            if (memcmp(found, &names[ino], sizeof(NameEntry)) == 0) continue;
+            FSCK_PROBLEM(report->name_index_errors, "I-node %u: índice de nomes tem '%.*s' em %u, árvore tem '%s' em %u.\n", ino,
+                         MAX_FILENAME_LEN, found->name, found->parent, names[ino].name, names[ino].parent);
+            if (repair) report->repaired++;
+        }
+        if (repair && name_table.data) {
+            memcpy(name_table.data, names, (size_t) sb.total_inodes * sizeof(NameEntry));
+            memset(name_table.dirty, 1, name_table.blocks);
+        }
+        free(names);
+        for (uint32_t ino = 0; ino < sb.total_inodes && usage_table.data; ++ino) {
+            if (expected[ino].entries == 0) {
+                // Fora da árvore: não soma em ninguém
+                expected[ino].parent = USAGE_UNLINKED;
+                continue;
+            }
+            const UsageEntry* found = usage_entry(ino);
+            if (memcmp(found, &expected[ino], sizeof(UsageEntry)) == 0) continue;
+            FSCK_PROBLEM(report->usage_errors, "I-node %u: uso registrado %llu bytes/%u blocos/%u itens, calculado %llu/%u/%u.\n", ino,
+                         (unsigned long long) found->bytes, found->blocks, found->entries,
+                         (unsigned long long) expected[ino].bytes, expected[ino].blocks, expected[ino].entries);
+            if (repair) report->repaired++;
+        }
+        if (repair && usage_table.data) {
+            memcpy(usage_table.data, expected, (size_t) sb.total_inodes * sizeof(UsageEntry));
+            memset(usage_table.dirty, 1, usage_table.blocks);
+        }
+        free(expected);
+    }
+    if (repair) {
+        for (uint32_t ino = 0; ino < sb.total_inodes; ++ino) {
+            if (ctx.inode_refs[ino] > 0 && !bitmap_test(ctx.inode_bitmap, ino)) {
+                bitmap_assign(ctx.inode_bitmap, ino, 1);
+                report->repaired++;
+            }
+        }
+        if (store_bitmap(sb.inode_bitmap_start, sb.total_inodes, ctx.inode_bitmap) != 0 ||
+            store_bitmap(sb.block_bitmap_start, sb.total_blocks, ctx.block_bitmap) != 0) {
+            fprintf(stderr, "Erro ao gravar bitmaps reparados.\n");
+            goto out;
+        }
+        // Contadores dos grupos e extents livres voltam a refletir os bitmaps reparados
+        groups_load();
+        extents_load();
+        meta_tables_store();
+        checksum_store();
+        fflush(disk_file);
+    }
+    rc = report->bad_inodes + report->orphan_inodes + report->dangling_entries + report->link_count_errors +
+         report->dotdot_errors + report->size_errors + report->leaked_blocks + report->unmarked_blocks +
+         report->duplicate_blocks + report->inode_bitmap_errors + report->checksum_errors + report->refcount_errors +
+         report->usage_errors + report->name_index_errors;
+out:
+    if (repair) dcache_clear(); // O reparo pode ter reescrito entradas de diretório
+    free(ctx.inode_bitmap); free(ctx.block_bitmap); free(ctx.table); free(ctx.bad); free(ctx.has_dangling);
+    free(ctx.inode_refs); free(ctx.ref_parent); free(ctx.dotdot); free(ctx.subdirs); free(ctx.live_bytes);
+    free(ctx.dir_list); free(ctx.block_refs); free(ctx.block_owner); free(ctx.bad_checksum);
+    return rc;
+}
+
+// --- Busca (find) ---
+// Com o índice de nomes, a busca é uma varredura da tabela em memória e o
+// caminho de cada resultado sai subindo pelos pais. Sem ele (ou com 'walk'),
+// a árvore é percorrida por um grupo de threads com roubo de trabalho: cada
+// thread consome do fim da própria fila os subdiretórios que encontrou e,
+// quando ela esvazia, rouba do início da fila de outra. As leituras usam
+// pread, como no fsck.
+
+#define FIND_MAX_THREADS 16
+
+typedef struct {
+    uint32_t inode_num;
+    char* path;
+} FindItem;
+
+typedef struct {
+    pthread_mutex_t lock;
+    FindItem* items;
+    size_t head;      // Próximo item a ser roubado
+    size_t tail;      // A dona empilha e desempilha aqui
+    size_t capacity;
+} FindQueue;
+
+typedef struct {
+    int fd;
+    const char* pattern;
+    char literal[MAX_FILENAME_LEN]; // Trecho fixo do padrão, testado antes do fnmatch
+    FindQueue queues[FIND_MAX_THREADS];
+    int nthreads;
+    int next_id;                    // Incrementado atomicamente por cada thread
+    uint32_t pending;               // Diretórios na fila ou em varredura (atômico)
+    pthread_mutex_t match_lock;
+    char** matches;
+    size_t match_count;
+    size_t match_capacity;
+    int failed;
+} FindContext;
+
+// Maior sequência do padrão sem curingas: todo nome que casa a contém.
+static void find_literal(const char* pattern, char* out, size_t size) {
+    out[0] = '\0';
+    size_t best = 0;
+    const char* p = pattern;
+    while (*p) {
+        if (*p == '*' || *p == '?') { p++; continue; }
+        if (*p == '[') {
+            // Classe de caracteres: pula até o ']' que a fecha
+            const char* close = strchr(p + 2, ']');
+            p = close ? close + 1 : p + strlen(p);
+            continue;
+        }
+        if (*p == '\\') { p += p[1] ? 2 : 1; continue; }
+        size_t len = strcspn(p, "*?[\\");
+        if (len > best && len < size) {
+            memcpy(out, p, len);
+            out[len] = '\0';
+            best = len;
+        }
+        p += len;
+    }
 }
 
-int fs_check_item_type(const char* name) {
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
-    int target_inode_num = find_in_directory(&parent_inode, name);
-    if (target_inode_num == -1) return -1;
-    
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
-    
-    return target_inode.type;
+static int find_name_matches(const FindContext* ctx, const char* name) {
+    if (ctx->literal[0] && !strstr(name, ctx->literal)) return 0;
+    return fnmatch(ctx->pattern, name, 0) == 0;
 }
 
+static char* find_join(const char* dir, const char* name) {
+    size_t dir_len = strlen(dir);
+    int slash = dir_len == 0 || dir[dir_len - 1] != '/';
+    char* path = malloc(dir_len + slash + strlen(name) + 1);
+    if (path) sprintf(path, "%s%s%s", dir, slash ? "/" : "", name);
+    return path;
+}
 
-int fs_write_file(const char* filename, const char* text, const char* op) {
-    verbose_printf("Iniciando 'echo' para o arquivo '%s' (operação: %s)\n", filename, op);
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return -1;
-    int target_inode_num = find_in_directory(&parent_inode, filename);
-    if (strcmp(op, ">") == 0 && target_inode_num != -1) {
-        verbose_printf("Arquivo '%s' existe. Removendo para sobrescrever.\n", filename);
-        if (fs_remove_file(filename) != 0) {
-            fprintf(stderr, "Erro ao tentar sobrescrever o arquivo existente.\n");
-            return -1;
+static void find_add_match(FindContext* ctx, char* path) {
+    pthread_mutex_lock(&ctx->match_lock);
+    if (ctx->match_count == ctx->match_capacity) {
+        size_t new_cap = ctx->match_capacity ? ctx->match_capacity * 2 : 64;
+        char** tmp = realloc(ctx->matches, new_cap * sizeof(char*));
+        if (!tmp) {
+            ctx->failed = 1;
+            pthread_mutex_unlock(&ctx->match_lock);
+            free(path);
+            return;
         }
-        target_inode_num = -1;
+        ctx->matches = tmp;
+        ctx->match_capacity = new_cap;
     }
-    if (target_inode_num == -1) {
-        verbose_printf("Arquivo '%s' não existe. Criando novo arquivo.\n", filename);
-        int new_inode_num = alloc_inode();
-        if (new_inode_num == -1) return -1;
-        if (add_entry_to_directory(&parent_inode, current_inode_num, filename, new_inode_num) != 0) {
-            free_inode(new_inode_num);
+    ctx->matches[ctx->match_count++] = path;
+    pthread_mutex_unlock(&ctx->match_lock);
+}
+
+static int find_push(FindQueue* queue, FindItem item) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail == queue->capacity && queue->head > 0) {
+        memmove(queue->items, queue->items + queue->head, (queue->tail - queue->head) * sizeof(FindItem));
+        queue->tail -= queue->head;
+        queue->head = 0;
+    }
+    if (queue->tail == queue->capacity) {
+        size_t new_cap = queue->capacity ? queue->capacity * 2 : 64;
+        FindItem* tmp = realloc(queue->items, new_cap * sizeof(FindItem));
+        if (!tmp) {
+            pthread_mutex_unlock(&queue->lock);
             return -1;
         }
-        target_inode_num = new_inode_num;
+        queue->items = tmp;
+        queue->capacity = new_cap;
     }
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return -1;
-    if(target_inode.type == TYPE_DIR) {
-        fprintf(stderr, "Erro: Não é possível escrever em um diretório.\n");
-        return -1;
+    queue->items[queue->tail++] = item;
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+// Tira um item da fila: a dona pega o mais recente, quem rouba pega o mais antigo.
+static int find_take(FindQueue* queue, int steal, FindItem* item) {
+    int got = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail > queue->head) {
+        *item = steal ? queue->items[queue->head++] : queue->items[--queue->tail];
+        got = 1;
     }
-    long text_len = strlen(text);
-    long new_size = target_inode.size + text_len;
-    uint32_t total_blocks_needed = (new_size + sb.block_size - 1) / sb.block_size;
-    verbose_printf("Texto com %ld bytes. Novo tamanho do arquivo: %ld bytes. Blocos necessários: %u.\n", text_len, new_size, total_blocks_needed);
-    if (total_blocks_needed > INODE_DIRECT_BLOCKS) {
-        fprintf(stderr, "Erro: Conteúdo excede o tamanho máximo do arquivo.\n");
-        return -1;
+    pthread_mutex_unlock(&queue->lock);
+    return got;
+}
+
+static int find_read_inode(int fd, uint32_t inode_num, Inode* inode) {
+    unsigned char raw[sizeof(InodeV1)];
+    off_t offset = (off_t) inode_table_block(inode_num / inodes_per_block()) * sb.block_size +
+                   (inode_num % inodes_per_block()) * inode_disk_size();
+    if (pread(fd, raw, inode_disk_size(), offset) != (ssize_t) inode_disk_size()) return -1;
+    inode_decode(raw, inode);
+    return 0;
+}
+
+static void find_scan_dir(FindContext* ctx, int id, const FindItem* item) {
+    Inode dir_inode;
+    if (find_read_inode(ctx->fd, item->inode_num, &dir_inode) != 0 || dir_inode.type != TYPE_DIR) {
+        ctx->failed = 1;
+        return;
     }
-    const char* p_text = text;
     char block_buffer[sb.block_size];
-    uint32_t current_block_index = (strcmp(op, ">>") == 0) ? (target_inode.size / sb.block_size) : 0;
-    uint32_t offset_in_block = (strcmp(op, ">>") == 0) ? (target_inode.size % sb.block_size) : 0;
-    if (offset_in_block > 0) {
-        block_read(target_inode.direct_blocks[current_block_index], block_buffer);
-    }
-    while(p_text < text + text_len) {
-        if (offset_in_block == 0) {
-            memset(block_buffer, 0, sb.block_size);
-            if (target_inode.direct_blocks[current_block_index] == 0) {
-                int new_block = alloc_block();
-                if(new_block == -1) return -1;
-                target_inode.direct_blocks[current_block_index] = new_block;
+    uint64_t live_left = dir_inode.size;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && live_left > 0; ++i) {
+        if (dir_inode.direct_blocks[i] == 0) continue;
+        if (pread_blocks(ctx->fd, dir_inode.direct_blocks[i], 1, block_buffer) != 0) {
+            ctx->failed = 1;
+            return;
+        }
+        DirCursor cur = {0};
+        DirectoryEntry entry;
+        while (live_left > 0 && dirent_next(block_buffer, &cur, &entry)) {
+            uint32_t record = cur.next - cur.pos;
+            live_left = live_left > record ? live_left - record : 0;
+            if (strcmp(entry.name, ".") == 0 || strcmp(entry.name, "..") == 0) continue;
+            char* path = find_join(item->path, entry.name);
+            if (!path) { ctx->failed = 1; return; }
+            if (find_name_matches(ctx, entry.name)) find_add_match(ctx, strdup(path));
+            Inode child;
+            if (entry.inode_num < sb.total_inodes && find_read_inode(ctx->fd, entry.inode_num, &child) == 0 &&
+                child.type == TYPE_DIR) {
+                __atomic_fetch_add(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+                if (find_push(&ctx->queues[id], (FindItem){ entry.inode_num, path }) == 0) continue;
+                __atomic_fetch_sub(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+                ctx->failed = 1;
             }
+            free(path);
         }
-        size_t space_in_block = sb.block_size - offset_in_block;
-        size_t bytes_to_write = strlen(p_text);
-        if (bytes_to_write > space_in_block) {
-            bytes_to_write = space_in_block;
+    }
+}
+
+static void* find_worker(void* arg) {
+    FindContext* ctx = (FindContext*) arg;
+    int id = __atomic_fetch_add(&ctx->next_id, 1, __ATOMIC_RELAXED);
+    FindItem item;
+    for (;;) {
+        int got = find_take(&ctx->queues[id], 0, &item);
+        for (int k = 1; !got && k < ctx->nthreads; ++k) got = find_take(&ctx->queues[(id + k) % ctx->nthreads], 1, &item);
+        if (got) {
+            find_scan_dir(ctx, id, &item);
+            free(item.path);
+            __atomic_fetch_sub(&ctx->pending, 1, __ATOMIC_ACQ_REL);
+        } else if (__atomic_load_n(&ctx->pending, __ATOMIC_ACQUIRE) == 0) {
+            return NULL;
+        } else {
+            sched_yield();
         }
-        verbose_printf("Escrevendo %zu bytes no bloco %u (offset %u).\n", bytes_to_write, target_inode.direct_blocks[current_block_index], offset_in_block);
-        memcpy(block_buffer + offset_in_block, p_text, bytes_to_write);
-        block_write(target_inode.direct_blocks[current_block_index], block_buffer);
-        p_text += bytes_to_write;
-        offset_in_block = 0;
-        current_block_index++;
     }
-    target_inode.size = new_size;
-    target_inode.modified = target_inode.accessed = time(NULL);
-    inode_write(target_inode_num, &target_inode);
-    return 0;
 }
 
-int fs_move_item(const char* source_name, const char* dest_dir_name) {
-    verbose_printf("Iniciando 'mv %s' para '%s'.\n", source_name, dest_dir_name);
-    if (strcmp(source_name, ".") == 0 || strcmp(source_name, "..") == 0) {
-        fprintf(stderr, "Erro: Não é permitido mover '.' ou '..'.\n");
-        return -1;
+static void find_walk(FindContext* ctx, uint32_t base, const char* base_path) {
+    fflush(disk_file);
+    ctx->fd = fileno(disk_file);
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    ctx->nthreads = ncpu > 0 ? (int) ncpu : 1;
+    if (ctx->nthreads > FIND_MAX_THREADS) ctx->nthreads = FIND_MAX_THREADS;
+    for (int t = 0; t < ctx->nthreads; ++t) pthread_mutex_init(&ctx->queues[t].lock, NULL);
+    verbose_printf("Percorrendo a árvore com %d threads.\n", ctx->nthreads);
+
+    ctx->pending = 1;
+    char* root_path = strdup(base_path);
+    if (!root_path || find_push(&ctx->queues[0], (FindItem){ base, root_path }) != 0) {
+        free(root_path);
+        ctx->failed = 1;
+        ctx->pending = 0;
     }
-    if (strcmp(source_name, dest_dir_name) == 0) {
-        fprintf(stderr, "Erro: A origem e o destino não podem ser os mesmos.\n");
-        return -1;
+    pthread_t threads[FIND_MAX_THREADS];
+    int started = 0;
+    for (int t = 0; t < ctx->nthreads; ++t) {
+        if (pthread_create(&threads[t], NULL, find_worker, ctx) == 0) started++;
     }
-    Inode current_dir_inode;
-    if (inode_read(current_inode_num, &current_dir_inode) != 0) return -1;
-    int source_inode_num = find_in_directory(&current_dir_inode, source_name);
-    if (source_inode_num == -1) {
-        fprintf(stderr, "Erro: Item de origem '%s' não encontrado.\n", source_name);
-        return -1;
+    if (started == 0) find_worker(ctx);
+    for (int t = 0; t < started; ++t) pthread_join(threads[t], NULL);
+    for (int t = 0; t < ctx->nthreads; ++t) {
+        free(ctx->queues[t].items);
+        pthread_mutex_destroy(&ctx->queues[t].lock);
     }
-    int dest_dir_inode_num = find_in_directory(&current_dir_inode, dest_dir_name);
-    if (dest_dir_inode_num == -1) {
-        fprintf(stderr, "Erro: Diretório de destino '%s' não encontrado.\n", dest_dir_name);
-        return -1;
+}
+
+static void find_in_index(FindContext* ctx, uint32_t base, const char* base_path) {
+    verbose_printf("Consultando o índice de nomes.\n");
+    size_t base_len = strlen(base_path);
+    int slash = base_len == 0 || base_path[base_len - 1] != '/';
+    for (uint32_t ino = 1; ino < sb.total_inodes; ++ino) {
+        const NameEntry* entry = name_entry(ino);
+        if (ino == base || entry->name[0] == '\0' || !find_name_matches(ctx, entry->name)) continue;
+        // Sobe até 'base' somando o tamanho do caminho relativo
+        size_t rel_len = 0;
+        uint32_t n = ino;
+        for (uint32_t hops = 0; n != base && hops < sb.total_inodes; ++hops) {
+            const NameEntry* up = name_entry(n);
+            if (up->name[0] == '\0') break;  // Ancestral fora da árvore
+            rel_len += strnlen(up->name, MAX_FILENAME_LEN) + 1;
+            n = up->parent;
+        }
+        if (n != base) continue;
+        char* path = malloc(base_len + slash + rel_len);
+        if (!path) { ctx->failed = 1; return; }
+        memcpy(path, base_path, base_len);
+        size_t end = base_len + slash + rel_len - 1;
+        path[end] = '\0';
+        for (n = ino; n != base; n = name_entry(n)->parent) {
+            size_t len = strnlen(name_entry(n)->name, MAX_FILENAME_LEN);
+            end -= len;
+            memcpy(path + end, name_entry(n)->name, len);
+            path[--end] = '/';
+        }
+        find_add_match(ctx, path);
     }
-    Inode source_inode, dest_dir_inode;
-    if (inode_read(source_inode_num, &source_inode) != 0) return -1;
-    if (inode_read(dest_dir_inode_num, &dest_dir_inode) != 0) return -1;
-    if (dest_dir_inode.type != TYPE_DIR) {
-        fprintf(stderr, "Erro: O destino '%s' não é um diretório.\n", dest_dir_name);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static int find_untraced(const char* path, const char* pattern, int walk, FsFindCallback cb, void* cb_ctx) {
+    verbose_printf("Iniciando 'find %s -name %s'.\n", path, pattern);
+    int base = namei(path);
+    Inode base_inode;
+    if (base == -1 || inode_read(base, &base_inode) != 0) {
+        fprintf(stderr, "Erro: Diretório '%s' não encontrado.\n", path);
         return -1;
     }
-    if (find_in_directory(&dest_dir_inode, source_name) != -1) {
-        fprintf(stderr, "Erro: Já existe um item com o nome '%s' no destino.\n", source_name);
+    if (base_inode.type != TYPE_DIR) {
+        fprintf(stderr, "Erro: '%s' não é um diretório.\n", path);
         return -1;
     }
-    verbose_printf("Movendo i-node %d para o diretório de destino (i-node %d).\n", source_inode_num, dest_dir_inode_num);
-    if (add_entry_to_directory(&dest_dir_inode, dest_dir_inode_num, source_name, source_inode_num) != 0) { return -1; }
-    if (source_inode.type == TYPE_DIR) {
-        verbose_printf("Item movido é um diretório. Atualizando sua entrada '..'.\n");
-        char block_buffer[sb.block_size];
-        if(block_read(source_inode.direct_blocks[0], block_buffer) != 0) return -1;
-        DirectoryEntry* entry = (DirectoryEntry*) block_buffer;
-        int num_entries = sb.block_size / sizeof(DirectoryEntry);
-        for (int i = 0; i < num_entries; ++i) {
-            if (strcmp(entry[i].name, "..") == 0) {
-                entry[i].inode_num = dest_dir_inode_num;
-                break;
-            }
-        }
-        if(block_write(source_inode.direct_blocks[0], block_buffer) != 0) return -1;
-        verbose_printf("Atualizando contagem de links dos diretórios pai (antigo: %u, novo: %u).\n", current_inode_num, dest_dir_inode_num);
-        current_dir_inode.link_count--;
-        dest_dir_inode.link_count++;
-        inode_write(current_inode_num, &current_dir_inode);
-        inode_write(dest_dir_inode_num, &dest_dir_inode);
-    }
-    if (remove_entry_from_directory(&current_dir_inode, current_inode_num, source_name) != 0) {
-        fprintf(stderr, "Erro crítico: O item foi copiado para o destino, mas falhou ao ser removido da origem.\n");
+    FindContext* ctx = calloc(1, sizeof(FindContext));
+    char* base_path = strdup(path);
+    if (!ctx || !base_path) {
+        free(ctx);
+        free(base_path);
         return -1;
     }
-    return 0;
-}
-
-char* fs_read_file(const char* filename) {
-    verbose_printf("Iniciando 'cat %s'.\n", filename);
+    // Sem barras no final, exceto na raiz
+    for (size_t len = strlen(base_path); len > 1 && base_path[len - 1] == '/'; --len) base_path[len - 1] = '\0';
+    ctx->pattern = pattern;
+    find_literal(pattern, ctx->literal, sizeof(ctx->literal));
+    pthread_mutex_init(&ctx->match_lock, NULL);
 
-    Inode parent_inode;
-    if (inode_read(current_inode_num, &parent_inode) != 0) return NULL;
+    if (name_table.data && !walk) find_in_index(ctx, base, base_path);
+    else find_walk(ctx, base, base_path);
 
-    int target_inode_num = find_in_directory(&parent_inode, filename);
-    if (target_inode_num == -1) {
-        fprintf(stderr, "Erro: Arquivo '%s' não encontrado.\n", filename);
-        return NULL;
+    int rc = ctx->failed ? -1 : (int) ctx->match_count;
+    if (rc == -1) fprintf(stderr, "Erro: Falha ao percorrer '%s'.\n", path);
+    qsort(ctx->matches, ctx->match_count, sizeof(char*), compare_paths);
+    for (size_t i = 0; i < ctx->match_count; ++i) {
+        if (rc != -1 && cb && cb(ctx->matches[i], cb_ctx) != 0) cb = NULL;
+        free(ctx->matches[i]);
     }
+    free(ctx->matches);
+    pthread_mutex_destroy(&ctx->match_lock);
+    free(ctx);
+    free(base_path);
+    return rc;
+}
 
-    Inode target_inode;
-    if (inode_read(target_inode_num, &target_inode) != 0) return NULL;
-
-    if (target_inode.type != TYPE_FILE) {
-        fprintf(stderr, "Erro: '%s' não é um arquivo.\n", filename);
-        return NULL;
-    }
+// --- Desfragmentação ---
 
-    verbose_printf("Lendo %u bytes do arquivo (i-node %d).\n", target_inode.size, target_inode_num);
+// Cursor da passada incremental: próximo i-node a ser examinado.
+static uint32_t defrag_cursor = 0;
 
-    if (target_inode.size == 0) {
-        // Arquivo vazio, retorna string vazia alocada
-        char* empty = malloc(1);
-        if (empty) empty[0] = '\0';
-        return empty;
+static uint32_t count_extents(const Inode* inode, uint32_t* nblocks) {
+    uint32_t extents = 0, prev = 0;
+    *nblocks = 0;
+    if (inode_is_inline(inode)) return 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t blk = inode->direct_blocks[i];
+        if (blk == 0) continue;
+        if (prev == 0 || blk != prev + 1) extents++;
+        prev = blk;
+        (*nblocks)++;
     }
+    return extents;
+}
 
-    char* content = malloc(target_inode.size + 1); // +1 para o '\0'
-    if (!content) {
-        fprintf(stderr, "Erro de alocação de memória.\n");
-        return NULL;
+// Move os blocos do i-node para uma sequência contígua. Os novos blocos são
+// marcados e preenchidos antes de o i-node ser regravado; só então os antigos
+// são liberados, de modo que uma interrupção no meio nunca perde dados.
+static int defrag_inode(uint32_t ino, Inode* inode, unsigned char* bitmap, int compact, DefragReport* report) {
+    uint32_t nblocks;
+    uint32_t extents = count_extents(inode, &nblocks);
+    if (nblocks == 0) return 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        // Mover um bloco compartilhado desfaria o compartilhamento
+        if (inode->direct_blocks[i] != 0 && block_extra_refs(inode->direct_blocks[i]) > 0) {
+            report->extents_before += extents;
+            report->extents_after += extents;
+            return 0;
+        }
     }
+    uint32_t first = 0;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS && first == 0; ++i) first = inode->direct_blocks[i];
+    report->extents_before += extents;
+    if (extents > 1) report->fragmented++;
 
-    char block_buffer[sb.block_size];
-    long bytes_left_to_read = target_inode.size;
-    size_t offset = 0;
+    uint32_t limit = (extents == 1) ? first : sb.total_blocks;
+    if (extents == 1 && !compact) { report->extents_after += extents; return 0; }
+    uint32_t target = find_free_run(bitmap, sb.data_blocks_start, nblocks, limit);
+    if (target == 0) { report->extents_after += extents; return 0; }
 
-    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
-        uint32_t block_num = target_inode.direct_blocks[i];
-        if (block_num == 0 || bytes_left_to_read == 0) break;
+    verbose_printf("Realocando %u bloco(s) do i-node %u para %u..%u.\n", nblocks, ino, target, target + nblocks - 1);
+    if (set_bit_range(sb.block_bitmap_start, target, nblocks, 1) != 0) return -1;
+    for (uint32_t b = 0; b < nblocks; ++b) bitmap_assign(bitmap, target + b, 1);
 
-        if (block_read(block_num, block_buffer) != 0) {
-            fprintf(stderr, "Erro ao ler bloco de dados do arquivo.\n");
-            free(content);
-            return NULL;
+    char block_buffer[sb.block_size];
+    Inode moved = *inode;
+    uint32_t next = target;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        if (inode->direct_blocks[i] == 0) continue;
+        if (block_read(inode->direct_blocks[i], block_buffer) != 0 || block_write(next, block_buffer) != 0) {
+            set_bit_range(sb.block_bitmap_start, target, nblocks, 0);
+            for (uint32_t b = 0; b < nblocks; ++b) bitmap_assign(bitmap, target + b, 0);
+            return -1;
         }
+        moved.direct_blocks[i] = next++;
+    }
+    if (inode_write(ino, &moved) != 0) return -1;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t blk = inode->direct_blocks[i];
+        if (blk == 0) continue;
+        free_block(blk);
+        bitmap_assign(bitmap, blk, 0);
+    }
+    *inode = moved;
+    report->relocated++;
+    report->blocks_moved += nblocks;
+    report->extents_after += 1;
+    return 0;
+}
 
-        size_t bytes_to_copy = (bytes_left_to_read > sb.block_size) ? sb.block_size : bytes_left_to_read;
-        memcpy(content + offset, block_buffer, bytes_to_copy);
-
-        offset += bytes_to_copy;
-        bytes_left_to_read -= bytes_to_copy;
+// Diretórios com entradas removidas são reempacotados antes de mover os blocos.
+static int defrag_directory(uint32_t ino, Inode* inode, unsigned char* bitmap, DefragReport* report) {
+    if (inode->type != TYPE_DIR || !directory_needs_compaction(inode, 0)) return 0;
+    Inode before = *inode;
+    if (compact_directory(inode, ino) != 0) return -1;
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) {
+        uint32_t blk = before.direct_blocks[i];
+        int kept = 0;
+        for (int j = 0; j < INODE_DIRECT_BLOCKS && !kept; ++j) kept = (inode->direct_blocks[j] == blk);
+        if (blk != 0 && !kept) bitmap_assign(bitmap, blk, 0);
     }
+    report->dirs_compacted++;
+    return 0;
+}
 
-    content[target_inode.size] = '\0'; // Garantir terminação nula
+static long elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
 
-    verbose_printf("Atualizando timestamp de acesso do i-node %d.\n", target_inode_num);
-    target_inode.accessed = time(NULL);
-    inode_write(target_inode_num, &target_inode);
+static int defrag_untraced(const char* name, int compact, uint32_t budget_ms, DefragReport* report) {
+    verbose_printf("Iniciando 'defrag' (%s, compactar: %d, fatia: %u ms).\n", name ? name : "disco inteiro", compact, budget_ms);
+    memset(report, 0, sizeof(DefragReport));
+    flush_all_dirty_buffers();
+    unsigned char* bitmap = NULL;
+    if (load_bitmap(sb.block_bitmap_start, sb.total_blocks, &bitmap) != 0) {
+        fprintf(stderr, "Erro ao ler o bitmap de blocos.\n");
+        free(bitmap);
+        return -1;
+    }
+    int rc = 0;
+    if (name) {
+        Inode inode;
+        int ino = namei(name);
+        if (ino == -1 || inode_read(ino, &inode) != 0) {
+            fprintf(stderr, "Erro: Item '%s' não encontrado.\n", name);
+            free(bitmap);
+            return -1;
+        }
+        report->files_scanned = 1;
+        rc = defrag_directory(ino, &inode, bitmap, report);
+        if (rc == 0) rc = defrag_inode(ino, &inode, bitmap, compact, report);
+        report->finished = 1;
+        free(bitmap);
+        return rc;
+    }
 
-    return content;
+    unsigned char* inode_bitmap = NULL;
+    if (load_bitmap(sb.inode_bitmap_start, sb.total_inodes, &inode_bitmap) != 0) {
+        fprintf(stderr, "Erro ao ler o bitmap de i-nodes.\n");
+        free(inode_bitmap);
+        free(bitmap);
+        return -1;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (defrag_cursor >= sb.total_inodes) defrag_cursor = 0;
+    while (defrag_cursor < sb.total_inodes) {
+        if (budget_ms > 0 && elapsed_ms(&start) >= (long) budget_ms) break;
+        uint32_t ino = defrag_cursor++;
+        if (!bitmap_test(inode_bitmap, ino)) continue;
+        Inode inode;
+        if (inode_read(ino, &inode) != 0) { rc = -1; break; }
+        report->files_scanned++;
+        if (defrag_directory(ino, &inode, bitmap, report) != 0 ||
+            defrag_inode(ino, &inode, bitmap, compact, report) != 0) { rc = -1; break; }
+    }
+    report->finished = (defrag_cursor >= sb.total_inodes);
+    if (report->finished) defrag_cursor = 0;
+    free(inode_bitmap);
+    free(bitmap);
+    return rc;
 }
 
 void fs_set_verbose(int mode) {
@@ -873,25 +4822,87 @@ void fs_set_verbose(int mode) {
     printf("Modo verboso %s.\n", verbose_mode ? "ativado" : "desativado");
 }
 
-int fs_format(const char* path, uint32_t total_size_kb, uint32_t block_size_kb) {
-    uint32_t total_size = total_size_kb * 1024;
+int fs_format(const char* path, uint64_t total_size_kb, uint32_t block_size_kb) {
+    return fs_format_with_options(path, total_size_kb, block_size_kb, NULL);
+}
+
+int fs_format_with_options(const char* path, uint64_t total_size_kb, uint32_t block_size_kb, const FormatOptions* options) {
+    uint64_t total_size = total_size_kb * 1024;
     uint32_t block_size = block_size_kb * 1024;
     if (block_size == 0 || total_size == 0) {
         fprintf(stderr, "Erro: Tamanho do disco e do bloco devem ser maiores que zero.\n");
         return -1;
     }
+    if (block_size_kb > UINT32_MAX / 1024 || total_size / block_size > UINT32_MAX) {
+        fprintf(stderr, "Erro: O disco pode ter no máximo %u blocos; use blocos maiores.\n", UINT32_MAX);
+        return -1;
+    }
+    memset(&sb, 0, sizeof(Superblock));
     sb.block_size = block_size;
     sb.total_blocks = total_size / block_size;
-    sb.total_inodes = sb.total_blocks / 4;
-    if (sb.total_inodes < 16) sb.total_inodes = 16;
+    uint64_t inodes = (options && options->bytes_per_inode) ? total_size / options->bytes_per_inode : sb.total_blocks / 4;
+    sb.total_inodes = inodes < 16 ? 16 : (inodes > UINT32_MAX / 2 ? UINT32_MAX / 2 : (uint32_t) inodes);
     sb.magic_number = MAGIC_NUMBER;
-    sb.inode_bitmap_start = 1;
-    uint32_t inode_bitmap_blocks = (sb.total_inodes + 8 * block_size - 1) / (8 * block_size);
-    sb.block_bitmap_start = sb.inode_bitmap_start + inode_bitmap_blocks;
-    uint32_t block_bitmap_blocks = (sb.total_blocks + 8 * block_size - 1) / (8 * block_size);
-    sb.inode_table_start = sb.block_bitmap_start + block_bitmap_blocks;
-    uint32_t inode_table_blocks = (sb.total_inodes * sizeof(Inode) + block_size - 1) / block_size;
-    sb.data_blocks_start = sb.inode_table_start + inode_table_blocks;
+    sb.version = FS_VERSION;
+    sb.features = FEATURE_INLINE_DATA | FEATURE_CHECKSUMS | FEATURE_REFCOUNT | FEATURE_DIR_USAGE | FEATURE_NAME_INDEX |
+                  FEATURE_LARGE_FILES | FEATURE_BLOCK_GROUPS | (options ? options->features : 0);
+    if (options) sb.features &= ~options->disabled_features;
+    sb.state = 0;
+    if (grouped_layout()) {
+        // Os i-nodes são divididos igualmente entre os grupos, no máximo um
+        // bloco de bitmap por grupo; um último grupo pequeno demais para os
+        // próprios metadados fica de fora do disco.
+        uint32_t per_block = inodes_per_block();
+        uint32_t groups = group_count();
+        uint32_t last = sb.total_blocks - (groups - 1) * blocks_per_group();
+        uint32_t per_group = (sb.total_inodes + groups - 1) / groups;
+        per_group = (per_group + per_block - 1) / per_block * per_block;
+        if (per_group > 8 * block_size / per_block * per_block) per_group = 8 * block_size / per_block * per_block;
+        if (groups > 1 && last <= 2 + per_group / per_block) {
+            printf("Aviso: os últimos %u blocos não formam um grupo completo e não serão usados.\n", last);
+            sb.total_blocks -= last;
+            groups--;
+        }
+        sb.total_inodes = per_group * groups;
+        sb.checksum_start = 1;
+    } else {
+        sb.inode_bitmap_start = 1;
+        uint32_t inode_bitmap_blocks = (sb.total_inodes + 8 * block_size - 1) / (8 * block_size);
+        sb.block_bitmap_start = sb.inode_bitmap_start + inode_bitmap_blocks;
+        uint32_t block_bitmap_blocks = (sb.total_blocks + 8 * block_size - 1) / (8 * block_size);
+        sb.inode_table_start = sb.block_bitmap_start + block_bitmap_blocks;
+        sb.checksum_start = sb.inode_table_start + inode_table_blocks(sb.total_inodes);
+    }
+    uint32_t checksum_blocks = (sb.features & FEATURE_CHECKSUMS) ? checksum_table_blocks(sb.total_blocks, block_size) : 0;
+    sb.refcount_start = sb.checksum_start + checksum_blocks;
+    sb.data_blocks_start = sb.refcount_start + refcount_table_blocks(sb.total_blocks, block_size);
+    sb.dedup_start = sb.dedup_slots = 0;
+    if (sb.features & FEATURE_DEDUP) {
+        // Duas posições por bloco mantêm a vizinhança de busca curta
+        sb.dedup_slots = 1;
+        while (sb.dedup_slots < 2 * (uint64_t) sb.total_blocks && sb.dedup_slots < (1u << 31)) sb.dedup_slots <<= 1;
+        sb.dedup_start = sb.data_blocks_start;
+        sb.data_blocks_start += dedup_table_blocks(sb.dedup_slots, block_size);
+    }
+    sb.usage_start = sb.data_blocks_start;
+    sb.data_blocks_start += usage_table_blocks(sb.total_inodes, block_size);
+    sb.name_index_start = sb.data_blocks_start;
+    sb.data_blocks_start += name_index_blocks(sb.total_inodes, block_size);
+    sb.reserved_start = sb.data_blocks_start;
+    sb.reserved_blocks = options ? ((uint64_t) options->reserved_kb * 1024 + block_size - 1) / block_size : 0;
+    if ((uint64_t) sb.data_blocks_start + sb.reserved_blocks >= sb.total_blocks) {
+        fprintf(stderr, "Erro: Tamanho do disco insuficiente para os metadados.\n");
+        return -1;
+    }
+    sb.data_blocks_start += sb.reserved_blocks;
+    if (grouped_layout()) {
+        // Depois das tabelas globais, os metadados dos grupos que começam
+        // dentro do cabeçalho; os demais grupos guardam os seus no início.
+        sb.block_bitmap_start = sb.data_blocks_start;
+        sb.inode_bitmap_start = sb.block_bitmap_start + 1;
+        sb.inode_table_start = sb.block_bitmap_start + 2;
+        sb.data_blocks_start += stacked_groups() * group_meta_blocks();
+    }
     if (sb.data_blocks_start >= sb.total_blocks) {
         fprintf(stderr, "Erro: Tamanho do disco insuficiente para os metadados.\n");
         return -1;
@@ -901,27 +4912,48 @@ int fs_format(const char* path, uint32_t total_size_kb, uint32_t block_size_kb)
         perror("Erro ao criar arquivo de disco");
         return -1;
     }
+    // O arquivo é estendido sem escrever nada: o host lê zeros nos trechos
+    // nunca gravados e só aloca espaço para o que o simulador escrever
     void* zero_block = calloc(1, block_size);
-    for (uint32_t i = 0; i < sb.total_blocks; ++i) {
-        if (fwrite(zero_block, block_size, 1, disk_file) != 1) {
-            fprintf(stderr, "Erro ao zerar o disco\n");
-            free(zero_block);
-            fclose(disk_file);
-            return -1;
-        }
+    if (!zero_block || ftruncate(fileno(disk_file), (off_t) sb.total_blocks * block_size) != 0) {
+        fprintf(stderr, "Erro ao zerar o disco\n");
+        free(zero_block);
+        fclose(disk_file);
+        disk_file = NULL;
+        return -1;
+    }
+    checksum_release();
+    meta_tables_release();
+    groups_release();
+    extents_release();
+    if ((sb.features & FEATURE_CHECKSUMS) && checksum_alloc() != 0) {
+        free(zero_block);
+        fclose(disk_file);
+        disk_file = NULL;
+        return -1;
+    }
+    if (block_checksums) {
+        // Disco todo zerado: todos os blocos começam com o mesmo CRC
+        uint32_t zero_crc = crc32c(0, zero_block, block_size);
+        for (uint32_t i = 0; i < sb.total_blocks; ++i) block_checksums[i] = zero_crc;
+        memset(checksum_dirty, 1, checksum_blocks);
     }
     free(zero_block);
     fflush(disk_file);
     void* block_buffer = malloc(block_size);
     memset(block_buffer, 0, block_size);
-    memcpy(block_buffer, &sb, sizeof(Superblock));
+    superblock_encode(&sb, block_buffer);
     if (block_write(0, block_buffer) != 0) {
         fprintf(stderr, "Erro ao escrever superbloco.\n");
-        fclose(disk_file);
-        free(block_buffer);
-        return -1;
+        goto fail;
     }
     fflush(disk_file);
+    for (uint32_t g = grouped_layout() ? stacked_groups() : group_count(); g < group_count(); ++g) {
+        if (set_bit_range(sb.block_bitmap_start, group_meta_start(g), group_meta_blocks(), 1) != 0) {
+            fprintf(stderr, "Erro ao marcar os metadados do grupo %u.\n", g);
+            goto fail;
+        }
+    }
     int root_inode_num = find_free_bit_from(sb.inode_bitmap_start, sb.total_inodes, 0);
     if (root_inode_num != 0) {
         fprintf(stderr, "Erro: O primeiro i-node alocado não foi o 0.\n");
@@ -934,8 +4966,9 @@ int fs_format(const char* path, uint32_t total_size_kb, uint32_t block_size_kb)
         goto fail;
     }
     Inode root_inode;
+    memset(&root_inode, 0, sizeof(Inode));
     root_inode.type = TYPE_DIR;
-    root_inode.size = sizeof(DirectoryEntry) * 2;
+    root_inode.size = empty_directory_size();
     root_inode.link_count = 2;
     root_inode.created = root_inode.modified = root_inode.accessed = time(NULL);
     for(int i=0; i<INODE_DIRECT_BLOCKS; ++i) root_inode.direct_blocks[i] = 0;
@@ -944,46 +4977,97 @@ int fs_format(const char* path, uint32_t total_size_kb, uint32_t block_size_kb)
         fprintf(stderr, "Erro ao escrever o i-node raiz.\n");
         goto fail;
     }
-    DirectoryEntry dot_entry;
-    strncpy(dot_entry.name, ".", MAX_FILENAME_LEN);
-    dot_entry.inode_num = root_inode_num;
-    DirectoryEntry dotdot_entry;
-    strncpy(dotdot_entry.name, "..", MAX_FILENAME_LEN);
-    dotdot_entry.inode_num = root_inode_num;
-    memset(block_buffer, 0, block_size);
-    memcpy(block_buffer, &dot_entry, sizeof(DirectoryEntry));
-    memcpy(block_buffer + sizeof(DirectoryEntry), &dotdot_entry, sizeof(DirectoryEntry));
+    dirent_block_init(block_buffer, root_inode_num, root_inode_num);
     if (block_write(root_data_block_num, block_buffer) != 0) {
         fprintf(stderr, "Erro ao escrever o bloco de dados do diretório raiz.\n");
         goto fail;
     }
+    // Tabela de uso: só a raiz, que é o próprio pai e ocupa um bloco
+    UsageEntry root_usage = { .blocks = 1, .entries = 1, .own_blocks = 1, .parent = root_inode_num };
+    memset(block_buffer, 0, block_size);
+    memcpy(block_buffer, &root_usage, sizeof(UsageEntry));
+    if (tables_need_swap()) usage_table_swap(block_buffer, sizeof(UsageEntry));
+    if (block_write(sb.usage_start, block_buffer) != 0) {
+        fprintf(stderr, "Erro ao escrever a tabela de uso.\n");
+        goto fail;
+    }
+    if (checksum_store() != 0) {
+        fprintf(stderr, "Erro ao gravar a tabela de checksums.\n");
+        goto fail;
+    }
+    checksum_release();
     fflush(disk_file);
     fclose(disk_file);
     disk_file = NULL;
     free(block_buffer);
     printf("Disco formatado com sucesso.\n");
+    printf("Geometria: %u blocos de %u KB; %u i-nodes (um a cada %llu bytes, tabela de %u blocos); %u grupo(s) de %u blocos.\n",
+           sb.total_blocks, block_size / 1024, sb.total_inodes, (unsigned long long) (total_size / sb.total_inodes),
+           inode_table_blocks(sb.total_inodes), (sb.total_blocks + blocks_per_group() - 1) / blocks_per_group(), blocks_per_group());
+    uint32_t group_meta = grouped_layout() ? (group_count() - stacked_groups()) * group_meta_blocks() : 0;
+    printf("Metadados: %u blocos%s; reservados: %u; dados: %u blocos.\n", sb.data_blocks_start - sb.reserved_blocks + group_meta,
+           (sb.features & FEATURE_CHECKSUMS) ? " (com checksums)" : " (sem checksums)", sb.reserved_blocks,
+           sb.total_blocks - sb.data_blocks_start - group_meta);
     printf("Diretório raiz criado no i-node %d e bloco de dados %u.\n", root_inode_num, root_data_block_num);
+    if (sb.features & FEATURE_COMPRESSION) printf("Compressão de arquivos habilitada para todo o disco.\n");
     return 0;
 fail:
+    checksum_release();
     fclose(disk_file);
     disk_file = NULL;
     free(block_buffer);
     return -1;
 }
 
+// Carrega (ou recalcula) a tabela de checksums conforme as opções de montagem.
+static int mount_checksums(const MountOptions* options) {
+    if (!(sb.features & FEATURE_CHECKSUMS)) return 0;
+    if (options && options->no_checksum) {
+        // Escritas sem checksum deixam a tabela desatualizada; a próxima montagem normal a recalcula
+        printf("Aviso: Verificação de checksums desligada nesta montagem.\n");
+        if (!(sb.state & SB_STATE_CHECKSUMS_STALE)) {
+            sb.state |= SB_STATE_CHECKSUMS_STALE;
+            superblock_write();
+            fflush(disk_file);
+        }
+        return 0;
+    }
+    if (checksum_load() != 0) {
+        fprintf(stderr, "Erro: Não foi possível ler a tabela de checksums.\n");
+        return -1;
+    }
+    if (sb.state & SB_STATE_CHECKSUMS_STALE) {
+        printf("Recalculando checksums (o disco foi montado sem verificação).\n");
+        sb.state &= ~SB_STATE_CHECKSUMS_STALE;
+        if (checksum_rebuild() != 0 || superblock_write() != 0 || checksum_store() != 0) {
+            fprintf(stderr, "Erro: Falha ao recalcular os checksums.\n");
+            return -1;
+        }
+        fflush(disk_file);
+    }
+    verbose_printf("Checksums CRC32C ativos (%s).\n", crc32c_impl());
+    return 0;
+}
+
 int fs_mount(const char* path) {
+    return fs_mount_with_options(path, NULL);
+}
+
+int fs_mount_with_options(const char* path, const MountOptions* options) {
     disk_file = fopen(path, "rb+");
     if (!disk_file) {
         return -1;
     }
     fseek(disk_file, 0, SEEK_SET);
+    unsigned char raw_sb[sizeof(Superblock)];
     Superblock temp_sb;
-    if (fread(&temp_sb, sizeof(Superblock), 1, disk_file) != 1) {
+    if (fread(raw_sb, sizeof(raw_sb), 1, disk_file) != 1) {
         fprintf(stderr, "Erro: Não foi possível ler o superbloco do disco.\n");
         fclose(disk_file);
         disk_file = NULL;
         return -1;
     }
+    superblock_decode(raw_sb, &temp_sb);
     if (temp_sb.magic_number != MAGIC_NUMBER) {
         fprintf(stderr, "Erro: Magic number inválido (lido: 0x%X, esperado: 0x%X).\n", temp_sb.magic_number, MAGIC_NUMBER);
         fprintf(stderr, "O arquivo não é um disco do nosso sistema ou está corrompido.\n");
@@ -991,14 +5075,465 @@ int fs_mount(const char* path) {
         disk_file = NULL;
         return -1;
     }
+    if (temp_sb.version > FS_VERSION) {
+        fprintf(stderr, "Erro: Disco no formato v%u; esta versão do programa só conhece até o v%u.\n", temp_sb.version, FS_VERSION);
+        fclose(disk_file);
+        disk_file = NULL;
+        return -1;
+    }
     memcpy(&sb, &temp_sb, sizeof(Superblock));
+    // Discos antigos reservavam a tabela de i-nodes pelo total de bytes, e os
+    // últimos i-nodes caíam sobre a área seguinte: esses não são usados.
+    uint32_t usable_inodes = (inode_table_end() - sb.inode_table_start) * inodes_per_block();
+    if (!grouped_layout() && sb.total_inodes > usable_inodes) {
+        verbose_printf("Tabela de i-nodes comporta só %u dos %u i-nodes; o restante não será usado.\n", usable_inodes, sb.total_inodes);
+        sb.total_inodes = usable_inodes;
+    }
     current_inode_num = 0;
+    dcache_clear();
+    checksum_release();
+    meta_tables_release();
+    direct_close();
+    if (options && options->direct) {
+        if (direct_open(path) == 0) verbose_printf("Disco aberto com O_DIRECT (blocos de %u bytes).\n", sb.block_size);
+        else fprintf(stderr, "Aviso: O_DIRECT indisponível para '%s' neste sistema de arquivos; usando E/S normal.\n", path);
+    }
+    if (mount_checksums(options) != 0 || meta_tables_load() != 0 || groups_load() != 0 || extents_load() != 0) {
+        fprintf(stderr, "Erro: Não foi possível carregar as tabelas de metadados do disco.\n");
+        checksum_release();
+        meta_tables_release();
+        groups_release();
+        extents_release();
+        direct_close();
+        fclose(disk_file);
+        disk_file = NULL;
+        return -1;
+    }
+    if (options && options->trace_path && trace_record_start(options->trace_path) != 0) {
+        fs_unmount();
+        return -1;
+    }
     return 0;
 }
 
+
 void fs_unmount() {
+    trace_record_stop();
     if (disk_file) {
+        if (flush_all_dirty_buffers() != 0) {
+            // Última chance já passou: o que sobrou não tem para onde ir
+            while (dirty_buffers) {
+                Inode inode;
+                fprintf(stderr, "Erro: %zu bytes pendentes do i-node %u foram perdidos.\n", dirty_buffers->len, dirty_buffers->inode_num);
+                release_dirty_buffer(dirty_buffers, inode_read(dirty_buffers->inode_num, &inode) == 0 ? inode.size : 0);
+            }
+        }
+        if (meta_tables_store() != 0) fprintf(stderr, "Erro ao gravar as tabelas de referências.\n");
+        if (checksum_store() != 0) fprintf(stderr, "Erro ao gravar a tabela de checksums.\n");
+        checksum_release();
+        meta_tables_release();
+        groups_release();
+        extents_release();
+        direct_close();
+        dcache_clear();
         fclose(disk_file);
         disk_file = NULL;
     }
 }
+
+// --- Atualização do Formato ---
+// Converte um disco v1 ou v2 para o v3. A tabela de i-nodes do v1 é reescrita
+// no formato compacto; ela nunca é maior que a v1, então a conversão cabe no
+// mesmo lugar e os blocos que sobram no fim ficam zerados e sem uso. Os
+// blocos de diretório passam para os registros compactos (nenhum é maior
+// que os 64 bytes antigos, então cada bloco cabe em si mesmo), o cabeçalho
+// dos clusters comprimidos e as tabelas laterais passam a little-endian.
+
+static int copy_image(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    if (!in) {
+        fprintf(stderr, "Erro: Não foi possível abrir '%s'.\n", from);
+        return -1;
+    }
+    FILE* out = fopen(to, "wb");
+    if (!out) {
+        fprintf(stderr, "Erro: Não foi possível criar '%s'.\n", to);
+        fclose(in);
+        return -1;
+    }
+    size_t chunk = 1 << 20;
+    char* buffer = malloc(chunk);
+    int rc = buffer ? 0 : -1;
+    size_t n;
+    while (rc == 0 && (n = fread(buffer, 1, chunk, in)) > 0) {
+        if (fwrite(buffer, 1, n, out) != n) rc = -1;
+    }
+    if (ferror(in)) rc = -1;
+    if (fclose(out) != 0) rc = -1;
+    fclose(in);
+    free(buffer);
+    if (rc != 0) fprintf(stderr, "Erro ao copiar '%s' para '%s'.\n", from, to);
+    return rc;
+}
+
+// Lê os blocos de todos os diretórios no formato antigo, antes de mudar a
+// versão. Retorna um vetor (i-node * INODE_DIRECT_BLOCKS + posição) com as
+// entradas de cada bloco; 'counts' recebe quantas há em cada um.
+static DirectoryEntry** upgrade_read_dirs(const Inode* table, const unsigned char* used, uint32_t** counts) {
+    size_t slots = (size_t) sb.total_inodes * INODE_DIRECT_BLOCKS;
+    DirectoryEntry** entries = calloc(slots, sizeof(DirectoryEntry*));
+    *counts = calloc(slots, sizeof(uint32_t));
+    char* block_buffer = malloc(sb.block_size);
+    int rc = (entries && *counts && block_buffer) ? 0 : -1;
+    for (uint32_t ino = 0; ino < sb.total_inodes && rc == 0; ++ino) {
+        if (table[ino].type != TYPE_DIR || !bitmap_test(used, ino)) continue;
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && rc == 0; ++i) {
+            uint32_t blk = table[ino].direct_blocks[i];
+            if (blk == 0) continue;
+            size_t slot = (size_t) ino * INODE_DIRECT_BLOCKS + i;
+            entries[slot] = malloc(sb.block_size / sizeof(DirectoryEntry) * sizeof(DirectoryEntry));
+            if (!entries[slot] || block_read(blk, block_buffer) != 0) {
+                rc = -1;
+                break;
+            }
+            DirCursor cur = {0};
+            while (dirent_next(block_buffer, &cur, &entries[slot][(*counts)[slot]])) (*counts)[slot]++;
+        }
+    }
+    free(block_buffer);
+    if (rc == 0) return entries;
+    for (size_t i = 0; entries && i < slots; ++i) free(entries[i]);
+    free(entries);
+    free(*counts);
+    *counts = NULL;
+    return NULL;
+}
+
+// Regrava os blocos lidos por upgrade_read_dirs no formato atual e corrige o
+// tamanho de cada diretório.
+static int upgrade_write_dirs(Inode* table, DirectoryEntry** entries, const uint32_t* counts) {
+    char* block_buffer = malloc(sb.block_size);
+    if (!block_buffer) return -1;
+    int rc = 0;
+    for (uint32_t ino = 0; ino < sb.total_inodes && rc == 0; ++ino) {
+        uint64_t size = 0;
+        int is_dir = 0;
+        for (int i = 0; i < INODE_DIRECT_BLOCKS && rc == 0; ++i) {
+            size_t slot = (size_t) ino * INODE_DIRECT_BLOCKS + i;
+            if (!entries[slot]) continue;
+            is_dir = 1;
+            memset(block_buffer, 0, sb.block_size);
+            for (uint32_t j = 0; j < counts[slot]; ++j) {
+                dirent_add(block_buffer, entries[slot][j].name, entries[slot][j].inode_num);
+                size += dirent_size(entries[slot][j].name);
+            }
+            if (block_write(table[ino].direct_blocks[i], block_buffer) != 0) rc = -1;
+        }
+        if (is_dir) table[ino].size = size;
+    }
+    free(block_buffer);
+    return rc;
+}
+
+// Passa o tamanho no início de cada cluster comprimido, gravado na ordem do
+// host, para little-endian.
+static int upgrade_cluster_headers(const Inode* table, const unsigned char* used) {
+    unsigned char* done = calloc(sb.total_blocks / 8 + 1, 1);
+    char* block_buffer = malloc(sb.block_size);
+    int rc = (done && block_buffer) ? 0 : -1;
+    for (uint32_t ino = 0; ino < sb.total_inodes && rc == 0; ++ino) {
+        const Inode* inode = &table[ino];
+        if (!bitmap_test(used, ino) || inode->type != TYPE_FILE || !inode_is_compressed(inode) || inode_is_inline(inode)) continue;
+        for (uint32_t k = 0; (uint64_t) k * cluster_bytes() < inode->size && rc == 0; ++k) {
+            size_t chunk = inode->size - (uint64_t) k * cluster_bytes();
+            if (chunk > cluster_bytes()) chunk = cluster_bytes();
+            uint32_t logical = (chunk + sb.block_size - 1) / sb.block_size;
+            uint32_t base = k * COMPRESS_CLUSTER_BLOCKS;
+            uint32_t physical = 0;
+            while (physical < logical && inode->direct_blocks[base + physical] != 0) physical++;
+            if (physical == 0 || physical == logical) continue;
+            uint32_t blk = inode->direct_blocks[base];
+            // Um bloco deduplicado aparece em vários clusters: converte uma vez só
+            if (bitmap_test(done, blk)) continue;
+            bitmap_assign(done, blk, 1);
+            if (block_read(blk, block_buffer) != 0) {
+                rc = -1;
+                break;
+            }
+            uint32_t clen;
+            memcpy(&clen, block_buffer, sizeof(clen));
+            unsigned char encoded[sizeof(uint32_t)];
+            put_le32(encoded, clen);
+            if (memcmp(encoded, block_buffer, sizeof(encoded)) == 0) continue;
+            memcpy(block_buffer, encoded, sizeof(encoded));
+            if (block_write(blk, block_buffer) != 0) rc = -1;
+        }
+    }
+    free(done);
+    free(block_buffer);
+    return rc;
+}
+
+int fs_upgrade(const char* path, const char* dest_path) {
+    if (dest_path && strcmp(dest_path, path) != 0) {
+        verbose_printf("Copiando '%s' para '%s' antes da conversão.\n", path, dest_path);
+        if (copy_image(path, dest_path) != 0) return -1;
+        path = dest_path;
+    }
+    if (fs_mount(path) != 0) return -1;
+    if (sb.version >= FS_VERSION) {
+        fs_unmount();
+        return 1;
+    }
+    flush_all_dirty_buffers();
+    uint32_t old_version = sb.version;
+    // O tamanho da tabela v1 vem do layout gravado, não da conta atual: o
+    // create antigo reservava pelo total de bytes, e os blocos seguintes já
+    // são de outra área (a montagem limitou total_inodes ao que cabe nela).
+    uint32_t old_blocks = inode_table_end() - sb.inode_table_start;
+    uint32_t old_per_block = inodes_per_block();
+    Inode* table = calloc(sb.total_inodes, sizeof(Inode));
+    char* block_buffer = malloc(sb.block_size);
+    int rc = (table && block_buffer) ? 0 : -1;
+    for (uint32_t b = 0; b < old_blocks && rc == 0; ++b) {
+        if (block_read(sb.inode_table_start + b, block_buffer) != 0) {
+            rc = -1;
+            break;
+        }
+        for (uint32_t k = 0; k < old_per_block && b * old_per_block + k < sb.total_inodes; ++k) {
+            inode_decode((unsigned char*) block_buffer + k * inode_disk_size(), &table[b * old_per_block + k]);
+        }
+    }
+    unsigned char* used = NULL;
+    if (rc == 0 && load_bitmap(sb.inode_bitmap_start, sb.total_inodes, &used) != 0) rc = -1;
+    uint32_t* counts = NULL;
+    DirectoryEntry** entries = rc == 0 ? upgrade_read_dirs(table, used, &counts) : NULL;
+    if (!entries) rc = -1;
+    if (rc == 0) {
+        sb.version = FS_VERSION;
+        sb.features |= FEATURE_LARGE_FILES;
+        if (upgrade_write_dirs(table, entries, counts) != 0 || upgrade_cluster_headers(table, used) != 0) rc = -1;
+    }
+    if (rc == 0) {
+        uint32_t per_block = inodes_per_block();
+        verbose_printf("Tabela de i-nodes: %u bloco(s) no v%u, %u no v%u.\n", old_blocks, old_version,
+                       inode_table_blocks(sb.total_inodes), sb.version);
+        for (uint32_t b = 0; b < old_blocks && rc == 0; ++b) {
+            memset(block_buffer, 0, sb.block_size);
+            for (uint32_t k = 0; k < per_block && b * per_block + k < sb.total_inodes; ++k) {
+                inode_encode(&table[b * per_block + k], (unsigned char*) block_buffer + k * INODE_DISK_SIZE);
+            }
+            if (block_write(sb.inode_table_start + b, block_buffer) != 0) rc = -1;
+        }
+        // As tabelas em memória estão na ordem do host: gravá-las inteiras
+        // no desmonte as deixa em little-endian
+        MetaTable* tables[] = { &refcount_table, &dedup_table, &usage_table, &name_table };
+        for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]); ++i) {
+            if (tables[i]->dirty) memset(tables[i]->dirty, 1, tables[i]->blocks);
+        }
+        if (checksum_dirty) memset(checksum_dirty, 1, checksum_table_blocks(sb.total_blocks, sb.block_size));
+        if (rc == 0 && superblock_write() != 0) rc = -1;
+    }
+    if (rc != 0) fprintf(stderr, "Erro: Falha ao converter o disco para o v%u; execute 'fsck'.\n", FS_VERSION);
+    for (size_t i = 0; entries && i < (size_t) sb.total_inodes * INODE_DIRECT_BLOCKS; ++i) free(entries[i]);
+    free(entries);
+    free(counts);
+    free(used);
+    free(table);
+    free(block_buffer);
+    fs_unmount();
+    return rc;
+}
+
+// --- Rastreamento das Chamadas ---
+// As funções públicas abaixo só envolvem as versões _untraced para que o
+// trace (run --record) grave cada chamada com a duração e o resultado.
+
+int fs_geometry(uint64_t* total_size_kb, uint32_t* block_size_kb, FormatOptions* options) {
+    if (!disk_file) return -1;
+    *total_size_kb = (uint64_t) sb.total_blocks * sb.block_size / 1024;
+    *block_size_kb = sb.block_size / 1024;
+    memset(options, 0, sizeof(*options));
+    options->features = sb.features;
+    options->disabled_features = ~sb.features;
+    options->bytes_per_inode = (uint32_t) ((uint64_t) sb.total_blocks * sb.block_size / sb.total_inodes);
+    options->reserved_kb = (uint32_t) ((uint64_t) sb.reserved_blocks * sb.block_size / 1024);
+    return 0;
+}
+
+FileList fs_list_path(const char* path) {
+    uint64_t start = trace_enter();
+    FileList files = list_path_untraced(path);
+    trace_leave(start, TRACE_LIST, files.entries ? 0 : -1, path, NULL, 0, 0);
+    return files;
+}
+
+int fs_create_directory(const char* path) {
+    uint64_t start = trace_enter();
+    int rc = create_directory_untraced(path);
+    trace_leave(start, TRACE_MKDIR, rc, path, NULL, 0, 0);
+    return rc;
+}
+
+int fs_change_directory(const char* name) {
+    uint64_t start = trace_enter();
+    int rc = change_directory_untraced(name);
+    trace_leave(start, TRACE_CHDIR, rc, name, NULL, 0, 0);
+    return rc;
+}
+
+int fs_remove_directory(const char* path) {
+    uint64_t start = trace_enter();
+    int rc = remove_directory_untraced(path);
+    trace_leave(start, TRACE_RMDIR, rc, path, NULL, 0, 0);
+    return rc;
+}
+
+int fs_import_file(const char* source_path, const char* dest_path) {
+    uint64_t start = trace_enter();
+    int rc = import_file_untraced(source_path, dest_path);
+    struct stat st;
+    uint64_t size = start && stat(source_path, &st) == 0 ? (uint64_t) st.st_size : 0;
+    trace_leave(start, TRACE_IMPORT, rc, source_path, dest_path, size, 0);
+    return rc;
+}
+
+int fs_import_tree(const char* host_dir, const char* dest_path) {
+    uint64_t start = trace_enter();
+    int rc = import_tree_untraced(host_dir, dest_path);
+    trace_leave(start, TRACE_IMPORT_TREE, rc, host_dir, dest_path, 0, 0);
+    return rc;
+}
+
+int fs_remove_file(const char* path) {
+    uint64_t start = trace_enter();
+    int rc = remove_file_untraced(path);
+    trace_leave(start, TRACE_UNLINK, rc, path, NULL, 0, 0);
+    return rc;
+}
+
+int fs_delete(const char* name) {
+    uint64_t start = trace_enter();
+    int rc = delete_untraced(name);
+    trace_leave(start, TRACE_DELETE, rc, name, NULL, 0, 0);
+    return rc;
+}
+
+int fs_rename(const char* old_path, const char* new_path) {
+    uint64_t start = trace_enter();
+    int rc = rename_untraced(old_path, new_path);
+    trace_leave(start, TRACE_RENAME, rc, old_path, new_path, 0, 0);
+    return rc;
+}
+
+Inode fs_stat_item(const char* name) {
+    uint64_t start = trace_enter();
+    Inode inode = stat_item_untraced(name);
+    trace_leave(start, TRACE_STAT, inode.link_count ? 0 : -1, name, NULL, 0, 0);
+    return inode;
+}
+
+DiskUsageInfo fs_disk_free() {
+    uint64_t start = trace_enter();
+    DiskUsageInfo usage = disk_free_untraced();
+    trace_leave(start, TRACE_DF, usage.total_blocks ? 0 : -1, NULL, NULL, 0, 0);
+    return usage;
+}
+
+int fs_dir_usage(const char* path, DirUsage* usage) {
+    uint64_t start = trace_enter();
+    int rc = dir_usage_untraced(path, usage);
+    trace_leave(start, TRACE_DU, rc, path, NULL, 0, 0);
+    return rc;
+}
+
+int fs_write_file(const char* path, const char* text, const char* op) {
+    uint64_t start = trace_enter();
+    int rc = write_file_untraced(path, text, op);
+    trace_leave(start, TRACE_ECHO, rc, path, NULL, strcmp(op, ">") == 0, strlen(text));
+    return rc;
+}
+
+int fs_sync() {
+    uint64_t start = trace_enter();
+    int rc = sync_untraced();
+    trace_leave(start, TRACE_SYNC, rc, NULL, NULL, 0, 0);
+    return rc;
+}
+
+int fs_move_item(const char* source_path, const char* dest_dir_name) {
+    uint64_t start = trace_enter();
+    int rc = move_item_untraced(source_path, dest_dir_name);
+    trace_leave(start, TRACE_MOVE, rc, source_path, dest_dir_name, 0, 0);
+    return rc;
+}
+
+int fs_stream_file(const char* filename, FsReadCallback cb, void* ctx) {
+    uint64_t start = trace_enter();
+    int rc = stream_file_untraced(filename, 0, UINT64_MAX, cb, ctx);
+    trace_leave(start, TRACE_READ, rc, filename, NULL, 0, 0);
+    return rc;
+}
+
+int fs_stream_range(const char* filename, uint64_t offset, uint64_t len, FsReadCallback cb, void* ctx) {
+    uint64_t start = trace_enter();
+    int rc = stream_file_untraced(filename, offset, len, cb, ctx);
+    trace_leave(start, TRACE_READ, rc, filename, NULL, offset, len);
+    return rc;
+}
+
+char* fs_read_file(const char* filename) {
+    uint64_t start = trace_enter();
+    char* content = read_file_untraced(filename);
+    trace_leave(start, TRACE_READ, content ? 0 : -1, filename, NULL, 0, 0);
+    return content;
+}
+
+int fs_compress_file(const char* filename) {
+    uint64_t start = trace_enter();
+    int rc = compress_file_untraced(filename);
+    trace_leave(start, TRACE_COMPRESS, rc, filename, NULL, 0, 0);
+    return rc;
+}
+
+int fs_copy_file(const char* source_name, const char* dest_path, int reflink) {
+    uint64_t start = trace_enter();
+    int rc = copy_file_untraced(source_name, dest_path, reflink);
+    trace_leave(start, TRACE_COPY, rc, source_name, dest_path, reflink != 0, 0);
+    return rc;
+}
+
+int fs_truncate_file(const char* filename, uint64_t size) {
+    uint64_t start = trace_enter();
+    int rc = truncate_file_untraced(filename, size);
+    trace_leave(start, TRACE_TRUNCATE, rc, filename, NULL, size, 0);
+    return rc;
+}
+
+int fs_write_at(const char* filename, uint64_t offset, const char* data, size_t len) {
+    uint64_t start = trace_enter();
+    int rc = write_at_untraced(filename, offset, data, len);
+    trace_leave(start, TRACE_WRITE, rc, filename, NULL, offset, len);
+    return rc;
+}
+
+int fs_punch_file(const char* filename, uint64_t offset, uint64_t len) {
+    uint64_t start = trace_enter();
+    int rc = punch_file_untraced(filename, offset, len);
+    trace_leave(start, TRACE_PUNCH, rc, filename, NULL, offset, len);
+    return rc;
+}
+
+int fs_find(const char* path, const char* pattern, int walk, FsFindCallback cb, void* cb_ctx) {
+    uint64_t start = trace_enter();
+    int found = find_untraced(path, pattern, walk, cb, cb_ctx);
+    trace_leave(start, TRACE_FIND, found < 0 ? -1 : 0, path, pattern, walk != 0, 0);
+    return found;
+}
+
+int fs_defrag(const char* name, int compact, uint32_t budget_ms, DefragReport* report) {
+    uint64_t start = trace_enter();
+    int rc = defrag_untraced(name, compact, budget_ms, report);
+    trace_leave(start, TRACE_DEFRAG, rc, name, NULL, compact != 0, budget_ms);
+    return rc;
+}
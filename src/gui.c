@@ -5,48 +5,381 @@
 GtkWidget *icon_view;
 GtkListStore *list_store;
 
+// Linhas inseridas por vez; o restante de um diretório grande entra aos
+// poucos pelo laço principal, sem travar a interface
+#define LS_PAGE_SIZE 256
+
+static GdkPixbuf *folder_pixbuf = NULL;
+static GdkPixbuf *file_pixbuf = NULL;
+static char shown_path[1024] = "";     // Diretório que as linhas atuais mostram
+static FileList pending_list = {0};    // Listagem cujas entradas ainda faltam inserir
+static size_t pending_next = 0;
+static guint pending_source = 0;
+
+// O núcleo não é thread-safe: toda chamada fs_* passa por este mutex, tanto
+// no laço principal quanto na thread de trabalho
+static GMutex fs_mutex;
+
+static void on_icon_theme_changed(GtkIconTheme *theme, gpointer user_data) {
+    // As linhas existentes mantêm sua referência; as próximas usam o tema novo
+    g_clear_object(&folder_pixbuf);
+    g_clear_object(&file_pixbuf);
+}
+
+// Os ícones são carregados uma única vez e compartilhados por todas as linhas.
+static GdkPixbuf *icon_for_type(int type) {
+    static gboolean theme_watched = FALSE;
+    GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
+    if (!theme_watched) {
+        g_signal_connect(icon_theme, "changed", G_CALLBACK(on_icon_theme_changed), NULL);
+        theme_watched = TRUE;
+    }
+    GdkPixbuf **cached = type == TYPE_DIR ? &folder_pixbuf : &file_pixbuf;
+    if (!*cached) {
+        const char *icon_name = type == TYPE_DIR ? "folder" : "text-x-generic";
+        *cached = gtk_icon_theme_load_icon(icon_theme, icon_name, 48, 0, NULL);
+    }
+    return *cached;
+}
+
+static void cancel_pending_rows() {
+    if (pending_source) {
+        g_source_remove(pending_source);
+        pending_source = 0;
+    }
+    free(pending_list.entries);
+    pending_list = (FileList){0};
+    pending_next = 0;
+}
+
+// Insere a próxima página da listagem pendente. Entradas com nome vazio já
+// estão na tela (marcadas pelo diff em update_ls).
+static gboolean append_pending_page(gpointer user_data) {
+    size_t end = pending_next + LS_PAGE_SIZE;
+    if (end > pending_list.count) end = pending_list.count;
+    for (; pending_next < end; ++pending_next) {
+        const FileEntry *entry = &pending_list.entries[pending_next];
+        if (entry->name[0] == '\0' || strcmp(entry->name, ".") == 0)
+            continue;
+        gtk_list_store_insert_with_values(list_store, NULL, -1,
+                                          0, icon_for_type(entry->type),
+                                          1, entry->name,
+                                          2, entry->type,
+                                          -1);
+    }
+    if (pending_next < pending_list.count)
+        return G_SOURCE_CONTINUE;
+    pending_source = 0;
+    free(pending_list.entries);
+    pending_list = (FileList){0};
+    pending_next = 0;
+    return G_SOURCE_REMOVE;
+}
+
 void update_ls() {
-    gtk_list_store_clear(list_store);
+    cancel_pending_rows();
 
+    char path[sizeof(shown_path)];
+    g_mutex_lock(&fs_mutex);
+    fs_get_current_path(path, sizeof(path));
     FileList file_list = fs_list_directory();
+    g_mutex_unlock(&fs_mutex);
 
-    for (size_t i = 0; i < file_list.count; ++i) {
-        if (strcmp(file_list.entries[i].name, ".") == 0)
-            continue;
+    if (strcmp(path, shown_path) != 0) {
+        // Outro diretório: nenhuma linha atual pode ser aproveitada
+        gtk_list_store_clear(list_store);
+        g_strlcpy(shown_path, path, sizeof(shown_path));
+    } else {
+        // Mesmo diretório: remove só as linhas que sumiram ou mudaram de tipo
+        // e marca as que continuam, para inserir apenas as entradas novas
+        GHashTable *fresh = g_hash_table_new(g_str_hash, g_str_equal);
+        for (size_t i = 0; i < file_list.count; ++i)
+            g_hash_table_insert(fresh, file_list.entries[i].name, &file_list.entries[i]);
 
+        GtkTreeModel *model = GTK_TREE_MODEL(list_store);
         GtkTreeIter iter;
-        gtk_list_store_append(list_store, &iter);
+        gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+        while (valid) {
+            char *name = NULL;
+            int type = -1;
+            gtk_tree_model_get(model, &iter, 1, &name, 2, &type, -1);
+            FileEntry *entry = g_hash_table_lookup(fresh, name);
+            if (entry && (int) entry->type == type) {
+                g_hash_table_remove(fresh, name);
+                entry->name[0] = '\0';
+                valid = gtk_tree_model_iter_next(model, &iter);
+            } else {
+                valid = gtk_list_store_remove(list_store, &iter);
+            }
+            g_free(name);
+        }
+        g_hash_table_destroy(fresh);
+    }
 
-        // Carrega o ícone do tema GTK
-        GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
-        GtkIconInfo *icon_info;
-        GError *error = NULL;
+    // A primeira página entra já; o resto fica para quando o laço estiver ocioso
+    pending_list = file_list;
+    pending_next = 0;
+    if (append_pending_page(NULL) == G_SOURCE_CONTINUE)
+        pending_source = g_idle_add(append_pending_page, NULL);
+}
+
+// --- Operações em segundo plano ---
+// Importar, deletar, mover e renomear rodam numa thread de trabalho que consome
+// uma fila. A barra de progresso é atualizada pelo laço principal (g_idle_add)
+// e a listagem é refeita uma única vez, quando a fila esvazia. O fs_mutex é
+// tomado a cada arquivo, não pelo trabalho inteiro: entre um item e outro o
+// laço principal consegue listar, abrir e mudar de diretório.
+
+typedef enum { JOB_IMPORT, JOB_DELETE, JOB_MOVE, JOB_RENAME, JOB_QUIT } JobKind;
+
+typedef struct {
+    JobKind kind;
+    char *src;   // Caminho no host (importação) ou no simulador
+    char *dest;  // Caminho de destino no simulador (importação, mover e renomear)
+} FsJob;
+
+static GAsyncQueue *job_queue = NULL;
+static GThread *job_thread = NULL;
+static GtkWidget *job_box = NULL;
+static GtkWidget *job_progress = NULL;
+static gint jobs_cancelled = 0;        // Lido pela thread de trabalho (atômico)
+
+// Estado do lote atual, protegido por job_state_mutex
+static GMutex job_state_mutex;
+static guint jobs_total = 0;
+static guint jobs_done = 0;
+static guint jobs_failed = 0;
+static char job_label[256] = "";
+static gboolean progress_scheduled = FALSE;
+
+// Os trabalhos guardam caminhos absolutos: o usuário pode trocar de diretório
+// enquanto a fila ainda está sendo processada. dir pode ser NULL.
+static char *job_path(const char *dir, const char *name) {
+    char cwd[1024];
+    g_mutex_lock(&fs_mutex);
+    fs_get_current_path(cwd, sizeof(cwd));
+    g_mutex_unlock(&fs_mutex);
+    return dir ? g_build_filename(cwd, dir, name, NULL) : g_build_filename(cwd, name, NULL);
+}
 
-        const char *icon_name = file_list.entries[i].type == TYPE_DIR ? "folder" : "text-x-generic";
-        GdkPixbuf *pixbuf = NULL;
+static const char *job_verb(JobKind kind) {
+    switch (kind) {
+        case JOB_IMPORT: return "Importando";
+        case JOB_DELETE: return "Deletando";
+        case JOB_MOVE:   return "Movendo";
+        case JOB_RENAME: return "Renomeando";
+        default:         return "";
+    }
+}
 
-        icon_info = gtk_icon_theme_lookup_icon(icon_theme, icon_name, 48, 0);
-        if (icon_info) {
-            pixbuf = gtk_icon_info_load_icon(icon_info, &error);
-            g_object_unref(icon_info);
+static void schedule_job_progress();
+
+static void set_job_label(JobKind kind, const char *path) {
+    g_mutex_lock(&job_state_mutex);
+    snprintf(job_label, sizeof(job_label), "%s %s", job_verb(kind), path);
+    g_mutex_unlock(&job_state_mutex);
+    schedule_job_progress();
+}
+
+// Importa um diretório do host criando cada subdiretório e importando cada
+// arquivo numa chamada separada ao núcleo.
+static int import_tree_per_file(const char *host_dir, const char *dest) {
+    g_mutex_lock(&fs_mutex);
+    int rc = fs_create_directory(dest);
+    g_mutex_unlock(&fs_mutex);
+    if (rc != 0) return -1;
+
+    GDir *dir = g_dir_open(host_dir, 0, NULL);
+    if (!dir) return -1;
+    const char *name;
+    while ((name = g_dir_read_name(dir)) && !g_atomic_int_get(&jobs_cancelled)) {
+        char *src = g_build_filename(host_dir, name, NULL);
+        char *dst = g_build_filename(dest, name, NULL);
+        if (g_file_test(src, G_FILE_TEST_IS_DIR)) {
+            if (import_tree_per_file(src, dst) != 0) rc = -1;
+        } else if (g_file_test(src, G_FILE_TEST_IS_REGULAR)) {
+            set_job_label(JOB_IMPORT, src);
+            g_mutex_lock(&fs_mutex);
+            if (fs_import_file(src, dst) != 0) rc = -1;
+            g_mutex_unlock(&fs_mutex);
         }
+        g_free(src);
+        g_free(dst);
+    }
+    g_dir_close(dir);
+    return rc;
+}
 
-        gtk_list_store_set(list_store, &iter,
-                           0, pixbuf,
-                           1, file_list.entries[i].name,
-                           2, file_list.entries[i].type,
-                           -1);
+// Remove um item do simulador; diretórios são esvaziados um item por vez.
+static int delete_per_file(const char *path) {
+    g_mutex_lock(&fs_mutex);
+    int type = fs_check_item_type(path);
+    char cwd[1024];
+    fs_get_current_path(cwd, sizeof(cwd));
+    size_t len = strlen(path);
+    if (type == TYPE_DIR && strncmp(cwd, path, len) == 0 && (cwd[len] == '\0' || cwd[len] == '/')) {
+        g_mutex_unlock(&fs_mutex);
+        fprintf(stderr, "Erro: '%s' contém o diretório atual.\n", path);
+        return -1;
+    }
+    if (type != TYPE_DIR) {
+        set_job_label(JOB_DELETE, path);
+        int rc = fs_delete(path);
+        g_mutex_unlock(&fs_mutex);
+        return rc;
+    }
+    FileList contents = fs_list_path(path);
+    g_mutex_unlock(&fs_mutex);
+
+    int rc = 0;
+    for (size_t i = 0; i < contents.count && !g_atomic_int_get(&jobs_cancelled); ++i) {
+        const char *name = contents.entries[i].name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        char *child = g_build_filename(path, name, NULL);
+        if (delete_per_file(child) != 0) rc = -1;
+        g_free(child);
+    }
+    free(contents.entries);
+    if (rc != 0 || g_atomic_int_get(&jobs_cancelled)) return -1;
+
+    g_mutex_lock(&fs_mutex);
+    rc = fs_remove_directory(path);
+    g_mutex_unlock(&fs_mutex);
+    return rc;
+}
 
-        if (pixbuf)
-            g_object_unref(pixbuf);
+static int run_job(const FsJob *job) {
+    int rc = 0;
+    switch (job->kind) {
+        case JOB_IMPORT:
+            if (g_file_test(job->src, G_FILE_TEST_IS_DIR))
+                return import_tree_per_file(job->src, job->dest);
+            g_mutex_lock(&fs_mutex);
+            rc = fs_import_file(job->src, job->dest);
+            g_mutex_unlock(&fs_mutex);
+            return rc;
+        case JOB_DELETE:
+            return delete_per_file(job->src);
+        case JOB_MOVE:
+            g_mutex_lock(&fs_mutex);
+            rc = fs_move_item(job->src, job->dest);
+            g_mutex_unlock(&fs_mutex);
+            return rc;
+        case JOB_RENAME:
+            g_mutex_lock(&fs_mutex);
+            rc = fs_rename(job->src, job->dest);
+            g_mutex_unlock(&fs_mutex);
+            return rc;
+        default:
+            return 0;
     }
+}
+
+static gboolean on_job_progress(gpointer user_data) {
+    g_mutex_lock(&job_state_mutex);
+    progress_scheduled = FALSE;
+    guint total = jobs_total, done = jobs_done, failed = jobs_failed;
+    char label[sizeof(job_label)];
+    g_strlcpy(label, job_label, sizeof(label));
+    if (done == total) jobs_total = jobs_done = jobs_failed = 0;
+    g_mutex_unlock(&job_state_mutex);
+
+    if (done < total) {
+        char text[sizeof(label) + 32];
+        snprintf(text, sizeof(text), "%s (%u/%u)", label, done + 1, total);
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(job_progress), (double) done / total);
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(job_progress), text);
+        return G_SOURCE_REMOVE;
+    }
+
+    // Lote concluído: só agora a listagem é refeita
+    if (failed > 0)
+        fprintf(stderr, "%u de %u operações falharam.\n", failed, total);
+    g_atomic_int_set(&jobs_cancelled, 0);
+    gtk_widget_hide(job_box);
+    update_ls();
+    return G_SOURCE_REMOVE;
+}
 
-    free(file_list.entries);
+static void schedule_job_progress() {
+    g_mutex_lock(&job_state_mutex);
+    gboolean schedule = !progress_scheduled;
+    progress_scheduled = TRUE;
+    g_mutex_unlock(&job_state_mutex);
+    if (schedule) g_idle_add(on_job_progress, NULL);
+}
+
+static gpointer job_worker(gpointer user_data) {
+    for (;;) {
+        FsJob *job = g_async_queue_pop(job_queue);
+        if (job->kind == JOB_QUIT) {
+            g_free(job);
+            return NULL;
+        }
+
+        int rc = 0;
+        if (!g_atomic_int_get(&jobs_cancelled)) {
+            set_job_label(job->kind, job->src);
+            rc = run_job(job);
+            if (rc != 0)
+                fprintf(stderr, "Erro: %s '%s' falhou.\n", job_verb(job->kind), job->src);
+        }
+
+        g_mutex_lock(&job_state_mutex);
+        jobs_done++;
+        if (rc != 0) jobs_failed++;
+        g_mutex_unlock(&job_state_mutex);
+        schedule_job_progress();
+
+        g_free(job->src);
+        g_free(job->dest);
+        g_free(job);
+    }
+}
+
+// Enfileira uma operação; assume a posse de src e dest.
+static void enqueue_job(JobKind kind, char *src, char *dest) {
+    FsJob *job = g_new(FsJob, 1);
+    job->kind = kind;
+    job->src = src;
+    job->dest = dest;
+
+    g_mutex_lock(&job_state_mutex);
+    jobs_total++;
+    g_mutex_unlock(&job_state_mutex);
+
+    gtk_widget_show(job_box);
+    g_async_queue_push(job_queue, job);
+}
+
+static void on_cancel_jobs(GtkButton *button, gpointer user_data) {
+    // Os trabalhos restantes são descartados; o que está em andamento termina
+    g_atomic_int_set(&jobs_cancelled, 1);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(job_progress), "Cancelando...");
+}
+
+static void start_job_worker() {
+    job_queue = g_async_queue_new();
+    job_thread = g_thread_new("fs-jobs", job_worker, NULL);
+}
+
+static void stop_job_worker() {
+    g_atomic_int_set(&jobs_cancelled, 1);
+    FsJob *quit = g_new0(FsJob, 1);
+    quit->kind = JOB_QUIT;
+    g_async_queue_push(job_queue, quit);
+    g_thread_join(job_thread);
+    g_async_queue_unref(job_queue);
 }
 
 void on_item_properties(GtkMenuItem *menuitem, gpointer user_data) {
     const char *item_name = (const char *) user_data;
+    g_mutex_lock(&fs_mutex);
     Inode inode = fs_stat_item(item_name);
+    DirUsage usage = {0};
+    int has_usage = inode.link_count != 0 && fs_dir_usage(item_name, &usage) == 0;
+    g_mutex_unlock(&fs_mutex);
 
     if (inode.link_count == 0) {
         fprintf(stderr, "Item '%s' não encontrado.\n", item_name);
@@ -61,12 +394,22 @@ void on_item_properties(GtkMenuItem *menuitem, gpointer user_data) {
 
     GtkWidget *content_area = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
     GtkWidget *label = gtk_label_new(NULL);
-    char buffer[256];
+    char buffer[512];
     snprintf(buffer, sizeof(buffer),
-             "Tipo: %s\nLinks: %u\nTamanho: %u bytes\nCriado em: %s\nAcessado em: %s\nModificado em: %s",
+             "Tipo: %s\nLinks: %u\nTamanho: %llu bytes\nCriado em: %s\nAcessado em: %s\nModificado em: %s",
              (inode.type == TYPE_DIR) ? "Diretório" : "Arquivo",
-             inode.link_count, inode.size,
+             inode.link_count, (unsigned long long) inode.size,
              ctime(&inode.created), ctime(&inode.accessed), ctime(&inode.modified));
+    if (has_usage) {
+        size_t used = strlen(buffer);
+        if (inode.type == TYPE_DIR) {
+            snprintf(buffer + used, sizeof(buffer) - used, "\nConteúdo: %u itens, %llu bytes\nEm disco: %llu KB (%u blocos)",
+                     usage.entries, (unsigned long long) usage.bytes, (unsigned long long) usage.kb, usage.blocks);
+        } else {
+            snprintf(buffer + used, sizeof(buffer) - used, "\nEm disco: %llu KB (%u blocos)",
+                     (unsigned long long) usage.kb, usage.blocks);
+        }
+    }
     gtk_label_set_text(GTK_LABEL(label), buffer);
     gtk_box_pack_start(GTK_BOX(content_area), label, TRUE, TRUE, 0);
     gtk_widget_show_all(dialog);
@@ -77,11 +420,7 @@ void on_item_properties(GtkMenuItem *menuitem, gpointer user_data) {
 
 void on_delete_item(GtkMenuItem *menuitem, gpointer user_data) {
     const char *item_name = (const char *) user_data;
-    if (fs_delete(item_name) == 0) {
-        update_ls();
-    } else {
-        fprintf(stderr, "Erro ao deletar '%s'\n", item_name);
-    }
+    enqueue_job(JOB_DELETE, job_path(NULL, item_name), NULL);
     g_free(user_data);
 }
 
@@ -103,11 +442,7 @@ void on_rename_item(GtkMenuItem *menuitem, gpointer user_data) {
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         const char *new_name = gtk_entry_get_text(GTK_ENTRY(entry));
-        if (fs_rename(old_name, new_name) == 0) {
-            update_ls();
-        } else {
-            fprintf(stderr, "Erro ao renomear '%s' para '%s'\n", old_name, new_name);
-        }
+        enqueue_job(JOB_RENAME, job_path(NULL, old_name), job_path(NULL, new_name));
     }
 
     gtk_widget_destroy(dialog);
@@ -145,12 +480,8 @@ void on_drag_data_received(GtkWidget *widget, GdkDragContext *context, gint x, g
             if (dragged_text) {
                 // Drag interno: mover item
                 if (dest_type == TYPE_DIR) {
-                    if (fs_move_item(dragged_text, dest_name) == 0) {
-                        printf("Item '%s' movido para '%s'\n", dragged_text, dest_name);
-                        success = TRUE;
-                    } else {
-                        fprintf(stderr, "Erro ao mover '%s' para '%s'\n", dragged_text, dest_name);
-                    }
+                    enqueue_job(JOB_MOVE, job_path(NULL, dragged_text), job_path(NULL, dest_name));
+                    success = TRUE;
                 } else {
                     fprintf(stderr, "Destino '%s' não é um diretório válido para mover.\n", dest_name);
                 }
@@ -163,21 +494,14 @@ void on_drag_data_received(GtkWidget *widget, GdkDragContext *context, gint x, g
                         gchar *filename = g_filename_from_uri(uris[i], NULL, NULL);
                         if (filename) {
                             gchar *basename = g_path_get_basename(filename);
-
-                            if (fs_change_directory(dest_name) == 0) {
-                                if (fs_import_file(filename, basename) == 0) {
-                                    printf("Importado com sucesso: %s\n", basename);
-                                    success = TRUE;
-                                } else {
-                                    fprintf(stderr, "Falha ao importar: %s\n", basename);
-                                }
-                                fs_change_directory("..");
+                            if (dest_type == TYPE_DIR) {
+                                enqueue_job(JOB_IMPORT, filename, job_path(dest_name, basename));
+                                success = TRUE;
                             } else {
-                                fprintf(stderr, "Erro ao acessar diretório '%s' para importar\n", dest_name);
+                                fprintf(stderr, "Destino '%s' não é um diretório para importar.\n", dest_name);
+                                g_free(filename);
                             }
-
                             g_free(basename);
-                            g_free(filename);
                         }
                     }
                     g_strfreev(uris);
@@ -196,21 +520,16 @@ void on_drag_data_received(GtkWidget *widget, GdkDragContext *context, gint x, g
                 gchar *filename = g_filename_from_uri(uris[i], NULL, NULL);
                 if (filename) {
                     gchar *basename = g_path_get_basename(filename);
-                    if (fs_import_file(filename, basename) == 0) {
-                        printf("Importado com sucesso: %s\n", basename);
-                        success = TRUE;
-                    } else {
-                        fprintf(stderr, "Falha ao importar: %s\n", basename);
-                    }
+                    enqueue_job(JOB_IMPORT, filename, job_path(NULL, basename));
+                    success = TRUE;
                     g_free(basename);
-                    g_free(filename);
                 }
             }
             g_strfreev(uris);
         }
     }
 
-    update_ls();
+    // A listagem é atualizada quando a fila terminar
     gtk_drag_finish(context, success, FALSE, time);
 }
 void on_drag_begin(GtkWidget *widget, GdkDragContext *context, gpointer user_data) {
@@ -264,7 +583,10 @@ void on_create_dir(GtkMenuItem *menuitem, gpointer user_data) {
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         const char *dir_name = gtk_entry_get_text(GTK_ENTRY(entry));
-        if (fs_create_directory(dir_name) == 0) {
+        g_mutex_lock(&fs_mutex);
+        int rc = fs_create_directory(dir_name);
+        g_mutex_unlock(&fs_mutex);
+        if (rc == 0) {
             update_ls();
         } else {
             g_print("Erro ao criar diretório: %s\n", dir_name);
@@ -306,7 +628,9 @@ void on_create_file(GtkMenuItem *menuitem, gpointer user_data) {
         if (strlen(filename) == 0) {
             fprintf(stderr, "Nome do arquivo não pode ser vazio.\n");
         } else {
+            g_mutex_lock(&fs_mutex);
             int item_type = fs_check_item_type(filename);
+            g_mutex_unlock(&fs_mutex);
             if (item_type == TYPE_DIR) {
                 fprintf(stderr, "Já existe um diretório com esse nome.\n");
             } else {
@@ -317,7 +641,10 @@ void on_create_file(GtkMenuItem *menuitem, gpointer user_data) {
                 char *text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
                 printf("Texto do arquivo: %s\n", text);
                 printf("Nome do arquivo: %s\n", filename);
-                if (fs_write_file(filename, text, ">") != 0) {
+                g_mutex_lock(&fs_mutex);
+                int rc = fs_write_file(filename, text, ">");
+                g_mutex_unlock(&fs_mutex);
+                if (rc != 0) {
                     fprintf(stderr, "Erro ao criar o arquivo '%s'\n", filename);
                 } else {
                     g_print("Arquivo '%s' criado com sucesso.\n", filename);
@@ -335,7 +662,9 @@ void on_create_file(GtkMenuItem *menuitem, gpointer user_data) {
 
 void on_disk_usage(GtkMenuItem *menuitem, gpointer user_data) {
     g_print("Informações do disco selecionadas\n");
+    g_mutex_lock(&fs_mutex);
     DiskUsageInfo disk_info = fs_disk_free();
+    g_mutex_unlock(&fs_mutex);
     if (disk_info.total_inodes == 0) {
         fprintf(stderr, "Erro ao obter informações do disco.\n");
         return;
@@ -375,9 +704,9 @@ void on_disk_usage(GtkMenuItem *menuitem, gpointer user_data) {
 
     // Linha espaço (KB)
     gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Espaço (KB)"), 0, 3, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%u", disk_info.free_kb)), 1, 3, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%u", disk_info.used_kb)), 2, 3, 1, 1);
-    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%u", disk_info.total_kb)), 3, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%llu", (unsigned long long) disk_info.free_kb)), 1, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%llu", (unsigned long long) disk_info.used_kb)), 2, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new(g_strdup_printf("%llu", (unsigned long long) disk_info.total_kb)), 3, 3, 1, 1);
 
     gtk_widget_show_all(dialog);
     gtk_dialog_run(GTK_DIALOG(dialog));
@@ -457,11 +786,16 @@ void on_item_activated(GtkIconView *icon_view, GtkTreePath *path, gpointer user_
                            -1);
 
         if (item_type == TYPE_DIR) {
-            if (fs_change_directory(item_name) == 0) {
+            g_mutex_lock(&fs_mutex);
+            int rc = fs_change_directory(item_name);
+            g_mutex_unlock(&fs_mutex);
+            if (rc == 0) {
                 update_ls();
             }
         } else {
+            g_mutex_lock(&fs_mutex);
             char *file_content = fs_read_file(item_name);
+            g_mutex_unlock(&fs_mutex);
             if (file_content) {
                 GtkWidget *dialog = gtk_dialog_new_with_buttons(
                     item_name,
@@ -553,8 +887,23 @@ void create_interface(int argc, char *argv[]) {
 
     gtk_box_pack_start(GTK_BOX(vbox), scrolled_window, TRUE, TRUE, 0);
 
+    // Progresso das operações em segundo plano; só aparece enquanto há fila
+    job_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+    job_progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(job_progress), TRUE);
+    GtkWidget *cancel_button = gtk_button_new_with_label("Cancelar");
+    g_signal_connect(cancel_button, "clicked", G_CALLBACK(on_cancel_jobs), NULL);
+    gtk_box_pack_start(GTK_BOX(job_box), job_progress, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(job_box), cancel_button, FALSE, FALSE, 0);
+    gtk_widget_show(job_progress);
+    gtk_widget_show(cancel_button);
+    gtk_widget_set_no_show_all(job_box, TRUE);
+    gtk_box_pack_end(GTK_BOX(vbox), job_box, FALSE, FALSE, 0);
+
+    start_job_worker();
     update_ls();
 
     gtk_widget_show_all(window);
     gtk_main();
+    stop_job_worker();
 }
@@ -0,0 +1,32 @@
+// src/gui_main.c
+#include <stdio.h>
+#include <unistd.h>
+#include "fs_core.h"
+#include "gui.h"
+
+// Binário da interface gráfica: o único que depende do GTK. O 'simulador'
+// de linha de comando só o executa ('./simulador interface').
+
+#define DISK_PATH "meu_sistema.disk"
+
+int main(int argc, char *argv[]) {
+    // Só cria um disco novo se ainda não houver um: um disco que não monta
+    // (corrompido, de outra versão) não pode ser apagado por engano
+    if (access(DISK_PATH, F_OK) != 0) {
+        uint32_t total_size = 2048;
+        uint32_t block_size = 1;
+        if (fs_format(DISK_PATH, total_size, block_size) != 0) {
+            fprintf(stderr, "ERRO FATAL: Falha ao formatar o disco.\n");
+            return 1;
+        }
+    }
+    if (fs_mount(DISK_PATH) != 0) {
+        fprintf(stderr, "ERRO FATAL: Falha ao montar o disco '%s'.\n", DISK_PATH);
+        return 1;
+    }
+    printf("Disco '%s' montado com sucesso. Bem-vindo!\n", DISK_PATH);
+    create_interface(argc, argv);
+    fs_unmount();
+    printf("Disco desmontado. Encerrando.\n");
+    return 0;
+}
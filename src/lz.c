@@ -0,0 +1,106 @@
+// src/lz.c
+#include <string.h>
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+#define LZ_MAX_OFFSET 65535
+#define LZ_LAST_LITERALS 5 // Os últimos bytes sempre saem como literais
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Grava um comprimento estendido (bytes 255 seguidos do resto).
+static int put_length(uint8_t* dst, size_t* op, size_t cap, size_t len) {
+    while (len >= 255) {
+        if (*op >= cap) return -1;
+        dst[(*op)++] = 255;
+        len -= 255;
+    }
+    if (*op >= cap) return -1;
+    dst[(*op)++] = (uint8_t) len;
+    return 0;
+}
+
+// Uma sequência: token, literais e (se match_len > 0) deslocamento e comprimento da cópia.
+static int put_sequence(uint8_t* dst, size_t* op, size_t cap, const uint8_t* literals, size_t lit_len, size_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    if (*op >= cap) return -1;
+    dst[(*op)++] = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && put_length(dst, op, cap, lit_len - 15) != 0) return -1;
+    if (*op + lit_len > cap) return -1;
+    memcpy(dst + *op, literals, lit_len);
+    *op += lit_len;
+    if (match_len == 0) return 0;
+    if (*op + 2 > cap) return -1;
+    dst[(*op)++] = (uint8_t)(offset & 0xFF);
+    dst[(*op)++] = (uint8_t)(offset >> 8);
+    if (ml >= 15 && put_length(dst, op, cap, ml - 15) != 0) return -1;
+    return 0;
+}
+
+int lz_compress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_capacity) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table)); // Guarda posição + 1; 0 = vazio
+    size_t ip = 0, anchor = 0, op = 0;
+    size_t match_limit = src_len > LZ_LAST_LITERALS + LZ_MIN_MATCH ? src_len - LZ_LAST_LITERALS : 0;
+    while (ip + LZ_MIN_MATCH <= match_limit) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = hash32(seq);
+        size_t ref = table[h];
+        table[h] = (uint32_t)(ip + 1);
+        if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || read32(src + ref - 1) != seq) {
+            ip++;
+            continue;
+        }
+        size_t match = ref - 1;
+        size_t len = LZ_MIN_MATCH;
+        while (ip + len < match_limit && src[match + len] == src[ip + len]) len++;
+        if (put_sequence(dst, &op, dst_capacity, src + anchor, ip - anchor, ip - match, len) != 0) return -1;
+        ip += len;
+        anchor = ip;
+    }
+    if (put_sequence(dst, &op, dst_capacity, src + anchor, src_len - anchor, 0, 0) != 0) return -1;
+    return (int) op;
+}
+
+static int get_length(const uint8_t* src, size_t* ip, size_t src_len, size_t* len) {
+    uint8_t b;
+    do {
+        if (*ip >= src_len) return -1;
+        b = src[(*ip)++];
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz_decompress(const uint8_t* src, size_t src_len, uint8_t* dst, size_t dst_capacity) {
+    size_t ip = 0, op = 0;
+    while (ip < src_len) {
+        uint8_t token = src[ip++];
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && get_length(src, &ip, src_len, &lit_len) != 0) return -1;
+        if (ip + lit_len > src_len || op + lit_len > dst_capacity) return -1;
+        memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == src_len) break; // Última sequência não tem cópia
+        if (ip + 2 > src_len) return -1;
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        size_t match_len = token & 0x0F;
+        if (match_len == 15 && get_length(src, &ip, src_len, &match_len) != 0) return -1;
+        match_len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || op + match_len > dst_capacity) return -1;
+        // Cópia byte a byte: a origem pode sobrepor o destino (repetições)
+        for (size_t i = 0; i < match_len; ++i, ++op) dst[op] = dst[op - offset];
+    }
+    return (int) op;
+}
@@ -3,12 +3,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h> // Para atoi
-#include "fs_core.h"
-#include "commands.h"
-#include "fs_types.h"
-#include "gui.h"
+#include "simfs.h"
 
 #define DISK_PATH "meu_sistema.disk"
+#define GUI_BINARY "simulador-gui"
+#define REPLAY_DISK_PATH "replay.disk"
 
 void prompt() {
     char path_buffer[1024];
@@ -37,9 +36,13 @@ void shell() {
         if (strcmp(cmd, "exit") == 0) {
             break;
         } else if (strcmp(cmd, "ls") == 0) {
-            cmd_ls();
+            cmd_ls(strtok(NULL, " \t"));
         } else if (strcmp(cmd, "df") == 0) {
             cmd_df();
+        } else if (strcmp(cmd, "du") == 0) {
+            cmd_du(strtok(NULL, " \t"));
+        } else if (strcmp(cmd, "sync") == 0) {
+            cmd_sync();
         } else if (strcmp(cmd, "mkdir") == 0) {
             char *arg1 = strtok(NULL, " \t");
             if (arg1) cmd_mkdir(arg1); else printf("Uso: mkdir <nome_dir>\n");
@@ -58,14 +61,40 @@ void shell() {
         } else if (strcmp(cmd, "cat") == 0) {
             char *arg1 = strtok(NULL, " \t");
             if (arg1) cmd_cat(arg1); else printf("Uso: cat <nome_arq>\n");
+        } else if (strcmp(cmd, "compress") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            if (arg1) cmd_compress(arg1); else printf("Uso: compress <nome_arq>\n");
         } else if (strcmp(cmd, "import") == 0) {
             char *arg1 = strtok(NULL, " \t");
             char *arg2 = strtok(NULL, " \t");
-            if (arg1 && arg2) cmd_import(arg1, arg2); else printf("Uso: import <caminho_real> <nome_dest>\n");
+            if (arg1 && strcmp(arg1, "-r") == 0) {
+                char *arg3 = strtok(NULL, " \t");
+                if (arg2 && arg3) cmd_import_tree(arg2, arg3); else printf("Uso: import -r <dir_real> <nome_dest>\n");
+            } else if (arg1 && arg2) cmd_import(arg1, arg2); else printf("Uso: import [-r] <caminho_real> <nome_dest>\n");
         } else if (strcmp(cmd, "rename") == 0) {
             char *arg1 = strtok(NULL, " \t");
             char *arg2 = strtok(NULL, " \t");
             if (arg1 && arg2) cmd_rename(arg1, arg2); else printf("Uso: rename <antigo> <novo>\n");
+        } else if (strcmp(cmd, "cp") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            int reflink = arg1 && strcmp(arg1, "--reflink") == 0;
+            if (reflink) arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            if (arg1 && arg2) cmd_cp(arg1, arg2, reflink); else printf("Uso: cp [--reflink] <origem> <destino>\n");
+        } else if (strcmp(cmd, "truncate") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            if (arg1 && arg2) cmd_truncate(arg1, arg2); else printf("Uso: truncate <arquivo> <tamanho>\n");
+        } else if (strcmp(cmd, "write") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            char *text = strtok(NULL, "\""); // Pega o texto entre aspas
+            if (arg1 && arg2 && text) cmd_write(arg1, arg2, text); else printf("Uso: write <arquivo> <deslocamento> \"texto\"\n");
+        } else if (strcmp(cmd, "punch") == 0) {
+            char *arg1 = strtok(NULL, " \t");
+            char *arg2 = strtok(NULL, " \t");
+            char *arg3 = strtok(NULL, " \t");
+            if (arg1 && arg2 && arg3) cmd_punch(arg1, arg2, arg3); else printf("Uso: punch <arquivo> <deslocamento> <tamanho>\n");
         } else if (strcmp(cmd, "mv") == 0) {
             char *arg1 = strtok(NULL, " \t");
             char *arg2 = strtok(NULL, " \t");
@@ -93,6 +122,37 @@ void shell() {
             } else {
                 printf("Uso: echo \"texto\" >/>> <arquivo>\n");
             }
+        } else if (strcmp(cmd, "find") == 0) {
+            int walk = 0;
+            char *path = NULL, *pattern = NULL, *arg;
+            while ((arg = strtok(NULL, " \t")) != NULL) {
+                if (strcmp(arg, "--walk") == 0) walk = 1;
+                else if (strcmp(arg, "-name") == 0) pattern = strtok(NULL, " \t");
+                else path = arg;
+            }
+            if (pattern) {
+                // Aspas em volta do padrão são opcionais
+                size_t len = strlen(pattern);
+                if (len >= 2 && (pattern[0] == '"' || pattern[0] == '\'') && pattern[len - 1] == pattern[0]) {
+                    pattern[len - 1] = '\0';
+                    pattern++;
+                }
+                cmd_find(path ? path : ".", pattern, walk);
+            } else {
+                printf("Uso: find [--walk] [caminho] -name <padrão>\n");
+            }
+        } else if (strcmp(cmd, "defrag") == 0) {
+            int compact = 0;
+            uint32_t budget_ms = 0;
+            char *name = NULL, *arg;
+            while ((arg = strtok(NULL, " \t")) != NULL) {
+                if (strcmp(arg, "-c") == 0) compact = 1;
+                else if (strcmp(arg, "-t") == 0) {
+                    char *ms = strtok(NULL, " \t");
+                    if (ms) budget_ms = atoi(ms);
+                } else name = arg;
+            }
+            cmd_defrag(name, compact, budget_ms);
         } else if (strcmp(cmd, "set") == 0) {
             char* arg1 = strtok(NULL, " \t");
             char* arg2 = strtok(NULL, " \t");
@@ -111,25 +171,75 @@ void shell() {
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         fprintf(stderr, "Uso:\n");
-        fprintf(stderr, "  %s create <tamanho_disco_kb> <tamanho_bloco_kb>\n", argv[0]);
-        fprintf(stderr, "  %s run\n", argv[0]);
+        fprintf(stderr, "  %s create <tamanho_disco_kb> <tamanho_bloco_kb|auto> [--compress] [--dedup] [--no-checksums]\n", argv[0]);
+        fprintf(stderr, "         [--inode-ratio <bytes>] [--reserve <bytes>] [--profile <script|dir>]\n");
+        fprintf(stderr, "  %s run [--no-checksum] [--direct] [--record <trace>] | run --connect <socket>\n", argv[0]);
+        fprintf(stderr, "  %s serve <socket> [--no-checksum] [--direct] [--record <trace>]\n", argv[0]);
+        fprintf(stderr, "  %s replay <trace> [--threads N] [--speed x] [--disk <caminho>] [--force]\n", argv[0]);
+        fprintf(stderr, "  %s fsck [-y]\n", argv[0]);
+        fprintf(stderr, "  %s upgrade [disco_destino]\n", argv[0]);
         return 1;
     }
 
     if (strcmp(argv[1], "create") == 0) {
-        if (argc != 4) {
-            fprintf(stderr, "Uso: %s create <tamanho_disco_kb> <tamanho_bloco_kb>\n", argv[0]);
+        FormatOptions options = {0};
+        const char* sample = NULL;
+        uint64_t value;
+        int bad_option = argc < 4;
+        for (int i = 4; i < argc; ++i) {
+            if (strcmp(argv[i], "--compress") == 0) options.features |= FEATURE_COMPRESSION;
+            else if (strcmp(argv[i], "--dedup") == 0) options.features |= FEATURE_DEDUP;
+            else if (strcmp(argv[i], "--no-checksums") == 0) options.disabled_features |= FEATURE_CHECKSUMS;
+            else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) sample = argv[++i];
+            else if (strcmp(argv[i], "--inode-ratio") == 0 && i + 1 < argc && parse_bytes(argv[i + 1], &value) == 0 &&
+                     value >= 128 && value <= UINT32_MAX) {
+                options.bytes_per_inode = (uint32_t) value;
+                i++;
+            } else if (strcmp(argv[i], "--reserve") == 0 && i + 1 < argc && parse_bytes(argv[i + 1], &value) == 0 &&
+                       value / 1024 < UINT32_MAX) {
+                options.reserved_kb = (uint32_t) ((value + 1023) / 1024);
+                i++;
+            } else bad_option = 1;
+        }
+        int auto_block = !bad_option && strcmp(argv[3], "auto") == 0;
+        if (bad_option || (auto_block && !sample)) {
+            fprintf(stderr, "Uso: %s create <tamanho_disco_kb> <tamanho_bloco_kb|auto> [--compress] [--dedup] [--no-checksums]\n", argv[0]);
+            fprintf(stderr, "         [--inode-ratio <bytes>] [--reserve <bytes>] [--profile <script|dir>]\n");
+            if (auto_block) fprintf(stderr, "O tamanho de bloco 'auto' precisa de uma amostra em --profile.\n");
             return 1;
         }
-        uint32_t total_size = atoi(argv[2]);
-        uint32_t block_size = atoi(argv[3]);
-        if (fs_format(DISK_PATH, total_size, block_size) != 0) {
+        uint64_t total_size = strtoull(argv[2], NULL, 10);
+        uint32_t block_size = auto_block ? 0 : atoi(argv[3]);
+        if (sample) {
+            // A amostra decide o que não foi dado explicitamente
+            WorkloadProfile profile;
+            if (cmd_profile(sample, block_size, &profile) != 0) return 1;
+            block_size = profile.block_size_kb;
+            if (!options.bytes_per_inode) options.bytes_per_inode = profile.bytes_per_inode;
+        }
+        if (fs_format_with_options(DISK_PATH, total_size, block_size, &options) != 0) {
             fprintf(stderr, "ERRO FATAL: Falha ao formatar o disco.\n");
             return 1;
         }
 
     } else if (strcmp(argv[1], "run") == 0) {
-        if (fs_mount(DISK_PATH) != 0) {
+        MountOptions options = {0};
+        const char* socket_path = NULL;
+        int bad_option = 0;
+        for (int i = 2; i < argc; ++i) {
+            if (strcmp(argv[i], "--no-checksum") == 0) options.no_checksum = 1;
+            else if (strcmp(argv[i], "--direct") == 0) options.direct = 1;
+            else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) options.trace_path = argv[++i];
+            else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) socket_path = argv[++i];
+            else bad_option = 1;
+        }
+        // Como cliente, quem monta o disco (e escolhe as opções) é o servidor
+        if (bad_option || (socket_path && (options.no_checksum || options.direct || options.trace_path))) {
+            fprintf(stderr, "Uso: %s run [--no-checksum] [--direct] [--record <trace>] | run --connect <socket>\n", argv[0]);
+            return 1;
+        }
+        if (socket_path) return client_shell(socket_path) == 0 ? 0 : 1;
+        if (fs_mount_with_options(DISK_PATH, &options) != 0) {
             fprintf(stderr, "ERRO FATAL: Falha ao montar o disco. O arquivo '%s' existe e foi formatado corretamente com o comando 'create'?\n", DISK_PATH);
             return 1;
         }
@@ -138,19 +248,75 @@ int main(int argc, char *argv[]) {
         fs_unmount();
         printf("Disco desmontado. Encerrando.\n");
 
-    } else if (strcmp(argv[1], "interface") == 0) {
+    } else if (strcmp(argv[1], "serve") == 0) {
+        MountOptions options = {0};
+        int bad_option = argc < 3;
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "--no-checksum") == 0) options.no_checksum = 1;
+            else if (strcmp(argv[i], "--direct") == 0) options.direct = 1;
+            else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) options.trace_path = argv[++i];
+            else bad_option = 1;
+        }
+        if (bad_option) {
+            fprintf(stderr, "Uso: %s serve <socket> [--no-checksum] [--direct] [--record <trace>]\n", argv[0]);
+            return 1;
+        }
+        if (server_run(DISK_PATH, argv[2], &options) != 0) return 1;
+        printf("Disco desmontado. Encerrando.\n");
+
+    } else if (strcmp(argv[1], "replay") == 0) {
+        int threads = 1, force = 0;
+        double speed = 0;
+        const char* disk = REPLAY_DISK_PATH;
+        int bad_option = argc < 3;
+        for (int i = 3; i < argc; ++i) {
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) speed = atof(argv[++i]);
+            else if (strcmp(argv[i], "--disk") == 0 && i + 1 < argc) disk = argv[++i];
+            else if (strcmp(argv[i], "--force") == 0) force = 1;
+            else bad_option = 1;
+        }
+        if (bad_option || threads < 1 || threads > 1024 || speed < 0) {
+            fprintf(stderr, "Uso: %s replay <trace> [--threads N] [--speed x] [--disk <caminho>] [--force]\n", argv[0]);
+            return 1;
+        }
+        // Sempre num disco novo, que é formatado: um arquivo existente só é sobrescrito com --force
+        if (!force && access(disk, F_OK) == 0) {
+            fprintf(stderr, "Erro: '%s' já existe. Use --force para sobrescrevê-lo ou --disk para escolher outro arquivo.\n", disk);
+            return 1;
+        }
+        if (trace_replay(argv[2], disk, threads, speed) != 0) return 1;
+
+    } else if (strcmp(argv[1], "fsck") == 0) {
+        int repair = (argc > 2 && strcmp(argv[2], "-y") == 0);
         if (fs_mount(DISK_PATH) != 0) {
-            uint32_t total_size = 2048;
-            uint32_t block_size = 1;
-            if (fs_format(DISK_PATH, total_size, block_size) != 0) {
-                fprintf(stderr, "ERRO FATAL: Falha ao formatar o disco.\n");
-                return 1;
-            }
+            fprintf(stderr, "ERRO FATAL: Falha ao montar o disco '%s'.\n", DISK_PATH);
+            return 1;
         }
-        printf("Disco '%s' montado com sucesso. Bem-vindo!\n", DISK_PATH);
-        create_interface(argc, argv);
+        int problems = cmd_fsck(repair);
         fs_unmount();
-        printf("Disco desmontado. Encerrando.\n");
+        if (problems != 0) return repair && problems > 0 ? 1 : 4;
+
+    } else if (strcmp(argv[1], "upgrade") == 0) {
+        int rc = fs_upgrade(DISK_PATH, argc > 2 ? argv[2] : NULL);
+        if (rc < 0) {
+            fprintf(stderr, "ERRO FATAL: Falha ao converter o disco '%s'.\n", DISK_PATH);
+            return 1;
+        }
+        if (rc == 1) printf("O disco já está no formato v%d.\n", FS_VERSION);
+        else printf("Disco '%s' convertido para o formato v%d.\n", argc > 2 ? argv[2] : DISK_PATH, FS_VERSION);
+
+    } else if (strcmp(argv[1], "interface") == 0) {
+        // A interface gráfica é outro binário, o único ligado ao GTK; ele fica
+        // ao lado deste (ou no PATH, se este foi achado pelo PATH)
+        char gui_path[4096];
+        const char* slash = strrchr(argv[0], '/');
+        if (slash) snprintf(gui_path, sizeof(gui_path), "%.*s/%s", (int) (slash - argv[0]), argv[0], GUI_BINARY);
+        else snprintf(gui_path, sizeof(gui_path), "%s", GUI_BINARY);
+        argv[1] = gui_path;
+        if (slash) execv(gui_path, argv + 1); else execvp(gui_path, argv + 1);
+        fprintf(stderr, "Erro: Não foi possível iniciar '%s'. Compile a interface com 'make'.\n", gui_path);
+        return 1;
     } else {
         fprintf(stderr, "Comando desconhecido: %s\n", argv[1]);
         return 1;
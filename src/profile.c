@@ -0,0 +1,394 @@
+// src/profile.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "profile.h"
+#include "fs_types.h"
+
+// --- Amostra ---
+// Tudo que a escolha da geometria precisa: o tamanho de cada arquivo e o
+// número de entradas de cada diretório (sem contar '.' e '..').
+typedef struct {
+    uint64_t* file_sizes;
+    size_t files, files_cap;
+    uint32_t* dir_entries;
+    size_t dirs, dirs_cap;
+} Sample;
+
+static int sample_add_file(Sample* s, uint64_t size) {
+    if (s->files == s->files_cap) {
+        size_t cap = s->files_cap ? s->files_cap * 2 : 64;
+        uint64_t* tmp = realloc(s->file_sizes, cap * sizeof(uint64_t));
+        if (!tmp) return -1;
+        s->file_sizes = tmp;
+        s->files_cap = cap;
+    }
+    s->file_sizes[s->files++] = size;
+    return 0;
+}
+
+static int sample_add_dir(Sample* s, uint32_t entries) {
+    if (s->dirs == s->dirs_cap) {
+        size_t cap = s->dirs_cap ? s->dirs_cap * 2 : 64;
+        uint32_t* tmp = realloc(s->dir_entries, cap * sizeof(uint32_t));
+        if (!tmp) return -1;
+        s->dir_entries = tmp;
+        s->dirs_cap = cap;
+    }
+    s->dir_entries[s->dirs++] = entries;
+    return 0;
+}
+
+// --- Diretório do Host ---
+static int sample_host_dir(Sample* s, const char* dir_path) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) {
+        fprintf(stderr, "Erro: Não foi possível abrir o diretório '%s'.\n", dir_path);
+        return -1;
+    }
+    uint32_t entries = 0;
+    int rc = 0;
+    struct dirent* ent;
+    while (rc == 0 && (ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        char child[4096];
+        snprintf(child, sizeof(child), "%s/%s", dir_path, ent->d_name);
+        struct stat st;
+        if (lstat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            rc = sample_host_dir(s, child);
+            entries++;
+        } else if (S_ISREG(st.st_mode)) {
+            rc = sample_add_file(s, (uint64_t) st.st_size);
+            entries++;
+        }
+    }
+    closedir(dir);
+    return rc == 0 ? sample_add_dir(s, entries) : -1;
+}
+
+// --- Script de Comandos ---
+// O script é reproduzido sobre uma árvore só de nomes e tamanhos, com o
+// diretório atual acompanhando os 'cd'. Caminhos ficam absolutos ("/a/b").
+
+typedef struct {
+    char* path;
+    uint64_t size;
+    int is_dir;
+} ScriptNode;
+
+typedef struct {
+    ScriptNode* nodes;
+    size_t count, cap;
+    char cwd[1024];
+} ScriptTree;
+
+static ScriptNode* tree_find(ScriptTree* t, const char* path) {
+    for (size_t i = 0; i < t->count; ++i) if (strcmp(t->nodes[i].path, path) == 0) return &t->nodes[i];
+    return NULL;
+}
+
+static ScriptNode* tree_add(ScriptTree* t, const char* path, int is_dir) {
+    ScriptNode* node = tree_find(t, path);
+    if (node) return node;
+    if (t->count == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        ScriptNode* tmp = realloc(t->nodes, cap * sizeof(ScriptNode));
+        if (!tmp) return NULL;
+        t->nodes = tmp;
+        t->cap = cap;
+    }
+    node = &t->nodes[t->count];
+    node->path = strdup(path);
+    if (!node->path) return NULL;
+    node->size = 0;
+    node->is_dir = is_dir;
+    t->count++;
+    return node;
+}
+
+static void tree_remove(ScriptTree* t, const char* path) {
+    size_t len = strlen(path);
+    for (size_t i = 0; i < t->count;) {
+        const char* p = t->nodes[i].path;
+        if (strcmp(p, path) == 0 || (strncmp(p, path, len) == 0 && p[len] == '/')) {
+            free(t->nodes[i].path);
+            t->nodes[i] = t->nodes[--t->count];
+        } else {
+            i++;
+        }
+    }
+}
+
+// Troca o prefixo 'from' por 'to' no próprio nó e em tudo abaixo dele.
+static void tree_move(ScriptTree* t, const char* from, const char* to) {
+    size_t len = strlen(from);
+    for (size_t i = 0; i < t->count; ++i) {
+        const char* p = t->nodes[i].path;
+        if (strcmp(p, from) != 0 && !(strncmp(p, from, len) == 0 && p[len] == '/')) continue;
+        char moved[2048];
+        snprintf(moved, sizeof(moved), "%s%s", to, p + len);
+        char* copy = strdup(moved);
+        if (!copy) continue;
+        free(t->nodes[i].path);
+        t->nodes[i].path = copy;
+    }
+}
+
+// Resolve 'arg' (absoluto ou relativo ao diretório atual, com '.' e '..').
+static void tree_resolve(const ScriptTree* t, const char* arg, char* out, size_t out_size) {
+    char buffer[2048];
+    snprintf(buffer, sizeof(buffer), "%s/%s", arg[0] == '/' ? "" : t->cwd, arg);
+    out[0] = '\0';
+    size_t len = 0;
+    for (char* part = strtok(buffer, "/"); part; part = strtok(NULL, "/")) {
+        if (strcmp(part, ".") == 0) continue;
+        if (strcmp(part, "..") == 0) {
+            char* slash = strrchr(out, '/');
+            if (slash) *slash = '\0';
+            len = strlen(out);
+            continue;
+        }
+        len += snprintf(out + len, len < out_size ? out_size - len : 0, "/%s", part);
+    }
+}
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// Texto entre aspas da linha; devolve o ponteiro logo após a aspa final.
+static char* quoted_text(char* line, size_t* len) {
+    char* open = strchr(line, '"');
+    char* close = open ? strchr(open + 1, '"') : NULL;
+    if (!close) return NULL;
+    *len = close - open - 1;
+    return close + 1;
+}
+
+static int script_import_tree(ScriptTree* t, const char* host_dir, const char* dest) {
+    if (!tree_add(t, dest, 1)) return -1;
+    DIR* dir = opendir(host_dir);
+    if (!dir) return 0;
+    struct dirent* ent;
+    int rc = 0;
+    while (rc == 0 && (ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) continue;
+        char child[4096], dest_child[2048];
+        snprintf(child, sizeof(child), "%s/%s", host_dir, ent->d_name);
+        snprintf(dest_child, sizeof(dest_child), "%s/%s", dest, ent->d_name);
+        struct stat st;
+        if (lstat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            rc = script_import_tree(t, child, dest_child);
+        } else if (S_ISREG(st.st_mode)) {
+            ScriptNode* node = tree_add(t, dest_child, 0);
+            if (!node) rc = -1;
+            else node->size = st.st_size;
+        }
+    }
+    closedir(dir);
+    return rc;
+}
+
+static void script_line(ScriptTree* t, char* line) {
+    char work[1024];
+    snprintf(work, sizeof(work), "%s", line);
+    char* cmd = strtok(work, " \t");
+    if (!cmd || cmd[0] == '#') return;
+    char path[1024], other[1024];
+    if (strcmp(cmd, "echo") == 0 || strcmp(cmd, "write") == 0) {
+        size_t text_len;
+        char* rest = quoted_text(line, &text_len);
+        if (!rest) return;
+        if (strcmp(cmd, "echo") == 0) {
+            char* op = strtok(rest, " \t");
+            char* name = strtok(NULL, " \t");
+            if (!op || !name) return;
+            tree_resolve(t, name, path, sizeof(path));
+            ScriptNode* node = tree_add(t, path, 0);
+            if (node) node->size = (strcmp(op, ">>") == 0 ? node->size : 0) + text_len;
+        } else {
+            char* name = strtok(NULL, " \t");
+            char* offset = strtok(NULL, " \t");
+            if (!name || !offset) return;
+            tree_resolve(t, name, path, sizeof(path));
+            ScriptNode* node = tree_add(t, path, 0);
+            uint64_t end = strtoull(offset, NULL, 10) + text_len;
+            if (node && end > node->size) node->size = end;
+        }
+        return;
+    }
+    char* arg1 = strtok(NULL, " \t");
+    char* arg2 = strtok(NULL, " \t");
+    char* arg3 = strtok(NULL, " \t");
+    if (!arg1) return;
+    if (strcmp(cmd, "mkdir") == 0) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        tree_add(t, path, 1);
+    } else if (strcmp(cmd, "cd") == 0) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        snprintf(t->cwd, sizeof(t->cwd), "%s", path);
+    } else if (strcmp(cmd, "import") == 0 && strcmp(arg1, "-r") == 0 && arg2 && arg3) {
+        tree_resolve(t, arg3, path, sizeof(path));
+        script_import_tree(t, arg2, path);
+    } else if (strcmp(cmd, "import") == 0 && arg2) {
+        struct stat st;
+        tree_resolve(t, arg2, path, sizeof(path));
+        ScriptNode* node = tree_add(t, path, 0);
+        if (node && stat(arg1, &st) == 0) node->size = st.st_size;
+    } else if (strcmp(cmd, "truncate") == 0 && arg2) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        ScriptNode* node = tree_add(t, path, 0);
+        char* suffix;
+        uint64_t size = strtoull(arg2, &suffix, 10);
+        if (*suffix == 'K' || *suffix == 'k') size *= 1024;
+        else if (*suffix == 'M' || *suffix == 'm') size *= 1024 * 1024;
+        if (node) node->size = size;
+    } else if (strcmp(cmd, "cp") == 0) {
+        if (strcmp(arg1, "--reflink") == 0) {
+            arg1 = arg2;
+            arg2 = arg3;
+        }
+        if (!arg1 || !arg2) return;
+        tree_resolve(t, arg1, path, sizeof(path));
+        ScriptNode* source = tree_find(t, path);
+        uint64_t size = source ? source->size : 0;
+        tree_resolve(t, arg2, other, sizeof(other));
+        ScriptNode* node = tree_add(t, other, 0);
+        if (node) node->size = size;
+    } else if ((strcmp(cmd, "rm") == 0 || strcmp(cmd, "rmdir") == 0)) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        tree_remove(t, path);
+    } else if (strcmp(cmd, "rename") == 0 && arg2) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        tree_resolve(t, arg2, other, sizeof(other));
+        if (tree_find(t, path)) tree_move(t, path, other);
+    } else if (strcmp(cmd, "mv") == 0 && arg2) {
+        tree_resolve(t, arg1, path, sizeof(path));
+        tree_resolve(t, arg2, other, sizeof(other));
+        // Destino longo demais para o buffer: o item fica onde estava
+        size_t len = strlen(other);
+        const char* name = base_name(path);
+        if (len + 1 + strlen(name) >= sizeof(other)) return;
+        other[len] = '/';
+        strcpy(other + len + 1, name);
+        if (tree_find(t, path)) tree_move(t, path, other);
+    }
+}
+
+static int sample_script(Sample* s, const char* script_path) {
+    FILE* f = fopen(script_path, "r");
+    if (!f) {
+        fprintf(stderr, "Erro: Não foi possível abrir o script '%s'.\n", script_path);
+        return -1;
+    }
+    ScriptTree tree = {0};
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        script_line(&tree, line);
+    }
+    fclose(f);
+    // Entradas de cada diretório: os nós cujo pai é ele ('' é a raiz)
+    int rc = 0;
+    for (size_t d = 0; d <= tree.count && rc == 0; ++d) {
+        const char* dir = d < tree.count ? tree.nodes[d].path : "";
+        if (d < tree.count && !tree.nodes[d].is_dir) continue;
+        size_t len = strlen(dir);
+        uint32_t entries = 0;
+        for (size_t i = 0; i < tree.count; ++i) {
+            const char* p = tree.nodes[i].path;
+            if (strncmp(p, dir, len) == 0 && p[len] == '/' && !strchr(p + len + 1, '/')) entries++;
+        }
+        rc = sample_add_dir(s, entries);
+    }
+    for (size_t i = 0; i < tree.count; ++i) {
+        if (rc == 0 && !tree.nodes[i].is_dir) rc = sample_add_file(s, tree.nodes[i].size);
+        free(tree.nodes[i].path);
+    }
+    free(tree.nodes);
+    return rc;
+}
+
+// --- Escolha da Geometria ---
+
+static void evaluate(const Sample* s, ProfileCandidate* c) {
+    uint64_t bs = (uint64_t) c->block_size_kb * 1024;
+    c->viable = 1;
+    c->used_bytes = c->wasted_bytes = 0;
+    for (size_t i = 0; i < s->files; ++i) {
+        uint64_t size = s->file_sizes[i];
+        if (size <= INODE_INLINE_SIZE) continue;
+        uint64_t blocks = (size + bs - 1) / bs;
+        if (blocks > INODE_DIRECT_BLOCKS) c->viable = 0;
+        c->used_bytes += blocks * bs;
+        c->wasted_bytes += blocks * bs - size;
+    }
+    // Sem os nomes, cada entrada conta como o maior registro (64 bytes)
+    for (size_t i = 0; i < s->dirs; ++i) {
+        uint64_t bytes = (uint64_t) (s->dir_entries[i] + 2) * sizeof(DirectoryEntry);
+        uint64_t blocks = (bytes + bs - 1) / bs;
+        if (blocks > INODE_DIRECT_BLOCKS) c->viable = 0;
+        c->used_bytes += blocks * bs;
+        c->wasted_bytes += blocks * bs - bytes;
+    }
+}
+
+int profile_workload(const char* path, WorkloadProfile* profile) {
+    memset(profile, 0, sizeof(WorkloadProfile));
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Erro: Amostra '%s' não encontrada.\n", path);
+        return -1;
+    }
+    Sample s = {0};
+    int rc = S_ISDIR(st.st_mode) ? sample_host_dir(&s, path) : sample_script(&s, path);
+    if (rc == 0) {
+        profile->files = s.files;
+        profile->dirs = s.dirs;
+        for (size_t i = 0; i < s.files; ++i) {
+            profile->total_bytes += s.file_sizes[i];
+            if (s.file_sizes[i] > profile->max_file) profile->max_file = s.file_sizes[i];
+            if (s.file_sizes[i] <= INODE_INLINE_SIZE) profile->inline_files++;
+        }
+        for (size_t i = 0; i < s.dirs; ++i) {
+            if (s.dir_entries[i] > profile->max_fanout) profile->max_fanout = s.dir_entries[i];
+        }
+        for (int c = 0; c < PROFILE_CANDIDATES; ++c) {
+            profile->candidates[c].block_size_kb = 1u << c;
+            evaluate(&s, &profile->candidates[c]);
+        }
+    }
+    free(s.file_sizes);
+    free(s.dir_entries);
+    return rc;
+}
+
+void profile_choose_geometry(WorkloadProfile* profile, uint32_t block_size_kb) {
+    const ProfileCandidate* best = NULL;
+    for (int c = 0; c < PROFILE_CANDIDATES; ++c) {
+        const ProfileCandidate* cand = &profile->candidates[c];
+        if (block_size_kb) {
+            if (cand->block_size_kb == block_size_kb) best = cand;
+            continue;
+        }
+        // Empate no desperdício: o bloco maior lê cada arquivo com menos requisições
+        if (cand->viable && (!best || cand->wasted_bytes <= best->wasted_bytes)) best = cand;
+    }
+    if (!best && !block_size_kb) best = &profile->candidates[PROFILE_CANDIDATES - 1];
+    profile->block_size_kb = best ? best->block_size_kb : block_size_kb;
+
+    // Cada item da amostra ocupa, em média, 'per_item' bytes do disco. Com
+    // metade disso por i-node sobra folga para o dobro de itens pequenos. O
+    // mínimo de 2 KB limita os metadados por i-node (tabela, uso e índice de
+    // nomes, ~170 bytes) a menos de 10% do disco.
+    uint32_t items = profile->files + profile->dirs;
+    uint64_t per_item = (best && items) ? best->used_bytes / items : (uint64_t) profile->block_size_kb * 4096;
+    uint64_t ratio = 2048;
+    while (ratio * 2 <= per_item / 2 && ratio < (1u << 24)) ratio *= 2;
+    profile->bytes_per_inode = (uint32_t) ratio;
+}
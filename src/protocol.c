@@ -0,0 +1,227 @@
+// src/protocol.c
+#include <stdlib.h>
+#include <string.h>
+#include "protocol.h"
+
+// --- Escrita ---
+
+int proto_reserve(ProtoBuf* buf, size_t extra) {
+    if (buf->len + extra <= buf->cap) return 0;
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->len + extra) cap *= 2;
+    uint8_t* data = realloc(buf->data, cap);
+    if (!data) return -1;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+int proto_put(ProtoBuf* buf, const void* data, size_t len) {
+    if (proto_reserve(buf, len) != 0) return -1;
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+int proto_put_u8(ProtoBuf* buf, uint8_t value) {
+    return proto_put(buf, &value, sizeof(value));
+}
+
+static int proto_put_u16(ProtoBuf* buf, uint16_t value) {
+    return proto_put(buf, &value, sizeof(value));
+}
+
+int proto_put_u32(ProtoBuf* buf, uint32_t value) {
+    return proto_put(buf, &value, sizeof(value));
+}
+
+int proto_put_u64(ProtoBuf* buf, uint64_t value) {
+    return proto_put(buf, &value, sizeof(value));
+}
+
+int proto_put_str(ProtoBuf* buf, const char* text) {
+    size_t len = strlen(text);
+    if (len > UINT16_MAX) return -1;
+    if (proto_put_u16(buf, (uint16_t) len) != 0) return -1;
+    return proto_put(buf, text, len);
+}
+
+// tipo (u8) | flags (u32) | size (u64) | link_count (u32) | created, modified, accessed (u64) | direct_blocks
+int proto_put_inode(ProtoBuf* buf, const Inode* inode) {
+    int rc = proto_put_u8(buf, (uint8_t) inode->type);
+    rc |= proto_put_u32(buf, inode->flags);
+    rc |= proto_put_u64(buf, inode->size);
+    rc |= proto_put_u32(buf, inode->link_count);
+    rc |= proto_put_u64(buf, (uint64_t) inode->created);
+    rc |= proto_put_u64(buf, (uint64_t) inode->modified);
+    rc |= proto_put_u64(buf, (uint64_t) inode->accessed);
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) rc |= proto_put_u32(buf, inode->direct_blocks[i]);
+    return rc ? -1 : 0;
+}
+
+int proto_put_usage(ProtoBuf* buf, const DiskUsageInfo* usage) {
+    int rc = proto_put_u32(buf, usage->free_inodes);
+    rc |= proto_put_u32(buf, usage->free_blocks);
+    rc |= proto_put_u32(buf, usage->total_inodes);
+    rc |= proto_put_u32(buf, usage->total_blocks);
+    rc |= proto_put_u64(buf, usage->used_kb);
+    rc |= proto_put_u64(buf, usage->total_kb);
+    rc |= proto_put_u64(buf, usage->free_kb);
+    rc |= proto_put_u32(buf, usage->used_blocks);
+    rc |= proto_put_u32(buf, usage->used_inodes);
+    rc |= proto_put_u32(buf, usage->logical_blocks);
+    rc |= proto_put_u64(buf, usage->logical_kb);
+    return rc ? -1 : 0;
+}
+
+int proto_put_dir_usage(ProtoBuf* buf, const DirUsage* usage) {
+    int rc = proto_put_u64(buf, usage->bytes);
+    rc |= proto_put_u32(buf, usage->blocks);
+    rc |= proto_put_u64(buf, usage->kb);
+    rc |= proto_put_u32(buf, usage->entries);
+    return rc ? -1 : 0;
+}
+
+void proto_consume(ProtoBuf* buf, size_t n) {
+    if (n >= buf->len) {
+        buf->len = 0;
+        return;
+    }
+    memmove(buf->data, buf->data + n, buf->len - n);
+    buf->len -= n;
+}
+
+void proto_free(ProtoBuf* buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+}
+
+// --- Cabeçalho ---
+
+size_t proto_begin(ProtoBuf* buf, uint16_t op, int16_t status, uint32_t id) {
+    size_t start = buf->len;
+    ProtoHeader header = { 0, op, status, id };
+    if (proto_reserve(buf, PROTO_HEADER_SIZE) == 0) {
+        memcpy(buf->data + buf->len, &header.length, 4);
+        memcpy(buf->data + buf->len + 4, &header.op, 2);
+        memcpy(buf->data + buf->len + 6, &header.status, 2);
+        memcpy(buf->data + buf->len + 8, &header.id, 4);
+        buf->len += PROTO_HEADER_SIZE;
+    }
+    return start;
+}
+
+void proto_end(ProtoBuf* buf, size_t start) {
+    if (buf->len < start + PROTO_HEADER_SIZE) return;
+    uint32_t length = (uint32_t) (buf->len - start - PROTO_HEADER_SIZE);
+    memcpy(buf->data + start, &length, 4);
+}
+
+void proto_set_status(ProtoBuf* buf, size_t start, int16_t status) {
+    if (buf->len < start + PROTO_HEADER_SIZE) return;
+    memcpy(buf->data + start + 6, &status, 2);
+}
+
+void proto_header(const uint8_t* data, ProtoHeader* header) {
+    memcpy(&header->length, data, 4);
+    memcpy(&header->op, data + 4, 2);
+    memcpy(&header->status, data + 6, 2);
+    memcpy(&header->id, data + 8, 4);
+}
+
+// --- Leitura ---
+
+void proto_reader_init(ProtoReader* r, const uint8_t* data, size_t len) {
+    r->p = data;
+    r->left = len;
+    r->bad = 0;
+}
+
+static int proto_get(ProtoReader* r, void* out, size_t len) {
+    if (r->bad || r->left < len) {
+        r->bad = 1;
+        memset(out, 0, len);
+        return -1;
+    }
+    memcpy(out, r->p, len);
+    r->p += len;
+    r->left -= len;
+    return 0;
+}
+
+uint8_t proto_get_u8(ProtoReader* r) {
+    uint8_t value;
+    proto_get(r, &value, sizeof(value));
+    return value;
+}
+
+static uint16_t proto_get_u16(ProtoReader* r) {
+    uint16_t value;
+    proto_get(r, &value, sizeof(value));
+    return value;
+}
+
+uint32_t proto_get_u32(ProtoReader* r) {
+    uint32_t value;
+    proto_get(r, &value, sizeof(value));
+    return value;
+}
+
+uint64_t proto_get_u64(ProtoReader* r) {
+    uint64_t value;
+    proto_get(r, &value, sizeof(value));
+    return value;
+}
+
+int proto_get_str(ProtoReader* r, char* out, size_t out_size) {
+    uint16_t len = proto_get_u16(r);
+    if (r->bad || len >= out_size || proto_get(r, out, len) != 0) {
+        r->bad = 1;
+        if (out_size > 0) out[0] = '\0';
+        return -1;
+    }
+    out[len] = '\0';
+    return 0;
+}
+
+const uint8_t* proto_get_rest(ProtoReader* r, size_t* len) {
+    const uint8_t* rest = r->p;
+    *len = r->bad ? 0 : r->left;
+    r->p += *len;
+    r->left -= *len;
+    return rest;
+}
+
+void proto_get_inode(ProtoReader* r, Inode* inode) {
+    memset(inode, 0, sizeof(*inode));
+    inode->type = proto_get_u8(r) == TYPE_DIR ? TYPE_DIR : TYPE_FILE;
+    inode->flags = proto_get_u32(r);
+    inode->size = proto_get_u64(r);
+    inode->link_count = proto_get_u32(r);
+    inode->created = (time_t) proto_get_u64(r);
+    inode->modified = (time_t) proto_get_u64(r);
+    inode->accessed = (time_t) proto_get_u64(r);
+    for (int i = 0; i < INODE_DIRECT_BLOCKS; ++i) inode->direct_blocks[i] = proto_get_u32(r);
+}
+
+void proto_get_usage(ProtoReader* r, DiskUsageInfo* usage) {
+    usage->free_inodes = proto_get_u32(r);
+    usage->free_blocks = proto_get_u32(r);
+    usage->total_inodes = proto_get_u32(r);
+    usage->total_blocks = proto_get_u32(r);
+    usage->used_kb = proto_get_u64(r);
+    usage->total_kb = proto_get_u64(r);
+    usage->free_kb = proto_get_u64(r);
+    usage->used_blocks = proto_get_u32(r);
+    usage->used_inodes = proto_get_u32(r);
+    usage->logical_blocks = proto_get_u32(r);
+    usage->logical_kb = proto_get_u64(r);
+}
+
+void proto_get_dir_usage(ProtoReader* r, DirUsage* usage) {
+    usage->bytes = proto_get_u64(r);
+    usage->blocks = proto_get_u32(r);
+    usage->kb = proto_get_u64(r);
+    usage->entries = proto_get_u32(r);
+}
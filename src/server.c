@@ -0,0 +1,408 @@
+// src/server.c
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "fs_core.h"
+#include "protocol.h"
+#include "server.h"
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_OUT_LIMIT (4 * 1024 * 1024) // Respostas acumuladas antes de parar de ler o cliente
+
+typedef struct {
+    int fd;
+    ProtoBuf in;      // Bytes recebidos ainda não processados
+    ProtoBuf out;     // Respostas ainda não enviadas
+    size_t out_sent;
+    int eof;          // O cliente fechou a escrita; fecha depois de responder
+    uint32_t events;  // Eventos registrados no epoll
+} Client;
+
+static volatile sig_atomic_t stop_requested = 0;
+static int active_clients = 0;
+
+static void on_signal(int sig) {
+    (void) sig;
+    stop_requested = 1;
+}
+
+// --- Operações ---
+
+static int read_range_chunk(const char* data, size_t len, void* ctx) {
+    return proto_put((ProtoBuf*) ctx, data, len) != 0 ? -1 : 0;
+}
+
+// Caminhos do find; os que não cabem na resposta só entram na contagem
+typedef struct {
+    ProtoBuf* out;
+    size_t count_at;   // Posição do u32 com quantos caminhos foram enviados
+    uint32_t sent;
+} FindReply;
+
+static int find_reply_path(const char* path, void* ctx) {
+    FindReply* reply = ctx;
+    size_t mark = reply->out->len;
+    if (proto_put_str(reply->out, path) != 0 || reply->out->len > PROTO_MAX_DATA) {
+        reply->out->len = mark;
+        return 1;
+    }
+    reply->sent++;
+    return 0;
+}
+
+// Executa um pedido e acrescenta o resultado em 'out'. Retorna o status.
+static int dispatch(uint16_t op, ProtoReader* r, ProtoBuf* out) {
+    char path[PROTO_MAX_PATH], other[PROTO_MAX_PATH];
+    if (op != OP_STATFS && op != OP_SYNC && proto_get_str(r, path, sizeof(path)) != 0) return PROTO_BAD_REQUEST;
+
+    switch (op) {
+        case OP_LOOKUP: {
+            Inode inode = fs_stat_item(path);
+            if (inode.link_count == 0) return PROTO_FAILED;
+            return proto_put_inode(out, &inode) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_READDIR: {
+            FileList files = fs_list_path(path);
+            if (!files.entries) return PROTO_FAILED;
+            int rc = proto_put_u32(out, (uint32_t) files.count);
+            for (size_t i = 0; i < files.count; i++) {
+                rc |= proto_put_u8(out, (uint8_t) files.entries[i].type);
+                rc |= proto_put_str(out, files.entries[i].name);
+            }
+            free(files.entries);
+            return rc ? PROTO_FAILED : PROTO_OK;
+        }
+        case OP_READ: {
+            uint64_t offset = proto_get_u64(r);
+            uint32_t len = proto_get_u32(r);
+            if (r->bad || len > PROTO_MAX_DATA) return PROTO_BAD_REQUEST;
+            size_t mark = out->len;
+            // Só os blocos do trecho pedido são lidos: o cat do cliente não relê o início a cada pedido
+            if (len > 0 && fs_stream_range(path, offset, len, read_range_chunk, out) != 0) {
+                out->len = mark;
+                return PROTO_FAILED;
+            }
+            return PROTO_OK;
+        }
+        case OP_WRITE: {
+            uint64_t offset = proto_get_u64(r);
+            size_t len;
+            const uint8_t* data = proto_get_rest(r, &len);
+            if (r->bad) return PROTO_BAD_REQUEST;
+            return fs_write_at(path, offset, (const char*) data, len) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_APPEND: {
+            int overwrite = proto_get_u8(r);
+            size_t len;
+            const uint8_t* data = proto_get_rest(r, &len);
+            if (r->bad) return PROTO_BAD_REQUEST;
+            // fs_write_file recebe o texto terminado em '\0'
+            char* text = malloc(len + 1);
+            if (!text) return PROTO_FAILED;
+            memcpy(text, data, len);
+            text[len] = '\0';
+            int rc = fs_write_file(path, text, overwrite ? ">" : ">>");
+            free(text);
+            return rc == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_MKDIR:
+            return fs_create_directory(path) == 0 ? PROTO_OK : PROTO_FAILED;
+        case OP_RMDIR:
+            return fs_remove_directory(path) == 0 ? PROTO_OK : PROTO_FAILED;
+        case OP_UNLINK:
+            return fs_remove_file(path) == 0 ? PROTO_OK : PROTO_FAILED;
+        case OP_RENAME:
+        case OP_MOVE:
+        case OP_COPY: {
+            if (proto_get_str(r, other, sizeof(other)) != 0) return PROTO_BAD_REQUEST;
+            int rc;
+            if (op == OP_RENAME) rc = fs_rename(path, other);
+            else if (op == OP_MOVE) rc = fs_move_item(path, other);
+            else {
+                int reflink = proto_get_u8(r);
+                if (r->bad) return PROTO_BAD_REQUEST;
+                rc = fs_copy_file(path, other, reflink);
+            }
+            return rc == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_TRUNCATE: {
+            uint64_t size = proto_get_u64(r);
+            if (r->bad) return PROTO_BAD_REQUEST;
+            return fs_truncate_file(path, size) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_PUNCH: {
+            uint64_t offset = proto_get_u64(r);
+            uint64_t len = proto_get_u64(r);
+            if (r->bad) return PROTO_BAD_REQUEST;
+            return fs_punch_file(path, offset, len) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_COMPRESS:
+            return fs_compress_file(path) == 0 ? PROTO_OK : PROTO_FAILED;
+        case OP_STATFS: {
+            DiskUsageInfo usage = fs_disk_free();
+            if (usage.total_blocks == 0) return PROTO_FAILED;
+            return proto_put_usage(out, &usage) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_SYNC:
+            return fs_sync() == 0 ? PROTO_OK : PROTO_FAILED;
+        case OP_DU: {
+            DirUsage usage;
+            if (fs_dir_usage(path, &usage) != 0) return PROTO_FAILED;
+            return proto_put_dir_usage(out, &usage) == 0 ? PROTO_OK : PROTO_FAILED;
+        }
+        case OP_FIND: {
+            if (proto_get_str(r, other, sizeof(other)) != 0) return PROTO_BAD_REQUEST;
+            int walk = proto_get_u8(r);
+            if (r->bad) return PROTO_BAD_REQUEST;
+            size_t mark = out->len;
+            if (proto_put_u32(out, 0) != 0 || proto_put_u32(out, 0) != 0) return PROTO_FAILED;
+            FindReply reply = { out, mark + 4, 0 };
+            int found = fs_find(path, other, walk, find_reply_path, &reply);
+            if (found < 0) {
+                out->len = mark;
+                return PROTO_FAILED;
+            }
+            uint32_t total = (uint32_t) found;
+            memcpy(out->data + mark, &total, 4);
+            memcpy(out->data + reply.count_at, &reply.sent, 4);
+            return PROTO_OK;
+        }
+        default:
+            return PROTO_BAD_REQUEST;
+    }
+}
+
+// --- Conexões ---
+
+// Processa os pedidos completos em 'in', em ordem, até a saída acumular
+// SERVER_OUT_LIMIT bytes. Retorna -1 se o cliente mandou algo inválido.
+static int process_requests(Client* c) {
+    size_t pos = 0;
+    while (c->in.len - pos >= PROTO_HEADER_SIZE && c->out.len - c->out_sent < SERVER_OUT_LIMIT) {
+        ProtoHeader header;
+        proto_header(c->in.data + pos, &header);
+        if (header.length > PROTO_MAX_PAYLOAD) {
+            fprintf(stderr, "Erro: Pedido de %u bytes recusado (máximo %d).\n", header.length, PROTO_MAX_PAYLOAD);
+            return -1;
+        }
+        if (c->in.len - pos - PROTO_HEADER_SIZE < header.length) break; // Pedido ainda incompleto
+
+        ProtoReader r;
+        proto_reader_init(&r, c->in.data + pos + PROTO_HEADER_SIZE, header.length);
+        if (proto_reserve(&c->out, PROTO_HEADER_SIZE) != 0) return -1;
+        size_t start = proto_begin(&c->out, header.op, PROTO_OK, header.id);
+        int status = dispatch(header.op, &r, &c->out);
+        if (status != PROTO_OK) {
+            // Respostas de erro não levam dados
+            c->out.len = start + PROTO_HEADER_SIZE;
+            proto_set_status(&c->out, start, (int16_t) status);
+        }
+        proto_end(&c->out, start);
+        pos += PROTO_HEADER_SIZE + header.length;
+    }
+    proto_consume(&c->in, pos);
+    return 0;
+}
+
+// Lê tudo o que já chegou. Retorna -1 em erro de leitura.
+static int receive(Client* c) {
+    while (c->in.len < 2 * (size_t) PROTO_MAX_PAYLOAD) {
+        if (proto_reserve(&c->in, 65536) != 0) return -1;
+        ssize_t n = recv(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len, 0);
+        if (n > 0) {
+            c->in.len += n;
+        } else if (n == 0) {
+            c->eof = 1;
+            return 0;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+// Envia o que der das respostas pendentes. Retorna -1 se o cliente sumiu.
+static int flush(Client* c) {
+    while (c->out_sent < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + c->out_sent, c->out.len - c->out_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->out_sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+    }
+    c->out.len = c->out_sent = 0;
+    return 0;
+}
+
+static void close_client(int epoll_fd, Client* c) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    proto_free(&c->in);
+    proto_free(&c->out);
+    free(c);
+    active_clients--;
+    printf("Cliente desconectado (%d ativo(s)).\n", active_clients);
+}
+
+// Com respostas pendentes, espera o socket aceitar escrita e não lê mais
+// pedidos; sem elas, volta a ler.
+static int update_interest(int epoll_fd, Client* c) {
+    uint32_t events = c->out_sent < c->out.len ? EPOLLOUT : EPOLLIN;
+    if (events == c->events) return 0;
+    struct epoll_event ev = { .events = events, .data.ptr = c };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) != 0) return -1;
+    c->events = events;
+    return 0;
+}
+
+static void handle_client(int epoll_fd, Client* c, uint32_t events) {
+    if ((events & EPOLLIN) && receive(c) != 0) {
+        close_client(epoll_fd, c);
+        return;
+    }
+    if ((events & EPOLLERR) || ((events & EPOLLHUP) && !(events & EPOLLIN))) c->eof = 1;
+    // Processa em lotes enquanto houver pedidos e o cliente estiver aceitando respostas
+    size_t before;
+    do {
+        before = c->in.len;
+        if (flush(c) != 0 || process_requests(c) != 0 || flush(c) != 0) {
+            close_client(epoll_fd, c);
+            return;
+        }
+    } while (c->out_sent == c->out.len && c->in.len >= PROTO_HEADER_SIZE && c->in.len < before);
+    // Um cliente que fechou a conexão sai depois de receber as respostas; um
+    // pedido incompleto que ele tenha deixado é descartado
+    if (c->eof && c->out_sent == c->out.len) {
+        close_client(epoll_fd, c);
+        return;
+    }
+    if (update_interest(epoll_fd, c) != 0) close_client(epoll_fd, c);
+}
+
+static void accept_clients(int epoll_fd, int listen_fd) {
+    while (1) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("Erro ao aceitar conexão");
+            return;
+        }
+        Client* c = calloc(1, sizeof(Client));
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+        if (!c || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            fprintf(stderr, "Erro: Não foi possível registrar o cliente.\n");
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        active_clients++;
+        printf("Cliente conectado (%d ativo(s)).\n", active_clients);
+    }
+}
+
+// --- Socket ---
+
+static int open_listener(const char* socket_path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Erro: Caminho do socket '%s' longo demais.\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("Erro ao criar o socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        // Um socket que sobrou de um servidor encerrado pode ser reaproveitado; um ativo, não
+        int probe = errno == EADDRINUSE ? socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+        int alive = probe >= 0 && connect(probe, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (alive) {
+            fprintf(stderr, "Erro: Já existe um servidor atendendo em '%s'.\n", socket_path);
+            close(fd);
+            return -1;
+        }
+        if (probe < 0 || unlink(socket_path) != 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+            perror("Erro ao abrir o socket");
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        perror("Erro ao abrir o socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char* disk_path, const char* socket_path, const MountOptions* options) {
+    int listen_fd = open_listener(socket_path);
+    if (listen_fd < 0) return -1;
+    if (fs_mount_with_options(disk_path, options) != 0) {
+        fprintf(stderr, "Erro: Falha ao montar o disco '%s'.\n", disk_path);
+        close(listen_fd);
+        unlink(socket_path);
+        return -1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+        perror("Erro ao iniciar o epoll");
+        if (epoll_fd >= 0) close(epoll_fd);
+        close(listen_fd);
+        unlink(socket_path);
+        fs_unmount();
+        return -1;
+    }
+
+    // Sem SA_RESTART: o sinal interrompe o epoll_wait e o laço termina
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    printf("Disco '%s' montado. Atendendo em '%s' (Ctrl+C encerra).\n", disk_path, socket_path);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int rc = 0;
+    while (!stop_requested) {
+        int n = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro no epoll_wait");
+            rc = -1;
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.ptr == NULL) accept_clients(epoll_fd, listen_fd);
+            else handle_client(epoll_fd, events[i].data.ptr, events[i].events);
+        }
+        fflush(stdout);
+    }
+
+    // Clientes ainda conectados perdem a conexão; o disco é desmontado normalmente
+    printf("Encerrando o servidor (%d cliente(s) conectado(s)).\n", active_clients);
+    close(epoll_fd);
+    close(listen_fd);
+    unlink(socket_path);
+    fs_unmount();
+    return rc;
+}
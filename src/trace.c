@@ -0,0 +1,516 @@
+// src/trace.c
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fs_core.h"
+#include "trace.h"
+
+static const char* op_names[TRACE_OP_COUNT] = {
+    [TRACE_LIST] = "ls", [TRACE_MKDIR] = "mkdir", [TRACE_CHDIR] = "cd", [TRACE_RMDIR] = "rmdir",
+    [TRACE_IMPORT] = "import", [TRACE_IMPORT_TREE] = "import -r", [TRACE_UNLINK] = "rm", [TRACE_DELETE] = "delete",
+    [TRACE_RENAME] = "rename", [TRACE_STAT] = "stat", [TRACE_DF] = "df", [TRACE_DU] = "du", [TRACE_ECHO] = "echo",
+    [TRACE_SYNC] = "sync", [TRACE_MOVE] = "mv", [TRACE_READ] = "cat", [TRACE_COMPRESS] = "compress",
+    [TRACE_COPY] = "cp", [TRACE_TRUNCATE] = "truncate", [TRACE_WRITE] = "write", [TRACE_PUNCH] = "punch",
+    [TRACE_FIND] = "find", [TRACE_DEFRAG] = "defrag",
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// --- Gravação ---
+
+static FILE* trace_file = NULL;
+static char* trace_buffer = NULL;
+static uint64_t last_start = 0;   // Início do registro anterior
+static uint64_t recorded = 0;
+static int depth = 0;             // Chamadas públicas em andamento (aninhadas)
+
+static void put_varint(uint64_t value) {
+    uint8_t bytes[10];
+    int n = 0;
+    do {
+        bytes[n] = value & 0x7f;
+        value >>= 7;
+        if (value) bytes[n] |= 0x80;
+        n++;
+    } while (value);
+    fwrite(bytes, 1, n, trace_file);
+}
+
+static void put_string(const char* text) {
+    size_t len = text ? strlen(text) : 0;
+    put_varint(len);
+    if (len) fwrite(text, 1, len, trace_file);
+}
+
+int trace_record_start(const char* path) {
+    uint64_t total_kb;
+    uint32_t block_kb;
+    FormatOptions options;
+    if (trace_file || fs_geometry(&total_kb, &block_kb, &options) != 0) {
+        fprintf(stderr, "Erro: A gravação precisa de um disco montado.\n");
+        return -1;
+    }
+    // Itens que já existem não estarão no disco novo da reprodução
+    DiskUsageInfo usage = fs_disk_free();
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        perror("Erro ao criar o arquivo de trace");
+        return -1;
+    }
+    trace_buffer = malloc(1 << 20);
+    if (trace_buffer) setvbuf(trace_file, trace_buffer, _IOFBF, 1 << 20);
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace_file);
+    put_varint(TRACE_VERSION);
+    put_varint(total_kb);
+    put_varint(block_kb);
+    put_varint(options.features);
+    put_varint(options.bytes_per_inode);
+    put_varint(options.reserved_kb);
+    put_varint(usage.used_inodes);
+    last_start = now_ns();
+    recorded = 0;
+    printf("Gravando as chamadas em '%s'.\n", path);
+    return 0;
+}
+
+void trace_record_stop(void) {
+    if (!trace_file) return;
+    long size = ftell(trace_file);
+    if (fclose(trace_file) != 0) fprintf(stderr, "Erro ao gravar o arquivo de trace.\n");
+    else printf("Trace: %llu chamadas gravadas (%ld bytes).\n", (unsigned long long) recorded, size);
+    trace_file = NULL;
+    free(trace_buffer);
+    trace_buffer = NULL;
+}
+
+uint64_t trace_enter(void) {
+    if (depth++ > 0 || !trace_file) return 0;
+    uint64_t start = now_ns();
+    return start ? start : 1;
+}
+
+void trace_leave(uint64_t start, TraceOp op, int rc, const char* path, const char* path2, uint64_t a, uint64_t b) {
+    depth--;
+    if (!start || !trace_file) return;
+    uint64_t end = now_ns();
+    fputc(op, trace_file);
+    fputc(rc != 0, trace_file);
+    put_varint(start > last_start ? start - last_start : 0);
+    put_varint(end - start);
+    put_varint(a);
+    put_varint(b);
+    put_string(path);
+    put_string(path2);
+    last_start = start;
+    recorded++;
+}
+
+// --- Leitura do Trace ---
+
+typedef struct {
+    uint8_t op;
+    uint8_t failed;
+    uint64_t start;      // Desde o início da gravação
+    uint64_t duration;
+    uint64_t a, b;
+    char* path;          // NULL quando vazio
+    char* path2;
+} TraceRecord;
+
+typedef struct {
+    uint64_t total_kb;
+    uint32_t block_kb;
+    FormatOptions options;
+    uint64_t used_inodes;
+    TraceRecord* records;
+    size_t count;
+    uint64_t max_data;   // Maior texto ou escrita
+} Trace;
+
+typedef struct {
+    const uint8_t* p;
+    size_t left;
+    int bad;
+} Cursor;
+
+static uint64_t get_varint(Cursor* c) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (c->left == 0) break;
+        uint8_t byte = *c->p++;
+        c->left--;
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    c->bad = 1;
+    return 0;
+}
+
+static char* get_string(Cursor* c) {
+    uint64_t len = get_varint(c);
+    if (c->bad || len > c->left) {
+        c->bad = 1;
+        return NULL;
+    }
+    if (len == 0) return NULL;
+    char* text = malloc(len + 1);
+    if (!text) {
+        c->bad = 1;
+        return NULL;
+    }
+    memcpy(text, c->p, len);
+    text[len] = '\0';
+    c->p += len;
+    c->left -= len;
+    return text;
+}
+
+static void trace_free(Trace* trace) {
+    for (size_t i = 0; i < trace->count; i++) {
+        free(trace->records[i].path);
+        free(trace->records[i].path2);
+    }
+    free(trace->records);
+}
+
+static int trace_load(const char* path, Trace* trace) {
+    memset(trace, 0, sizeof(*trace));
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Erro: Não foi possível abrir o trace '%s'.\n", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = size > 0 ? malloc(size) : NULL;
+    if (!data || fread(data, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "Erro: Não foi possível ler o trace '%s'.\n", path);
+        free(data);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    size_t magic_len = strlen(TRACE_MAGIC);
+    Cursor c = { data + magic_len, size - magic_len, 0 };
+    if ((size_t) size < magic_len || memcmp(data, TRACE_MAGIC, magic_len) != 0 || get_varint(&c) != TRACE_VERSION) {
+        fprintf(stderr, "Erro: '%s' não é um trace do simulador (ou é de outra versão).\n", path);
+        free(data);
+        return -1;
+    }
+    trace->total_kb = get_varint(&c);
+    trace->block_kb = (uint32_t) get_varint(&c);
+    trace->options.features = (uint32_t) get_varint(&c);
+    trace->options.disabled_features = ~trace->options.features;
+    trace->options.bytes_per_inode = (uint32_t) get_varint(&c);
+    trace->options.reserved_kb = (uint32_t) get_varint(&c);
+    trace->used_inodes = get_varint(&c);
+
+    size_t capacity = 0;
+    uint64_t clock = 0;
+    while (!c.bad && c.left > 0) {
+        if (trace->count == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            TraceRecord* grown = realloc(trace->records, capacity * sizeof(TraceRecord));
+            if (!grown) {
+                c.bad = 1;
+                break;
+            }
+            trace->records = grown;
+        }
+        TraceRecord* r = &trace->records[trace->count];
+        memset(r, 0, sizeof(*r));
+        if (c.left < 2) {
+            c.bad = 1;
+            break;
+        }
+        r->op = c.p[0];
+        r->failed = c.p[1];
+        c.p += 2;
+        c.left -= 2;
+        clock += get_varint(&c);
+        r->start = clock;
+        r->duration = get_varint(&c);
+        r->a = get_varint(&c);
+        r->b = get_varint(&c);
+        r->path = get_string(&c);
+        r->path2 = get_string(&c);
+        trace->count++;
+        if (r->op == 0 || r->op >= TRACE_OP_COUNT) c.bad = 1;
+        if ((r->op == TRACE_ECHO || r->op == TRACE_WRITE) && r->b > trace->max_data) trace->max_data = r->b;
+    }
+    free(data);
+    if (c.bad) {
+        fprintf(stderr, "Erro: Trace '%s' corrompido no registro %zu.\n", path, trace->count);
+        trace_free(trace);
+        return -1;
+    }
+    return 0;
+}
+
+// --- Reprodução ---
+
+// O fs_core não é reentrante: as threads se revezam nas chamadas, e a
+// latência medida inclui a espera pela vez
+static pthread_mutex_t fs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    const Trace* trace;
+    char prefix[32];      // Diretório da thread ("/replayN"), vazio com uma thread só
+    uint32_t cwd;         // Diretório atual da thread (i-node)
+    char* data;           // Padrão escrito por WRITE e ECHO
+    double speed;
+    uint64_t base;        // Início da reprodução
+    uint64_t* latency;    // Por registro, em ns
+    uint8_t* failed;
+} ReplayThread;
+
+static int discard_chunk(const char* data, size_t len, void* ctx) {
+    (void) data; (void) len; (void) ctx;
+    return 0;
+}
+
+static int discard_path(const char* path, void* ctx) {
+    (void) path; (void) ctx;
+    return 0;
+}
+
+// Caminhos absolutos ficam dentro do diretório da thread
+static const char* thread_path(const ReplayThread* t, const char* path, char* buf, size_t size) {
+    if (!path || path[0] != '/' || !t->prefix[0]) return path;
+    snprintf(buf, size, "%s%s", t->prefix, path);
+    return buf;
+}
+
+static int replay_call(ReplayThread* t, const TraceRecord* r) {
+    char buf1[1024], buf2[1024];
+    const char* path = thread_path(t, r->path ? r->path : "", buf1, sizeof(buf1));
+    const char* path2 = thread_path(t, r->path2 ? r->path2 : "", buf2, sizeof(buf2));
+    switch (r->op) {
+        case TRACE_LIST: {
+            FileList files = fs_list_path(path);
+            int rc = files.entries ? 0 : -1;
+            free(files.entries);
+            return rc;
+        }
+        case TRACE_MKDIR: return fs_create_directory(path);
+        case TRACE_CHDIR: return fs_change_directory(path);
+        case TRACE_RMDIR: return fs_remove_directory(path);
+        // O caminho no host não muda de thread para thread
+        case TRACE_IMPORT: return fs_import_file(r->path ? r->path : "", path2);
+        case TRACE_IMPORT_TREE: return fs_import_tree(r->path ? r->path : "", path2);
+        case TRACE_UNLINK: return fs_remove_file(path);
+        case TRACE_DELETE: return fs_delete(path);
+        case TRACE_RENAME: return fs_rename(path, path2);
+        case TRACE_STAT: return fs_stat_item(path).link_count ? 0 : -1;
+        case TRACE_DF: return fs_disk_free().total_blocks ? 0 : -1;
+        case TRACE_DU: {
+            DirUsage usage;
+            return fs_dir_usage(path, &usage);
+        }
+        case TRACE_ECHO: {
+            char saved = t->data[r->b];
+            t->data[r->b] = '\0';
+            int rc = fs_write_file(path, t->data, r->a ? ">" : ">>");
+            t->data[r->b] = saved;
+            return rc;
+        }
+        case TRACE_SYNC: return fs_sync();
+        case TRACE_MOVE: return fs_move_item(path, path2);
+        case TRACE_READ: return r->b ? fs_stream_range(path, r->a, r->b, discard_chunk, NULL) : fs_stream_file(path, discard_chunk, NULL);
+        case TRACE_COMPRESS: return fs_compress_file(path);
+        case TRACE_COPY: return fs_copy_file(path, path2, (int) r->a);
+        case TRACE_TRUNCATE: return fs_truncate_file(path, r->a);
+        case TRACE_WRITE: return fs_write_at(path, r->a, t->data, r->b);
+        case TRACE_PUNCH: return fs_punch_file(path, r->a, r->b);
+        case TRACE_FIND: return fs_find(path, r->path2 ? r->path2 : "*", (int) r->a, discard_path, NULL) < 0 ? -1 : 0;
+        case TRACE_DEFRAG: {
+            DefragReport report;
+            return fs_defrag(r->path ? path : NULL, (int) r->a, (uint32_t) r->b, &report);
+        }
+        default: return -1;
+    }
+}
+
+static void* replay_thread(void* arg) {
+    ReplayThread* t = arg;
+    const Trace* trace = t->trace;
+    for (size_t i = 0; i < trace->count; i++) {
+        const TraceRecord* r = &trace->records[i];
+        if (t->speed > 0) {
+            // No ritmo gravado: espera o instante do registro (dividido pela velocidade)
+            uint64_t due = t->base + (uint64_t) (r->start / t->speed);
+            struct timespec ts = { (time_t) (due / 1000000000ULL), (long) (due % 1000000000ULL) };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+        }
+        uint64_t start = now_ns();
+        pthread_mutex_lock(&fs_lock);
+        current_inode_num = t->cwd;
+        int rc = replay_call(t, r);
+        t->cwd = current_inode_num;
+        pthread_mutex_unlock(&fs_lock);
+        t->latency[i] = now_ns() - start;
+        t->failed[i] = rc != 0;
+    }
+    return NULL;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const uint64_t* sorted, size_t n, double p) {
+    // Menor amostra com pelo menos p * n amostras até ela
+    size_t index = (size_t) (p * n);
+    if ((double) index < p * n) index++;
+    if (index > 0) index--;
+    if (index >= n) index = n - 1;
+    return sorted[index] / 1e3;
+}
+
+static void print_report(const Trace* trace, const ReplayThread* threads, int nthreads) {
+    uint64_t* samples = malloc(trace->count * nthreads * sizeof(uint64_t));
+    if (!samples) return;
+    printf("%-10s %9s %7s %10s %10s %10s %10s %10s %10s\n", "Operação", "Chamadas", "Falhas", "Média", "p50", "p99",
+           "p99.9", "Máx", "Gravado");
+    uint64_t mismatches = 0;
+    for (int op = 1; op < TRACE_OP_COUNT; op++) {
+        size_t n = 0, recorded_n = 0;
+        uint64_t failures = 0, sum = 0, recorded_sum = 0;
+        for (size_t i = 0; i < trace->count; i++) {
+            const TraceRecord* r = &trace->records[i];
+            if (r->op != op) continue;
+            recorded_sum += r->duration;
+            recorded_n++;
+            for (int k = 0; k < nthreads; k++) {
+                samples[n++] = threads[k].latency[i];
+                sum += threads[k].latency[i];
+                failures += threads[k].failed[i];
+                mismatches += threads[k].failed[i] != r->failed;
+            }
+        }
+        if (n == 0) continue;
+        qsort(samples, n, sizeof(uint64_t), compare_u64);
+        printf("%-10s %9zu %7llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", op_names[op], n,
+               (unsigned long long) failures, sum / 1e3 / n, percentile_us(samples, n, 0.50),
+               percentile_us(samples, n, 0.99), percentile_us(samples, n, 0.999), samples[n - 1] / 1e3,
+               recorded_sum / 1e3 / recorded_n);
+    }
+    printf("(latências em µs; 'Gravado' é a média da gravação original)\n");
+    if (mismatches > 0) {
+        printf("Aviso: %llu chamada(s) tiveram resultado diferente do gravado (sucesso x falha).\n",
+               (unsigned long long) mismatches);
+    }
+    free(samples);
+}
+
+int trace_replay(const char* trace_path, const char* disk_path, int nthreads, double speed) {
+    Trace trace;
+    if (trace_load(trace_path, &trace) != 0) return -1;
+    if (trace.count == 0) {
+        fprintf(stderr, "Erro: O trace '%s' não tem chamadas.\n", trace_path);
+        trace_free(&trace);
+        return -1;
+    }
+    if (trace.used_inodes > 1) {
+        printf("Aviso: a gravação começou num disco com %llu item(ns); as chamadas sobre eles vão falhar no disco novo.\n",
+               (unsigned long long) trace.used_inodes - 1);
+    }
+    if (fs_format_with_options(disk_path, trace.total_kb, trace.block_kb, &trace.options) != 0 || fs_mount(disk_path) != 0) {
+        fprintf(stderr, "Erro: Não foi possível preparar o disco '%s'.\n", disk_path);
+        trace_free(&trace);
+        return -1;
+    }
+
+    ReplayThread* threads = calloc(nthreads, sizeof(ReplayThread));
+    pthread_t* ids = calloc(nthreads, sizeof(pthread_t));
+    int rc = threads && ids ? 0 : -1;
+    for (int k = 0; rc == 0 && k < nthreads; k++) {
+        ReplayThread* t = &threads[k];
+        t->trace = &trace;
+        t->speed = speed;
+        t->data = malloc(trace.max_data + 1);
+        t->latency = malloc(trace.count * sizeof(uint64_t));
+        t->failed = malloc(trace.count);
+        if (!t->data || !t->latency || !t->failed) {
+            rc = -1;
+            break;
+        }
+        // Texto pseudoaleatório de letras e espaços, igual em todas as threads
+        uint32_t x = 12345;
+        for (uint64_t i = 0; i < trace.max_data; i++) {
+            x = x * 1103515245u + 12345u;
+            t->data[i] = (x >> 16) % 8 == 0 ? ' ' : 'a' + (x >> 16) % 26;
+        }
+        t->data[trace.max_data] = '\0';
+        t->cwd = 0;
+        if (nthreads > 1) {
+            // Cada thread reproduz o trace inteiro no seu próprio diretório
+            snprintf(t->prefix, sizeof(t->prefix), "/replay%d", k);
+            current_inode_num = 0;
+            if (fs_create_directory(t->prefix) != 0 || fs_change_directory(t->prefix) != 0) rc = -1;
+            t->cwd = current_inode_num;
+        }
+    }
+
+    if (rc == 0) {
+        printf("Reproduzindo %zu chamadas com %d thread(s)%s...\n", trace.count, nthreads,
+               speed > 0 ? " no ritmo gravado" : " o mais rápido possível");
+        fflush(stdout);
+        // As mensagens de erro das chamadas reproduzidas não interessam aqui
+        fflush(stderr);
+        int saved_stderr = dup(STDERR_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) dup2(null_fd, STDERR_FILENO);
+
+        uint64_t base = now_ns();
+        int started = 0;
+        for (int k = 0; k < nthreads; k++) {
+            threads[k].base = base;
+            if (pthread_create(&ids[k], NULL, replay_thread, &threads[k]) != 0) break;
+            started++;
+        }
+        for (int k = 0; k < started; k++) pthread_join(ids[k], NULL);
+        uint64_t elapsed = now_ns() - base;
+
+        fflush(stderr);
+        if (saved_stderr >= 0) {
+            dup2(saved_stderr, STDERR_FILENO);
+            close(saved_stderr);
+        }
+        if (null_fd >= 0) close(null_fd);
+
+        if (started < nthreads) {
+            fprintf(stderr, "Erro: Não foi possível criar as threads da reprodução.\n");
+            rc = -1;
+        } else {
+            double seconds = elapsed / 1e9;
+            printf("%zu chamadas em %.3f s: %.0f chamadas/s.\n", trace.count * nthreads, seconds,
+                   trace.count * nthreads / seconds);
+            print_report(&trace, threads, nthreads);
+        }
+    } else {
+        fprintf(stderr, "Erro: Não foi possível preparar a reprodução.\n");
+    }
+
+    fs_unmount();
+    for (int k = 0; threads && k < nthreads; k++) {
+        free(threads[k].data);
+        free(threads[k].latency);
+        free(threads[k].failed);
+    }
+    free(threads);
+    free(ids);
+    trace_free(&trace);
+    return rc;
+}
@@ -0,0 +1,66 @@
+#!/bin/sh
+# tests/block_groups.sh
+# Cada grupo de blocos começa com os próprios bitmaps e a sua fatia da tabela
+# de i-nodes: o i-node de um arquivo novo e os seus dados ficam no grupo do
+# diretório pai. Também confere que o fsck repara os metadados de um grupo
+# marcados como livres no bitmap de blocos.
+# Uso: sh tests/block_groups.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (block_groups): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+OUT="$("$SIM" create 32768 1 2>&1)" || fail "'create' retornou erro" "$OUT"
+echo "$OUT" | grep -q "4 grupo(s) de 8192 blocos" || fail "o disco não tem 4 grupos" "$OUT"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+
+# Diretórios novos são espalhados: algum deles cai fora do grupo 0
+OUT="$( {
+    for d in a b c d; do echo "mkdir $d"; done
+    echo "set verbose on"
+    for d in a b c d; do echo "import dados.txt $d/f"; done
+    echo "set verbose off"
+    for d in a b c d; do echo "stat $d/f"; done
+    echo exit
+} | "$SIM" run 2>&1)"
+INODE_BLOCKS="$(echo "$OUT" | sed -n 's/.*Inicializando i-node \([0-9]*\) .*/\1/p' | while read -r ino; do
+    echo "$OUT" | sed -n "s/.*Escrevendo i-node $ino (Bloco: \([0-9]*\),.*/\1/p" | head -1
+done)"
+DATA_BLOCKS="$(echo "$OUT" | sed -n 's/.*Blocos de Dados: \[ \([0-9]*\) .*/\1/p')"
+[ "$(echo "$INODE_BLOCKS" | wc -l)" -eq 4 ] && [ "$(echo "$DATA_BLOCKS" | wc -l)" -eq 4 ] ||
+    fail "blocos dos i-nodes ou dos dados não encontrados" "$OUT"
+
+outside=0
+for k in 1 2 3 4; do
+    IB="$(echo "$INODE_BLOCKS" | sed -n "${k}p")"
+    DB="$(echo "$DATA_BLOCKS" | sed -n "${k}p")"
+    [ $((IB / 8192)) -eq $((DB / 8192)) ] || fail "i-node no bloco $IB e dados no bloco $DB estão em grupos diferentes" "$OUT"
+    if [ $((IB / 8192)) -gt 0 ]; then
+        # A fatia da tabela fica logo depois dos dois blocos de bitmap do grupo
+        [ $((IB % 8192)) -ge 2 ] && [ $((IB % 8192)) -lt $((DB % 8192)) ] ||
+            fail "o i-node no bloco $IB não está no início do próprio grupo" "$OUT"
+        outside=$((outside + 1))
+    fi
+done
+[ $outside -gt 0 ] || fail "nenhum arquivo foi criado fora do grupo 0" "$OUT"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+
+# Bitmap do grupo 2 (bloco 16384) zerado: os metadados do grupo aparecem livres
+rm -f meu_sistema.disk
+"$SIM" create 32768 1 --no-checksums > /dev/null 2>&1 || fail "'create --no-checksums' retornou erro"
+printf '\000' | dd of=meu_sistema.disk bs=1 seek=$((16384 * 1024)) conv=notrunc 2> /dev/null
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Bloco 16384 de metadados do grupo 2 livre no bitmap" || fail "fsck não notou os metadados livres" "$FSCK"
+"$SIM" fsck -y > /dev/null 2>&1
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck -y não reparou o bitmap do grupo" "$FSCK"
+echo "OK: metadados em cada grupo de blocos"
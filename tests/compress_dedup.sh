@@ -0,0 +1,45 @@
+#!/bin/sh
+# tests/compress_dedup.sh
+# Com '--compress --dedup', os blocos dos clusters comprimidos também são
+# compartilhados: importar o mesmo arquivo duas vezes não gasta blocos novos,
+# e regravar o último cluster (anexo) não deixa referências sobrando.
+# Uso: sh tests/compress_dedup.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (compress_dedup): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+used_blocks() {
+    echo "$1" | awk '/^Blocos/ { print $5 }' | tail -n 1
+}
+
+"$SIM" create 512 1 --compress --dedup > /dev/null 2>&1 || fail "'create' retornou erro"
+
+# Um arquivo que comprime bem e outro que não comprime (clusters crus); o
+# segundo termina com um bloco cheio e um parcial no último cluster
+awk 'BEGIN { for (k = 0; k < 600; k++) printf "linha %d\n", k % 40 }' | head -c 7000 > texto
+awk 'BEGIN { srand(7); for (k = 0; k < 10000; k++) printf "%c", 97 + int(rand() * 26) }' > aleatorio
+
+OUT="$(printf 'import texto t1\nimport aleatorio a1\ndf\nimport texto t2\nimport aleatorio a2\ndf\nexit\n' | "$SIM" run 2>&1)"
+ONE="$(echo "$OUT" | awk '/^Blocos/ { print $5; exit }')"
+TWO="$(used_blocks "$OUT")"
+[ -n "$ONE" ] && [ "$ONE" = "$TWO" ] || fail "as cópias comprimidas não foram deduplicadas ($ONE -> $TWO blocos)" "$OUT"
+
+OUT="$(printf 'echo "fim" >> a1\necho "fim" >> t1\nsync\ncat a2\nrm t2\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "$(head -c 60 aleatorio)" || fail "'cat' da cópia não mostrou o conteúdo" "$OUT"
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas após o anexo" "$FSCK"
+
+OUT="$(printf 'cat a1\ncat t1\nrm a1\nrm a2\nrm t1\ndf\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "[a-z]fim" || fail "o anexo no arquivo cru não aparece no 'cat'" "$OUT"
+[ "$(used_blocks "$OUT")" = "1" ] || fail "sobraram blocos após remover todos os arquivos" "$OUT"
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas após as remoções" "$FSCK"
+echo "OK: deduplicação de clusters comprimidos"
@@ -0,0 +1,74 @@
+#!/bin/sh
+# tests/defrag_shared.sh
+# O defrag junta os blocos de um arquivo fragmentado, mas não move blocos
+# compartilhados por reflink (movê-los desfaria o compartilhamento). Quando
+# a cópia some, o arquivo volta a poder ser realocado.
+# Uso: sh tests/defrag_shared.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (defrag_shared): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+read_file() {
+    printf 'cat %s\nexit\n' "$1" | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -c "$2"
+}
+
+blocks_of() {
+    echo "$2" | sed -n "/Estatísticas para: '$1'/,/Blocos de Dados/s/.*Blocos de Dados: \[ \(.*\) \]/\1/p"
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' | head -c 1024 > um.txt
+
+# O segundo bloco de cada arquivo é escrito depois de outros arquivos: dois
+# arquivos fragmentados, 'g' com uma cópia por reflink
+OUT="$( {
+    echo "import um.txt frag"
+    echo "import um.txt f2"
+    echo "import um.txt f3"
+    echo "write frag 1024 \"bloco dois\""
+    echo "rm f2"
+    echo "import um.txt g"
+    echo "write g 1024 \"segundo\""
+    echo "cp --reflink g clone"
+    echo "stat frag"
+    echo "stat g"
+    echo "defrag -c"
+    echo "stat frag"
+    echo "stat g"
+    echo "stat clone"
+    echo exit
+} | "$SIM" run 2>&1)"
+# 'g' é compartilhado: fica de fora da contagem e não é realocado
+echo "$OUT" | grep -q "fragmentados: 1 " || fail "o defrag não encontrou só 'frag' para juntar" "$OUT"
+FRAG="$(blocks_of frag "$OUT" | tail -1)"
+set -- $FRAG
+[ $# -eq 2 ] && [ $2 -eq $(($1 + 1)) ] || fail "'frag' continua fragmentado ($FRAG)" "$OUT"
+G="$(blocks_of g "$OUT")"
+[ "$(echo "$G" | head -1)" = "$(echo "$G" | tail -1)" ] || fail "o defrag moveu blocos compartilhados de 'g'" "$OUT"
+[ "$(blocks_of clone "$OUT")" = "$(echo "$G" | tail -1)" ] || fail "'g' e 'clone' não compartilham mais os blocos" "$OUT"
+
+{ cat um.txt; printf 'bloco dois'; } > esperado.txt
+read_file frag 1034 > lido.txt
+cmp -s esperado.txt lido.txt || fail "o defrag estragou 'frag'"
+{ cat um.txt; printf 'segundo'; } > esperado.txt
+read_file clone 1031 > lido.txt
+cmp -s esperado.txt lido.txt || fail "o defrag estragou 'clone'"
+
+# Sem a cópia, 'g' deixa de ser compartilhado e pode ser juntado
+OUT="$(printf 'rm clone\ndefrag -c\nstat g\nexit\n' | "$SIM" run 2>&1)"
+set -- $(blocks_of g "$OUT")
+[ $# -eq 2 ] && [ $2 -eq $(($1 + 1)) ] || fail "'g' não foi juntado depois de remover a cópia" "$OUT"
+read_file g 1031 > lido.txt
+cmp -s esperado.txt lido.txt || fail "realocar 'g' estragou o conteúdo"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: defrag com blocos compartilhados"
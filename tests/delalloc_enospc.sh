@@ -0,0 +1,48 @@
+#!/bin/sh
+# tests/delalloc_enospc.sh
+# Anexos adiados ('echo >>') reservam blocos na hora em que são aceitos: os
+# imports que vêm depois não podem usar esses blocos, e o 'sync' precisa
+# conseguir gravar tudo o que o shell já informou como escrito, mesmo com o
+# disco cheio.
+# Uso: sh tests/delalloc_enospc.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (delalloc_enospc): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+
+# 30 anexos de 900 bytes em três arquivos (9 blocos pendentes em cada) e
+# depois mais arquivos de 11 blocos do que o disco comporta
+TEXT="$(printf '%0900d' 0 | tr 0 x)"
+i=1
+while [ $i -le 48 ]; do
+    awk -v n=$i 'BEGIN { for (k = 0; k < 1000; k++) printf "%s-%09d\n", n, k }' | head -c 11264 > "h$i"
+    i=$((i + 1))
+done
+OUT="$( {
+    i=1
+    while [ $i -le 30 ]; do echo "echo \"$TEXT\" >> f$((i % 3 + 1))"; i=$((i + 1)); done
+    i=1
+    while [ $i -le 48 ]; do echo "import h$i i$i"; i=$((i + 1)); done
+    echo sync
+    echo exit
+} | "$SIM" run 2>&1)"
+
+[ "$(echo "$OUT" | grep -c "Texto escrito")" -eq 30 ] || fail "nem todo 'echo >>' foi aceito" "$OUT"
+echo "$OUT" | grep -q "Sem blocos de dados livres" || fail "os imports não chegaram a encher o disco" "$OUT"
+echo "$OUT" | grep -q "dados pendentes" && fail "a descarga dos anexos ficou sem espaço" "$OUT"
+
+OUT="$(printf 'cat f1\ncat f2\ncat f3\nexit\n' | "$SIM" run 2>&1)"
+[ "$(echo "$OUT" | grep -c "x\{9000\}")" -eq 3 ] || fail "os anexos não estão todos no disco" "$OUT"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: anexos adiados com o disco cheio"
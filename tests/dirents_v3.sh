@@ -0,0 +1,64 @@
+#!/bin/sh
+# tests/dirents_v3.sh
+# Entradas de diretório do v3: registros compactos (i-node little-endian,
+# tamanho do nome e o nome, alinhados a 4 bytes). Confere os bytes gravados,
+# o tamanho do diretório (soma dos registros), um rename que não cabe mais no
+# bloco cheio e a compactação depois de remoções.
+# Uso: sh tests/dirents_v3.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (dirents_v3): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+echo abc > a.txt
+
+# 16 nomes de 53 bytes (registros de 60) e um nome curto enchem o primeiro bloco
+L=nome_bem_comprido_para_encher_o_bloco_de_diretorio_
+OUT="$( {
+    echo "mkdir d"
+    i=10
+    while [ $i -le 25 ]; do echo "import a.txt d/$L$i"; i=$((i + 1)); done
+    echo "import a.txt d/x"
+    echo "rename d/x d/${L}99"
+    echo "stat d"
+    echo "ls d"
+    echo "stat /"
+    echo exit
+} | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "renomeado para 'd/${L}99'" || fail "o rename para um nome que não cabe no bloco falhou" "$OUT"
+echo "$OUT" | grep -q "<FILE>.*${L}99" || fail "a entrada renomeada sumiu" "$OUT"
+echo "$OUT" | grep -q "<FILE>.*x$" && fail "o nome antigo continua no diretório" "$OUT"
+# . e .. (8 bytes cada) + 17 registros de 60 bytes
+echo "$OUT" | grep -q "Tamanho.......: 1036 bytes" || fail "tamanho do diretório não é a soma dos registros" "$OUT"
+
+# O bloco da raiz começa com '.', '..' e 'd': i-node LE, tamanho do nome, nome
+ROOT="$(echo "$OUT" | sed -n 's/.*Blocos de Dados: \[ \([0-9]*\) \].*/\1/p' | tail -1)"
+[ -n "$ROOT" ] || fail "bloco da raiz não encontrado" "$OUT"
+BYTES="$(od -A n -t x1 -v -j $((ROOT * 1024)) -N 24 meu_sistema.disk | tr -s ' \n' ' ')"
+[ "$BYTES" = " 00 00 00 00 01 2e 00 00 00 00 00 00 02 2e 2e 00 01 00 00 00 01 64 00 00 " ] ||
+    fail "registros da raiz fora do formato v3" "$BYTES"
+
+OUT="$( {
+    i=10
+    while [ $i -le 20 ]; do echo "rm d/$L$i"; i=$((i + 1)); done
+    echo "defrag"
+    echo "stat d"
+    echo "ls d"
+    echo exit
+} | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "Diretórios compactados: 1" || fail "o defrag não compactou o diretório" "$OUT"
+echo "$OUT" | grep -q "Tamanho.......: 376 bytes" || fail "tamanho errado depois das remoções" "$OUT"
+echo "$OUT" | grep -q "Blocos de Dados: \[ [0-9]* \]" || fail "o diretório compactado ainda ocupa mais de um bloco" "$OUT"
+[ "$(echo "$OUT" | grep -c "<FILE>")" -eq 6 ] || fail "entradas perdidas na compactação" "$OUT"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: entradas de diretório compactas do v3"
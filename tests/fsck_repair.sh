@@ -0,0 +1,72 @@
+#!/bin/sh
+# tests/fsck_repair.sh
+# Corrompe o disco por fora (bitmap de blocos e tabela de referências) e
+# confere que o fsck aponta cada problema, que 'fsck -y' repara tudo sem
+# perder dados e que as referências reparadas protegem os blocos
+# compartilhados. O disco é criado sem checksums para que as alterações
+# manuais não virem erros de checksum.
+# Uso: sh tests/fsck_repair.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (fsck_repair): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+read_file() {
+    printf 'cat %s\nexit\n' "$1" | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -300
+}
+
+# Campo 'n' (u32 little-endian) do superbloco
+sb_field() {
+    od -A n -t u4 -j $(($1 * 4)) -N 4 meu_sistema.disk | tr -d ' '
+}
+
+peek() {
+    od -A n -t u1 -j "$1" -N 1 meu_sistema.disk | tr -d ' '
+}
+
+poke() {
+    printf "\\$(printf %o "$2")" | dd of=meu_sistema.disk bs=1 seek="$1" conv=notrunc 2> /dev/null
+}
+
+"$SIM" create 512 1 --no-checksums > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+OUT="$(printf 'mkdir d\nimport dados.txt d/a\ncp --reflink d/a d/b\nstat d/a\nexit\n' | "$SIM" run 2>&1)"
+FIRST="$(echo "$OUT" | sed -n 's/.*Blocos de Dados: \[ \([0-9]*\) .*/\1/p')"
+[ -n "$FIRST" ] || fail "blocos de 'd/a' não encontrados" "$OUT"
+
+BITMAP=$(($(sb_field 5) * 1024))
+LEAK=$(($(sb_field 7) + 200))
+# Primeiro bloco de 'd/a' livre no bitmap, um bloco sem dono marcado e a
+# tabela de referências zerada
+poke $((BITMAP + FIRST / 8)) $(($(peek $((BITMAP + FIRST / 8))) & ~(1 << (FIRST % 8))))
+poke $((BITMAP + LEAK / 8)) $(($(peek $((BITMAP + LEAK / 8))) | (1 << (LEAK % 8))))
+dd if=/dev/zero of=meu_sistema.disk bs=1024 seek="$(sb_field 11)" count=1 conv=notrunc 2> /dev/null
+
+FSCK="$("$SIM" fsck 2>&1)"
+[ $? -eq 4 ] || fail "fsck sem -y não retornou 4 com problemas" "$FSCK"
+for msg in "Bloco $FIRST em uso pelo i-node [0-9]* mas livre no bitmap" "Bloco $LEAK marcado como usado mas sem dono" \
+           "Bloco $FIRST: 0 referência(s) extra(s) registrada(s), 1 encontrada(s)"; do
+    echo "$FSCK" | grep -q "$msg" || fail "fsck não apontou '$msg'" "$FSCK"
+done
+echo "$FSCK" | grep -q "Blocos em uso não marcados..: 1" || fail "contagem de blocos não marcados errada" "$FSCK"
+
+"$SIM" fsck -y > /dev/null 2>&1
+FSCK="$("$SIM" fsck 2>&1)" || fail "fsck -y deixou problemas" "$FSCK"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck -y deixou problemas" "$FSCK"
+
+# Com as referências reparadas, remover uma cópia mantém a outra
+read_file d/a > lido.txt
+cmp -s dados.txt lido.txt || fail "'d/a' mudou com o reparo"
+printf 'rm d/a\nimport dados.txt d/c\nexit\n' | "$SIM" run > /dev/null 2>&1
+read_file d/b > lido.txt
+cmp -s dados.txt lido.txt || fail "'d/b' perdeu os blocos compartilhados depois do reparo"
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas no fim" "$FSCK"
+echo "OK: fsck encontra e repara bitmap e referências"
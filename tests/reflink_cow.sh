@@ -0,0 +1,57 @@
+#!/bin/sh
+# tests/reflink_cow.sh
+# 'cp --reflink' compartilha os blocos da origem (contagem de referências) e
+# a primeira escrita numa das cópias duplica só o bloco alterado. Remover uma
+# das cópias não pode liberar os blocos que a outra ainda usa.
+# Uso: sh tests/reflink_cow.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (reflink_cow): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+# Conteúdo de um arquivo do disco, sem o prompt e as mensagens do shell
+read_file() {
+    printf 'cat %s\nexit\n' "$1" | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -300
+}
+
+blocks_of() {
+    echo "$2" | sed -n "/Estatísticas para: '$1'/,/Blocos de Dados/s/.*Blocos de Dados: \[ \(.*\) \]/\1/p"
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+
+OUT="$(printf 'import dados.txt a\ncp --reflink a b\ncp a c\nstat a\nstat b\nstat c\ndf\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "copiado para 'b' (blocos compartilhados)" || fail "'cp --reflink' não compartilhou os blocos" "$OUT"
+A="$(blocks_of a "$OUT")"
+[ -n "$A" ] && [ "$A" = "$(blocks_of b "$OUT")" ] || fail "a cópia por reflink não usa os blocos da origem" "$OUT"
+[ "$A" != "$(blocks_of c "$OUT")" ] || fail "o 'cp' comum compartilhou os blocos" "$OUT"
+echo "$OUT" | grep -q "(3 KB economizados com blocos compartilhados)" || fail "o 'df' não contou os blocos compartilhados" "$OUT"
+
+# Escrita em 'b': só o primeiro bloco é duplicado
+OUT="$(printf 'write b 0 "XYZ"\nstat a\nstat b\nexit\n' | "$SIM" run 2>&1)"
+A2="$(blocks_of a "$OUT")"
+B2="$(blocks_of b "$OUT")"
+[ "$A2" = "$A" ] || fail "a escrita em 'b' moveu os blocos de 'a'" "$OUT"
+[ "${A2%% *}" != "${B2%% *}" ] && [ "${A2#* }" = "${B2#* }" ] || fail "a escrita não duplicou só o bloco alterado ($A2 / $B2)" "$OUT"
+read_file a > a_lido.txt
+cmp -s dados.txt a_lido.txt || fail "a escrita em 'b' alterou 'a'"
+sed '1s/^.../XYZ/' dados.txt > esperado.txt
+read_file b > b_lido.txt
+cmp -s esperado.txt b_lido.txt || fail "'b' não tem a escrita nova"
+
+# Sem 'a', os blocos que 'b' ainda usa continuam dela
+OUT="$(printf 'rm a\nimport dados.txt d\nexit\n' | "$SIM" run 2>&1)"
+read_file b > b_lido.txt
+cmp -s esperado.txt b_lido.txt || fail "remover 'a' estragou 'b'"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: cópias por reflink e cópia na escrita"
@@ -0,0 +1,52 @@
+#!/bin/sh
+# tests/server_client.sh
+# 'serve' monta o disco e atende num socket Unix; 'run --connect' manda os
+# comandos do shell para ele. Confere a ida e volta (escrita, leitura, ls,
+# import, du e find), o encerramento com Ctrl+C (SIGINT), que desmonta o
+# disco e remove o socket, e que tudo ficou gravado.
+# Uso: sh tests/server_client.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+SERVER=""
+trap '[ -n "$SERVER" ] && kill "$SERVER" 2> /dev/null; rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (server_client): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+
+"$SIM" serve fs.sock > servidor.log 2>&1 &
+SERVER=$!
+i=0
+while [ ! -S fs.sock ] && [ $i -lt 50 ]; do sleep 0.1; i=$((i + 1)); done
+[ -S fs.sock ] || fail "o servidor não criou o socket" "$(cat servidor.log)"
+
+OUT="$(printf 'mkdir d\necho "ola servidor" > d/t\ncat d/t\nimport dados.txt d/dados\nls d\ndu\nfind -name dados\nexit\n' |
+       "$SIM" run --connect fs.sock 2>&1)" || fail "o cliente retornou erro" "$OUT"
+for item in "Conectado ao servidor em 'fs.sock'" "Texto escrito em 'd/t'" "ola servidor" "<FILE>.*dados" \
+            "2902 .* d/" "/d/dados" "1 item(ns) encontrado(s)"; do
+    echo "$OUT" | grep -q "$item" || fail "'$item' não aparece na saída do cliente" "$OUT"
+done
+printf 'cat d/dados\nexit\n' | "$SIM" run --connect fs.sock 2> /dev/null |
+    sed -e 's/^fs:[^$]*\$ //' -e '/^Conectado /d' | head -300 > lido.txt
+cmp -s dados.txt lido.txt || fail "'cat' pelo cliente não devolveu o arquivo importado"
+
+kill -INT "$SERVER"
+wait "$SERVER"
+RC=$?
+SERVER=""
+[ $RC -eq 0 ] || fail "o servidor terminou com o código $RC" "$(cat servidor.log)"
+grep -q "Disco desmontado" servidor.log || fail "o servidor não desmontou o disco" "$(cat servidor.log)"
+[ -e fs.sock ] && fail "o socket continua no diretório"
+
+OUT="$(printf 'cat d/t\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "ola servidor" || fail "a escrita feita pelo cliente não ficou no disco" "$OUT"
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: servidor e cliente pelo socket"
@@ -0,0 +1,57 @@
+#!/bin/sh
+# tests/sparse_files.sh
+# Arquivos esparsos: 'truncate' para cima cria um buraco sem alocar blocos,
+# 'write' no meio aloca só o bloco escrito, 'punch' libera um intervalo (que
+# passa a ser lido como zeros) e 'truncate' para baixo libera o fim.
+# Uso: sh tests/sparse_files.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (sparse_files): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+# Bytes de um arquivo do disco, sem o prompt e as mensagens do shell
+read_file() {
+    printf 'cat %s\nexit\n' "$1" | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -c "$2"
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+
+OUT="$(printf 'truncate s 10000\nstat s\nwrite s 5000 "meio"\nstat s\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "Arquivo 's' agora tem 10000 bytes" || fail "'truncate' não estendeu o arquivo" "$OUT"
+echo "$OUT" | grep -q "Blocos de Dados: \[ \]" || fail "o buraco do 'truncate' alocou blocos" "$OUT"
+echo "$OUT" | grep -q "Blocos de Dados: \[ [0-9]* \]" || fail "o 'write' no meio não alocou exatamente um bloco" "$OUT"
+{ head -c 5000 /dev/zero; printf 'meio'; head -c 4996 /dev/zero; } > esperado.txt
+read_file s 10000 > lido.txt
+cmp -s esperado.txt lido.txt || fail "o arquivo esparso não é lido como zeros fora do trecho escrito"
+
+# Punch no segundo bloco: o bloco é liberado e lido como zeros
+OUT="$(printf 'import dados.txt p\ndf\npunch p 1024 1024\nstat p\ndf\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "Intervalo liberado em 'p'" || fail "'punch' falhou" "$OUT"
+echo "$OUT" | grep -q "Tamanho.......: 2890 bytes" || fail "'punch' mudou o tamanho" "$OUT"
+[ "$(echo "$OUT" | sed -n 's/.*Blocos de Dados: \[ \(.*\) \]/\1/p' | wc -w)" -eq 2 ] || fail "'punch' não liberou o bloco" "$OUT"
+USED="$(echo "$OUT" | sed -n 's/^Blocos *| *[0-9]* | *\([0-9]*\) .*/\1/p')"
+[ "$(echo "$USED" | tail -1)" -eq $(($(echo "$USED" | head -1) - 1)) ] || fail "o 'df' não mostra o bloco liberado" "$OUT"
+{ head -c 1024 dados.txt; head -c 1024 /dev/zero; tail -c +2049 dados.txt; } > esperado.txt
+read_file p 2890 > lido.txt
+cmp -s esperado.txt lido.txt || fail "o intervalo liberado não é lido como zeros"
+
+# Truncate para baixo libera os blocos do fim
+OUT="$(printf 'truncate p 100\nstat p\ntruncate s 0\nstat s\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "Tamanho.......: 100 bytes" || fail "'truncate' não reduziu 'p'" "$OUT"
+[ "$(echo "$OUT" | sed -n 's/.*Blocos de Dados: \[ \(.*\) \]/\1/p' | head -1 | wc -w)" -eq 1 ] || fail "'truncate' não liberou o fim de 'p'" "$OUT"
+echo "$OUT" | grep -q "Blocos de Dados: \[ \]" || fail "'truncate s 0' não liberou os blocos" "$OUT"
+head -c 100 dados.txt > esperado.txt
+read_file p 100 > lido.txt
+cmp -s esperado.txt lido.txt || fail "'truncate' estragou o início de 'p'"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas" "$FSCK"
+echo "OK: arquivos esparsos, truncate e punch"
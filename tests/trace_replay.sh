@@ -0,0 +1,55 @@
+#!/bin/sh
+# tests/trace_replay.sh
+# 'run --record' grava as chamadas do shell e 'replay' as repete num disco
+# novo com a mesma geometria. Confere que o replay refaz a árvore, que um
+# disco existente só é sobrescrito com --force (nem o disco principal passado
+# em --disk) e que --disk escolhe outro arquivo.
+# Uso: sh tests/trace_replay.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (trace_replay): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+"$SIM" create 512 1 > /dev/null 2>&1 || fail "'create' retornou erro"
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d\n", k }' > dados.txt
+OUT="$(printf 'mkdir d\nimport dados.txt d/a\ncp --reflink d/a d/b\necho "oi" > d/t\ncat d/t\nls d\nrm d/b\nexit\n' |
+       "$SIM" run --record carga.trace 2>&1)" || fail "'run --record' retornou erro" "$OUT"
+[ -s carga.trace ] || fail "o trace não foi gravado" "$OUT"
+ORIGINAL="$(cksum < meu_sistema.disk)"
+
+OUT="$("$SIM" replay carga.trace 2>&1)" || fail "'replay' retornou erro" "$OUT"
+echo "$OUT" | grep -q "Reproduzindo 7 chamadas" || fail "o replay não repetiu as 7 chamadas" "$OUT"
+for op in mkdir import cp echo cat ls rm; do
+    echo "$OUT" | grep -q "^$op  *1  *0 " || fail "'$op' não aparece uma vez e sem falhas no relatório" "$OUT"
+done
+[ -f replay.disk ] || fail "o replay não criou replay.disk" "$OUT"
+[ "$(cksum < meu_sistema.disk)" = "$ORIGINAL" ] || fail "o replay alterou o disco principal"
+
+# O disco do replay tem a mesma árvore: confere com o simulador num diretório
+# à parte. O trace guarda só o tamanho do texto do 'echo', não o conteúdo.
+mkdir confere
+cp replay.disk confere/meu_sistema.disk
+OUT="$(cd confere && printf 'ls d\nstat d/a\nstat d/t\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "<FILE>.*a$" && echo "$OUT" | grep -q "<FILE>.*t$" || fail "a árvore do replay não confere" "$OUT"
+echo "$OUT" | grep -q "Tamanho.......: 2890 bytes" && echo "$OUT" | grep -q "Tamanho.......: 2 bytes" ||
+    fail "os tamanhos dos arquivos do replay não conferem" "$OUT"
+echo "$OUT" | grep -q "<FILE>.*b$" && fail "o 'rm' não foi repetido" "$OUT"
+FSCK="$(cd confere && "$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas no disco do replay" "$FSCK"
+
+# Discos existentes só com --force
+OUT="$("$SIM" replay carga.trace 2>&1)" && fail "o replay sobrescreveu replay.disk sem --force" "$OUT"
+echo "$OUT" | grep -q "'replay.disk' já existe" || fail "mensagem de disco existente ausente" "$OUT"
+OUT="$("$SIM" replay carga.trace --disk meu_sistema.disk 2>&1)" && fail "o replay sobrescreveu o disco principal" "$OUT"
+[ "$(cksum < meu_sistema.disk)" = "$ORIGINAL" ] || fail "o disco principal mudou sem --force"
+OUT="$("$SIM" replay carga.trace --force 2>&1)" || fail "'replay --force' retornou erro" "$OUT"
+OUT="$("$SIM" replay carga.trace --disk outro.disk 2>&1)" || fail "'replay --disk' retornou erro" "$OUT"
+[ -f outro.disk ] || fail "--disk não criou outro.disk" "$OUT"
+echo "OK: gravação e replay de traces"
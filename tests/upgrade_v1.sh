@@ -0,0 +1,34 @@
+#!/bin/sh
+# tests/upgrade_v1.sh
+# Converte um disco criado pelo 'create' da primeira versão do simulador
+# (formato v1, tabela de i-nodes reservada pelo total de bytes, sem checksums)
+# e confere que a árvore, o conteúdo e a consistência sobrevivem ao 'upgrade'.
+# A imagem em data/v1_baseline.disk.gz foi gerada por aquela versão com:
+#   create 512 1
+#   mkdir docs; import notas.txt notas.txt; cd docs; import dados.txt dados.txt
+#   mkdir sub; cd sub; import notas.txt copia.txt
+# Uso: sh tests/upgrade_v1.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+DATA="$(cd "$(dirname "$0")" && pwd)/data"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (upgrade_v1): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+gunzip -c "$DATA/v1_baseline.disk.gz" > meu_sistema.disk || fail "não foi possível extrair a imagem"
+"$SIM" upgrade > /dev/null 2>&1 || fail "'upgrade' retornou erro"
+
+OUT="$(printf 'ls\nls docs\nls docs/sub\ncat docs/sub/copia.txt\nexit\n' | "$SIM" run 2>&1)"
+for item in "<DIR>.*docs" "<FILE>.*notas.txt" "<FILE>.*dados.txt" "<DIR>.*sub" "<FILE>.*copia.txt" "conteudo do arquivo de teste"; do
+    echo "$OUT" | grep -q "$item" || fail "'$item' não aparece depois do upgrade" "$OUT"
+done
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas depois do upgrade" "$FSCK"
+echo "OK: upgrade de um disco v1"
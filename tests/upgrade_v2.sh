@@ -0,0 +1,52 @@
+#!/bin/sh
+# tests/upgrade_v2.sh
+# Converte um disco v2 (entradas de diretório de 64 bytes com buracos,
+# clusters comprimidos e deduplicados, tabelas laterais na ordem do host) para
+# o v3 e confere que a árvore, o conteúdo e a consistência sobrevivem.
+# A imagem em data/v2_baseline.disk.gz foi gerada pela versão v2 com:
+#   create 512 1 --compress --dedup
+#   mkdir docs; import rel.txt docs/rel.txt; import rel.txt docs/rel_copia.txt
+#   import curto.txt docs/arquivo_numero_N.txt (N = 1..20)
+#   rm docs/arquivo_numero_3.txt; rm docs/arquivo_numero_7.txt
+#   mkdir docs/um_diretorio_com_um_nome_bem_comprido_para_testar_registros
+# onde rel.txt tem 300 linhas "linha <k % 7> do relatorio" e curto.txt
+# contém "conteudo curto".
+# Uso: sh tests/upgrade_v2.sh <caminho do simulador>
+
+SIM="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+DATA="$(cd "$(dirname "$0")" && pwd)/data"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+fail() {
+    echo "FALHOU (upgrade_v2): $1"
+    [ -n "$2" ] && echo "$2"
+    exit 1
+}
+
+gunzip -c "$DATA/v2_baseline.disk.gz" > meu_sistema.disk || fail "não foi possível extrair a imagem"
+OUT="$("$SIM" upgrade 2>&1)" || fail "'upgrade' retornou erro" "$OUT"
+echo "$OUT" | grep -q "convertido para o formato v3" || fail "'upgrade' não converteu para o v3" "$OUT"
+OUT="$("$SIM" upgrade 2>&1)" || fail "o segundo 'upgrade' retornou erro" "$OUT"
+echo "$OUT" | grep -q "já está no formato v3" || fail "o segundo 'upgrade' não reconheceu o v3" "$OUT"
+
+awk 'BEGIN { for (k = 0; k < 300; k++) printf "linha %d do relatorio\n", k % 7 }' > rel.txt
+printf 'cat docs/rel.txt\nexit\n' | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -300 > rel_lido.txt
+cmp -s rel.txt rel_lido.txt || fail "docs/rel.txt mudou com o upgrade"
+printf 'cat docs/rel_copia.txt\nexit\n' | "$SIM" run 2> /dev/null | sed -e 's/^fs:[^$]*\$ //' -e '/^Disco /d' -e '/^Shell /d' | head -300 > rel_lido.txt
+cmp -s rel.txt rel_lido.txt || fail "docs/rel_copia.txt mudou com o upgrade"
+
+OUT="$(printf 'ls docs\ncat docs/arquivo_numero_20.txt\nexit\n' | "$SIM" run 2>&1)"
+for item in "<FILE>.*rel_copia.txt" "<FILE>.*arquivo_numero_1.txt" "<FILE>.*arquivo_numero_20.txt" "<DIR>.*um_diretorio_com_um_nome_bem_comprido_para_testar_registros" "conteudo curto"; do
+    echo "$OUT" | grep -q "$item" || fail "'$item' não aparece depois do upgrade" "$OUT"
+done
+echo "$OUT" | grep -q "arquivo_numero_3.txt" && fail "uma entrada removida no v2 voltou" "$OUT"
+
+# As entradas convertidas continuam editáveis: renomear para um nome maior e remover
+OUT="$(printf 'cd docs\nrename arquivo_numero_1.txt arquivo_com_um_nome_bem_maior_que_o_anterior.txt\nrm arquivo_numero_2.txt\nls\nexit\n' | "$SIM" run 2>&1)"
+echo "$OUT" | grep -q "<FILE>.*arquivo_com_um_nome_bem_maior_que_o_anterior.txt" || fail "o rename depois do upgrade falhou" "$OUT"
+
+FSCK="$("$SIM" fsck 2>&1)"
+echo "$FSCK" | grep -q "Nenhum problema encontrado" || fail "fsck encontrou problemas depois do upgrade" "$FSCK"
+echo "OK: upgrade de um disco v2"